@@ -0,0 +1,42 @@
+#version 450
+
+// Specialization constants, see GraphicsPipeline::MeshVariant.
+layout(constant_id = 0) const bool kLighting = true;
+layout(constant_id = 1) const uint kView     = 0; // 0 shaded, 1 normals, 2 instances, 3 overdraw
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) flat in uint inInstance;
+
+layout(location = 0) out vec4 Color;
+
+// Added per shaded fragment in the overdraw view: ten layers read as white.
+const vec3 kOverdrawStep = vec3(0.10, 0.05, 0.02);
+
+void main()
+{
+    if (kView == 3)
+    {
+        Color = vec4(kOverdrawStep, 0.0);
+        return;
+    }
+
+    vec3 base = vec3(1.0);
+    if (kView == 1)
+    {
+        base = normalize(inNormal) * 0.5 + 0.5;
+    }
+    else if (kView == 2)
+    {
+        uint hash = inInstance * 2654435761u;
+        base = vec3((hash >> 8) & 255u, (hash >> 16) & 255u, (hash >> 24) & 255u) / 255.0;
+    }
+
+    if (kLighting)
+    {
+        vec3 lightDir = normalize(vec3(0.4, 1.0, 0.3));
+        float diffuse = max(dot(normalize(inNormal), lightDir), 0.0);
+        base *= 0.15 + 0.85 * diffuse;
+    }
+
+    Color = vec4(base, 1.0);
+}
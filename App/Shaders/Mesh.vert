@@ -0,0 +1,32 @@
+#version 450
+
+layout(std430, set = 0, binding = 0) readonly buffer Models
+{
+    mat4 models[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+// The depth prepass and the EQUAL color pass must produce identical depth.
+invariant gl_Position;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) flat out uint outInstance;
+
+layout(std140, set = 1, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPosition;
+} frame;
+
+void main()
+{
+    mat4 model  = models[gl_InstanceIndex];
+    gl_Position = frame.viewProj * model * vec4(inPosition, 1.0);
+    outNormal   = mat3(model) * inNormal;
+    outInstance = uint(gl_InstanceIndex);
+}
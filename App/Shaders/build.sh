@@ -4,8 +4,21 @@ set -euo pipefail
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 
 BUILD_DIR="$SCRIPT_DIR/bin"
-FRAG_S="Fragment.frag"
-VERT_S="Vertex.vert"
+SHADERS=(
+    "Fragment.frag"
+    "Vertex.vert"
+    "Mesh.vert"
+    "Mesh.frag"
+    "ClusterCull.comp"
+    "HiZReduce.comp"
+    "OcclusionCull.comp"
+    "BloomDownsample.comp"
+    "BloomUpsample.comp"
+    "Tonemap.comp"
+)
 
-glslc $SCRIPT_DIR/$FRAG_S -o $BUILD_DIR/$FRAG_S.spv
-glslc $SCRIPT_DIR/$VERT_S -o $BUILD_DIR/$VERT_S.spv
\ No newline at end of file
+mkdir -p $BUILD_DIR
+
+for SHADER in "${SHADERS[@]}"; do
+    glslc $SCRIPT_DIR/$SHADER -o $BUILD_DIR/$SHADER.spv
+done
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "Visuals/Camera.h"
+#include "Visuals/Clusters.h"
+#include "Visuals/Mesh.h"
+
+// Triangles submitted vs rendered for a clustered mesh while the camera orbits it.
+// Runs the CPU reference of ClusterCull.comp so it works without a GPU.
+// Usage: SkyClusterCullBench <mesh.skym> [frames]
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <mesh.skym> [frames]" << std::endl;
+        return 1;
+    }
+
+    int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 360;
+
+    Visuals::Mesh::Mapped mapped;
+    try
+    {
+        Visuals::Mesh::Map(argv[1], mapped);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    const Visuals::MeshFormat::Header& header = *mapped.header;
+    if (0 == header.meshletCount)
+    {
+        std::cerr << argv[1] << " has no clusters, repack it with SkyMeshPacker --clusters" << std::endl;
+        Visuals::Mesh::Unmap(mapped);
+        return 1;
+    }
+
+    const Visuals::MeshFormat::Meshlet* meshlets = Visuals::Mesh::Meshlets(mapped);
+    VkExtent2D extent{1280, 720};
+    Visuals::Camera::State camera;
+
+    uint64_t submitted = 0, rendered = 0, frustumCulled = 0, backfaceCulled = 0;
+    std::chrono::nanoseconds cullTime{0};
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // Full turn over the run, including views from inside the bounds' shadow.
+        Visuals::Camera::Orbit(camera, header.bounds, frame * (4.0 * 3.14159265 / frames));
+
+        glm::mat4 viewProj = Visuals::Camera::Projection(camera, extent) * Visuals::Camera::View(camera);
+        glm::vec4 planes[6];
+        Visuals::Camera::FrustumPlanes(viewProj, planes);
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < header.meshletCount; ++i)
+        {
+            switch (Visuals::Clusters::Test(meshlets[i], planes, camera.position))
+            {
+                case Visuals::Clusters::Result::Visible:        rendered += meshlets[i].triangleCount; break;
+                case Visuals::Clusters::Result::FrustumCulled:  frustumCulled++; break;
+                case Visuals::Clusters::Result::BackfaceCulled: backfaceCulled++; break;
+            }
+        }
+        cullTime += std::chrono::steady_clock::now() - start;
+
+        submitted += header.indexCount / 3;
+    }
+
+    double clusterTests = static_cast<double>(header.meshletCount) * frames;
+
+    std::cout << "clusters:            " << header.meshletCount << " (" << (header.indexCount / 3) / header.meshletCount << " tris avg)" << std::endl;
+    std::cout << "frames:              " << frames << std::endl;
+    std::cout << "triangles submitted: " << submitted / frames << " / frame" << std::endl;
+    std::cout << "triangles rendered:  " << rendered / frames << " / frame (" << 100.0 * rendered / submitted << "%)" << std::endl;
+    std::cout << "frustum culled:      " << 100.0 * frustumCulled / clusterTests << "% of clusters" << std::endl;
+    std::cout << "backface culled:     " << 100.0 * backfaceCulled / clusterTests << "% of clusters" << std::endl;
+    std::cout << "cpu cull cost:       " << cullTime.count() / clusterTests << " ns / cluster" << std::endl;
+
+    Visuals::Mesh::Unmap(mapped);
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "Visuals/Dispatch.h"
+#include "Visuals/GraphicsPipeline.h"
+#include "Visuals/Headless.h"
+
+// CPU cost per recorded command, through the loader's exported trampolines
+// against the Dispatch table loaded from vkGetDeviceProcAddr. Records one
+// command buffer of N draws, and one of N pipeline binds plus draws like a
+// heavy unbatched scene, without submitting either; the median of the runs
+// is reported. Validation layers are not enabled, so the difference is the
+// loader's own indirection.
+// Usage: SkyDispatchBench [draws] [runs] [device index | cpu]
+
+using namespace Visuals;
+
+enum class Path
+{
+    Loader,
+    Direct
+};
+
+// Nanoseconds per call of the recorded loop.
+static double Record(Headless::Frame& frame, Headless::Target& target, VkPipeline pipelines[2], uint32_t draws, bool binds, Path path)
+{
+    Dispatch::DeviceTable& vk = Dispatch::Device();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(frame.commandBuffer, 0);
+    vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+    Headless::BeginPass(frame.commandBuffer, target);
+    vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);
+
+    auto start = std::chrono::steady_clock::now();
+    if (Path::Loader == path)
+    {
+        for (uint32_t i = 0; i < draws; ++i)
+        {
+            if (binds)
+            {
+                vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i & 1]);
+            }
+            vkCmdDraw(frame.commandBuffer, 3, 1, 0, i);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < draws; ++i)
+        {
+            if (binds)
+            {
+                vk.CmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i & 1]);
+            }
+            vk.CmdDraw(frame.commandBuffer, 3, 1, 0, i);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    vkCmdEndRenderPass(frame.commandBuffer);
+    vkEndCommandBuffer(frame.commandBuffer);
+
+    double calls = binds ? 2.0 * draws : draws;
+    return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+static double Median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t draws  = argc > 1 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[1]))) : 100000;
+    int      runs   = argc > 2 ? std::max(1, std::atoi(argv[2])) : 15;
+    int32_t  device = argc > 3 ? (0 == strcmp(argv[3], "cpu") ? Headless::kPickCpu : std::atoi(argv[3])) : 0;
+
+    Headless::Context context;
+    Headless::Target  target;
+    Headless::Frame   frame;
+    VkPipeline        pipelines[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkPipelineLayout  layouts[2]   = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+
+    try
+    {
+        Headless::Create("SkyDispatchBench", device, context);
+        Headless::CreateTarget(context, VkExtent2D{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, 1, target);
+        Headless::CreateFrame(context, frame);
+
+        // Two identical pipelines, so every bind is a real state change.
+        for (int i = 0; i < 2; ++i)
+        {
+            GraphicsPipeline::Create(pipelines[i], context.device, target.extent, layouts[i], target.renderPass, target.samples);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "[dispatch] " << draws << " draws, " << runs << " runs, on " << context.properties.deviceName << std::endl;
+
+    const char* names[] = {"draw", "bind + draw"};
+    for (int binds = 0; binds < 2; ++binds)
+    {
+        std::vector<double> samples[2];
+        for (int run = 0; run <= runs; ++run)
+        {
+            // Alternate the order so neither path always runs on a warm cache.
+            Path first  = 0 == run % 2 ? Path::Loader : Path::Direct;
+            Path second = Path::Loader == first ? Path::Direct : Path::Loader;
+            double firstNs  = Record(frame, target, pipelines, draws, 1 == binds, first);
+            double secondNs = Record(frame, target, pipelines, draws, 1 == binds, second);
+
+            // Run 0 warms up.
+            if (run > 0)
+            {
+                samples[static_cast<int>(first)].push_back(firstNs);
+                samples[static_cast<int>(second)].push_back(secondNs);
+            }
+        }
+
+        double loader = Median(samples[static_cast<int>(Path::Loader)]);
+        double direct = Median(samples[static_cast<int>(Path::Direct)]);
+        std::cout << std::fixed << std::setprecision(2)
+                  << "[" << names[binds] << "] loader " << loader << " ns/call, direct " << direct << " ns/call"
+                  << ", saved " << loader - direct << " ns (" << (loader > 0.0 ? 100.0 * (loader - direct) / loader : 0.0) << "%)"
+                  << ", " << (loader - direct) * draws * (binds ? 2 : 1) * 1e-6 << " ms per frame of " << draws << " draws" << std::endl;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        GraphicsPipeline::Destroy(context.device, pipelines[i], layouts[i]);
+    }
+    Headless::DestroyFrame(context, frame);
+    Headless::DestroyTarget(context, target);
+    Headless::Destroy(context);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Visuals/Camera.h"
+#include "Visuals/FrustumCull.h"
+
+// Objects per nanosecond for FrustumCull over random spheres and boxes, for
+// every instruction set this CPU supports and 1..N job workers. Each variant has
+// to produce the scalar reference's visible index list on every frame.
+// Usage: SkyFrustumCullBench [objects] [frames]
+
+using namespace Visuals;
+
+template <typename Bounds>
+static bool Run(const char* kind, const Bounds& bounds, const std::vector<std::vector<glm::vec4>>& frames, FrustumCull::Isa isa, Jobs::Scheduler& jobs, const std::vector<std::vector<uint32_t>>& reference)
+{
+    std::vector<uint32_t> visible(bounds.Count());
+    uint64_t visibleTotal = 0;
+    bool     matches      = true;
+    double   ns           = 0.0;
+
+    // Only the cull is timed, the comparison with the reference is not.
+    for (size_t frame = 0; frame < frames.size(); ++frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Jobs::BeginFrame(jobs);
+        uint32_t count = FrustumCull::Cull(bounds, frames[frame].data(), visible.data(), isa, &jobs);
+        ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        // Both lists are ascending.
+        visibleTotal += count;
+        matches = matches && reference[frame].size() == count && std::equal(reference[frame].begin(), reference[frame].end(), visible.begin());
+    }
+
+    double tested = static_cast<double>(bounds.Count()) * frames.size();
+    std::cout << std::left << std::setw(8) << kind << std::setw(8) << FrustumCull::IsaName(isa) << std::right << std::setw(3) << jobs.workerCount << " workers  "
+              << std::fixed << std::setprecision(3) << std::setw(8) << tested / ns << " objects/ns  "
+              << std::setprecision(1) << std::setw(5) << 100.0 * visibleTotal / tested << "% visible"
+              << (matches ? "" : "  MISMATCH") << std::endl;
+    return matches;
+}
+
+template <typename Bounds>
+static std::vector<std::vector<uint32_t>> Reference(const Bounds& bounds, const std::vector<std::vector<glm::vec4>>& frames)
+{
+    std::vector<uint32_t> visible(bounds.Count());
+    std::vector<std::vector<uint32_t>> lists;
+    for (const auto& planes : frames)
+    {
+        uint32_t count = FrustumCull::Cull(bounds, planes.data(), visible.data(), FrustumCull::Isa::Scalar);
+        lists.emplace_back(visible.begin(), visible.begin() + count);
+    }
+    return lists;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t objects = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 1000000;
+    int frameCount   = argc > 2 ? std::atoi(argv[2]) : 60;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+    FrustumCull::Spheres spheres;
+    FrustumCull::Boxes boxes;
+    for (uint32_t i = 0; i < objects; ++i)
+    {
+        glm::vec3 center(position(rng), position(rng), position(rng));
+        glm::vec3 extent(size(rng), size(rng), size(rng));
+        spheres.Add(glm::vec4(center, size(rng)));
+        boxes.Add(center - extent, center + extent);
+    }
+
+    // Camera at the center turning a full circle, so roughly a sixth is visible.
+    VkExtent2D extent{1280, 720};
+    Camera::State camera;
+    camera.position = glm::vec3(0.0f);
+    camera.zNear    = 0.1f;
+    camera.zFar     = 1000.0f;
+
+    std::vector<std::vector<glm::vec4>> frames(frameCount, std::vector<glm::vec4>(6));
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        float angle   = frame * (2.0f * 3.14159265f / frameCount);
+        camera.target = glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+        Camera::FrustumPlanes(Camera::Projection(camera, extent) * Camera::View(camera), frames[frame].data());
+    }
+
+    std::vector<FrustumCull::Isa> isas = {FrustumCull::Isa::Scalar};
+    if (FrustumCull::DetectIsa() >= FrustumCull::Isa::SSE)
+    {
+        isas.push_back(FrustumCull::Isa::SSE);
+    }
+    if (FrustumCull::DetectIsa() >= FrustumCull::Isa::AVX2)
+    {
+        isas.push_back(FrustumCull::Isa::AVX2);
+    }
+
+    std::vector<uint32_t> workerCounts = {1};
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t workers = 2; workers <= hardware; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    if (workerCounts.back() != hardware)
+    {
+        workerCounts.push_back(hardware);
+    }
+
+    std::cout << objects << " objects, " << frameCount << " frames" << std::endl;
+
+    std::vector<std::vector<uint32_t>> sphereReference = Reference(spheres, frames);
+    std::vector<std::vector<uint32_t>> boxReference    = Reference(boxes, frames);
+
+    bool ok = true;
+    for (const char* kind : {"spheres", "boxes"})
+    {
+        for (FrustumCull::Isa isa : isas)
+        {
+            for (uint32_t workers : workerCounts)
+            {
+                Jobs::Scheduler jobs;
+                Jobs::Create(jobs, workers);
+                if ('s' == kind[0])
+                {
+                    ok = Run(kind, spheres, frames, isa, jobs, sphereReference) && ok;
+                }
+                else
+                {
+                    ok = Run(kind, boxes, frames, isa, jobs, boxReference) && ok;
+                }
+                Jobs::Destroy(jobs);
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "Visuals/Camera.h"
+#include "Visuals/FrustumCull.h"
+#include "Visuals/Jobs.h"
+#include "Visuals/Scene.h"
+
+// Milliseconds per synthetic frame on 1..N job workers, with the same job
+// graph Visuals::Loop uses minus the GPU: scene update and camera, then the
+// frustum cull, plus a spray of small per-object jobs standing in for
+// gameplay. Every worker count has to produce the same visible counts.
+// Usage: SkyJobsBench [groups] [objectsPerGroup] [frames]
+
+using namespace Visuals;
+
+struct World
+{
+    Scene::Graph          scene;
+    std::vector<uint32_t> groups;
+    FrustumCull::Spheres  spheres;
+    std::vector<uint32_t> visible;
+    std::vector<float>    simulation;
+    glm::vec4             planes[6];
+    uint32_t              visibleCount = 0;
+};
+
+static void Animate(World& world, Jobs::Scheduler& jobs, float time)
+{
+    for (size_t group = 0; group < world.groups.size(); group += 2)
+    {
+        glm::vec3 position(std::cos(time + group) * 4.0f, std::sin(time * 1.5f + group) * 4.0f, 0.0f);
+        Scene::SetPosition(world.scene, world.groups[group], position);
+    }
+
+    Scene::Update(world.scene, &jobs);
+
+    for (uint32_t slot = world.scene.changedBegin; slot < world.scene.changedEnd; ++slot)
+    {
+        world.spheres.Set(slot, world.scene.worldSphere[slot]);
+    }
+}
+
+static double Run(World& world, uint32_t workers, int frames, std::vector<uint32_t>& counts)
+{
+    Jobs::Scheduler jobs;
+    Jobs::Create(jobs, workers);
+
+    Camera::State camera;
+    camera.position = glm::vec3(0.0f, 0.0f, -300.0f);
+    camera.zNear    = 0.1f;
+    camera.zFar     = 2000.0f;
+    VkExtent2D extent{1280, 720};
+
+    counts.clear();
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        float time = frame / 60.0f;
+
+        Jobs::BeginFrame(jobs);
+        Jobs::Counter prepared;
+        Jobs::Counter culled;
+        Jobs::Counter simulated;
+
+        Jobs::Run(jobs, [&world, &jobs, time]() { Animate(world, jobs, time); }, &prepared);
+        Jobs::Run(jobs, [&world, &camera, &extent, time]()
+        {
+            camera.target = glm::vec3(std::sin(time) * 300.0f, 0.0f, 0.0f);
+            Camera::FrustumPlanes(Camera::Projection(camera, extent) * Camera::View(camera), world.planes);
+        }, &prepared);
+        Jobs::RunAfter(jobs, prepared, [&world, &jobs]()
+        {
+            world.visibleCount = FrustumCull::Cull(world.spheres, world.planes, world.visible.data(), FrustumCull::DetectIsa(), &jobs);
+        }, &culled);
+
+        // Many tiny independent jobs, the case stealing is for.
+        uint32_t slice = 256;
+        for (uint32_t begin = 0; begin < world.simulation.size(); begin += slice)
+        {
+            float* values = world.simulation.data();
+            uint32_t end  = std::min<uint32_t>(static_cast<uint32_t>(world.simulation.size()), begin + slice);
+            Jobs::Run(jobs, [values, begin, end, time]()
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    values[i] = std::sin(values[i] + time) * 0.5f + std::cos(values[i] * 0.25f);
+                }
+            }, &simulated);
+        }
+
+        Jobs::Wait(jobs, culled);
+        Jobs::Wait(jobs, simulated);
+        counts.push_back(world.visibleCount);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    Jobs::Destroy(jobs);
+    return ms / frames;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t groupCount      = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 256;
+    uint32_t objectsPerGroup = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 1024;
+    int      frames          = argc > 3 ? std::atoi(argv[3]) : 120;
+
+    World world;
+    uint32_t root = Scene::Add(world.scene, Scene::kNone, Scene::Transform{});
+    for (uint32_t group = 0; group < groupCount; ++group)
+    {
+        Scene::Transform transform;
+        transform.position = glm::vec3((group % 16) * 40.0f - 300.0f, (group / 16) * 40.0f - 300.0f, 0.0f);
+        world.groups.push_back(Scene::Add(world.scene, root, transform));
+
+        for (uint32_t object = 0; object < objectsPerGroup; ++object)
+        {
+            Scene::Transform local;
+            local.position = glm::vec3((object % 32) * 1.2f - 19.0f, (object / 32) * 1.2f - 19.0f, (object % 7) * 3.0f);
+            Scene::Add(world.scene, world.groups.back(), local, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
+        }
+    }
+
+    uint32_t count = Scene::Count(world.scene);
+    world.spheres.Resize(count);
+    world.visible.resize(count);
+    world.simulation.assign(count, 0.0f);
+
+    std::vector<uint32_t> workerCounts = {1};
+    uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t workers = 2; workers <= hardware; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    if (workerCounts.back() != hardware)
+    {
+        workerCounts.push_back(hardware);
+    }
+
+    std::cout << count << " nodes, " << frames << " frames" << std::endl;
+
+    std::vector<uint32_t> reference;
+    std::vector<uint32_t> counts;
+    double baseline = 0.0;
+    bool ok = true;
+    for (uint32_t workers : workerCounts)
+    {
+        // Fresh transforms, so every run starts from the same state.
+        world.scene.dirty.assign(count, 1);
+        double ms = Run(world, workers, frames, 1 == workers ? reference : counts);
+        baseline  = 1 == workers ? ms : baseline;
+
+        bool matches = 1 == workers || counts == reference;
+        ok = ok && matches;
+
+        std::cout << std::setw(3) << workers << " workers  " << std::fixed << std::setprecision(3) << std::setw(8) << ms << " ms/frame  "
+                  << std::setprecision(2) << std::setw(5) << baseline / ms << "x" << (matches ? "" : "  MISMATCH") << std::endl;
+    }
+
+    return ok ? 0 : 1;
+}
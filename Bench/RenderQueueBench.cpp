@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "Visuals/Descriptors.h"
+#include "Visuals/Dispatch.h"
+#include "Visuals/GraphicsPipeline.h"
+#include "Visuals/Headless.h"
+#include "Visuals/Memory.h"
+#include "Visuals/RenderQueue.h"
+
+// CPU cost of the render queue at scene scale: N draws spread over P
+// pipelines and M materials in arbitrary order, radix sorted (checked
+// against std::stable_sort, timed for reference) and recorded with
+// redundant binds elided, against recording them as submitted with a
+// pipeline and set bind per draw. Nothing is submitted; the median of the
+// runs is reported.
+// Usage: SkyRenderQueueBench [draws] [pipelines] [materials] [runs] [device index | cpu]
+
+using namespace Visuals;
+
+struct Workload
+{
+    std::vector<VkPipeline>      pipelines;
+    std::vector<VkDescriptorSet> sets;
+    VkPipelineLayout             layout = VK_NULL_HANDLE;
+    std::vector<uint32_t>        pipelineOf; // per draw
+    std::vector<uint32_t>        materialOf;
+    std::vector<uint32_t>        depthOf;
+};
+
+static void Fill(RenderQueue::Queue& queue, const Workload& workload)
+{
+    RenderQueue::BeginFrame(queue);
+    for (VkPipeline pipeline : workload.pipelines)
+    {
+        RenderQueue::AddPipeline(queue, pipeline);
+    }
+    for (VkDescriptorSet set : workload.sets)
+    {
+        RenderQueue::Material material;
+        material.layout   = workload.layout;
+        material.setCount = 1;
+        material.sets[0]  = set;
+        RenderQueue::AddMaterial(queue, material);
+    }
+
+    for (uint32_t i = 0; i < workload.pipelineOf.size(); ++i)
+    {
+        RenderQueue::Draw draw;
+        draw.indexCount    = 3;
+        draw.firstInstance = i;
+        RenderQueue::Push(queue, RenderQueue::Key(0, workload.pipelineOf[i], workload.materialOf[i], workload.depthOf[i]), draw);
+    }
+}
+
+static VkCommandBuffer& Begin(Headless::Frame& frame, Headless::Target& target, VkBuffer indices)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(frame.commandBuffer, 0);
+    vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+    Headless::BeginPass(frame.commandBuffer, target);
+    vkCmdBindIndexBuffer(frame.commandBuffer, indices, 0, VK_INDEX_TYPE_UINT16);
+    return frame.commandBuffer;
+}
+
+static void End(Headless::Frame& frame)
+{
+    vkCmdEndRenderPass(frame.commandBuffer);
+    vkEndCommandBuffer(frame.commandBuffer);
+}
+
+// Milliseconds to record every draw in submission order, binding both each time.
+static double RecordUnsorted(VkCommandBuffer& commandBuffer, const Workload& workload)
+{
+    Dispatch::DeviceTable& vk = Dispatch::Device();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < workload.pipelineOf.size(); ++i)
+    {
+        vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, workload.pipelines[workload.pipelineOf[i]]);
+        vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, workload.layout, 0, 1, &workload.sets[workload.materialOf[i]], 0, nullptr);
+        vk.CmdDrawIndexed(commandBuffer, 3, 1, 0, 0, i);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double Median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t draws     = argc > 1 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[1]))) : 100000;
+    uint32_t pipelines = argc > 2 ? static_cast<uint32_t>(std::min(4096, std::max(1, std::atoi(argv[2])))) : 16;
+    uint32_t materials = argc > 3 ? static_cast<uint32_t>(std::min(65536, std::max(1, std::atoi(argv[3])))) : 256;
+    int      runs      = argc > 4 ? std::max(1, std::atoi(argv[4])) : 15;
+    int32_t  device    = argc > 5 ? (0 == strcmp(argv[5], "cpu") ? Headless::kPickCpu : std::atoi(argv[5])) : 0;
+
+    Headless::Context     context;
+    Headless::Target      target;
+    Headless::Frame       frame;
+    Workload              workload;
+    VkDescriptorSetLayout setLayout      = VK_NULL_HANDLE;
+    VkDescriptorPool      pool           = VK_NULL_HANDLE;
+    VkBuffer              uniforms       = VK_NULL_HANDLE;
+    VkDeviceMemory        uniformsMemory = VK_NULL_HANDLE;
+    VkBuffer              indices        = VK_NULL_HANDLE;
+    VkDeviceMemory        indicesMemory  = VK_NULL_HANDLE;
+
+    try
+    {
+        Headless::Create("SkyRenderQueueBench", device, context);
+        Headless::CreateTarget(context, VkExtent2D{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, 1, target);
+        Headless::CreateFrame(context, frame);
+
+        // One uniform buffer behind every material, the triangle shaders never read it.
+        Memory::CreateBuffer(context.device, context.physicalDevice, 256, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniforms, uniformsMemory);
+        Memory::CreateBuffer(context.device, context.physicalDevice, 8, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indices, indicesMemory);
+        void* data;
+        vkMapMemory(context.device, indicesMemory, 0, 8, 0, &data);
+        uint16_t triangle[4] = {0, 1, 2, 0};
+        memcpy(data, triangle, sizeof(triangle));
+        vkUnmapMemory(context.device, indicesMemory);
+
+        Descriptors::CreateSetLayout(context.device, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER}, VK_SHADER_STAGE_VERTEX_BIT, setLayout);
+        Descriptors::CreatePool(context.device, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER}, materials, pool);
+        workload.sets.resize(materials);
+        for (VkDescriptorSet& set : workload.sets)
+        {
+            Descriptors::Allocate(context.device, pool, setLayout, set);
+            Descriptors::WriteBuffer(context.device, set, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms, 0, 256);
+        }
+
+        // Identical pipelines sharing one layout, so every bind is a real state change.
+        GraphicsPipeline::Config config;
+        config.setLayouts = {setLayout};
+        config.samples    = target.samples;
+        workload.pipelines.resize(pipelines);
+        for (VkPipeline& pipeline : workload.pipelines)
+        {
+            GraphicsPipeline::Create(pipeline, context.device, target.extent, workload.layout, target.renderPass, config);
+            config.layout = workload.layout;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::mt19937 random(7);
+    for (uint32_t i = 0; i < draws; ++i)
+    {
+        workload.pipelineOf.push_back(random() % pipelines);
+        workload.materialOf.push_back(random() % materials);
+        workload.depthOf.push_back(random());
+    }
+
+    std::cout << "[queue] " << draws << " draws, " << pipelines << " pipelines, " << materials << " materials, " << runs << " runs, on " << context.properties.deviceName << std::endl;
+
+    RenderQueue::Queue queue;
+    std::vector<double> radixMs, stdMs, sortedMs, unsortedMs;
+    for (int run = 0; run <= runs; ++run)
+    {
+        Fill(queue, workload);
+        std::vector<RenderQueue::Item> reference = queue.items;
+
+        auto start = std::chrono::steady_clock::now();
+        std::stable_sort(reference.begin(), reference.end(), [](const RenderQueue::Item& a, const RenderQueue::Item& b) { return a.key < b.key; });
+        double stdSort = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        RenderQueue::Sort(queue);
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            if (reference[i].key != queue.items[i].key || reference[i].draw != queue.items[i].draw)
+            {
+                std::cerr << "Radix sort differs from std::stable_sort at " << i << " !" << std::endl;
+                return 1;
+            }
+        }
+
+        VkCommandBuffer& sorted = Begin(frame, target, indices);
+        RenderQueue::Record(sorted, queue, 0);
+        End(frame);
+
+        VkCommandBuffer& unsorted = Begin(frame, target, indices);
+        double unsortedRecord = RecordUnsorted(unsorted, workload);
+        End(frame);
+
+        // Run 0 warms up.
+        if (run > 0)
+        {
+            radixMs.push_back(queue.stats.sortMs);
+            stdMs.push_back(stdSort);
+            sortedMs.push_back(queue.stats.recordMs);
+            unsortedMs.push_back(unsortedRecord);
+        }
+    }
+
+    const RenderQueue::Stats& stats = queue.stats;
+    double sorted   = Median(radixMs) + Median(sortedMs);
+    double unsorted = Median(unsortedMs);
+    std::cout << std::fixed << std::setprecision(3)
+              << "[sort] radix " << Median(radixMs) << " ms, std::stable_sort " << Median(stdMs) << " ms" << std::endl
+              << "[record] sorted " << Median(sortedMs) << " ms, as submitted " << unsorted << " ms" << std::endl
+              << "[binds] pipeline " << stats.pipelineBinds << " (" << stats.pipelineBindsAvoided << " avoided)"
+              << ", material " << stats.materialBinds << " (" << stats.materialBindsAvoided << " avoided)"
+              << ", as submitted " << draws << " + " << draws << std::endl
+              << "[total] sort + record " << sorted << " ms against " << unsorted << " ms, saved " << unsorted - sorted << " ms per frame" << std::endl;
+
+    for (VkPipeline& pipeline : workload.pipelines)
+    {
+        vkDestroyPipeline(context.device, pipeline, HostMemory::Callbacks());
+    }
+    vkDestroyPipelineLayout(context.device, workload.layout, HostMemory::Callbacks());
+    vkDestroyDescriptorPool(context.device, pool, HostMemory::Callbacks());
+    vkDestroyDescriptorSetLayout(context.device, setLayout, HostMemory::Callbacks());
+    Memory::DestroyBuffer(context.device, uniforms, uniformsMemory);
+    Memory::DestroyBuffer(context.device, indices, indicesMemory);
+    Headless::DestroyFrame(context, frame);
+    Headless::DestroyTarget(context, target);
+    Headless::Destroy(context);
+    return 0;
+}
@@ -0,0 +1,841 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Visuals/MeshFormat.h"
+#include "Visuals/Clusters.h"
+
+// Offline converter: OBJ / glTF (.gltf, .glb) -> .skym
+// Usage: SkyMeshPacker [--clusters] <input> <output.skym>
+
+namespace MeshPacker
+{
+    using Visuals::MeshFormat::Vertex;
+
+    struct Geometry
+    {
+        std::vector<Vertex>   vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Visuals::MeshFormat::Meshlet> meshlets;
+        std::vector<uint8_t>  missingNormal; // per vertex, 1 when the source gave it none
+    };
+
+    static std::vector<char> ReadFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+        return buffer;
+    }
+
+    static std::string DirectoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return std::string::npos == slash ? std::string() : path.substr(0, slash + 1);
+    }
+
+    static bool EndsWith(const std::string& value, const std::string& suffix)
+    {
+        return value.size() >= suffix.size() && 0 == value.compare(value.size() - suffix.size(), suffix.size(), suffix);
+    }
+
+    // ---------------------------------------------------------------- OBJ
+
+    namespace Obj
+    {
+        struct Corner
+        {
+            int v, vt, vn;
+
+            bool operator==(const Corner& other) const
+            {
+                return v == other.v && vt == other.vt && vn == other.vn;
+            }
+        };
+
+        struct CornerHash
+        {
+            size_t operator()(const Corner& c) const
+            {
+                size_t h = std::hash<int>()(c.v);
+                h ^= std::hash<int>()(c.vt) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                h ^= std::hash<int>()(c.vn) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+
+        // OBJ indices are 1-based, negative values count back from the end.
+        static int Resolve(int index, size_t count)
+        {
+            return index < 0 ? static_cast<int>(count) + index : index - 1;
+        }
+
+        static Corner ParseCorner(const std::string& token, size_t vCount, size_t vtCount, size_t vnCount)
+        {
+            Corner corner{-1, -1, -1};
+            int fields[3] = {0, 0, 0};
+            int field = 0;
+            size_t start = 0;
+
+            for (size_t i = 0; i <= token.size() && field < 3; ++i)
+            {
+                if (i == token.size() || '/' == token[i])
+                {
+                    if (i > start)
+                    {
+                        fields[field] = std::stoi(token.substr(start, i - start));
+                    }
+                    field++;
+                    start = i + 1;
+                }
+            }
+
+            if (0 != fields[0]) corner.v  = Resolve(fields[0], vCount);
+            if (0 != fields[1]) corner.vt = Resolve(fields[1], vtCount);
+            if (0 != fields[2]) corner.vn = Resolve(fields[2], vnCount);
+
+            if (corner.v < 0 || corner.v >= static_cast<int>(vCount))
+            {
+                throw std::runtime_error("OBJ face references a missing position");
+            }
+
+            return corner;
+        }
+
+        void Load(const std::string& filename, Geometry& geometry)
+        {
+            std::ifstream file(filename);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Failed to open file: " + filename);
+            }
+
+            std::vector<float> positions, texcoords, normals;
+            std::unordered_map<Corner, uint32_t, CornerHash> unique;
+            std::vector<uint32_t> face;
+            std::string line, tag, token;
+
+            while (std::getline(file, line))
+            {
+                std::istringstream stream(line);
+                if (!(stream >> tag))
+                {
+                    continue;
+                }
+
+                if ("v" == tag)
+                {
+                    float x = 0, y = 0, z = 0;
+                    stream >> x >> y >> z;
+                    positions.insert(positions.end(), {x, y, z});
+                }
+                else if ("vt" == tag)
+                {
+                    float u = 0, v = 0;
+                    stream >> u >> v;
+                    texcoords.insert(texcoords.end(), {u, v});
+                }
+                else if ("vn" == tag)
+                {
+                    float x = 0, y = 0, z = 0;
+                    stream >> x >> y >> z;
+                    normals.insert(normals.end(), {x, y, z});
+                }
+                else if ("f" == tag)
+                {
+                    face.clear();
+                    while (stream >> token)
+                    {
+                        Corner corner = ParseCorner(token, positions.size() / 3, texcoords.size() / 2, normals.size() / 3);
+
+                        auto it = unique.find(corner);
+                        if (unique.end() == it)
+                        {
+                            Vertex vertex{};
+                            memcpy(vertex.position, &positions[corner.v * 3], sizeof(vertex.position));
+                            if (corner.vt >= 0) memcpy(vertex.uv, &texcoords[corner.vt * 2], sizeof(vertex.uv));
+                            if (corner.vn >= 0) memcpy(vertex.normal, &normals[corner.vn * 3], sizeof(vertex.normal));
+
+                            it = unique.emplace(corner, static_cast<uint32_t>(geometry.vertices.size())).first;
+                            geometry.vertices.push_back(vertex);
+                            geometry.missingNormal.push_back(corner.vn < 0 ? 1 : 0);
+                        }
+                        face.push_back(it->second);
+                    }
+
+                    // Fan triangulation of convex polygons.
+                    for (size_t i = 2; i < face.size(); ++i)
+                    {
+                        geometry.indices.insert(geometry.indices.end(), {face[0], face[i - 1], face[i]});
+                    }
+                }
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------- glTF
+
+    namespace Json
+    {
+        const int kMaxDepth = 64; // nested arrays and objects, deeper input is rejected rather than recursed into
+
+        struct Value
+        {
+            enum class Type { Null, Bool, Number, String, Array, Object } type = Type::Null;
+            double                               number = 0.0;
+            std::string                          string;
+            std::vector<Value>                   array;
+            std::map<std::string, Value>         object;
+
+            const Value* Find(const std::string& key) const
+            {
+                auto it = object.find(key);
+                return object.end() == it ? nullptr : &it->second;
+            }
+
+            const Value& operator[](const std::string& key) const
+            {
+                const Value* value = Find(key);
+                if (nullptr == value)
+                {
+                    throw std::runtime_error("glTF is missing key: " + key);
+                }
+                return *value;
+            }
+
+            double NumberOr(const std::string& key, double fallback) const
+            {
+                const Value* value = Find(key);
+                return nullptr == value ? fallback : value->number;
+            }
+        };
+
+        struct Parser
+        {
+            const char* cur;
+            const char* end;
+            int         depth = 0;
+
+            // Counts one array or object level for as long as it is being parsed.
+            struct Nested
+            {
+                int& depth;
+
+                explicit Nested(int& parserDepth) : depth(parserDepth)
+                {
+                    if (++depth > kMaxDepth)
+                    {
+                        throw std::runtime_error("JSON is nested too deeply");
+                    }
+                }
+
+                ~Nested()
+                {
+                    --depth;
+                }
+            };
+
+            // The character at cur, '\0' past the end so a truncated file fails the checks below.
+            char Peek() const
+            {
+                return cur < end ? *cur : '\0';
+            }
+
+            bool Match(const char* word)
+            {
+                size_t length = strlen(word);
+                if (static_cast<size_t>(end - cur) < length || 0 != memcmp(cur, word, length))
+                {
+                    return false;
+                }
+                cur += length;
+                return true;
+            }
+
+            void SkipWhitespace()
+            {
+                while (cur < end && (' ' == *cur || '\n' == *cur || '\r' == *cur || '\t' == *cur))
+                {
+                    cur++;
+                }
+            }
+
+            void Expect(char c)
+            {
+                SkipWhitespace();
+                if (cur >= end || c != *cur)
+                {
+                    throw std::runtime_error("Malformed JSON");
+                }
+                cur++;
+            }
+
+            std::string ParseString()
+            {
+                Expect('"');
+                std::string out;
+                while (cur < end && '"' != *cur)
+                {
+                    if ('\\' == *cur && cur + 1 < end)
+                    {
+                        cur++;
+                        switch (*cur)
+                        {
+                            case 'n': out.push_back('\n'); break;
+                            case 't': out.push_back('\t'); break;
+                            case 'r': out.push_back('\r'); break;
+                            case 'b': out.push_back('\b'); break;
+                            case 'f': out.push_back('\f'); break;
+                            case 'u': // names only, never decoded
+                                if (end - cur <= 4)
+                                {
+                                    throw std::runtime_error("Malformed JSON string");
+                                }
+                                out.push_back('?');
+                                cur += 4;
+                                break;
+                            default:  out.push_back(*cur); break;
+                        }
+                    }
+                    else
+                    {
+                        out.push_back(*cur);
+                    }
+                    cur++;
+                }
+                Expect('"');
+                return out;
+            }
+
+            Value ParseValue()
+            {
+                SkipWhitespace();
+                if (cur >= end)
+                {
+                    throw std::runtime_error("Unexpected end of JSON");
+                }
+
+                Value value;
+                if ('{' == Peek())
+                {
+                    Nested nested(depth);
+                    value.type = Value::Type::Object;
+                    cur++;
+                    SkipWhitespace();
+                    if ('}' == Peek())
+                    {
+                        cur++;
+                        return value;
+                    }
+                    for (;;)
+                    {
+                        std::string key = ParseString();
+                        Expect(':');
+                        value.object[key] = ParseValue();
+                        SkipWhitespace();
+                        if (',' == Peek()) { cur++; continue; }
+                        Expect('}');
+                        return value;
+                    }
+                }
+                if ('[' == Peek())
+                {
+                    Nested nested(depth);
+                    value.type = Value::Type::Array;
+                    cur++;
+                    SkipWhitespace();
+                    if (']' == Peek())
+                    {
+                        cur++;
+                        return value;
+                    }
+                    for (;;)
+                    {
+                        value.array.push_back(ParseValue());
+                        SkipWhitespace();
+                        if (',' == Peek()) { cur++; continue; }
+                        Expect(']');
+                        return value;
+                    }
+                }
+                if ('"' == Peek())
+                {
+                    value.type   = Value::Type::String;
+                    value.string = ParseString();
+                    return value;
+                }
+                if (Match("true"))  { value.type = Value::Type::Bool; value.number = 1; return value; }
+                if (Match("false")) { value.type = Value::Type::Bool; return value; }
+                if (Match("null"))  { return value; }
+
+                // strtod needs a terminated copy, the buffer is not terminated.
+                char   number[64];
+                size_t length = 0;
+                while (cur + length < end && length + 1 < sizeof(number) && nullptr != strchr("+-0123456789.eE", cur[length]))
+                {
+                    number[length] = cur[length];
+                    length++;
+                }
+                number[length] = '\0';
+
+                char* numberEnd = nullptr;
+                value.type   = Value::Type::Number;
+                value.number = strtod(number, &numberEnd);
+                if (numberEnd == number)
+                {
+                    throw std::runtime_error("Malformed JSON number");
+                }
+                cur += numberEnd - number;
+                return value;
+            }
+        };
+
+        Value Parse(const char* data, size_t size)
+        {
+            Parser parser{data, data + size};
+            return parser.ParseValue();
+        }
+    }
+
+    namespace Gltf
+    {
+        static std::vector<char> DecodeBase64(const std::string& text)
+        {
+            static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::vector<char> out;
+            uint32_t accum = 0;
+            int bits = 0;
+
+            for (char c : text)
+            {
+                size_t v = alphabet.find(c);
+                if (std::string::npos == v)
+                {
+                    continue; // padding, whitespace
+                }
+                accum = (accum << 6) | static_cast<uint32_t>(v);
+                bits += 6;
+                if (bits >= 8)
+                {
+                    bits -= 8;
+                    out.push_back(static_cast<char>((accum >> bits) & 0xFF));
+                }
+            }
+            return out;
+        }
+
+        struct Document
+        {
+            Json::Value                    root;
+            std::vector<std::vector<char>> buffers;
+        };
+
+        // Returns a pointer to element 0 of an accessor and its byte stride.
+        static const char* AccessorData(const Document& doc, size_t accessorIndex, size_t elementSize, size_t& count, size_t& stride, int& componentType)
+        {
+            const Json::Value& accessor = doc.root["accessors"].array.at(accessorIndex);
+            const Json::Value& view     = doc.root["bufferViews"].array.at(static_cast<size_t>(accessor["bufferView"].number));
+            const std::vector<char>& buffer = doc.buffers.at(static_cast<size_t>(view["buffer"].number));
+
+            count         = static_cast<size_t>(accessor["count"].number);
+            componentType = static_cast<int>(accessor["componentType"].number);
+            stride        = static_cast<size_t>(view.NumberOr("byteStride", 0.0));
+            if (0 == stride)
+            {
+                stride = elementSize;
+            }
+
+            // Divided rather than multiplied, stride * (count - 1) can overflow.
+            size_t offset = static_cast<size_t>(view.NumberOr("byteOffset", 0.0) + accessor.NumberOr("byteOffset", 0.0));
+            if (0 == count || offset > buffer.size() || elementSize > buffer.size() - offset || count - 1 > (buffer.size() - offset - elementSize) / stride)
+            {
+                throw std::runtime_error("glTF accessor is out of bounds");
+            }
+
+            return buffer.data() + offset;
+        }
+
+        void Load(const std::string& filename, Geometry& geometry)
+        {
+            std::vector<char> file = ReadFile(filename);
+            Document doc;
+            std::vector<char> glbBinary;
+
+            if (EndsWith(filename, ".glb"))
+            {
+                // 12 byte header, then JSON chunk, then optional BIN chunk.
+                // Chunk headers are length then type.
+                const uint32_t kChunkJson = 0x4E4F534A;
+                const uint32_t kChunkBin  = 0x004E4942;
+                if (file.size() < 20 || 0 != memcmp(file.data(), "glTF", 4))
+                {
+                    throw std::runtime_error("Not a binary glTF file");
+                }
+
+                uint32_t jsonLength, jsonType;
+                memcpy(&jsonLength, file.data() + 12, 4);
+                memcpy(&jsonType, file.data() + 16, 4);
+                if (kChunkJson != jsonType || size_t(20) + jsonLength > file.size())
+                {
+                    throw std::runtime_error("Malformed binary glTF JSON chunk");
+                }
+                doc.root = Json::Parse(file.data() + 20, jsonLength);
+
+                size_t binChunk = size_t(20) + jsonLength;
+                if (binChunk + 8 <= file.size())
+                {
+                    uint32_t binLength, binType;
+                    memcpy(&binLength, file.data() + binChunk, 4);
+                    memcpy(&binType, file.data() + binChunk + 4, 4);
+                    if (kChunkBin != binType || binChunk + 8 + binLength > file.size())
+                    {
+                        throw std::runtime_error("Malformed binary glTF BIN chunk");
+                    }
+                    glbBinary.assign(file.data() + binChunk + 8, file.data() + binChunk + 8 + binLength);
+                }
+            }
+            else
+            {
+                doc.root = Json::Parse(file.data(), file.size());
+            }
+
+            for (const Json::Value& buffer : doc.root["buffers"].array)
+            {
+                const Json::Value* uri = buffer.Find("uri");
+                if (nullptr == uri)
+                {
+                    doc.buffers.push_back(glbBinary);
+                }
+                else if (0 == uri->string.compare(0, 5, "data:"))
+                {
+                    doc.buffers.push_back(DecodeBase64(uri->string.substr(uri->string.find(',') + 1)));
+                }
+                else
+                {
+                    doc.buffers.push_back(ReadFile(DirectoryOf(filename) + uri->string));
+                }
+            }
+
+            for (const Json::Value& mesh : doc.root["meshes"].array)
+            {
+                for (const Json::Value& primitive : mesh["primitives"].array)
+                {
+                    if (4 != static_cast<int>(primitive.NumberOr("mode", 4.0)))
+                    {
+                        continue; // triangles only
+                    }
+
+                    const Json::Value& attributes = primitive["attributes"];
+                    size_t count, stride;
+                    int componentType;
+
+                    const char* positions = AccessorData(doc, static_cast<size_t>(attributes["POSITION"].number), 12, count, stride, componentType);
+                    if (5126 != componentType)
+                    {
+                        throw std::runtime_error("glTF positions must be FLOAT"); // quantized positions are not supported
+                    }
+                    size_t positionStride = stride;
+                    size_t vertexCount    = count;
+                    uint32_t base         = static_cast<uint32_t>(geometry.vertices.size());
+
+                    const char* normals = nullptr;
+                    size_t normalStride = 0;
+                    if (const Json::Value* normal = attributes.Find("NORMAL"))
+                    {
+                        normals = AccessorData(doc, static_cast<size_t>(normal->number), 12, count, normalStride, componentType);
+                        if (5126 != componentType || count < vertexCount)
+                        {
+                            throw std::runtime_error("glTF normals must be FLOAT, one per position");
+                        }
+                    }
+
+                    const char* uvs = nullptr;
+                    size_t uvStride = 0;
+                    if (const Json::Value* uv = attributes.Find("TEXCOORD_0"))
+                    {
+                        uvs = AccessorData(doc, static_cast<size_t>(uv->number), 8, count, uvStride, componentType);
+                        if (5126 != componentType || count < vertexCount)
+                        {
+                            uvs = nullptr; // normalized integer UVs are not supported
+                        }
+                    }
+
+                    for (size_t i = 0; i < vertexCount; ++i)
+                    {
+                        Vertex vertex{};
+                        memcpy(vertex.position, positions + i * positionStride, sizeof(vertex.position));
+                        if (nullptr != normals) memcpy(vertex.normal, normals + i * normalStride, sizeof(vertex.normal));
+                        if (nullptr != uvs)     memcpy(vertex.uv, uvs + i * uvStride, sizeof(vertex.uv));
+                        geometry.vertices.push_back(vertex);
+                        geometry.missingNormal.push_back(nullptr == normals ? 1 : 0);
+                    }
+
+                    if (const Json::Value* indices = primitive.Find("indices"))
+                    {
+                        size_t elementSize = 4;
+                        const Json::Value& accessor = doc.root["accessors"].array.at(static_cast<size_t>(indices->number));
+                        int type = static_cast<int>(accessor["componentType"].number);
+                        if (5121 == type) elementSize = 1;
+                        if (5123 == type) elementSize = 2;
+
+                        const char* data = AccessorData(doc, static_cast<size_t>(indices->number), elementSize, count, stride, componentType);
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            uint32_t index = 0;
+                            memcpy(&index, data + i * stride, elementSize);
+                            if (index >= vertexCount)
+                            {
+                                throw std::runtime_error("glTF index is out of range");
+                            }
+                            geometry.indices.push_back(base + index);
+                        }
+                    }
+                    else
+                    {
+                        for (uint32_t i = 0; i < vertexCount; ++i)
+                        {
+                            geometry.indices.push_back(base + i);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------- output
+
+    // Only for the vertices in missingNormal, the source's normals are kept.
+    void GenerateNormals(Geometry& geometry)
+    {
+        for (size_t i = 0; i < geometry.vertices.size(); ++i)
+        {
+            Vertex& vertex = geometry.vertices[i];
+            if (geometry.missingNormal[i])
+            {
+                vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+            }
+        }
+
+        // Area weighted face normals accumulated on shared vertices.
+        for (size_t i = 0; i + 2 < geometry.indices.size(); i += 3)
+        {
+            const uint32_t corners[3] = {geometry.indices[i + 0], geometry.indices[i + 1], geometry.indices[i + 2]};
+            if (!geometry.missingNormal[corners[0]] && !geometry.missingNormal[corners[1]] && !geometry.missingNormal[corners[2]])
+            {
+                continue;
+            }
+
+            Vertex& a = geometry.vertices[corners[0]];
+            Vertex& b = geometry.vertices[corners[1]];
+            Vertex& c = geometry.vertices[corners[2]];
+
+            float e1[3] = {b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2]};
+            float e2[3] = {c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2]};
+            float n[3]  = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+            for (uint32_t corner : corners)
+            {
+                if (geometry.missingNormal[corner])
+                {
+                    Vertex& v = geometry.vertices[corner];
+                    v.normal[0] += n[0];
+                    v.normal[1] += n[1];
+                    v.normal[2] += n[2];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < geometry.vertices.size(); ++i)
+        {
+            Vertex& vertex = geometry.vertices[i];
+            if (!geometry.missingNormal[i])
+            {
+                continue;
+            }
+
+            float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+            if (length > 0.0f)
+            {
+                vertex.normal[0] /= length;
+                vertex.normal[1] /= length;
+                vertex.normal[2] /= length;
+            }
+        }
+    }
+
+    Visuals::MeshFormat::Bounds ComputeBounds(const Geometry& geometry)
+    {
+        Visuals::MeshFormat::Bounds bounds{};
+        if (geometry.vertices.empty())
+        {
+            return bounds;
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds.min[axis] = bounds.max[axis] = geometry.vertices[0].position[axis];
+        }
+
+        for (const Vertex& vertex : geometry.vertices)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                bounds.min[axis] = std::min(bounds.min[axis], vertex.position[axis]);
+                bounds.max[axis] = std::max(bounds.max[axis], vertex.position[axis]);
+            }
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds.center[axis] = 0.5f * (bounds.min[axis] + bounds.max[axis]);
+        }
+
+        float radiusSq = 0.0f;
+        for (const Vertex& vertex : geometry.vertices)
+        {
+            float dx = vertex.position[0] - bounds.center[0];
+            float dy = vertex.position[1] - bounds.center[1];
+            float dz = vertex.position[2] - bounds.center[2];
+            radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+        }
+        bounds.radius = std::sqrt(radiusSq);
+
+        return bounds;
+    }
+
+    static void WriteStream(std::ofstream& file, const void* data, uint64_t size, uint64_t offset)
+    {
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    void Write(const std::string& filename, const Geometry& geometry)
+    {
+        using namespace Visuals::MeshFormat;
+
+        if (geometry.indices.empty())
+        {
+            throw std::runtime_error("No triangles to write: " + filename);
+        }
+
+        Header header{};
+        header.magic        = kMagic;
+        header.version      = kVersion;
+        header.vertexStride = sizeof(Vertex);
+        header.vertexCount  = geometry.vertices.size();
+        header.indexCount   = geometry.indices.size();
+        header.bounds       = ComputeBounds(geometry);
+
+        bool index32 = geometry.vertices.size() > 0xFFFF;
+        if (index32)
+        {
+            header.flags |= kFlagIndex32;
+        }
+
+        std::vector<uint16_t> indices16;
+        if (!index32)
+        {
+            indices16.assign(geometry.indices.begin(), geometry.indices.end());
+        }
+
+        header.vertices.offset = AlignUp(sizeof(Header));
+        header.vertices.size   = header.vertexCount * sizeof(Vertex);
+        header.indices.offset  = AlignUp(header.vertices.offset + header.vertices.size);
+        header.indices.size    = header.indexCount * (index32 ? 4 : 2);
+
+        if (!geometry.meshlets.empty())
+        {
+            header.flags          |= kFlagMeshlets;
+            header.meshletCount    = geometry.meshlets.size();
+            header.meshlets.offset = AlignUp(header.indices.offset + header.indices.size);
+            header.meshlets.size   = header.meshletCount * sizeof(Meshlet);
+        }
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open output: " + filename);
+        }
+
+        WriteStream(file, &header, sizeof(header), 0);
+        WriteStream(file, geometry.vertices.data(), header.vertices.size, header.vertices.offset);
+        WriteStream(file, index32 ? static_cast<const void*>(geometry.indices.data()) : indices16.data(), header.indices.size, header.indices.offset);
+        WriteStream(file, geometry.meshlets.data(), header.meshlets.size, header.meshlets.offset);
+
+        if (!file.good())
+        {
+            throw std::runtime_error("Failed to write output: " + filename);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool clusters = argc > 1 && 0 == strcmp(argv[1], "--clusters");
+    int  first    = clusters ? 2 : 1;
+
+    if (argc - first < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--clusters] <input.obj|input.gltf|input.glb> <output.skym>" << std::endl;
+        return 1;
+    }
+
+    std::string input  = argv[first];
+    std::string output = argv[first + 1];
+
+    try
+    {
+        MeshPacker::Geometry geometry;
+
+        if (MeshPacker::EndsWith(input, ".obj"))
+        {
+            MeshPacker::Obj::Load(input, geometry);
+        }
+        else if (MeshPacker::EndsWith(input, ".gltf") || MeshPacker::EndsWith(input, ".glb"))
+        {
+            MeshPacker::Gltf::Load(input, geometry);
+        }
+        else
+        {
+            throw std::runtime_error("Unsupported input format: " + input);
+        }
+
+        if (std::find(geometry.missingNormal.begin(), geometry.missingNormal.end(), 1) != geometry.missingNormal.end())
+        {
+            MeshPacker::GenerateNormals(geometry);
+        }
+
+        if (clusters)
+        {
+            Visuals::Clusters::Build(geometry.vertices.data(), geometry.vertices.size(), geometry.indices, geometry.meshlets);
+        }
+
+        MeshPacker::Write(output, geometry);
+
+        std::cout << output << ": " << geometry.vertices.size() << " vertices, " << geometry.indices.size() / 3 << " triangles, " << geometry.meshlets.size() << " clusters" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
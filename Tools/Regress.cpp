@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Visuals/Capture.h"
+#include "Visuals/Headless.h"
+
+// Renders .skyc captures (Visuals::Capture) as canonical scenes on a headless
+// device, the first CPU one unless told otherwise, and checks them against
+// the goldens and baselines kept in <data dir>:
+//   <name>.ppm     the scene's last frame, compared with a per pixel tolerance
+//   baselines.txt  "name draws triangles objects pipelines allocations", one
+//                  scene a line, allocations "-" until recorded on a device
+// Draws, triangles and objects must match, pipelines and allocations may not
+// grow. Frame time is only reported, it varies too much between runs and
+// machines to gate on. A scene without a golden is checked on its counters.
+// --update renders the scenes and rewrites the goldens and baselines.
+// Exits with 1 when any scene regressed, with kSkipped (CTest's
+// SKIP_RETURN_CODE) when none did but some have no golden and no baseline
+// recorded yet.
+// Usage: SkyRegress <data dir> <capture.skyc>... [--update] [--device index | cpu]
+
+namespace Regress
+{
+    const int    kIterations    = 5;
+    const int    kChannelSlack  = 8;     // per channel difference still counted as equal
+    const double kPixelSlack    = 0.005; // fraction of pixels allowed to differ
+    const int    kSkipped       = 77;
+
+    struct Baseline
+    {
+        uint64_t draws       = 0; // over one pass of the capture
+        uint64_t triangles   = 0;
+        uint64_t objects     = 0;
+        uint64_t pipelines   = 0;
+        int64_t  allocations = -1; // -1 when not recorded, not checked
+        double   frameMs     = 0.0; // reported, not kept
+    };
+
+    struct Image
+    {
+        uint32_t             width  = 0;
+        uint32_t             height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    static std::string Name(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        std::string name = std::string::npos == slash ? path : path.substr(slash + 1);
+        size_t dot = name.find_last_of('.');
+        return std::string::npos == dot ? name : name.substr(0, dot);
+    }
+
+    static std::map<std::string, Baseline> LoadBaselines(const std::string& path)
+    {
+        std::map<std::string, Baseline> baselines;
+        std::ifstream file(path);
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            std::string name;
+            std::string allocations;
+            Baseline    baseline;
+            if (fields >> name >> baseline.draws >> baseline.triangles >> baseline.objects >> baseline.pipelines >> allocations && '#' != name[0])
+            {
+                baseline.allocations = "-" == allocations ? -1 : std::atoll(allocations.c_str());
+                baselines[name]      = baseline;
+            }
+        }
+
+        return baselines;
+    }
+
+    static void SaveBaselines(const std::string& path, const std::map<std::string, Baseline>& baselines)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write baselines: " + path);
+        }
+
+        file << "# name draws triangles objects pipelines allocations\n";
+        for (const auto& [name, baseline] : baselines)
+        {
+            file << name << " " << baseline.draws << " " << baseline.triangles << " " << baseline.objects << " " << baseline.pipelines << " ";
+            file << (baseline.allocations < 0 ? std::string("-") : std::to_string(baseline.allocations)) << "\n";
+        }
+    }
+
+    // Binary PPM, alpha is dropped.
+    static void SaveImage(const std::string& path, const Image& image)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write golden image: " + path);
+        }
+
+        file << "P6\n" << image.width << " " << image.height << "\n255\n";
+        for (size_t i = 0; i < image.rgba.size(); i += 4)
+        {
+            file.write(reinterpret_cast<const char*>(&image.rgba[i]), 3);
+        }
+    }
+
+    static bool LoadImage(const std::string& path, Image& image)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string   magic;
+        uint32_t      maxValue = 0;
+        if (!(file >> magic >> image.width >> image.height >> maxValue) || "P6" != magic || 255 != maxValue)
+        {
+            return false;
+        }
+        file.get();
+
+        std::vector<uint8_t> rgb(size_t(image.width) * image.height * 3);
+        if (!file.read(reinterpret_cast<char*>(rgb.data()), rgb.size()))
+        {
+            return false;
+        }
+
+        image.rgba.resize(size_t(image.width) * image.height * 4);
+        for (size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4)
+        {
+            image.rgba[j]     = rgb[i];
+            image.rgba[j + 1] = rgb[i + 1];
+            image.rgba[j + 2] = rgb[i + 2];
+            image.rgba[j + 3] = 255;
+        }
+        return true;
+    }
+
+    // Fraction of pixels whose RGB differs by more than kChannelSlack, 1 for a size mismatch.
+    static double Difference(const Image& golden, const Image& image)
+    {
+        if (golden.width != image.width || golden.height != image.height)
+        {
+            return 1.0;
+        }
+
+        size_t differing = 0;
+        for (size_t i = 0; i < image.rgba.size(); i += 4)
+        {
+            int worst = 0;
+            for (size_t c = 0; c < 3; ++c)
+            {
+                worst = std::max(worst, std::abs(int(golden.rgba[i + c]) - int(image.rgba[i + c])));
+            }
+            differing += worst > kChannelSlack ? 1 : 0;
+        }
+
+        return image.rgba.empty() ? 0.0 : double(differing) / (image.rgba.size() / 4);
+    }
+
+    /* Renders every frame of the capture kIterations times after a warm-up
+    pass, whose draws and triangles are counted. frameMs is the median GPU
+    time, CPU time without timestamps. */
+    static Baseline Run(Visuals::Headless::Context& context, const std::string& path, Image& image)
+    {
+        Visuals::Capture::Stream stream;
+        Visuals::Capture::Load(path.c_str(), stream);
+
+        uint64_t before = Visuals::Memory::Allocated().allocations.load();
+
+        // Goldens are compared in a fixed 8 bit format, whatever the capture was taken in.
+        Visuals::Headless::Target target;
+        Visuals::Capture::Player  player;
+        VkExtent2D extent{stream.header.width, stream.header.height};
+        Visuals::Headless::CreateTarget(context, extent, VK_FORMAT_R8G8B8A8_UNORM, stream.header.samples, target);
+        Visuals::Capture::CreatePlayer(context.device, context.physicalDevice, context.commandPool, context.queue, target.renderPass, target.extent, target.samples, stream, player);
+
+        Visuals::Headless::Frame frameResources;
+        Visuals::Headless::CreateFrame(context, frameResources);
+
+        Baseline result;
+        result.allocations = static_cast<int64_t>(Visuals::Memory::Allocated().allocations.load() - before);
+        result.pipelines   = player.pipelines.pipelines.size() + player.pipelinesEqual.pipelines.size() + 1;
+        result.objects     = stream.objectCount;
+
+        std::vector<double> frameMs;
+        for (int iteration = 0; iteration <= kIterations; ++iteration)
+        {
+            for (const Visuals::Capture::FrameView& frame : stream.frames)
+            {
+                VkCommandBuffer& commandBuffer = Visuals::Headless::Begin(frameResources, target);
+                Visuals::Capture::Execute(commandBuffer, stream, frame, player);
+                Visuals::Headless::Timing timing = Visuals::Headless::End(context, frameResources);
+
+                if (iteration > 0)
+                {
+                    frameMs.push_back(timing.gpuMs >= 0.0 ? timing.gpuMs : timing.cpuMs);
+                }
+            }
+
+            if (0 == iteration)
+            {
+                result.draws     = player.draws;
+                result.triangles = player.triangles;
+            }
+        }
+
+        std::sort(frameMs.begin(), frameMs.end());
+        result.frameMs = frameMs.empty() ? 0.0 : frameMs[frameMs.size() / 2];
+
+        image.width  = target.extent.width;
+        image.height = target.extent.height;
+        Visuals::Headless::ReadBack(context, target, image.rgba);
+
+        Visuals::Headless::DestroyFrame(context, frameResources);
+        Visuals::Capture::DestroyPlayer(context.device, player);
+        Visuals::Headless::DestroyTarget(context, target);
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string              dataDir;
+    std::vector<std::string> captures;
+    bool                     update = false;
+    int32_t                  device = Visuals::Headless::kPickCpu;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "--update"))
+        {
+            update = true;
+        }
+        else if (0 == strcmp(argv[i], "--device") && i + 1 < argc)
+        {
+            ++i;
+            device = 0 == strcmp(argv[i], "cpu") ? Visuals::Headless::kPickCpu : std::atoi(argv[i]);
+        }
+        else if (dataDir.empty())
+        {
+            dataDir = argv[i];
+        }
+        else
+        {
+            captures.push_back(argv[i]);
+        }
+    }
+
+    if (dataDir.empty() || captures.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <data dir> <capture.skyc>... [--update] [--device index | cpu]" << std::endl;
+        return 1;
+    }
+
+    Visuals::Headless::Context context;
+    std::string baselinesPath = dataDir + "/baselines.txt";
+    std::map<std::string, Regress::Baseline> baselines = Regress::LoadBaselines(baselinesPath);
+    int failures = 0;
+    int skipped  = 0;
+
+    try
+    {
+        Visuals::Headless::Create("SkyRegress", device, context);
+
+        for (const std::string& capture : captures)
+        {
+            std::string       name       = Regress::Name(capture);
+            std::string       goldenPath = dataDir + "/" + name + ".ppm";
+            Regress::Image    image;
+            Regress::Baseline result     = Regress::Run(context, capture, image);
+
+            std::cout << "[" << name << "] " << result.frameMs << " ms, " << result.draws << " draws, " << result.triangles << " triangles, " << result.objects << " objects, "
+                      << result.pipelines << " pipelines, " << result.allocations << " allocations" << std::endl;
+
+            if (update)
+            {
+                Regress::SaveImage(goldenPath, image);
+                baselines[name] = result;
+                continue;
+            }
+
+            Regress::Image golden;
+            bool           hasGolden = Regress::LoadImage(goldenPath, golden);
+            auto           found     = baselines.find(name);
+            if (!hasGolden && baselines.end() == found)
+            {
+                std::cout << "SKIP " << name << ", nothing recorded, run with --update" << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            std::vector<std::string> problems;
+            std::vector<std::string> notes;
+
+            if (!hasGolden)
+            {
+                notes.push_back("no golden image " + goldenPath + ", pixels not compared");
+            }
+            else
+            {
+                double difference = Regress::Difference(golden, image);
+                if (difference > Regress::kPixelSlack)
+                {
+                    problems.push_back(std::to_string(difference * 100.0) + "% of pixels differ from the golden image");
+                }
+            }
+
+            if (baselines.end() == found)
+            {
+                problems.push_back("no baseline in " + baselinesPath);
+            }
+            else
+            {
+                const Regress::Baseline& baseline = found->second;
+                if (result.draws != baseline.draws)
+                {
+                    problems.push_back("draws " + std::to_string(result.draws) + " differ from baseline " + std::to_string(baseline.draws));
+                }
+                if (result.triangles != baseline.triangles)
+                {
+                    problems.push_back("triangles " + std::to_string(result.triangles) + " differ from baseline " + std::to_string(baseline.triangles));
+                }
+                if (result.objects != baseline.objects)
+                {
+                    problems.push_back("objects " + std::to_string(result.objects) + " differ from baseline " + std::to_string(baseline.objects));
+                }
+                if (baseline.allocations >= 0 && result.allocations > baseline.allocations)
+                {
+                    problems.push_back("allocations " + std::to_string(result.allocations) + " over baseline " + std::to_string(baseline.allocations));
+                }
+                if (result.pipelines > baseline.pipelines)
+                {
+                    problems.push_back("pipelines " + std::to_string(result.pipelines) + " over baseline " + std::to_string(baseline.pipelines));
+                }
+            }
+
+            std::cout << (problems.empty() ? "PASS " : "FAIL ") << name << std::endl;
+            for (const std::string& problem : problems)
+            {
+                std::cout << "    " << problem << std::endl;
+            }
+            for (const std::string& note : notes)
+            {
+                std::cout << "    " << note << std::endl;
+            }
+            failures += problems.empty() ? 0 : 1;
+        }
+
+        if (update)
+        {
+            Regress::SaveBaselines(baselinesPath, baselines);
+            std::cout << "Updated " << captures.size() << " scenes in " << dataDir << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        Visuals::Headless::Destroy(context);
+        return 1;
+    }
+
+    Visuals::Headless::Destroy(context);
+    return failures > 0 ? 1 : skipped > 0 ? Regress::kSkipped : 0;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Visuals/Capture.h"
+#include "Visuals/Headless.h"
+
+// Re-executes a .skyc capture (Visuals::Capture) offscreen, frame by frame,
+// and reports CPU and GPU time per frame. Every frame is waited on before
+// the next is recorded, so each one is timed alone and runs are comparable
+// across builds and devices.
+// Usage: SkyReplay <capture.skyc> [iterations] [device index | cpu]
+
+namespace Replay
+{
+    struct Summary
+    {
+        double mean   = 0.0;
+        double median = 0.0;
+        double p95    = 0.0;
+        double min    = 0.0;
+        double max    = 0.0;
+    };
+
+    static Summary Summarize(std::vector<double> samples)
+    {
+        Summary summary;
+        if (samples.empty())
+        {
+            return summary;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        for (double sample : samples)
+        {
+            summary.mean += sample;
+        }
+
+        summary.mean  /= samples.size();
+        summary.median = samples[samples.size() / 2];
+        summary.p95    = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+        summary.min    = samples.front();
+        summary.max    = samples.back();
+        return summary;
+    }
+
+    static void Print(const char* name, const Summary& summary)
+    {
+        std::cout << name << " ms  mean " << summary.mean << "  median " << summary.median << "  p95 " << summary.p95
+                  << "  min " << summary.min << "  max " << summary.max << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture.skyc> [iterations] [device index | cpu]" << std::endl;
+        return 1;
+    }
+
+    int     iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    int32_t device     = argc > 3 ? (0 == strcmp(argv[3], "cpu") ? Visuals::Headless::kPickCpu : std::atoi(argv[3])) : 0;
+
+    Visuals::Capture::Stream  stream;
+    Visuals::Headless::Context context;
+    Visuals::Headless::Target  target;
+    Visuals::Capture::Player   player;
+
+    try
+    {
+        Visuals::Capture::Load(argv[1], stream);
+        Visuals::Headless::Create("SkyReplay", device, context);
+
+        VkExtent2D extent{stream.header.width, stream.header.height};
+        Visuals::Headless::CreateTarget(context, extent, static_cast<VkFormat>(stream.header.colorFormat), stream.header.samples, target);
+        Visuals::Capture::CreatePlayer(context.device, context.physicalDevice, context.commandPool, context.queue, target.renderPass, target.extent, target.samples, stream, player);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "[replay] " << stream.frames.size() << " frames, " << stream.draws / stream.frames.size() << " draws per frame, "
+              << target.extent.width << "x" << target.extent.height << " " << target.samples << "x, on " << context.properties.deviceName << std::endl;
+
+    Visuals::Headless::Frame frameResources;
+    Visuals::Headless::CreateFrame(context, frameResources);
+
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+    std::vector<double> iterationMs;
+
+    // Iteration 0 warms up pipelines and caches and is not counted.
+    for (int iteration = 0; iteration <= iterations; ++iteration)
+    {
+        auto iterationStart = std::chrono::steady_clock::now();
+
+        for (const Visuals::Capture::FrameView& frame : stream.frames)
+        {
+            VkCommandBuffer& commandBuffer = Visuals::Headless::Begin(frameResources, target);
+            Visuals::Capture::Execute(commandBuffer, stream, frame, player);
+            Visuals::Headless::Timing timing = Visuals::Headless::End(context, frameResources);
+
+            if (0 == iteration)
+            {
+                continue;
+            }
+
+            cpuMs.push_back(timing.cpuMs);
+            if (timing.gpuMs >= 0.0)
+            {
+                gpuMs.push_back(timing.gpuMs);
+            }
+        }
+
+        if (iteration > 0)
+        {
+            iterationMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - iterationStart).count());
+        }
+    }
+
+    Replay::Print("[frame cpu]", Replay::Summarize(cpuMs));
+    if (!gpuMs.empty())
+    {
+        Replay::Print("[frame gpu]", Replay::Summarize(gpuMs));
+    }
+    Replay::Print("[iteration]", Replay::Summarize(iterationMs));
+
+    Visuals::Headless::DestroyFrame(context, frameResources);
+    Visuals::Capture::DestroyPlayer(context.device, player);
+    Visuals::Headless::DestroyTarget(context, target);
+    Visuals::Headless::Destroy(context);
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Visuals/Camera.h"
+#include "Visuals/Capture.h"
+
+// Writes the canonical SkyRegress scenes as .skyc captures (Visuals::Capture).
+// They are built from code rather than recorded from a window, so they need
+// no assets and come out the same on every machine:
+//   grid     16 x 16 lit cubes, the camera circling them
+//   prepass  the same grid through the depth prepass and the EQUAL pass
+//   views    unlit normals view, a quarter of the cubes spinning every frame
+// Usage: SkyScenes <out dir>
+
+namespace Scenes
+{
+    const uint32_t kWidth  = 256;
+    const uint32_t kHeight = 256;
+    const uint32_t kFrames = 8;
+    const uint32_t kSide   = 16;
+    const uint32_t kCount  = kSide * kSide;
+
+    // Unit cube, four vertices a face so every face keeps its own normal.
+    static std::vector<char> Cube()
+    {
+        using namespace Visuals::MeshFormat;
+
+        const float faces[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+        std::vector<Vertex>   vertices;
+        std::vector<uint16_t> indices;
+        for (const float* n : faces)
+        {
+            // u x v = n, so the corners below run counter-clockwise seen from outside.
+            float u[3] = {n[1], n[2], n[0]};
+            float v[3] = {n[1] * u[2] - n[2] * u[1], n[2] * u[0] - n[0] * u[2], n[0] * u[1] - n[1] * u[0]};
+
+            uint16_t first = static_cast<uint16_t>(vertices.size());
+            const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+            for (const float* c : corners)
+            {
+                Vertex vertex{};
+                for (int i = 0; i < 3; ++i)
+                {
+                    vertex.position[i] = 0.5f * (n[i] + c[0] * u[i] + c[1] * v[i]);
+                    vertex.normal[i]   = n[i];
+                }
+                vertex.uv[0] = 0.5f + 0.5f * c[0];
+                vertex.uv[1] = 0.5f + 0.5f * c[1];
+                vertices.push_back(vertex);
+            }
+
+            const uint16_t quad[] = {0, 1, 2, 0, 2, 3};
+            for (uint16_t index : quad)
+            {
+                indices.push_back(static_cast<uint16_t>(first + index));
+            }
+        }
+
+        Header header{};
+        header.magic            = kMagic;
+        header.version          = kVersion;
+        header.vertexStride     = sizeof(Vertex);
+        header.vertexCount      = vertices.size();
+        header.indexCount       = indices.size();
+        header.vertices.offset  = AlignUp(sizeof(Header));
+        header.vertices.size    = vertices.size() * sizeof(Vertex);
+        header.indices.offset   = AlignUp(header.vertices.offset + header.vertices.size);
+        header.indices.size     = indices.size() * sizeof(uint16_t);
+        header.bounds           = {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, std::sqrt(0.75f)};
+
+        std::vector<char> bytes(header.indices.offset + header.indices.size, 0);
+        memcpy(bytes.data(), &header, sizeof(header));
+        memcpy(bytes.data() + header.vertices.offset, vertices.data(), header.vertices.size);
+        memcpy(bytes.data() + header.indices.offset, indices.data(), header.indices.size);
+        return bytes;
+    }
+
+    struct Grid
+    {
+        std::vector<glm::mat4> models;
+        std::vector<glm::vec4> spheres;
+    };
+
+    // Unit cubes 1.5 apart on x and z, their heights in a fixed wave.
+    static void Place(Grid& grid, uint32_t index, float angle)
+    {
+        float x = (static_cast<float>(index % kSide) - 0.5f * (kSide - 1)) * 1.5f;
+        float z = (static_cast<float>(index / kSide) - 0.5f * (kSide - 1)) * 1.5f;
+        float y = 0.5f * std::sin(x * 0.6f) * std::cos(z * 0.4f);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+        grid.models[index]  = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        grid.spheres[index] = glm::vec4(x, y, z, std::sqrt(0.75f));
+    }
+
+    static Visuals::UniformRing::FrameUniforms Uniforms(uint32_t frame)
+    {
+        Visuals::MeshFormat::Bounds bounds{};
+        bounds.radius = static_cast<float>(kSide);
+
+        Visuals::Camera::State camera;
+        Visuals::Camera::Orbit(camera, bounds, frame * 0.25);
+
+        VkExtent2D extent{kWidth, kHeight};
+        Visuals::UniformRing::FrameUniforms uniforms{};
+        uniforms.view           = Visuals::Camera::View(camera);
+        uniforms.projection     = Visuals::Camera::Projection(camera, extent);
+        uniforms.viewProj       = uniforms.projection * uniforms.view;
+        uniforms.cameraPosition = glm::vec4(camera.position, 1.0f);
+        return uniforms;
+    }
+
+    // Every cube is drawn, there is no culling to keep the stream fixed.
+    static void Draw(Visuals::Capture::Log& log, Visuals::Capture::Pipeline pipeline, uint32_t indexCount)
+    {
+        Visuals::Capture::BindPipeline(log, pipeline);
+        for (uint32_t i = 0; i < kCount; ++i)
+        {
+            Visuals::Capture::DrawIndexed(log, indexCount, i);
+        }
+    }
+
+    static void Write(const std::string& path, const std::vector<char>& mesh, bool prepass, bool spin, Visuals::GraphicsPipeline::MeshVariant variant)
+    {
+        using namespace Visuals;
+
+        Capture::Log log;
+        Capture::Create(path, VkExtent2D{kWidth, kHeight}, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, kFrames, log);
+
+        Mesh::Mapped mapped;
+        mapped.data   = const_cast<char*>(mesh.data());
+        mapped.size   = mesh.size();
+        mapped.header = reinterpret_cast<const MeshFormat::Header*>(mesh.data());
+        Capture::WriteMesh(log, mapped);
+
+        uint32_t indexCount = static_cast<uint32_t>(mapped.header->indexCount);
+
+        Grid grid;
+        grid.models.resize(kCount);
+        grid.spheres.resize(kCount);
+        for (uint32_t i = 0; i < kCount; ++i)
+        {
+            Place(grid, i, 0.0f);
+        }
+
+        for (uint32_t frame = 0; frame < kFrames; ++frame)
+        {
+            uint32_t begin = 0;
+            uint32_t end   = 0;
+            if (spin && frame > 0)
+            {
+                begin = kCount / 4;
+                end   = kCount / 2;
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    Place(grid, i, frame * 0.3f);
+                }
+            }
+
+            Capture::BeginFrame(log, Uniforms(frame), variant);
+            Capture::WriteObjects(log, kCount, grid.models.data(), grid.spheres.data(), begin, end);
+            if (prepass)
+            {
+                Draw(log, Capture::Pipeline::DepthOnly, indexCount);
+                Draw(log, Capture::Pipeline::Equal, indexCount);
+            }
+            else
+            {
+                Draw(log, Capture::Pipeline::Mesh, indexCount);
+            }
+            Capture::EndFrame(log);
+        }
+
+        Capture::Destroy(log);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <out dir>" << std::endl;
+        return 1;
+    }
+
+    std::string dir = argv[1];
+
+    try
+    {
+        std::vector<char> cube = Scenes::Cube();
+
+        Visuals::GraphicsPipeline::MeshVariant lit;
+        Visuals::GraphicsPipeline::MeshVariant normals;
+        normals.lighting = VK_FALSE;
+        normals.view     = static_cast<uint32_t>(Visuals::GraphicsPipeline::MeshView::Normals);
+
+        Scenes::Write(dir + "/grid.skyc", cube, false, false, lit);
+        Scenes::Write(dir + "/prepass.skyc", cube, true, false, lit);
+        Scenes::Write(dir + "/views.skyc", cube, false, true, normals);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote 3 scenes to " << dir << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Math.h"
+#include <algorithm>
+#include <cmath>
+#include <vulkan/vulkan_core.h>
+#include "MeshFormat.h"
+
+namespace Visuals
+{
+    namespace Camera
+    {
+        struct State
+        {
+            glm::vec3 position{0.0f, 0.0f, 2.0f};
+            glm::vec3 target{0.0f, 0.0f, 0.0f};
+            float     fovY  = glm::radians(60.0f);
+            float     zNear = 0.05f;
+            float     zFar  = 1000.0f;
+        };
+
+        glm::mat4 View(const State& camera)
+        {
+            return glm::lookAt(camera.position, camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+
+        glm::mat4 Projection(const State& camera, VkExtent2D& extent)
+        {
+            float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+            glm::mat4 proj = glm::perspective(camera.fovY, aspect, camera.zNear, camera.zFar);
+            proj[1][1] *= -1.0f; // Vulkan clip space has Y pointing down
+            return proj;
+        }
+
+        // Slowly circles the given bounds, used while there is no input handling.
+        // offset is added to the angle, extra windows look from further round.
+        void Orbit(State& camera, const MeshFormat::Bounds& bounds, double time, float offset = 0.0f)
+        {
+            float distance = std::max(bounds.radius, 0.01f) * 2.5f;
+            float angle    = static_cast<float>(time) * 0.5f + offset;
+
+            camera.target   = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+            camera.position = camera.target + glm::vec3(std::cos(angle) * distance, bounds.radius * 0.5f, std::sin(angle) * distance);
+            camera.zNear    = distance * 0.01f;
+            camera.zFar     = distance * 4.0f;
+        }
+
+        // Flies on along +z at speed units per second and weaves from side to
+        // side, looking ahead and a little down. For worlds streamed around
+        // the camera; range is the far plane.
+        void Fly(State& camera, double time, float speed, float height, float range)
+        {
+            float t     = static_cast<float>(time);
+            float weave = 0.05f;
+
+            camera.position = glm::vec3(std::sin(t * weave) * 60.0f, height + std::sin(t * 0.13f) * 6.0f, t * speed);
+            glm::vec3 ahead = glm::normalize(glm::vec3(std::cos(t * weave) * 60.0f * weave, 0.0f, speed));
+            camera.target   = camera.position + ahead * 40.0f - glm::vec3(0.0f, 12.0f, 0.0f);
+            camera.zNear    = 0.5f;
+            camera.zFar     = range;
+        }
+
+        // Planes point inwards: a point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+        void FrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
+        {
+            glm::mat4 m = glm::transpose(viewProj);
+
+            planes[0] = m[3] + m[0]; // left
+            planes[1] = m[3] - m[0]; // right
+            planes[2] = m[3] + m[1]; // bottom
+            planes[3] = m[3] - m[1]; // top
+            planes[4] = m[2];        // near (depth 0..1)
+            planes[5] = m[3] - m[2]; // far
+
+            for (int i = 0; i < 6; ++i)
+            {
+                planes[i] /= glm::length(glm::vec3(planes[i]));
+            }
+        }
+    }
+}
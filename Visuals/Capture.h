@@ -0,0 +1,468 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "Dispatch.h"
+#include "GraphicsPipeline.h"
+#include "Mesh.h"
+#include "MeshFormat.h"
+#include "Objects.h"
+#include "UniformRing.h"
+#include "Variants.h"
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Capture
+    {
+        /* .skyc, a recording of what CommandBuffer::Record drew, frame by
+        frame, in the renderer's own vocabulary rather than raw Vulkan calls,
+        so it replays on any device (SkyReplay):
+
+            Header
+            Mesh      the whole .skym file
+            per frame:
+                Frame     FrameUniforms, mesh variant
+                Objects   count, changed range [begin, end), models, spheres
+                Bind      Pipeline kind                        \  as recorded,
+                Draws     indexCount, n, firstInstance[n]      /  repeated
+                EndFrame
+
+        Every record is an 8 byte {op, size} followed by size bytes, padded
+        to 8. Consecutive draws of the same index count share one Draws
+        record, 4 bytes each. The first captured frame writes every object,
+        so replaying from frame 0 always starts from the same state.
+
+        Only the CPU culled mesh path is recorded: cluster and Hi-Z draws
+        are generated on the GPU and have no fixed command stream.
+        */
+
+        const uint32_t kMagic   = 0x43594B53; // "SKYC"
+        const uint32_t kVersion = 1;
+
+        struct Header
+        {
+            uint32_t magic       = kMagic;
+            uint32_t version     = kVersion;
+            uint32_t width       = 0;
+            uint32_t height      = 0;
+            uint32_t samples     = 1;
+            uint32_t colorFormat = 0;
+        };
+
+        enum class Op : uint32_t
+        {
+            Mesh,
+            Frame,
+            Objects,
+            Bind,
+            Draws,
+            EndFrame
+        };
+
+        enum class Pipeline : uint32_t
+        {
+            Mesh,      // the frame's variant, LESS
+            DepthOnly,
+            Equal      // the frame's variant after a depth prepass
+        };
+
+        struct Record
+        {
+            Op       op;
+            uint32_t size;
+        };
+
+        struct Frame
+        {
+            UniformRing::FrameUniforms    uniforms;
+            GraphicsPipeline::MeshVariant variant;
+        };
+
+        // Followed by (end - begin) models, then as many spheres.
+        struct ObjectsRange
+        {
+            uint32_t count;
+            uint32_t begin;
+            uint32_t end;
+            uint32_t reserved;
+        };
+
+        struct Bind
+        {
+            Pipeline pipeline;
+            uint32_t reserved;
+        };
+
+        // Followed by drawCount firstInstance values.
+        struct Draws
+        {
+            uint32_t indexCount;
+            uint32_t drawCount;
+        };
+
+        static_assert(0 == sizeof(Header) % 8 && 0 == sizeof(Frame) % 8, "Records stay 8 byte aligned");
+
+        // ---------------------------------------------------------------- capture
+
+        struct Log
+        {
+            std::ofstream         file;
+            std::vector<char>     frame;     // the frame being recorded, written out at EndFrame
+            std::vector<uint32_t> draws;     // firstInstance of the pending Draws record
+            uint32_t              indexCount = 0;
+            uint32_t              frames     = 0;
+            uint32_t              maxFrames  = 0;
+        };
+
+        static void Append(std::vector<char>& out, Op op, const void* data, size_t size, const void* extra = nullptr, size_t extraSize = 0)
+        {
+            Record record{op, static_cast<uint32_t>((size + extraSize + 7) & ~size_t(7))};
+
+            size_t at = out.size();
+            out.resize(at + sizeof(Record) + record.size, 0);
+            memcpy(out.data() + at, &record, sizeof(Record));
+            if (size > 0)
+            {
+                memcpy(out.data() + at + sizeof(Record), data, size);
+            }
+            if (extraSize > 0)
+            {
+                memcpy(out.data() + at + sizeof(Record) + size, extra, extraSize);
+            }
+        }
+
+        static void FlushDraws(Log& log)
+        {
+            if (log.draws.empty())
+            {
+                return;
+            }
+
+            Draws draws{log.indexCount, static_cast<uint32_t>(log.draws.size())};
+            Append(log.frame, Op::Draws, &draws, sizeof(draws), log.draws.data(), log.draws.size() * sizeof(uint32_t));
+            log.draws.clear();
+        }
+
+        // Records the next maxFrames frames into path.
+        void Create(const std::string& path, VkExtent2D extent, VkFormat colorFormat, VkSampleCountFlagBits samples, uint32_t maxFrames, Log& log)
+        {
+            log.file.open(path, std::ios::binary | std::ios::trunc);
+            if (!log.file.is_open())
+            {
+                throw std::runtime_error("Failed to open capture file !");
+            }
+
+            Header header;
+            header.width       = extent.width;
+            header.height      = extent.height;
+            header.samples     = static_cast<uint32_t>(samples);
+            header.colorFormat = static_cast<uint32_t>(colorFormat);
+            log.file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            log.maxFrames = maxFrames;
+        }
+
+        bool Active(const Log& log)
+        {
+            return log.file.is_open();
+        }
+
+        // The mesh every frame draws, before the first frame.
+        void WriteMesh(Log& log, const Mesh::Mapped& mapped)
+        {
+            std::vector<char> record;
+            Append(record, Op::Mesh, mapped.data, mapped.size);
+            log.file.write(record.data(), static_cast<std::streamsize>(record.size()));
+        }
+
+        void BeginFrame(Log& log, const UniformRing::FrameUniforms& uniforms, const GraphicsPipeline::MeshVariant& variant)
+        {
+            Frame frame{uniforms, variant};
+            log.frame.clear();
+            Append(log.frame, Op::Frame, &frame, sizeof(frame));
+        }
+
+        // Same arguments as the Objects::Write it follows.
+        void WriteObjects(Log& log, uint32_t count, const glm::mat4* models, const glm::vec4* spheres, uint32_t begin, uint32_t end)
+        {
+            if (0 == log.frames)
+            {
+                begin = 0;
+                end   = count;
+            }
+
+            if (begin >= end)
+            {
+                return;
+            }
+
+            ObjectsRange range{count, begin, end, 0};
+            std::vector<char> payload(sizeof(range) + (end - begin) * (sizeof(glm::mat4) + sizeof(glm::vec4)));
+            memcpy(payload.data(), &range, sizeof(range));
+            memcpy(payload.data() + sizeof(range), models + begin, (end - begin) * sizeof(glm::mat4));
+            memcpy(payload.data() + sizeof(range) + (end - begin) * sizeof(glm::mat4), spheres + begin, (end - begin) * sizeof(glm::vec4));
+
+            Append(log.frame, Op::Objects, payload.data(), payload.size());
+        }
+
+        void BindPipeline(Log& log, Pipeline pipeline)
+        {
+            FlushDraws(log);
+
+            Bind bind{pipeline, 0};
+            Append(log.frame, Op::Bind, &bind, sizeof(bind));
+        }
+
+        void DrawIndexed(Log& log, uint32_t indexCount, uint32_t firstInstance)
+        {
+            if (indexCount != log.indexCount)
+            {
+                FlushDraws(log);
+                log.indexCount = indexCount;
+            }
+
+            log.draws.push_back(firstInstance);
+        }
+
+        // Writes the frame out. Returns false once maxFrames are captured and the file is closed.
+        bool EndFrame(Log& log)
+        {
+            FlushDraws(log);
+            Append(log.frame, Op::EndFrame, nullptr, 0);
+            log.file.write(log.frame.data(), static_cast<std::streamsize>(log.frame.size()));
+
+            if (++log.frames >= log.maxFrames)
+            {
+                log.file.close();
+                return false;
+            }
+
+            return true;
+        }
+
+        void Destroy(Log& log)
+        {
+            if (log.file.is_open())
+            {
+                log.file.close();
+            }
+        }
+
+        // ---------------------------------------------------------------- replay
+
+        // Byte ranges into Stream::bytes.
+        struct FrameView
+        {
+            size_t frame   = 0;
+            size_t objects = 0; // 0 when no object changed
+            size_t begin   = 0; // first Bind / Draws record
+            size_t end     = 0; // the EndFrame record
+        };
+
+        struct Stream
+        {
+            std::vector<char>      bytes;
+            Header                 header;
+            Mesh::Mapped           mesh;    // points into bytes, never unmapped
+            std::vector<FrameView> frames;
+            uint32_t               objectCount = 0;
+            uint64_t               draws       = 0;
+        };
+
+        template <typename T>
+        const T* At(const Stream& stream, size_t offset)
+        {
+            return reinterpret_cast<const T*>(stream.bytes.data() + offset);
+        }
+
+        void Load(const std::string& path, Stream& stream)
+        {
+            std::ifstream file(path, std::ios::ate | std::ios::binary);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Failed to open capture file !");
+            }
+
+            size_t size = static_cast<size_t>(file.tellg());
+            stream.bytes.resize(size);
+            file.seekg(0);
+            file.read(stream.bytes.data(), static_cast<std::streamsize>(size));
+
+            if (size < sizeof(Header))
+            {
+                throw std::runtime_error("Capture file is too small !");
+            }
+
+            memcpy(&stream.header, stream.bytes.data(), sizeof(Header));
+            if (kMagic != stream.header.magic || kVersion != stream.header.version)
+            {
+                throw std::runtime_error("Not a SKYC capture file !");
+            }
+
+            FrameView frame;
+            size_t    at = sizeof(Header);
+            while (at + sizeof(Record) <= size)
+            {
+                const Record& record = *At<Record>(stream, at);
+                size_t payload = at + sizeof(Record);
+                if (payload + record.size > size)
+                {
+                    throw std::runtime_error("Capture file is truncated !");
+                }
+
+                switch (record.op)
+                {
+                    case Op::Mesh:
+                        stream.mesh.data   = stream.bytes.data() + payload;
+                        stream.mesh.size   = record.size;
+                        stream.mesh.header = At<MeshFormat::Header>(stream, payload);
+                        MeshFormat::Validate(*stream.mesh.header, record.size);
+                        break;
+                    case Op::Frame:
+                        frame       = {};
+                        frame.frame = payload;
+                        break;
+                    case Op::Objects:
+                        frame.objects      = payload;
+                        stream.objectCount = std::max(stream.objectCount, At<ObjectsRange>(stream, payload)->count);
+                        break;
+                    case Op::Bind:
+                    case Op::Draws:
+                        frame.begin = 0 == frame.begin ? at : frame.begin;
+                        stream.draws += Op::Draws == record.op ? At<Draws>(stream, payload)->drawCount : 0;
+                        break;
+                    case Op::EndFrame:
+                        frame.end   = at;
+                        frame.begin = 0 == frame.begin ? at : frame.begin;
+                        stream.frames.push_back(frame);
+                        break;
+                    default:
+                        throw std::runtime_error("Unknown capture record !");
+                }
+
+                at = payload + record.size;
+            }
+
+            if (nullptr == stream.mesh.header || stream.frames.empty() || 0 == stream.objectCount)
+            {
+                throw std::runtime_error("Capture file holds no complete frame !");
+            }
+        }
+
+        // What a replayed frame draws with, built the way Visuals builds it.
+        struct Player
+        {
+            Mesh::Gpu                                      mesh;
+            Objects::Buffer                                objects;
+            UniformRing::Ring                              uniforms;
+            VkPipelineLayout                               layout = VK_NULL_HANDLE;
+            Variants::Cache<GraphicsPipeline::MeshVariant> pipelines;
+            Variants::Cache<GraphicsPipeline::MeshVariant> pipelinesEqual;
+            VkPipeline                                     depthOnly = VK_NULL_HANDLE;
+            std::vector<glm::mat4>                         models;
+            std::vector<glm::vec4>                         spheres;
+            uint64_t                                       draws     = 0; // issued by Execute, never reset
+            uint64_t                                       triangles = 0;
+        };
+
+        // renderPass is the one the replay renders into, extent the header's.
+        void CreatePlayer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool& commandPool, VkQueue& queue, VkRenderPass& renderPass, VkExtent2D& extent, VkSampleCountFlagBits samples, const Stream& stream, Player& player)
+        {
+            Mesh::Upload(device, physicalDevice, commandPool, queue, stream.mesh, player.mesh);
+
+            Objects::CreateSetLayout(device, player.objects);
+            Objects::Create(device, physicalDevice, stream.objectCount, player.objects);
+            UniformRing::CreateSetLayout(device, player.uniforms);
+            UniformRing::Create(device, physicalDevice, 64 * 1024, sizeof(UniformRing::FrameUniforms), player.uniforms);
+
+            GraphicsPipeline::CreateMeshVariants(player.pipelines, device, extent, player.layout, renderPass, player.objects.setLayout, player.uniforms.setLayout, VK_COMPARE_OP_LESS, samples);
+            GraphicsPipeline::CreateMeshVariants(player.pipelinesEqual, device, extent, player.layout, renderPass, player.objects.setLayout, player.uniforms.setLayout, VK_COMPARE_OP_EQUAL, samples);
+            GraphicsPipeline::CreateMeshDepthOnly(player.depthOnly, device, extent, player.layout, renderPass, player.objects.setLayout, player.uniforms.setLayout, samples);
+
+            player.models.assign(stream.objectCount, glm::mat4(1.0f));
+            player.spheres.assign(stream.objectCount, Objects::kNoBounds);
+        }
+
+        /* Uploads the frame's uniforms and objects and records its draws,
+        inside a render pass begun by the caller. Like Visuals::Apply, only
+        once the previous frame's fence has been waited on. */
+        void Execute(VkCommandBuffer& commandBuffer, const Stream& stream, const FrameView& view, Player& player)
+        {
+            const Frame& frame = *At<Frame>(stream, view.frame);
+
+            UniformRing::BeginFrame(player.uniforms);
+            uint32_t frameOffset = UniformRing::Push(player.uniforms, frame.uniforms);
+
+            uint32_t begin = 0;
+            uint32_t end   = 0;
+            if (0 != view.objects)
+            {
+                const ObjectsRange& range = *At<ObjectsRange>(stream, view.objects);
+                const char*         data  = stream.bytes.data() + view.objects + sizeof(ObjectsRange);
+                begin = range.begin;
+                end   = range.end;
+                memcpy(player.models.data() + begin, data, (end - begin) * sizeof(glm::mat4));
+                memcpy(player.spheres.data() + begin, data + (end - begin) * sizeof(glm::mat4), (end - begin) * sizeof(glm::vec4));
+            }
+            Objects::Write(player.objects, player.models.data(), player.spheres.data(), begin, end);
+
+            Dispatch::DeviceTable& vk           = Dispatch::Device();
+            VkDeviceSize           vertexOffset = player.mesh.vertexOffset;
+
+            size_t at = view.begin;
+            while (at < view.end)
+            {
+                const Record& record  = *At<Record>(stream, at);
+                size_t        payload = at + sizeof(Record);
+
+                if (Op::Bind == record.op)
+                {
+                    Pipeline   kind     = At<Bind>(stream, payload)->pipeline;
+                    VkPipeline pipeline = Pipeline::DepthOnly == kind ? player.depthOnly
+                                        : Pipeline::Equal == kind     ? Variants::Find(player.pipelinesEqual, frame.variant)
+                                                                      : Variants::Find(player.pipelines, frame.variant);
+
+                    vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                    VkDescriptorSet sets[] = {Objects::CurrentSet(player.objects), player.uniforms.descriptorSet};
+                    vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, player.layout, 0, 2, sets, 1, &frameOffset);
+                    vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &player.mesh.buffer, &vertexOffset);
+                    vk.CmdBindIndexBuffer(commandBuffer, player.mesh.buffer, player.mesh.indexOffset, player.mesh.indexType);
+                }
+                else if (Op::Draws == record.op)
+                {
+                    const Draws&    draws     = *At<Draws>(stream, payload);
+                    const uint32_t* instances = At<uint32_t>(stream, payload + sizeof(Draws));
+                    for (uint32_t i = 0; i < draws.drawCount; ++i)
+                    {
+                        vk.CmdDrawIndexed(commandBuffer, draws.indexCount, 1, 0, 0, instances[i]);
+                    }
+                    player.draws     += draws.drawCount;
+                    player.triangles += uint64_t(draws.drawCount) * (draws.indexCount / 3);
+                }
+
+                at = payload + record.size;
+            }
+        }
+
+        void DestroyPlayer(VkDevice& device, Player& player)
+        {
+            vkDestroyPipeline(device, player.depthOnly, HostMemory::Callbacks());
+            Variants::Destroy(device, player.pipelinesEqual);
+            GraphicsPipeline::DestroyMeshVariants(device, player.pipelines, player.layout);
+            UniformRing::Destroy(device, player.uniforms);
+            Objects::Destroy(device, player.objects);
+            Mesh::Destroy(device, player.mesh);
+
+            player = {};
+        }
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "ComputePipeline.h"
+#include "Descriptors.h"
+#include "Memory.h"
+#include "Mesh.h"
+#include "HostMemory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace ClusterCull
+    {
+        // Mirrors the DrawCommand block in ClusterCull.comp.
+        struct DrawCommand
+        {
+            VkDrawIndexedIndirectCommand draw;
+            uint32_t                     visibleClusters;
+            uint32_t                     frustumCulled;
+            uint32_t                     backfaceCulled;
+        };
+
+        struct PushConstants
+        {
+            glm::vec4  planes[6];
+            glm::vec4  cameraPosition;
+            glm::uvec4 info;
+        };
+
+        struct Stats
+        {
+            uint32_t clusters           = 0;
+            uint32_t visibleClusters    = 0;
+            uint32_t frustumCulled      = 0;
+            uint32_t backfaceCulled     = 0;
+            uint64_t submittedTriangles = 0;
+            uint64_t renderedTriangles  = 0;
+        };
+
+        struct Resources
+        {
+            VkDescriptorSetLayout setLayout      = VK_NULL_HANDLE;
+            VkPipelineLayout      pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline            pipeline       = VK_NULL_HANDLE;
+            VkDescriptorPool      descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet       descriptorSet  = VK_NULL_HANDLE;
+            VkBuffer              indexBuffer    = VK_NULL_HANDLE;
+            VkDeviceMemory        indexMemory    = VK_NULL_HANDLE;
+            VkBuffer              drawBuffer     = VK_NULL_HANDLE;
+            VkDeviceMemory        drawMemory     = VK_NULL_HANDLE;
+            VkBuffer              statsBuffer    = VK_NULL_HANDLE;
+            VkDeviceMemory        statsMemory    = VK_NULL_HANDLE;
+            DrawCommand*          statsMapped    = nullptr;
+        };
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, Mesh::Gpu& mesh, Resources& res)
+        {
+            if (0 == mesh.meshletCount)
+            {
+                throw std::runtime_error("Cluster culling needs a mesh packed with meshlets !");
+            }
+
+            const std::vector<VkDescriptorType> types(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            Descriptors::CreateSetLayout(device, types, VK_SHADER_STAGE_COMPUTE_BIT, res.setLayout);
+            ComputePipeline::Create(res.pipeline, device, res.pipelineLayout, "ClusterCull.comp.spv", {res.setLayout}, sizeof(PushConstants));
+
+            // Worst case every cluster survives.
+            Memory::CreateBuffer(device, physicalDevice, sizeof(uint32_t) * mesh.indexCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.indexBuffer, res.indexMemory);
+            Memory::CreateBuffer(device, physicalDevice, sizeof(DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.drawBuffer, res.drawMemory);
+            Memory::CreateBuffer(device, physicalDevice, sizeof(DrawCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, res.statsBuffer, res.statsMemory);
+
+            if (VK_SUCCESS != vkMapMemory(device, res.statsMemory, 0, sizeof(DrawCommand), 0, reinterpret_cast<void**>(&res.statsMapped)))
+            {
+                throw std::runtime_error("Failed to map cluster cull stats buffer !");
+            }
+            memset(res.statsMapped, 0, sizeof(DrawCommand));
+
+            Descriptors::CreatePool(device, types, 1, res.descriptorPool);
+            Descriptors::Allocate(device, res.descriptorPool, res.setLayout, res.descriptorSet);
+
+            // The source index range runs up to the meshlet stream so 16 bit
+            // meshes with an odd index count can still be read as whole words.
+            Descriptors::WriteBuffer(device, res.descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh.buffer, mesh.meshletOffset, sizeof(MeshFormat::Meshlet) * mesh.meshletCount);
+            Descriptors::WriteBuffer(device, res.descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh.buffer, mesh.indexOffset, mesh.meshletOffset - mesh.indexOffset);
+            Descriptors::WriteBuffer(device, res.descriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.indexBuffer, 0, VK_WHOLE_SIZE);
+            Descriptors::WriteBuffer(device, res.descriptorSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.drawBuffer, 0, VK_WHOLE_SIZE);
+        }
+
+        void Destroy(VkDevice& device, Resources& res)
+        {
+            if (VK_NULL_HANDLE == res.pipeline)
+            {
+                return;
+            }
+
+            vkUnmapMemory(device, res.statsMemory);
+            Memory::DestroyBuffer(device, res.statsBuffer, res.statsMemory);
+            Memory::DestroyBuffer(device, res.drawBuffer, res.drawMemory);
+            Memory::DestroyBuffer(device, res.indexBuffer, res.indexMemory);
+            vkDestroyDescriptorPool(device, res.descriptorPool, HostMemory::Callbacks());
+            ComputePipeline::Destroy(device, res.pipeline, res.pipelineLayout);
+            vkDestroyDescriptorSetLayout(device, res.setLayout, HostMemory::Callbacks());
+            res = {};
+        }
+
+        // Recorded outside the render pass: resets the draw, culls every cluster
+        // and leaves a compacted index list plus one indirect draw behind.
+        void Record(VkCommandBuffer& commandBuffer, Resources& res, Mesh::Gpu& mesh, const glm::vec4 planes[6], const glm::vec3& cameraPosition)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            DrawCommand reset{};
+            reset.draw.instanceCount = 1;
+            vk.CmdUpdateBuffer(commandBuffer, res.drawBuffer, 0, sizeof(reset), &reset);
+
+            VkMemoryBarrier resetBarrier{};
+            resetBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+            PushConstants params{};
+            for (int i = 0; i < 6; ++i)
+            {
+                params.planes[i] = planes[i];
+            }
+            params.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+            params.info           = glm::uvec4(mesh.meshletCount, VK_INDEX_TYPE_UINT32 == mesh.indexType ? 1u : 0u, 0u, 0u);
+
+            vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.pipeline);
+            vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.pipelineLayout, 0, 1, &res.descriptorSet, 0, nullptr);
+            vk.CmdPushConstants(commandBuffer, res.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+            // maxComputeWorkGroupCount[0] is only guaranteed to be 65535.
+            uint32_t groupsX = std::min(mesh.meshletCount, 65535u);
+            uint32_t groupsY = (mesh.meshletCount + groupsX - 1) / groupsX;
+            vk.CmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+            VkMemoryBarrier cullBarrier{};
+            cullBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+            VkBufferCopy copyRegion{};
+            copyRegion.size = sizeof(DrawCommand);
+            vk.CmdCopyBuffer(commandBuffer, res.drawBuffer, res.statsBuffer, 1, &copyRegion);
+
+            VkMemoryBarrier hostBarrier{};
+            hostBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        // Recorded inside the render pass with the mesh pipeline bound.
+        void Draw(VkCommandBuffer& commandBuffer, Resources& res, Mesh::Gpu& mesh)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            VkDeviceSize vertexOffset = mesh.vertexOffset;
+            vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.buffer, &vertexOffset);
+            vk.CmdBindIndexBuffer(commandBuffer, res.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            vk.CmdDrawIndexedIndirect(commandBuffer, res.drawBuffer, 0, 1, sizeof(DrawCommand));
+        }
+
+        // Only valid once the frame that recorded Record() has signalled its fence.
+        void ReadStats(Resources& res, Mesh::Gpu& mesh, Stats& stats)
+        {
+            const DrawCommand& result = *res.statsMapped;
+
+            stats.clusters           = mesh.meshletCount;
+            stats.visibleClusters    = result.visibleClusters;
+            stats.frustumCulled      = result.frustumCulled;
+            stats.backfaceCulled     = result.backfaceCulled;
+            stats.submittedTriangles = mesh.indexCount / 3;
+            stats.renderedTriangles  = result.draw.indexCount / 3;
+        }
+    }
+}
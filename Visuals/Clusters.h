@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Math.h"
+#include "MeshFormat.h"
+
+namespace Visuals
+{
+    namespace Clusters
+    {
+        // One compute thread per triangle in ClusterCull.comp, keep in sync with local_size_x.
+        static constexpr uint32_t kMaxTriangles = 128;
+
+        static glm::vec3 Position(const MeshFormat::Vertex* vertices, uint32_t index)
+        {
+            return glm::vec3(vertices[index].position[0], vertices[index].position[1], vertices[index].position[2]);
+        }
+
+        static void ComputeBounds(const MeshFormat::Vertex* vertices, const uint32_t* indices, MeshFormat::Meshlet& meshlet)
+        {
+            const uint32_t* tri = indices + meshlet.firstIndex;
+            uint32_t indexCount = meshlet.triangleCount * 3;
+
+            glm::vec3 lo = Position(vertices, tri[0]);
+            glm::vec3 hi = lo;
+            for (uint32_t i = 1; i < indexCount; ++i)
+            {
+                glm::vec3 p = Position(vertices, tri[i]);
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+
+            glm::vec3 center = 0.5f * (lo + hi);
+            float radius = 0.0f;
+            for (uint32_t i = 0; i < indexCount; ++i)
+            {
+                radius = std::max(radius, glm::length(Position(vertices, tri[i]) - center));
+            }
+
+            // Normal cone: average of unit face normals, cutoff from the widest one.
+            std::vector<glm::vec3> normals;
+            normals.reserve(meshlet.triangleCount);
+            glm::vec3 axis(0.0f);
+            for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                glm::vec3 a = Position(vertices, tri[t * 3 + 0]);
+                glm::vec3 b = Position(vertices, tri[t * 3 + 1]);
+                glm::vec3 c = Position(vertices, tri[t * 3 + 2]);
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float length = glm::length(n);
+                if (length > 0.0f)
+                {
+                    normals.push_back(n / length);
+                    axis += n / length;
+                }
+            }
+
+            float cutoff = 1.0f; // cone test can never pass
+            float axisLength = glm::length(axis);
+            if (axisLength > 0.0f)
+            {
+                axis /= axisLength;
+
+                float minDot = 1.0f;
+                for (const glm::vec3& n : normals)
+                {
+                    minDot = std::min(minDot, glm::dot(axis, n));
+                }
+
+                // Normals spread over more than a hemisphere cannot be rejected as a group.
+                if (minDot > 0.0f)
+                {
+                    cutoff = std::sqrt(1.0f - minDot * minDot);
+                }
+            }
+
+            meshlet.center[0]   = center.x;
+            meshlet.center[1]   = center.y;
+            meshlet.center[2]   = center.z;
+            meshlet.radius      = radius;
+            meshlet.coneAxis[0] = axis.x;
+            meshlet.coneAxis[1] = axis.y;
+            meshlet.coneAxis[2] = axis.z;
+            meshlet.coneCutoff  = cutoff;
+        }
+
+        // Splits a triangle list into clusters of at most maxTriangles triangles.
+        // Triangles are grown breadth first over shared vertices so clusters stay
+        // spatially compact. indices is rewritten so every cluster is a contiguous
+        // range [firstIndex, firstIndex + triangleCount * 3).
+        void Build(const MeshFormat::Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& indices, std::vector<MeshFormat::Meshlet>& meshlets, uint32_t maxTriangles = kMaxTriangles)
+        {
+            const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+            maxTriangles = std::min(std::max(maxTriangles, 1u), kMaxTriangles);
+
+            // vertex -> triangles adjacency, compressed rows.
+            std::vector<uint32_t> offsets(vertexCount + 1, 0);
+            for (uint32_t index : indices)
+            {
+                offsets[index + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                offsets[v + 1] += offsets[v];
+            }
+
+            std::vector<uint32_t> adjacency(indices.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (uint32_t t = 0; t < triangleCount; ++t)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    adjacency[fill[indices[t * 3 + k]]++] = t;
+                }
+            }
+
+            std::vector<uint8_t>  assigned(triangleCount, 0);
+            std::vector<uint32_t> reordered;
+            std::vector<uint32_t> queue;
+            reordered.reserve(indices.size());
+            meshlets.clear();
+
+            uint32_t seed = 0;
+            while (seed < triangleCount)
+            {
+                if (assigned[seed])
+                {
+                    seed++;
+                    continue;
+                }
+
+                MeshFormat::Meshlet meshlet{};
+                meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+
+                queue.clear();
+                queue.push_back(seed);
+                assigned[seed] = 1;
+
+                for (size_t head = 0; head < queue.size() && meshlet.triangleCount < maxTriangles; ++head)
+                {
+                    uint32_t t = queue[head];
+                    reordered.insert(reordered.end(), {indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2]});
+                    meshlet.triangleCount++;
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        uint32_t v = indices[t * 3 + k];
+                        for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+                        {
+                            uint32_t neighbor = adjacency[a];
+                            if (!assigned[neighbor])
+                            {
+                                assigned[neighbor] = 1;
+                                queue.push_back(neighbor);
+                            }
+                        }
+                    }
+                }
+
+                // Triangles queued but not emitted go back to the pool.
+                for (size_t head = meshlet.triangleCount; head < queue.size(); ++head)
+                {
+                    assigned[queue[head]] = 0;
+                }
+
+                meshlets.push_back(meshlet);
+            }
+
+            indices.swap(reordered);
+
+            for (MeshFormat::Meshlet& meshlet : meshlets)
+            {
+                ComputeBounds(vertices, indices.data(), meshlet);
+            }
+        }
+
+        enum class Result
+        {
+            Visible,
+            FrustumCulled,
+            BackfaceCulled,
+        };
+
+        // CPU reference of the test in ClusterCull.comp.
+        Result Test(const MeshFormat::Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition)
+        {
+            glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+
+            for (int i = 0; i < 6; ++i)
+            {
+                if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -meshlet.radius)
+                {
+                    return Result::FrustumCulled;
+                }
+            }
+
+            glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+            glm::vec3 view = center - cameraPosition;
+            if (glm::dot(view, axis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+            {
+                return Result::BackfaceCulled;
+            }
+
+            return Result::Visible;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "GraphicsPipeline.h"
+#include "HostMemory.h"
+#include "PipelineCache.h"
+
+namespace Visuals
+{
+    namespace ComputePipeline
+    {
+        void Create(VkPipeline& pipeline, VkDevice& device, VkPipelineLayout& pipelineLayout, const std::string& shader, const std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t pushConstantSize)
+        {
+            auto shaderCode = GraphicsPipeline::ReadFile(SKY_SHADER_DIR + shader);
+            VkShaderModule shaderModule = GraphicsPipeline::CreateShaderModule(device, shaderCode);
+
+            VkPushConstantRange pushConstant{};
+            pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstant.offset     = 0;
+            pushConstant.size       = pushConstantSize;
+
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount         = static_cast<uint32_t>(setLayouts.size());
+            pipelineLayoutInfo.pSetLayouts            = setLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+            pipelineLayoutInfo.pPushConstantRanges    = pushConstantSize > 0 ? &pushConstant : nullptr;
+
+            if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostMemory::Callbacks(), &pipelineLayout))
+            {
+                throw std::runtime_error("Failed to create compute pipeline layout !");
+            }
+
+            VkPipelineShaderStageCreateInfo stageInfo{};
+            stageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stageInfo.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+            stageInfo.module = shaderModule;
+            stageInfo.pName  = "main";
+
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage  = stageInfo;
+            pipelineInfo.layout = pipelineLayout;
+
+            if (VK_SUCCESS != vkCreateComputePipelines(device, PipelineCache::Handle(), 1, &pipelineInfo, HostMemory::Callbacks(), &pipeline))
+            {
+                throw std::runtime_error("Failed to create compute pipeline !");
+            }
+
+            vkDestroyShaderModule(device, shaderModule, HostMemory::Callbacks());
+        }
+
+        void Destroy(VkDevice& device, VkPipeline& pipeline, VkPipelineLayout& pipelineLayout)
+        {
+            vkDestroyPipeline(device, pipeline, HostMemory::Callbacks());
+            vkDestroyPipelineLayout(device, pipelineLayout, HostMemory::Callbacks());
+        }
+    }
+}
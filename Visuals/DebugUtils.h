@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Vulkan.h"
+#include "Dispatch.h"
+#include "HostMemory.h"
 #include <cstring>
 #include <stdexcept>
 #include <vulkan/vulkan.h>
@@ -109,7 +111,8 @@ namespace Visuals
 
         VkResult CreateDebugUtilsMessengerEXT(VkInstance& instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
         {
-            auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+            // Fetched by Dispatch::LoadInstance, the loader does not export it.
+            PFN_vkCreateDebugUtilsMessengerEXT func = Dispatch::Instance().CreateDebugUtilsMessengerEXT;
             if (nullptr != func)
             {
                 return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
@@ -122,7 +125,7 @@ namespace Visuals
 
         void DestroyDebugUtilsMessengerEXT(VkInstance& instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
         {
-            auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+            PFN_vkDestroyDebugUtilsMessengerEXT func = Dispatch::Instance().DestroyDebugUtilsMessengerEXT;
             if (nullptr != func)
             {
                 func(instance, debugMessenger, pAllocator);
@@ -134,7 +137,7 @@ namespace Visuals
             VkDebugUtilsMessengerCreateInfoEXT createInfo{};
             PopulateDebugMessengerCreateInfo(createInfo);
 
-            if (VK_SUCCESS != CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger))
+            if (VK_SUCCESS != CreateDebugUtilsMessengerEXT(instance, &createInfo, HostMemory::Callbacks(), &debugMessenger))
             {
                 throw std::runtime_error("Filed to create debug messenger !");
             }
@@ -144,7 +147,7 @@ namespace Visuals
         {
             if (true == kDebug && VK_NULL_HANDLE != debugMessenger)
             {
-                DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+                DestroyDebugUtilsMessengerEXT(instance, debugMessenger, HostMemory::Callbacks());
                 debugMessenger = VK_NULL_HANDLE;
             }
         }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "Memory.h"
+
+namespace Visuals
+{
+    namespace Depth
+    {
+        // Candidates in order of preference. Sampled usage is required because
+        // the Hi-Z pyramid is built from the depth attachment.
+        VkFormat FindFormat(VkPhysicalDevice& physicalDevice)
+        {
+            const std::vector<VkFormat> candidates =
+            {
+                VK_FORMAT_D32_SFLOAT,
+                VK_FORMAT_D32_SFLOAT_S8_UINT,
+                VK_FORMAT_D24_UNORM_S8_UINT,
+                VK_FORMAT_D16_UNORM
+            };
+
+            const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+            for (VkFormat format : candidates)
+            {
+                VkFormatProperties properties;
+                vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+                if ((properties.optimalTilingFeatures & required) == required)
+                {
+                    return format;
+                }
+            }
+
+            throw std::runtime_error("Failed to find a supported depth format !");
+        }
+
+        // Multisampled depth is never stored or sampled, so it is a transient attachment.
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkExtent2D& extent, VkFormat& depthFormat, VkImage& depthImage, VkDeviceMemory& depthImageMemory, VkImageView& depthImageView, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+        {
+            VkImageUsageFlags     usage      = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            if (VK_SAMPLE_COUNT_1_BIT != samples)
+            {
+                usage      = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+                properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+            }
+
+            Memory::CreateImage(device, physicalDevice, extent.width, extent.height, 1, depthFormat, usage, properties, depthImage, depthImageMemory, samples);
+            Memory::CreateImageView(device, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, depthImageView);
+        }
+
+        void Destroy(VkDevice& device, VkImage& depthImage, VkDeviceMemory& depthImageMemory, VkImageView& depthImageView)
+        {
+            vkDestroyImageView(device, depthImageView, HostMemory::Callbacks());
+            Memory::DestroyImage(device, depthImage, depthImageMemory);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Descriptors
+    {
+        // Binding i gets types[i], one descriptor each.
+        void CreateSetLayout(VkDevice& device, const std::vector<VkDescriptorType>& types, VkShaderStageFlags stageFlags, VkDescriptorSetLayout& setLayout)
+        {
+            std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+            for (uint32_t i = 0; i < types.size(); ++i)
+            {
+                bindings[i].binding         = i;
+                bindings[i].descriptorType  = types[i];
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags      = stageFlags;
+            }
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+            layoutInfo.pBindings    = bindings.data();
+
+            if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layoutInfo, HostMemory::Callbacks(), &setLayout))
+            {
+                throw std::runtime_error("Failed to create descriptor set layout !");
+            }
+        }
+
+        // Pool sized for maxSets sets of the given layout.
+        void CreatePool(VkDevice& device, const std::vector<VkDescriptorType>& types, uint32_t maxSets, VkDescriptorPool& pool)
+        {
+            std::map<VkDescriptorType, uint32_t> counts;
+            for (VkDescriptorType type : types)
+            {
+                counts[type] += maxSets;
+            }
+
+            std::vector<VkDescriptorPoolSize> poolSizes;
+            for (const auto& [type, count] : counts)
+            {
+                poolSizes.push_back({type, count});
+            }
+
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+            poolInfo.pPoolSizes    = poolSizes.data();
+            poolInfo.maxSets       = maxSets;
+
+            if (VK_SUCCESS != vkCreateDescriptorPool(device, &poolInfo, HostMemory::Callbacks(), &pool))
+            {
+                throw std::runtime_error("Failed to create descriptor pool !");
+            }
+        }
+
+        void Allocate(VkDevice& device, VkDescriptorPool& pool, VkDescriptorSetLayout& setLayout, VkDescriptorSet& set)
+        {
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool     = pool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts        = &setLayout;
+
+            if (VK_SUCCESS != vkAllocateDescriptorSets(device, &allocInfo, &set))
+            {
+                throw std::runtime_error("Failed to allocate descriptor set !");
+            }
+        }
+
+        void WriteBuffer(VkDevice& device, VkDescriptorSet& set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+        {
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = buffer;
+            bufferInfo.offset = offset;
+            bufferInfo.range  = range;
+
+            VkWriteDescriptorSet write{};
+            write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet          = set;
+            write.dstBinding      = binding;
+            write.descriptorCount = 1;
+            write.descriptorType  = type;
+            write.pBufferInfo     = &bufferInfo;
+
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
+
+        void WriteImage(VkDevice& device, VkDescriptorSet& set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout layout)
+        {
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.sampler     = sampler;
+            imageInfo.imageView   = view;
+            imageInfo.imageLayout = layout;
+
+            VkWriteDescriptorSet write{};
+            write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet          = set;
+            write.dstBinding      = binding;
+            write.descriptorCount = 1;
+            write.descriptorType  = type;
+            write.pImageInfo      = &imageInfo;
+
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstring>
 #include <set>
 #include "DebugUtils.h"
+#include "HostMemory.h"
 #include <optional>
 #include <vector>
 #include <iostream>
@@ -15,6 +17,7 @@ namespace Visuals
         {
             std::optional<uint32_t> graphicsFamily;
             std::optional<uint32_t> presentFamily;
+            std::optional<uint32_t> computeFamily; // compute without graphics, runs beside it
 
             bool IsComplete() const
             {
@@ -62,9 +65,39 @@ namespace Visuals
                 }
             }
 
+            for (uint32_t i = 0; i < queueFamilyCount; ++i)
+            {
+                const auto& qFamily = queueFamilies[i];
+
+                if ((qFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && 0 == (qFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+                {
+                    indices.computeFamily = i;
+                    break;
+                }
+            }
+
             return indices;
         }
 
+        // Optional extensions, enabled when the device has them.
+        bool HasExtension(VkPhysicalDevice& physicalDevice, const char* name)
+        {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+            for (const auto& extension : availableExtensions)
+            {
+                if (0 == strcmp(name, extension.extensionName))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         bool CheckDeviceExtensionSupport(VkPhysicalDevice& physicalDevice)
         {
             uint32_t extensionCount;
@@ -155,12 +188,17 @@ namespace Visuals
     namespace LogicalDevice
     {
 
-        void Create(VkPhysicalDevice& physicalDevice, VkDevice& device, const std::vector<const char*> validationLayers, VkQueue& graphicsQueue, VkQueue& presentQueue, VkSurfaceKHR& surface)
+        // Without a dedicated compute family computeQueue is the graphics queue.
+        void Create(VkPhysicalDevice& physicalDevice, VkDevice& device, const std::vector<const char*> validationLayers, VkQueue& graphicsQueue, VkQueue& presentQueue, VkQueue& computeQueue, VkSurfaceKHR& surface)
         {
             PhysicalDevice::QueueFamilyIndices indices = PhysicalDevice::FindQueueFamilies(physicalDevice, surface);
 
             std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
             std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+            if (indices.computeFamily.has_value())
+            {
+                uniqueQueueFamilies.insert(indices.computeFamily.value());
+            }
 
             float queuePriority = 1.0f;
             for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -173,15 +211,30 @@ namespace Visuals
                 queueCreateInfos.push_back(queueCreateInfo);
             }
 
+            VkPhysicalDeviceFeatures supportedFeatures;
+            vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+            // Occlusion culling draws one indirect command per object, the
+            // statistics query compares the depth prepass against plain drawing.
             VkPhysicalDeviceFeatures deviceFeatures{};
+            deviceFeatures.multiDrawIndirect         = supportedFeatures.multiDrawIndirect;
+            deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+            deviceFeatures.pipelineStatisticsQuery   = supportedFeatures.pipelineStatisticsQuery;
+
+            // Heap budgets for Residency.h, which falls back to heap sizes without it.
+            std::vector<const char*> extensions = PhysicalDevice::deviceExtensions;
+            if (PhysicalDevice::HasExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+            {
+                extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            }
 
             VkDeviceCreateInfo createInfo{};
             createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
             createInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size());
             createInfo.pQueueCreateInfos       = queueCreateInfos.data();
             createInfo.pEnabledFeatures        = &deviceFeatures;
-            createInfo.enabledExtensionCount   = static_cast<uint32_t>(PhysicalDevice::deviceExtensions.size());
-            createInfo.ppEnabledExtensionNames = PhysicalDevice::deviceExtensions.data();
+            createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+            createInfo.ppEnabledExtensionNames = extensions.data();
 
             if (true == kDebug)
             {
@@ -193,18 +246,19 @@ namespace Visuals
                 createInfo.enabledLayerCount   = 0;
             }
 
-            if (VK_SUCCESS != vkCreateDevice(physicalDevice, &createInfo, nullptr, &device))
+            if (VK_SUCCESS != vkCreateDevice(physicalDevice, &createInfo, HostMemory::Callbacks(), &device))
             {
                 throw std::runtime_error("Failed to create logical device !");
             }
 
             vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
             vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+            vkGetDeviceQueue(device, indices.computeFamily.value_or(indices.graphicsFamily.value()), 0, &computeQueue);
         }
 
         void Destroy(VkDevice& device)
         {
-            vkDestroyDevice(device, nullptr);
+            vkDestroyDevice(device, HostMemory::Callbacks());
         }
     }
 }
\ No newline at end of file
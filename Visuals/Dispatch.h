@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Visuals
+{
+    namespace Dispatch
+    {
+        /* Function pointers fetched once at startup instead of going through
+        the loader's exported trampolines on every call. Device level entries
+        come from vkGetDeviceProcAddr and jump straight into the driver (or
+        the first enabled layer), which is what the per draw calls of
+        Draw::Frame and CommandBuffer::Record want.
+
+        Every entry starts as the loader's export, so a table that was never
+        loaded, or an entry the device does not expose, still works. */
+
+        struct InstanceTable
+        {
+            PFN_vkGetDeviceProcAddr             GetDeviceProcAddr             = vkGetDeviceProcAddr;
+            PFN_vkCreateDebugUtilsMessengerEXT  CreateDebugUtilsMessengerEXT  = nullptr; // extension, no loader export
+            PFN_vkDestroyDebugUtilsMessengerEXT DestroyDebugUtilsMessengerEXT = nullptr;
+        };
+
+        // Only what runs per frame or per draw, everything else stays on the loader.
+        struct DeviceTable
+        {
+            VkDevice                        device                = VK_NULL_HANDLE; // the one it was loaded for
+            PFN_vkAcquireNextImageKHR       AcquireNextImageKHR   = vkAcquireNextImageKHR;
+            PFN_vkQueueSubmit               QueueSubmit           = vkQueueSubmit;
+            PFN_vkQueuePresentKHR           QueuePresentKHR       = vkQueuePresentKHR;
+            PFN_vkWaitForFences             WaitForFences         = vkWaitForFences;
+            PFN_vkResetFences               ResetFences           = vkResetFences;
+            PFN_vkResetCommandBuffer        ResetCommandBuffer    = vkResetCommandBuffer;
+            PFN_vkBeginCommandBuffer        BeginCommandBuffer    = vkBeginCommandBuffer;
+            PFN_vkEndCommandBuffer          EndCommandBuffer      = vkEndCommandBuffer;
+            PFN_vkCmdBeginRenderPass        CmdBeginRenderPass    = vkCmdBeginRenderPass;
+            PFN_vkCmdEndRenderPass          CmdEndRenderPass      = vkCmdEndRenderPass;
+            PFN_vkCmdSetViewport            CmdSetViewport        = vkCmdSetViewport;
+            PFN_vkCmdSetScissor             CmdSetScissor         = vkCmdSetScissor;
+            PFN_vkCmdBindPipeline           CmdBindPipeline       = vkCmdBindPipeline;
+            PFN_vkCmdBindDescriptorSets     CmdBindDescriptorSets = vkCmdBindDescriptorSets;
+            PFN_vkCmdBindVertexBuffers      CmdBindVertexBuffers  = vkCmdBindVertexBuffers;
+            PFN_vkCmdBindIndexBuffer        CmdBindIndexBuffer    = vkCmdBindIndexBuffer;
+            PFN_vkCmdDraw                   CmdDraw               = vkCmdDraw;
+            PFN_vkCmdDrawIndexed            CmdDrawIndexed        = vkCmdDrawIndexed;
+            PFN_vkCmdDrawIndexedIndirect    CmdDrawIndexedIndirect = vkCmdDrawIndexedIndirect;
+            PFN_vkCmdPushConstants          CmdPushConstants      = vkCmdPushConstants;
+            PFN_vkCmdDispatch               CmdDispatch           = vkCmdDispatch;
+            PFN_vkCmdPipelineBarrier        CmdPipelineBarrier    = vkCmdPipelineBarrier;
+            PFN_vkCmdCopyBuffer             CmdCopyBuffer         = vkCmdCopyBuffer;
+            PFN_vkCmdCopyImageToBuffer      CmdCopyImageToBuffer  = vkCmdCopyImageToBuffer;
+            PFN_vkCmdUpdateBuffer           CmdUpdateBuffer       = vkCmdUpdateBuffer;
+            PFN_vkCmdFillBuffer             CmdFillBuffer         = vkCmdFillBuffer;
+            PFN_vkCmdBlitImage              CmdBlitImage          = vkCmdBlitImage;
+            PFN_vkCmdResetQueryPool         CmdResetQueryPool     = vkCmdResetQueryPool;
+            PFN_vkCmdWriteTimestamp         CmdWriteTimestamp     = vkCmdWriteTimestamp;
+            PFN_vkCmdBeginQuery             CmdBeginQuery         = vkCmdBeginQuery;
+            PFN_vkCmdEndQuery               CmdEndQuery           = vkCmdEndQuery;
+        };
+
+        /* The rendering device of this process, what the hot paths call through.
+        There is one: SkyLands, SkyReplay and SkyRegress each create a single
+        device, and LoadDevice refuses a second until Unload. */
+        DeviceTable& Device()
+        {
+            static DeviceTable table;
+            return table;
+        }
+
+        InstanceTable& Instance()
+        {
+            static InstanceTable table;
+            return table;
+        }
+
+        template <typename F>
+        static void Get(VkInstance instance, const char* name, F& function)
+        {
+            PFN_vkVoidFunction found = vkGetInstanceProcAddr(instance, name);
+            if (nullptr != found)
+            {
+                function = reinterpret_cast<F>(found);
+            }
+        }
+
+        template <typename F>
+        static void Get(PFN_vkGetDeviceProcAddr getDeviceProcAddr, VkDevice device, const char* name, F& function)
+        {
+            PFN_vkVoidFunction found = getDeviceProcAddr(device, name);
+            if (nullptr != found)
+            {
+                function = reinterpret_cast<F>(found);
+            }
+        }
+
+        void LoadInstance(VkInstance instance, InstanceTable& table)
+        {
+            Get(instance, "vkGetDeviceProcAddr", table.GetDeviceProcAddr);
+            Get(instance, "vkCreateDebugUtilsMessengerEXT", table.CreateDebugUtilsMessengerEXT);
+            Get(instance, "vkDestroyDebugUtilsMessengerEXT", table.DestroyDebugUtilsMessengerEXT);
+        }
+
+        // Entries of extensions the device was created without stay on the loader.
+        void LoadDevice(const InstanceTable& instance, VkDevice device, DeviceTable& table)
+        {
+            PFN_vkGetDeviceProcAddr get = instance.GetDeviceProcAddr;
+
+            if (VK_NULL_HANDLE != table.device && device != table.device)
+            {
+                throw std::runtime_error("Dispatch table is already loaded for another device !");
+            }
+
+            table.device = device;
+            Get(get, device, "vkAcquireNextImageKHR", table.AcquireNextImageKHR);
+            Get(get, device, "vkQueueSubmit", table.QueueSubmit);
+            Get(get, device, "vkQueuePresentKHR", table.QueuePresentKHR);
+            Get(get, device, "vkWaitForFences", table.WaitForFences);
+            Get(get, device, "vkResetFences", table.ResetFences);
+            Get(get, device, "vkResetCommandBuffer", table.ResetCommandBuffer);
+            Get(get, device, "vkBeginCommandBuffer", table.BeginCommandBuffer);
+            Get(get, device, "vkEndCommandBuffer", table.EndCommandBuffer);
+            Get(get, device, "vkCmdBeginRenderPass", table.CmdBeginRenderPass);
+            Get(get, device, "vkCmdEndRenderPass", table.CmdEndRenderPass);
+            Get(get, device, "vkCmdSetViewport", table.CmdSetViewport);
+            Get(get, device, "vkCmdSetScissor", table.CmdSetScissor);
+            Get(get, device, "vkCmdBindPipeline", table.CmdBindPipeline);
+            Get(get, device, "vkCmdBindDescriptorSets", table.CmdBindDescriptorSets);
+            Get(get, device, "vkCmdBindVertexBuffers", table.CmdBindVertexBuffers);
+            Get(get, device, "vkCmdBindIndexBuffer", table.CmdBindIndexBuffer);
+            Get(get, device, "vkCmdDraw", table.CmdDraw);
+            Get(get, device, "vkCmdDrawIndexed", table.CmdDrawIndexed);
+            Get(get, device, "vkCmdDrawIndexedIndirect", table.CmdDrawIndexedIndirect);
+            Get(get, device, "vkCmdPushConstants", table.CmdPushConstants);
+            Get(get, device, "vkCmdDispatch", table.CmdDispatch);
+            Get(get, device, "vkCmdPipelineBarrier", table.CmdPipelineBarrier);
+            Get(get, device, "vkCmdCopyBuffer", table.CmdCopyBuffer);
+            Get(get, device, "vkCmdCopyImageToBuffer", table.CmdCopyImageToBuffer);
+            Get(get, device, "vkCmdUpdateBuffer", table.CmdUpdateBuffer);
+            Get(get, device, "vkCmdFillBuffer", table.CmdFillBuffer);
+            Get(get, device, "vkCmdBlitImage", table.CmdBlitImage);
+            Get(get, device, "vkCmdResetQueryPool", table.CmdResetQueryPool);
+            Get(get, device, "vkCmdWriteTimestamp", table.CmdWriteTimestamp);
+            Get(get, device, "vkCmdBeginQuery", table.CmdBeginQuery);
+            Get(get, device, "vkCmdEndQuery", table.CmdEndQuery);
+        }
+
+        // Before the device is destroyed, so nothing calls into a dead driver table.
+        void Unload(DeviceTable& table)
+        {
+            table = DeviceTable{};
+        }
+    }
+}
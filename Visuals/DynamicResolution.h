@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "GraphicsPipeline.h"
+#include "HostMemory.h"
+#include "Memory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace DynamicResolution
+    {
+        /* The frame renders into the top left renderExtent of an internal,
+        swapchain sized color target and is blitted up to the swapchain
+        image. Two timestamps around the command buffer give the GPU time of
+        the last frame; Read feeds it to a controller that trades pixels for
+        time to keep the frame inside the budget. GPU time is taken to grow
+        with the pixel count, so the next scale is the current one times the
+        square root of budget over time, approached slowly upwards and
+        quickly downwards so a load spike drops resolution, not frames.
+
+        The depth and multisampled targets of the swapchain framebuffers are
+        reused: the render area only ever shrinks below them. */
+
+        struct Settings
+        {
+            float  minScale = 0.5f;
+            float  maxScale = 1.0f;           // at most 1, the shared targets are swapchain sized
+            double budgetMs = 1000.0 / 60.0;
+        };
+
+        const double kHeadroom = 0.9;  // aim below the budget, GPU time jitters
+        const float  kRaise    = 0.1f; // fraction of the gap closed per frame
+        const float  kLower    = 0.5f;
+
+        struct Resources
+        {
+            Settings             settings;
+            VkRenderPass         renderPass  = VK_NULL_HANDLE;
+            VkImage              image       = VK_NULL_HANDLE;
+            VkDeviceMemory       memory      = VK_NULL_HANDLE;
+            VkImageView          view        = VK_NULL_HANDLE;
+            VkFramebuffer        framebuffer = VK_NULL_HANDLE;
+            std::vector<VkImage> targets; // swapchain images, by index
+            VkExtent2D           extent{};
+            VkExtent2D           renderExtent{};
+            VkQueryPool          timestamps  = VK_NULL_HANDLE;
+            double               period      = 1.0; // ns per tick
+            bool                 recorded    = false;
+            float                scale       = 1.0f;
+            double               gpuMs       = 0.0;
+        };
+
+        // Needs timestamps on the graphics queue and a linear blit between the formats.
+        bool Supported(VkPhysicalDevice& physicalDevice, VkFormat colorFormat)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            VkFormatProperties format;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &format);
+
+            const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+            return VK_TRUE == properties.limits.timestampComputeAndGraphics && (format.optimalTilingFeatures & required) == required;
+        }
+
+        static void Resize(Resources& res)
+        {
+            res.renderExtent.width  = std::max(1u, static_cast<uint32_t>(std::lround(res.extent.width  * res.scale)));
+            res.renderExtent.height = std::max(1u, static_cast<uint32_t>(std::lround(res.extent.height * res.scale)));
+        }
+
+        /* samples, depthImageView and colorImageView are those the swapchain
+        framebuffers were built with, colorImageView null without MSAA. */
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, std::vector<VkImage>& swapChainImages, VkExtent2D& swapChainExtent, VkFormat& colorFormat, VkFormat& depthFormat, VkSampleCountFlagBits samples, VkImageView& depthImageView, VkImageView colorImageView, const Settings& settings, Resources& res)
+        {
+            res.settings          = settings;
+            res.settings.maxScale = std::min(1.0f, settings.maxScale);
+            res.settings.minScale = std::min(res.settings.maxScale, std::max(0.1f, settings.minScale));
+            res.targets           = swapChainImages;
+            res.extent            = swapChainExtent;
+            res.scale             = res.settings.maxScale;
+            Resize(res);
+
+            RenderPasses::Create(device, res.renderPass, colorFormat, depthFormat, RenderPasses::Phase::Offscreen, samples);
+
+            Memory::CreateImage(device, physicalDevice, res.extent.width, res.extent.height, 1, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.image, res.memory);
+            Memory::CreateImageView(device, res.image, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, res.view);
+
+            // Same attachment order as Buffers::Create, the internal target standing in for the swapchain image.
+            bool        multisampled  = VK_NULL_HANDLE != colorImageView;
+            VkImageView attachments[] = {multisampled ? colorImageView : res.view, depthImageView, res.view};
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass      = res.renderPass;
+            framebufferInfo.attachmentCount = multisampled ? 3 : 2;
+            framebufferInfo.pAttachments    = attachments;
+            framebufferInfo.width           = res.extent.width;
+            framebufferInfo.height          = res.extent.height;
+            framebufferInfo.layers          = 1;
+
+            if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferInfo, HostMemory::Callbacks(), &res.framebuffer))
+            {
+                throw std::runtime_error("Failed to create framebuffer !");
+            }
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            res.period = properties.limits.timestampPeriod;
+
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = 2;
+
+            if (VK_SUCCESS != vkCreateQueryPool(device, &poolInfo, HostMemory::Callbacks(), &res.timestamps))
+            {
+                throw std::runtime_error("Failed to create timestamp query pool !");
+            }
+        }
+
+        // First thing in the command buffer.
+        void Begin(VkCommandBuffer& commandBuffer, Resources& res)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.CmdResetQueryPool(commandBuffer, res.timestamps, 0, 2);
+            vk.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, res.timestamps, 0);
+        }
+
+        /* After the render pass: stretches renderExtent of the internal target
+        over the whole swapchain image and leaves it ready to present. */
+        void Upscale(VkCommandBuffer& commandBuffer, Resources& res, uint32_t imageIndex)
+        {
+            // Draw::Submit waits for the image at COLOR_ATTACHMENT_OUTPUT.
+            Memory::BlitToPresent(commandBuffer, res.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, res.renderExtent, res.targets[imageIndex], res.extent, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        }
+
+        // Last thing in the command buffer.
+        void End(VkCommandBuffer& commandBuffer, Resources& res)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, res.timestamps, 1);
+            res.recorded = true;
+        }
+
+        // Picks the next frame's renderExtent from the last frame's GPU time.
+        void Update(Resources& res, double gpuMs)
+        {
+            res.gpuMs = gpuMs;
+            if (gpuMs <= 0.0)
+            {
+                return;
+            }
+
+            float wanted = res.scale * static_cast<float>(std::sqrt(res.settings.budgetMs * kHeadroom / gpuMs));
+            res.scale   += (wanted - res.scale) * (wanted < res.scale ? kLower : kRaise);
+            res.scale    = std::min(res.settings.maxScale, std::max(res.settings.minScale, res.scale));
+            Resize(res);
+        }
+
+        // Only once the fence of the recording frame has signaled.
+        void Read(VkDevice& device, Resources& res)
+        {
+            if (!res.recorded)
+            {
+                return;
+            }
+
+            res.recorded = false;
+
+            uint64_t ticks[2];
+            if (VK_SUCCESS == vkGetQueryPoolResults(device, res.timestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT))
+            {
+                Update(res, static_cast<double>(ticks[1] - ticks[0]) * res.period * 1e-6);
+            }
+        }
+
+        void Destroy(VkDevice& device, Resources& res)
+        {
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vkDestroyQueryPool(device, res.timestamps, HostMemory::Callbacks());
+            }
+
+            if (VK_NULL_HANDLE != res.framebuffer)
+            {
+                vkDestroyFramebuffer(device, res.framebuffer, HostMemory::Callbacks());
+            }
+
+            if (VK_NULL_HANDLE != res.view)
+            {
+                vkDestroyImageView(device, res.view, HostMemory::Callbacks());
+            }
+            Memory::DestroyImage(device, res.image, res.memory);
+
+            if (VK_NULL_HANDLE != res.renderPass)
+            {
+                vkDestroyRenderPass(device, res.renderPass, HostMemory::Callbacks());
+            }
+
+            res = {};
+        }
+    }
+}
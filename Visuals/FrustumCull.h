@@ -0,0 +1,399 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Math.h"
+#include "Jobs.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SKY_CULL_X86 1
+#include <immintrin.h>
+#else
+#define SKY_CULL_X86 0
+#endif
+
+namespace Visuals
+{
+    namespace FrustumCull
+    {
+        /* CPU culling for the CPU-submitted draw path.
+        Bounds are stored as structure of arrays so one SIMD register holds the
+        same component of 4 (SSE) or 8 (AVX2) objects, and every plane test is
+        a handful of multiply-adds over whole registers. The visible set comes
+        out as a compact, ascending list of object indices.
+        */
+
+        enum class Isa
+        {
+            Scalar,
+            SSE,
+            AVX2
+        };
+
+        const char* IsaName(Isa isa)
+        {
+            switch (isa)
+            {
+                case Isa::SSE:  return "SSE";
+                case Isa::AVX2: return "AVX2";
+                default:        return "Scalar";
+            }
+        }
+
+        // Widest instruction set this CPU runs, probed once.
+        Isa DetectIsa()
+        {
+            static const Isa isa = []()
+            {
+#if SKY_CULL_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2"))
+                {
+                    return Isa::AVX2;
+                }
+                if (__builtin_cpu_supports("sse2"))
+                {
+                    return Isa::SSE;
+                }
+#endif
+                return Isa::Scalar;
+            }();
+            return isa;
+        }
+
+        struct Spheres
+        {
+            std::vector<float> x, y, z, radius;
+
+            uint32_t Count() const { return static_cast<uint32_t>(x.size()); }
+
+            void Add(const glm::vec4& sphere)
+            {
+                x.push_back(sphere.x);
+                y.push_back(sphere.y);
+                z.push_back(sphere.z);
+                radius.push_back(sphere.w);
+            }
+
+            void Resize(uint32_t count)
+            {
+                x.resize(count);
+                y.resize(count);
+                z.resize(count);
+                radius.resize(count);
+            }
+
+            void Set(uint32_t i, const glm::vec4& sphere)
+            {
+                x[i]      = sphere.x;
+                y[i]      = sphere.y;
+                z[i]      = sphere.z;
+                radius[i] = sphere.w;
+            }
+        };
+
+        // Axis aligned boxes as center and half extent.
+        struct Boxes
+        {
+            std::vector<float> x, y, z, extentX, extentY, extentZ;
+
+            uint32_t Count() const { return static_cast<uint32_t>(x.size()); }
+
+            void Add(const glm::vec3& min, const glm::vec3& max)
+            {
+                x.push_back((min.x + max.x) * 0.5f);
+                y.push_back((min.y + max.y) * 0.5f);
+                z.push_back((min.z + max.z) * 0.5f);
+                extentX.push_back((max.x - min.x) * 0.5f);
+                extentY.push_back((max.y - min.y) * 0.5f);
+                extentZ.push_back((max.z - min.z) * 0.5f);
+            }
+        };
+
+        // Planes as produced by Camera::FrustumPlanes (inward facing, normalized).
+        struct Planes
+        {
+            float x[6], y[6], z[6], w[6];
+
+            explicit Planes(const glm::vec4 planes[6])
+            {
+                for (int i = 0; i < 6; ++i)
+                {
+                    x[i] = planes[i].x;
+                    y[i] = planes[i].y;
+                    z[i] = planes[i].z;
+                    w[i] = planes[i].w;
+                }
+            }
+        };
+
+        namespace Detail
+        {
+            // A sphere is outside when it lies fully behind any plane.
+            bool SphereVisible(const Planes& planes, float x, float y, float z, float radius)
+            {
+                for (int i = 0; i < 6; ++i)
+                {
+                    if ((planes.x[i] * x + planes.y[i] * y) + (planes.z[i] * z + planes.w[i]) < -radius)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Box center distance plus the box's projected radius onto the plane normal.
+            bool BoxVisible(const Planes& planes, float x, float y, float z, float ex, float ey, float ez)
+            {
+                for (int i = 0; i < 6; ++i)
+                {
+                    float radius = std::abs(planes.x[i]) * ex + std::abs(planes.y[i]) * ey + std::abs(planes.z[i]) * ez;
+                    if ((planes.x[i] * x + planes.y[i] * y) + (planes.z[i] * z + planes.w[i]) < -radius)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Appends base + bit for every set bit of mask, lowest first.
+            uint32_t Emit(uint32_t mask, uint32_t base, uint32_t* out, uint32_t count)
+            {
+                while (0 != mask)
+                {
+                    out[count++] = base + static_cast<uint32_t>(__builtin_ctz(mask));
+                    mask &= mask - 1;
+                }
+                return count;
+            }
+
+            uint32_t SpheresScalar(const Spheres& s, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                uint32_t count = 0;
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    if (SphereVisible(p, s.x[i], s.y[i], s.z[i], s.radius[i]))
+                    {
+                        out[count++] = i;
+                    }
+                }
+                return count;
+            }
+
+            uint32_t BoxesScalar(const Boxes& b, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                uint32_t count = 0;
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    if (BoxVisible(p, b.x[i], b.y[i], b.z[i], b.extentX[i], b.extentY[i], b.extentZ[i]))
+                    {
+                        out[count++] = i;
+                    }
+                }
+                return count;
+            }
+
+#if SKY_CULL_X86
+            __attribute__((target("sse2")))
+            uint32_t SpheresSSE(const Spheres& s, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                uint32_t count = 0;
+                uint32_t i     = begin;
+
+                for (; i + 4 <= end; i += 4)
+                {
+                    __m128 x       = _mm_loadu_ps(&s.x[i]);
+                    __m128 y       = _mm_loadu_ps(&s.y[i]);
+                    __m128 z       = _mm_loadu_ps(&s.z[i]);
+                    __m128 minimum = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&s.radius[i]));
+                    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+                    for (int plane = 0; plane < 6; ++plane)
+                    {
+                        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x[plane]), x), _mm_mul_ps(_mm_set1_ps(p.y[plane]), y)),
+                                                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z[plane]), z), _mm_set1_ps(p.w[plane])));
+                        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, minimum));
+                    }
+
+                    count = Emit(static_cast<uint32_t>(_mm_movemask_ps(visible)), i, out, count);
+                }
+
+                return count + SpheresScalar(s, p, i, end, out + count);
+            }
+
+            __attribute__((target("sse2")))
+            uint32_t BoxesSSE(const Boxes& b, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+                uint32_t count = 0;
+                uint32_t i     = begin;
+
+                for (; i + 4 <= end; i += 4)
+                {
+                    __m128 x       = _mm_loadu_ps(&b.x[i]);
+                    __m128 y       = _mm_loadu_ps(&b.y[i]);
+                    __m128 z       = _mm_loadu_ps(&b.z[i]);
+                    __m128 ex      = _mm_loadu_ps(&b.extentX[i]);
+                    __m128 ey      = _mm_loadu_ps(&b.extentY[i]);
+                    __m128 ez      = _mm_loadu_ps(&b.extentZ[i]);
+                    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+                    for (int plane = 0; plane < 6; ++plane)
+                    {
+                        __m128 px = _mm_set1_ps(p.x[plane]);
+                        __m128 py = _mm_set1_ps(p.y[plane]);
+                        __m128 pz = _mm_set1_ps(p.z[plane]);
+
+                        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, x), _mm_mul_ps(py, y)),
+                                                     _mm_add_ps(_mm_mul_ps(pz, z), _mm_set1_ps(p.w[plane])));
+                        __m128 radius   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, signMask), ex), _mm_mul_ps(_mm_and_ps(py, signMask), ey)),
+                                                     _mm_mul_ps(_mm_and_ps(pz, signMask), ez));
+                        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+                    }
+
+                    count = Emit(static_cast<uint32_t>(_mm_movemask_ps(visible)), i, out, count);
+                }
+
+                return count + BoxesScalar(b, p, i, end, out + count);
+            }
+
+            __attribute__((target("avx2")))
+            uint32_t SpheresAVX2(const Spheres& s, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                uint32_t count = 0;
+                uint32_t i     = begin;
+
+                for (; i + 8 <= end; i += 8)
+                {
+                    __m256 x       = _mm256_loadu_ps(&s.x[i]);
+                    __m256 y       = _mm256_loadu_ps(&s.y[i]);
+                    __m256 z       = _mm256_loadu_ps(&s.z[i]);
+                    __m256 minimum = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&s.radius[i]));
+                    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+                    for (int plane = 0; plane < 6; ++plane)
+                    {
+                        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.x[plane]), x), _mm256_mul_ps(_mm256_set1_ps(p.y[plane]), y)),
+                                                        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.z[plane]), z), _mm256_set1_ps(p.w[plane])));
+                        visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, minimum, _CMP_GE_OQ));
+                    }
+
+                    count = Emit(static_cast<uint32_t>(_mm256_movemask_ps(visible)), i, out, count);
+                }
+
+                return count + SpheresScalar(s, p, i, end, out + count);
+            }
+
+            __attribute__((target("avx2")))
+            uint32_t BoxesAVX2(const Boxes& b, const Planes& p, uint32_t begin, uint32_t end, uint32_t* out)
+            {
+                const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+                uint32_t count = 0;
+                uint32_t i     = begin;
+
+                for (; i + 8 <= end; i += 8)
+                {
+                    __m256 x       = _mm256_loadu_ps(&b.x[i]);
+                    __m256 y       = _mm256_loadu_ps(&b.y[i]);
+                    __m256 z       = _mm256_loadu_ps(&b.z[i]);
+                    __m256 ex      = _mm256_loadu_ps(&b.extentX[i]);
+                    __m256 ey      = _mm256_loadu_ps(&b.extentY[i]);
+                    __m256 ez      = _mm256_loadu_ps(&b.extentZ[i]);
+                    __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+                    for (int plane = 0; plane < 6; ++plane)
+                    {
+                        __m256 px = _mm256_set1_ps(p.x[plane]);
+                        __m256 py = _mm256_set1_ps(p.y[plane]);
+                        __m256 pz = _mm256_set1_ps(p.z[plane]);
+
+                        __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, x), _mm256_mul_ps(py, y)),
+                                                        _mm256_add_ps(_mm256_mul_ps(pz, z), _mm256_set1_ps(p.w[plane])));
+                        __m256 radius   = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(px, signMask), ex), _mm256_mul_ps(_mm256_and_ps(py, signMask), ey)),
+                                                        _mm256_mul_ps(_mm256_and_ps(pz, signMask), ez));
+                        visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_GE_OQ));
+                    }
+
+                    count = Emit(static_cast<uint32_t>(_mm256_movemask_ps(visible)), i, out, count);
+                }
+
+                return count + BoxesScalar(b, p, i, end, out + count);
+            }
+#endif
+
+            const uint32_t kMaxRanges = 64;
+
+            // Compacts every range into its own slice of out, then closes the
+            // gaps so the result is one ascending list.
+            template <typename Kernel>
+            uint32_t Parallel(uint32_t total, Jobs::Scheduler* jobs, uint32_t* out, Kernel kernel)
+            {
+                uint32_t begins[kMaxRanges];
+                uint32_t counts[kMaxRanges];
+
+                // Ranges are a multiple of 8 so none starts mid-register.
+                uint32_t ranges = Jobs::ParallelFor(jobs, total, 1024, 8, kMaxRanges, [&](uint32_t range, uint32_t begin, uint32_t end)
+                {
+                    begins[range] = begin;
+                    counts[range] = kernel(begin, end, out + begin);
+                });
+
+                uint32_t count = counts[0];
+                for (uint32_t range = 1; range < ranges; ++range)
+                {
+                    memmove(out + count, out + begins[range], sizeof(uint32_t) * counts[range]);
+                    count += counts[range];
+                }
+                return count;
+            }
+        }
+
+        /* Writes the indices of all visible objects to out, which must hold
+        Count() entries, and returns how many there are. With a scheduler the
+        test is split into jobs and this returns once all of them are done. */
+        uint32_t Cull(const Spheres& spheres, const glm::vec4 frustumPlanes[6], uint32_t* out, Isa isa = DetectIsa(), Jobs::Scheduler* jobs = nullptr)
+        {
+            Planes planes(frustumPlanes);
+
+            return Detail::Parallel(spheres.Count(), jobs, out, [&](uint32_t begin, uint32_t end, uint32_t* slice)
+            {
+#if SKY_CULL_X86
+                if (Isa::AVX2 == isa)
+                {
+                    return Detail::SpheresAVX2(spheres, planes, begin, end, slice);
+                }
+                if (Isa::SSE == isa)
+                {
+                    return Detail::SpheresSSE(spheres, planes, begin, end, slice);
+                }
+#endif
+                return Detail::SpheresScalar(spheres, planes, begin, end, slice);
+            });
+        }
+
+        uint32_t Cull(const Boxes& boxes, const glm::vec4 frustumPlanes[6], uint32_t* out, Isa isa = DetectIsa(), Jobs::Scheduler* jobs = nullptr)
+        {
+            Planes planes(frustumPlanes);
+
+            return Detail::Parallel(boxes.Count(), jobs, out, [&](uint32_t begin, uint32_t end, uint32_t* slice)
+            {
+#if SKY_CULL_X86
+                if (Isa::AVX2 == isa)
+                {
+                    return Detail::BoxesAVX2(boxes, planes, begin, end, slice);
+                }
+                if (Isa::SSE == isa)
+                {
+                    return Detail::BoxesSSE(boxes, planes, begin, end, slice);
+                }
+#endif
+                return Detail::BoxesScalar(boxes, planes, begin, end, slice);
+            });
+        }
+    }
+}
@@ -1,17 +1,103 @@
 #pragma once
 
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "MeshFormat.h"
+#include "PipelineCache.h"
+#include "Variants.h"
+
+#ifndef SKY_SHADER_DIR
+#define SKY_SHADER_DIR "/home/fly/Documents/Sky/App/Shaders/bin/"
+#endif
 
 namespace Visuals
 {
     namespace GraphicsPipeline
     {
+        // What Mesh.frag writes, constant_id 1.
+        enum class MeshView : uint32_t
+        {
+            Shaded,
+            Normals,
+            Instances,
+            Overdraw, // every shaded fragment adds a step, blended additively
+            Count
+        };
+
+        // Specialization constants of Mesh.frag.
+        struct MeshVariant
+        {
+            VkBool32 lighting = VK_TRUE;                                 // constant_id 0
+            uint32_t view     = static_cast<uint32_t>(MeshView::Shaded); // constant_id 1
+        };
+    }
+
+    template <>
+    struct Variants::Layout<GraphicsPipeline::MeshVariant>
+    {
+        static constexpr VkSpecializationMapEntry entries[] =
+        {
+            {0, offsetof(GraphicsPipeline::MeshVariant, lighting), sizeof(VkBool32)},
+            {1, offsetof(GraphicsPipeline::MeshVariant, view),     sizeof(uint32_t)},
+        };
+    };
+
+    namespace GraphicsPipeline
+    {
+        struct Config
+        {
+            std::string                                    vertShader = "Vertex.vert.spv";
+            std::string                                    fragShader = "Fragment.frag.spv"; // empty: depth only, no color writes
+            std::vector<VkVertexInputBindingDescription>   vertexBindings;
+            std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+            std::vector<VkDescriptorSetLayout>             setLayouts;
+            std::vector<VkPushConstantRange>               pushConstantRanges;
+            bool                                           depthTest  = true;
+            bool                                           depthWrite = true;
+            VkCompareOp                                    depthCompare = VK_COMPARE_OP_LESS;
+            bool                                           additive   = false; // ONE + ONE blending
+            VkSampleCountFlagBits                          samples    = VK_SAMPLE_COUNT_1_BIT; // must match the render pass
+
+            // Applied to both stages, see Variants.h.
+            const VkSpecializationInfo*                    specialization = nullptr;
+            // Shared by several pipelines when set, created from setLayouts otherwise.
+            VkPipelineLayout                               layout         = VK_NULL_HANDLE;
+        };
+
+        // SPIR-V read ahead of the device, keyed by full path.
+        struct Preloaded
+        {
+            std::mutex                                         mutex;
+            std::unordered_map<std::string, std::vector<char>> files;
+        };
+
+        static Preloaded& Shaders()
+        {
+            static Preloaded preloaded;
+            return preloaded;
+        }
 
         static std::vector<char> ReadFile(const std::string& filename)
         {
+            {
+                Preloaded& preloaded = Shaders();
+                std::lock_guard<std::mutex> lock(preloaded.mutex);
+                auto found = preloaded.files.find(filename);
+                if (preloaded.files.end() != found)
+                {
+                    return found->second;
+                }
+            }
+
             std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
             if (!file.is_open())
@@ -30,6 +116,28 @@ namespace Visuals
 
         }
 
+        /* Reads every .spv in directory, so pipeline creation does not wait
+        on the disk. Runs at startup while the instance and device are still
+        being created; a shader missing here is read on first use. */
+        void Preload(const std::string& directory)
+        {
+            std::error_code error;
+            for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+            {
+                if (".spv" != entry.path().extension())
+                {
+                    continue;
+                }
+
+                std::string       filename = directory + entry.path().filename().string();
+                std::vector<char> code     = ReadFile(filename);
+
+                Preloaded& preloaded = Shaders();
+                std::lock_guard<std::mutex> lock(preloaded.mutex);
+                preloaded.files[filename] = std::move(code);
+            }
+        }
+
         VkShaderModule CreateShaderModule(VkDevice& device, const std::vector<char>& code)
         {
             VkShaderModuleCreateInfo createInfo{};
@@ -38,7 +146,7 @@ namespace Visuals
             createInfo.pCode    = reinterpret_cast<const uint32_t*>(code.data());
 
             VkShaderModule shaderModule;
-            if (VK_SUCCESS != vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule))
+            if (VK_SUCCESS != vkCreateShaderModule(device, &createInfo, HostMemory::Callbacks(), &shaderModule))
             {
                 throw std::runtime_error("failed to create shader module!");
             }
@@ -46,13 +154,17 @@ namespace Visuals
             return shaderModule;
         }
 
-        void Create(VkPipeline& graphicsPipeline, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass)
+        void Create(VkPipeline& graphicsPipeline, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass, const Config& config)
         {
-            auto vertShaderCode = ReadFile("/home/fly/Documents/Sky/App/Shaders/bin/Vertex.vert.spv");
-            auto fragShaderCode = ReadFile("/home/fly/Documents/Sky/App/Shaders/bin/Fragment.frag.spv");
+            bool depthOnly = config.fragShader.empty();
 
+            auto vertShaderCode = ReadFile(SKY_SHADER_DIR + config.vertShader);
             VkShaderModule vertShaderModule = CreateShaderModule(device, vertShaderCode);
-            VkShaderModule fragShaderModule = CreateShaderModule(device, fragShaderCode);
+            VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+            if (!depthOnly)
+            {
+                fragShaderModule = CreateShaderModule(device, ReadFile(SKY_SHADER_DIR + config.fragShader));
+            }
 
 
             VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -60,12 +172,14 @@ namespace Visuals
             vertShaderStageInfo.stage  = VK_SHADER_STAGE_VERTEX_BIT;
             vertShaderStageInfo.module = vertShaderModule;
             vertShaderStageInfo.pName  = "main";
+            vertShaderStageInfo.pSpecializationInfo = config.specialization;
 
             VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
             fragShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
             fragShaderStageInfo.stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
             fragShaderStageInfo.module = fragShaderModule;
             fragShaderStageInfo.pName  = "main";
+            fragShaderStageInfo.pSpecializationInfo = config.specialization;
 
             VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
@@ -84,10 +198,10 @@ namespace Visuals
 
             VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
             vertexInputInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            vertexInputInfo.vertexBindingDescriptionCount   = 0;
-            vertexInputInfo.pVertexBindingDescriptions      = nullptr; // Optional
-            vertexInputInfo.vertexAttributeDescriptionCount = 0;
-            vertexInputInfo.pVertexAttributeDescriptions    = nullptr; // Optional
+            vertexInputInfo.vertexBindingDescriptionCount   = static_cast<uint32_t>(config.vertexBindings.size());
+            vertexInputInfo.pVertexBindingDescriptions      = config.vertexBindings.data();
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(config.vertexAttributes.size());
+            vertexInputInfo.pVertexAttributeDescriptions    = config.vertexAttributes.data();
 
 
             VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -136,7 +250,7 @@ namespace Visuals
             VkPipelineMultisampleStateCreateInfo multisampling{};
             multisampling.sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
             multisampling.sampleShadingEnable   = VK_FALSE;
-            multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+            multisampling.rasterizationSamples  = config.samples;
             multisampling.minSampleShading      = 1.0f; // Optional
             multisampling.pSampleMask           = nullptr; // Optional
             multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
@@ -144,13 +258,13 @@ namespace Visuals
 
 
             VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-            colorBlendAttachment.colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-            colorBlendAttachment.blendEnable         = VK_FALSE;
+            colorBlendAttachment.colorWriteMask      = depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            colorBlendAttachment.blendEnable         = config.additive ? VK_TRUE : VK_FALSE;
             colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+            colorBlendAttachment.dstColorBlendFactor = config.additive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO;
             colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD; // Optional
             colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+            colorBlendAttachment.dstAlphaBlendFactor = config.additive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO;
             colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD; // Optional
 
             VkPipelineColorBlendStateCreateInfo colorBlending{};
@@ -165,28 +279,41 @@ namespace Visuals
             colorBlending.blendConstants[3] = 0.0f;
 
 
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            depthStencil.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+            depthStencil.depthTestEnable       = config.depthTest ? VK_TRUE : VK_FALSE;
+            depthStencil.depthWriteEnable      = config.depthWrite ? VK_TRUE : VK_FALSE;
+            depthStencil.depthCompareOp        = config.depthCompare;
+            depthStencil.depthBoundsTestEnable = VK_FALSE;
+            depthStencil.stencilTestEnable     = VK_FALSE;
+
+
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
             pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            pipelineLayoutInfo.setLayoutCount         = 0; // Optional
-            pipelineLayoutInfo.pSetLayouts            = nullptr; // Optional
-            pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-            pipelineLayoutInfo.pPushConstantRanges    = nullptr; // Optional
+            pipelineLayoutInfo.setLayoutCount         = static_cast<uint32_t>(config.setLayouts.size());
+            pipelineLayoutInfo.pSetLayouts            = config.setLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(config.pushConstantRanges.size());
+            pipelineLayoutInfo.pPushConstantRanges    = config.pushConstantRanges.data();
 
-            if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout))
+            if (VK_NULL_HANDLE != config.layout)
+            {
+                pipelineLayout = config.layout;
+            }
+            else if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutInfo, HostMemory::Callbacks(), &pipelineLayout))
             {
                 throw std::runtime_error("Failed to create pipeline layout !");
             }
 
             VkGraphicsPipelineCreateInfo pipelineInfo{};
             pipelineInfo.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-            pipelineInfo.stageCount          = 2;
+            pipelineInfo.stageCount          = depthOnly ? 1 : 2;
             pipelineInfo.pStages             = shaderStages;
             pipelineInfo.pVertexInputState   = &vertexInputInfo;
             pipelineInfo.pInputAssemblyState = &inputAssembly;
             pipelineInfo.pViewportState      = &viewportState;
             pipelineInfo.pRasterizationState = &rasterizer;
             pipelineInfo.pMultisampleState   = &multisampling;
-            pipelineInfo.pDepthStencilState  = nullptr; // Optional
+            pipelineInfo.pDepthStencilState  = &depthStencil;
             pipelineInfo.pColorBlendState    = &colorBlending;
             pipelineInfo.pDynamicState       = &dynamicState;
             pipelineInfo.layout              = pipelineLayout;
@@ -195,31 +322,148 @@ namespace Visuals
             pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE; // Optional
             pipelineInfo.basePipelineIndex   = -1; // Optional
 
-            if (VK_SUCCESS != vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline))
+            if (VK_SUCCESS != vkCreateGraphicsPipelines(device, PipelineCache::Handle(), 1, &pipelineInfo, HostMemory::Callbacks(), &graphicsPipeline))
             {
                 throw std::runtime_error("failed to create graphics pipeline!");
             }
 
-            vkDestroyShaderModule(device, fragShaderModule, nullptr);
-            vkDestroyShaderModule(device, vertShaderModule, nullptr);
+            if (!depthOnly)
+            {
+                vkDestroyShaderModule(device, fragShaderModule, HostMemory::Callbacks());
+            }
+            vkDestroyShaderModule(device, vertShaderModule, HostMemory::Callbacks());
+
+        }
+
+        void Create(VkPipeline& graphicsPipeline, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+        {
+            Config config;
+            config.samples = samples;
+
+            Create(graphicsPipeline, device, swapChainExtent, pipelineLayout, renderPass, config);
+        }
+
+        static void MeshVertexInput(Config& config)
+        {
+            VkVertexInputBindingDescription binding{};
+            binding.binding   = 0;
+            binding.stride    = sizeof(MeshFormat::Vertex);
+            binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+            config.vertexBindings.push_back(binding);
+
+            config.vertexAttributes.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshFormat::Vertex, position)});
+            config.vertexAttributes.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshFormat::Vertex, normal)});
+            config.vertexAttributes.push_back({2, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(MeshFormat::Vertex, uv)});
+        }
+
+        /* Lit mesh pipeline reading MeshFormat::Vertex. Set 0 holds the
+        Objects buffers, set 1 the UniformRing frame block. EQUAL makes the
+        color pass that follows a depth prepass, it leaves depth alone.
+        The overdraw view keeps the pass's depth state, so it counts the
+        fragments that are actually shaded, like the pipeline statistics. */
+        void CreateMesh(VkPipeline& graphicsPipeline, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass, VkDescriptorSetLayout& objectSetLayout, VkDescriptorSetLayout& frameSetLayout, const MeshVariant& variant = MeshVariant{}, VkCompareOp depthCompare = VK_COMPARE_OP_LESS, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+        {
+            VkSpecializationInfo specialization = Variants::Specialization(variant);
+
+            Config config;
+            config.vertShader     = "Mesh.vert.spv";
+            config.fragShader     = "Mesh.frag.spv";
+            config.setLayouts     = {objectSetLayout, frameSetLayout};
+            config.specialization = &specialization;
+            config.layout         = pipelineLayout;
+            config.depthCompare   = depthCompare;
+            config.depthWrite     = VK_COMPARE_OP_EQUAL != depthCompare;
+            config.samples        = samples;
+            config.additive       = static_cast<uint32_t>(MeshView::Overdraw) == variant.view;
+
+            MeshVertexInput(config);
+
+            Create(graphicsPipeline, device, swapChainExtent, pipelineLayout, renderPass, config);
+        }
+
+        /* Bakes every mesh variant into cache, all sharing one layout. The
+        first variant creates pipelineLayout when it is still VK_NULL_HANDLE. */
+        void CreateMeshVariants(Variants::Cache<MeshVariant>& cache, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass, VkDescriptorSetLayout& objectSetLayout, VkDescriptorSetLayout& frameSetLayout, VkCompareOp depthCompare = VK_COMPARE_OP_LESS, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+        {
+            std::vector<MeshVariant> variants;
+            for (VkBool32 lighting : {VK_TRUE, VK_FALSE})
+            {
+                for (uint32_t view = 0; view < static_cast<uint32_t>(MeshView::Count); ++view)
+                {
+                    variants.push_back({lighting, view});
+                }
+            }
+
+            Variants::Bake(cache, variants, [&](const VkSpecializationInfo& specialization)
+            {
+                MeshVariant variant;
+                memcpy(&variant, specialization.pData, sizeof(variant));
+
+                VkPipeline pipeline;
+                CreateMesh(pipeline, device, swapChainExtent, pipelineLayout, renderPass, objectSetLayout, frameSetLayout, variant, depthCompare, samples);
+                return pipeline;
+            });
+        }
+
+        // Mesh.vert alone, writing depth for a later EQUAL color pass.
+        void CreateMeshDepthOnly(VkPipeline& graphicsPipeline, VkDevice& device, VkExtent2D& swapChainExtent, VkPipelineLayout& pipelineLayout, VkRenderPass& renderPass, VkDescriptorSetLayout& objectSetLayout, VkDescriptorSetLayout& frameSetLayout, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
+        {
+            Config config;
+            config.vertShader = "Mesh.vert.spv";
+            config.fragShader = "";
+            config.layout     = pipelineLayout;
+            config.setLayouts = {objectSetLayout, frameSetLayout};
+            config.samples    = samples;
 
+            MeshVertexInput(config);
+
+            Create(graphicsPipeline, device, swapChainExtent, pipelineLayout, renderPass, config);
         }
 
         void Destroy(VkDevice& device, VkPipeline& graphicsPipeline, VkPipelineLayout& pipelineLayout)
         {
-            vkDestroyPipeline(device, graphicsPipeline, nullptr);
-            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+            vkDestroyPipeline(device, graphicsPipeline, HostMemory::Callbacks());
+            vkDestroyPipelineLayout(device, pipelineLayout, HostMemory::Callbacks());
+        }
+
+        void DestroyMeshVariants(VkDevice& device, Variants::Cache<MeshVariant>& cache, VkPipelineLayout& pipelineLayout)
+        {
+            Variants::Destroy(device, cache);
+            vkDestroyPipelineLayout(device, pipelineLayout, HostMemory::Callbacks());
+            pipelineLayout = VK_NULL_HANDLE;
         }
 
     }
 
     namespace RenderPasses
     {
-        void Create(VkDevice& device, VkRenderPass& renderPass, VkFormat& swapChainImageFormat)
+        // Full draws a whole frame. First/Second split it around the Hi-Z build:
+        // First clears and keeps both attachments, Second loads them and presents.
+        // Full with samples above 1 renders into transient multisampled color and
+        // depth that are never stored, resolving into the swapchain image
+        // (attachment 2) at the end of the subpass. Offscreen is Full into an
+        // internal target that is blitted to the swapchain afterwards. Post is
+        // Full into a target the compute post chain samples.
+        enum class Phase
+        {
+            Full,
+            First,
+            Second,
+            Offscreen,
+            Post
+        };
+
+        void Create(VkDevice& device, VkRenderPass& renderPass, VkFormat& swapChainImageFormat, VkFormat& depthFormat, Phase phase = Phase::Full, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)
         {
+            bool multisampled = VK_SAMPLE_COUNT_1_BIT != samples;
+            if (multisampled && Phase::Full != phase && Phase::Offscreen != phase && Phase::Post != phase)
+            {
+                throw std::runtime_error("Multisampling only supports the full render pass !");
+            }
+
             VkAttachmentDescription colorAttachment{};
             colorAttachment.format         = swapChainImageFormat;
-            colorAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+            colorAttachment.samples        = samples;
             colorAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
             colorAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
             colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -227,23 +471,99 @@ namespace Visuals
             colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
             colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+            VkAttachmentDescription depthAttachment{};
+            depthAttachment.format         = depthFormat;
+            depthAttachment.samples        = samples;
+            depthAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            depthAttachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+            VkSubpassDependency dependency{};
+            dependency.srcSubpass    = VK_SUBPASS_EXTERNAL;
+            dependency.dstSubpass    = 0;
+            dependency.srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            // Extra windows reuse the depth and MSAA color targets in the next pass of the same frame.
+            dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependency.dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+            if (Phase::First == phase)
+            {
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                depthAttachment.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+                depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            }
+            else if (Phase::Second == phase)
+            {
+                colorAttachment.loadOp        = VK_ATTACHMENT_LOAD_OP_LOAD;
+                colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                depthAttachment.loadOp        = VK_ATTACHMENT_LOAD_OP_LOAD;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+                // The pyramid build sampled depth right before this pass.
+                dependency.srcStageMask  |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+                dependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                dependency.dstStageMask  |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            }
+            else if (Phase::Offscreen == phase)
+            {
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+                // Last frame's blit read the target this pass overwrites.
+                dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+            }
+            else if (Phase::Post == phase)
+            {
+                // Reads of the previous contents are ordered by the post semaphores.
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+
+            VkAttachmentDescription resolveAttachment = colorAttachment;
+            resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            resolveAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+            if (multisampled)
+            {
+                // Only the resolve reaches memory; on tilers the samples never leave the tile.
+                colorAttachment.storeOp     = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            }
+
             VkAttachmentReference colorAttachmentRef{};
             colorAttachmentRef.attachment = 0;
             colorAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+            VkAttachmentReference depthAttachmentRef{};
+            depthAttachmentRef.attachment = 1;
+            depthAttachmentRef.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+            VkAttachmentReference resolveAttachmentRef{};
+            resolveAttachmentRef.attachment = 2;
+            resolveAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
             VkSubpassDescription subpass{};
-            subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass.colorAttachmentCount = 1;
-            subpass.pColorAttachments    = &colorAttachmentRef;
+            subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount    = 1;
+            subpass.pColorAttachments       = &colorAttachmentRef;
+            subpass.pResolveAttachments     = multisampled ? &resolveAttachmentRef : nullptr;
+            subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+            VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment, resolveAttachment};
 
             VkRenderPassCreateInfo renderPassInfo{};
             renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            renderPassInfo.attachmentCount = 1;
-            renderPassInfo.pAttachments    = &colorAttachment;
+            renderPassInfo.attachmentCount = multisampled ? 3 : 2;
+            renderPassInfo.pAttachments    = attachments;
             renderPassInfo.subpassCount    = 1;
             renderPassInfo.pSubpasses      = &subpass;
+            renderPassInfo.dependencyCount = 1;
+            renderPassInfo.pDependencies   = &dependency;
 
-            if (VK_SUCCESS != vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass))
+            if (VK_SUCCESS != vkCreateRenderPass(device, &renderPassInfo, HostMemory::Callbacks(), &renderPass))
             {
                 throw std::runtime_error("Failed to create render pass !");
             }
@@ -252,7 +572,7 @@ namespace Visuals
 
         void Destroy(VkDevice& device, VkRenderPass& renderPass)
         {
-            vkDestroyRenderPass(device, renderPass, nullptr);
+            vkDestroyRenderPass(device, renderPass, HostMemory::Callbacks());
         }
     }
 }
\ No newline at end of file
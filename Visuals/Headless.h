@@ -0,0 +1,438 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Depth.h"
+#include "Dispatch.h"
+#include "GraphicsPipeline.h"
+#include "HostMemory.h"
+#include "Memory.h"
+#include "Multisample.h"
+
+namespace Visuals
+{
+    namespace Headless
+    {
+        /* Vulkan without a window or swapchain, for the offline tools: one
+        graphics queue and an offscreen target built like the swapchain
+        framebuffers, so the pipelines Visuals builds work on it unchanged.
+        Runs on any device, software rasterizers such as lavapipe included. */
+
+        const int32_t kPickCpu = -1; // the first CPU device, lavapipe or SwiftShader
+
+        struct Context
+        {
+            VkInstance                 instance       = VK_NULL_HANDLE;
+            VkPhysicalDevice           physicalDevice = VK_NULL_HANDLE;
+            VkPhysicalDeviceProperties properties{};
+            VkDevice                   device         = VK_NULL_HANDLE;
+            VkQueue                    queue          = VK_NULL_HANDLE;
+            uint32_t                   family         = 0;
+            bool                       timestamps     = false; // the queue has timestamp bits
+            VkCommandPool              commandPool    = VK_NULL_HANDLE;
+        };
+
+        // Lists every device on stdout and opens device index, or the first CPU one for kPickCpu.
+        void Create(const char* appName, int32_t index, Context& context)
+        {
+            VkApplicationInfo appInfo{};
+            appInfo.sType            = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+            appInfo.pApplicationName = appName;
+            appInfo.pEngineName      = "Sky";
+            appInfo.apiVersion       = VK_API_VERSION_1_3;
+
+            // required on MacOS.
+            const char* extensions[] = {VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME};
+
+            VkInstanceCreateInfo createInfo{};
+            createInfo.sType                   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+            createInfo.flags                   = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+            createInfo.pApplicationInfo        = &appInfo;
+            createInfo.enabledExtensionCount   = 1;
+            createInfo.ppEnabledExtensionNames = extensions;
+
+            if (VK_SUCCESS != vkCreateInstance(&createInfo, HostMemory::Callbacks(), &context.instance))
+            {
+                throw std::runtime_error("Failed to create VULKAN instance !");
+            }
+
+            uint32_t deviceCount = 0;
+            vkEnumeratePhysicalDevices(context.instance, &deviceCount, nullptr);
+            std::vector<VkPhysicalDevice> devices(deviceCount);
+            vkEnumeratePhysicalDevices(context.instance, &deviceCount, devices.data());
+
+            int32_t picked = -1;
+            for (uint32_t i = 0; i < deviceCount; ++i)
+            {
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(devices[i], &properties);
+                std::cout << "[device " << i << "] " << properties.deviceName << (VK_PHYSICAL_DEVICE_TYPE_CPU == properties.deviceType ? " (cpu)" : "") << std::endl;
+
+                bool match = kPickCpu == index ? VK_PHYSICAL_DEVICE_TYPE_CPU == properties.deviceType : static_cast<int32_t>(i) == index;
+                picked     = picked < 0 && match ? static_cast<int32_t>(i) : picked;
+            }
+
+            if (picked < 0)
+            {
+                throw std::runtime_error("Failed to find the requested GPU !");
+            }
+
+            context.physicalDevice = devices[picked];
+            vkGetPhysicalDeviceProperties(context.physicalDevice, &context.properties);
+
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, families.data());
+
+            bool found = false;
+            for (uint32_t i = 0; i < familyCount && !found; ++i)
+            {
+                if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                {
+                    context.family     = i;
+                    context.timestamps = families[i].timestampValidBits > 0;
+                    found              = true;
+                }
+            }
+
+            if (!found)
+            {
+                throw std::runtime_error("Failed to find a graphics queue !");
+            }
+
+            float queuePriority = 1.0f;
+            VkDeviceQueueCreateInfo queueInfo{};
+            queueInfo.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueInfo.queueFamilyIndex = context.family;
+            queueInfo.queueCount       = 1;
+            queueInfo.pQueuePriorities = &queuePriority;
+
+            VkPhysicalDeviceFeatures supportedFeatures;
+            vkGetPhysicalDeviceFeatures(context.physicalDevice, &supportedFeatures);
+
+            VkPhysicalDeviceFeatures deviceFeatures{};
+            deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+            VkDeviceCreateInfo deviceInfo{};
+            deviceInfo.sType                = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            deviceInfo.queueCreateInfoCount = 1;
+            deviceInfo.pQueueCreateInfos    = &queueInfo;
+            deviceInfo.pEnabledFeatures     = &deviceFeatures;
+
+            if (VK_SUCCESS != vkCreateDevice(context.physicalDevice, &deviceInfo, HostMemory::Callbacks(), &context.device))
+            {
+                throw std::runtime_error("Failed to create logical device !");
+            }
+
+            vkGetDeviceQueue(context.device, context.family, 0, &context.queue);
+
+            // The replayed draws go through Dispatch like the app's.
+            Dispatch::LoadInstance(context.instance, Dispatch::Instance());
+            Dispatch::LoadDevice(Dispatch::Instance(), context.device, Dispatch::Device());
+
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            poolInfo.queueFamilyIndex = context.family;
+
+            if (VK_SUCCESS != vkCreateCommandPool(context.device, &poolInfo, HostMemory::Callbacks(), &context.commandPool))
+            {
+                throw std::runtime_error("Failed to create command pool !");
+            }
+        }
+
+        void Destroy(Context& context)
+        {
+            if (VK_NULL_HANDLE != context.device)
+            {
+                Dispatch::Unload(Dispatch::Device());
+                vkDestroyCommandPool(context.device, context.commandPool, HostMemory::Callbacks());
+                vkDestroyDevice(context.device, HostMemory::Callbacks());
+            }
+
+            if (VK_NULL_HANDLE != context.instance)
+            {
+                vkDestroyInstance(context.instance, HostMemory::Callbacks());
+            }
+
+            context = {};
+        }
+
+        // Color ends the pass in TRANSFER_SRC_OPTIMAL, ready to be read back.
+        struct Target
+        {
+            VkExtent2D            extent{};
+            VkFormat              format      = VK_FORMAT_UNDEFINED;
+            VkFormat              depthFormat = VK_FORMAT_UNDEFINED;
+            VkSampleCountFlagBits samples     = VK_SAMPLE_COUNT_1_BIT;
+            VkImage               image       = VK_NULL_HANDLE;
+            VkDeviceMemory        memory      = VK_NULL_HANDLE;
+            VkImageView           view        = VK_NULL_HANDLE;
+            VkImage               depthImage  = VK_NULL_HANDLE;
+            VkDeviceMemory        depthMemory = VK_NULL_HANDLE;
+            VkImageView           depthView   = VK_NULL_HANDLE;
+            Multisample::Target   multisample;
+            VkRenderPass          renderPass  = VK_NULL_HANDLE;
+            VkFramebuffer         framebuffer = VK_NULL_HANDLE;
+        };
+
+        /* format falls back to R8G8B8A8_UNORM when it cannot be rendered to,
+        samples to what the device supports. */
+        void CreateTarget(Context& context, VkExtent2D extent, VkFormat format, uint32_t samples, Target& target)
+        {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(context.physicalDevice, format, &properties);
+
+            const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+            target.format      = (properties.optimalTilingFeatures & required) == required ? format : VK_FORMAT_R8G8B8A8_UNORM;
+            target.extent      = extent;
+            target.samples     = Multisample::Pick(context.physicalDevice, samples);
+            target.depthFormat = Depth::FindFormat(context.physicalDevice);
+
+            Memory::CreateImage(context.device, context.physicalDevice, extent.width, extent.height, 1, target.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.image, target.memory);
+            Memory::CreateImageView(context.device, target.image, target.format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, target.view);
+            Depth::Create(context.device, context.physicalDevice, target.extent, target.depthFormat, target.depthImage, target.depthMemory, target.depthView, target.samples);
+
+            bool multisampled = VK_SAMPLE_COUNT_1_BIT != target.samples;
+            if (multisampled)
+            {
+                Multisample::Create(context.device, context.physicalDevice, target.extent, target.format, target.samples, target.multisample);
+            }
+
+            RenderPasses::Create(context.device, target.renderPass, target.format, target.depthFormat, RenderPasses::Phase::Offscreen, target.samples);
+
+            // Same attachment order as Buffers::Create.
+            VkImageView attachments[] = {multisampled ? target.multisample.view : target.view, target.depthView, target.view};
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass      = target.renderPass;
+            framebufferInfo.attachmentCount = multisampled ? 3 : 2;
+            framebufferInfo.pAttachments    = attachments;
+            framebufferInfo.width           = extent.width;
+            framebufferInfo.height          = extent.height;
+            framebufferInfo.layers          = 1;
+
+            if (VK_SUCCESS != vkCreateFramebuffer(context.device, &framebufferInfo, HostMemory::Callbacks(), &target.framebuffer))
+            {
+                throw std::runtime_error("Failed to create framebuffer !");
+            }
+        }
+
+        // Clears and sets a full target viewport and scissor, like CommandBuffer::BeginPass.
+        void BeginPass(VkCommandBuffer& commandBuffer, Target& target)
+        {
+            VkClearValue clearValues[2]{};
+            clearValues[0].color        = {{0.0f, 0.0f, 0.0f, 1.0f}};
+            clearValues[1].depthStencil = {1.0f, 0};
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass        = target.renderPass;
+            renderPassInfo.framebuffer       = target.framebuffer;
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = target.extent;
+            renderPassInfo.clearValueCount   = 2;
+            renderPassInfo.pClearValues      = clearValues;
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            VkViewport viewport{0.0f, 0.0f, static_cast<float>(target.extent.width), static_cast<float>(target.extent.height), 0.0f, 1.0f};
+            VkRect2D   scissor{{0, 0}, target.extent};
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        }
+
+        /* One frame in flight at a time: Begin records into the command buffer
+        and opens the target's pass, End closes it, submits and waits, so
+        every frame is timed alone. */
+        struct Frame
+        {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence         fence         = VK_NULL_HANDLE;
+            VkQueryPool     timestamps    = VK_NULL_HANDLE; // null without timestamp bits
+            std::chrono::steady_clock::time_point start;
+        };
+
+        // cpuMs is record to fence, gpuMs the timestamps around the pass, negative without them.
+        struct Timing
+        {
+            double cpuMs = 0.0;
+            double gpuMs = -1.0;
+        };
+
+        void CreateFrame(Context& context, Frame& frame)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool        = context.commandPool;
+            allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (VK_SUCCESS != vkAllocateCommandBuffers(context.device, &allocInfo, &frame.commandBuffer))
+            {
+                throw std::runtime_error("Failed to allocate command buffers !");
+            }
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+            if (VK_SUCCESS != vkCreateFence(context.device, &fenceInfo, HostMemory::Callbacks(), &frame.fence))
+            {
+                throw std::runtime_error("Failed to create fence !");
+            }
+
+            if (context.timestamps)
+            {
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+                poolInfo.queryCount = 2;
+
+                if (VK_SUCCESS != vkCreateQueryPool(context.device, &poolInfo, HostMemory::Callbacks(), &frame.timestamps))
+                {
+                    throw std::runtime_error("Failed to create timestamp query pool !");
+                }
+            }
+        }
+
+        VkCommandBuffer& Begin(Frame& frame, Target& target)
+        {
+            frame.start = std::chrono::steady_clock::now();
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            vkResetCommandBuffer(frame.commandBuffer, 0);
+            if (VK_SUCCESS != vkBeginCommandBuffer(frame.commandBuffer, &beginInfo))
+            {
+                throw std::runtime_error("Failed to begin recording command buffer !");
+            }
+
+            if (VK_NULL_HANDLE != frame.timestamps)
+            {
+                vkCmdResetQueryPool(frame.commandBuffer, frame.timestamps, 0, 2);
+                vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamps, 0);
+            }
+
+            BeginPass(frame.commandBuffer, target);
+            return frame.commandBuffer;
+        }
+
+        Timing End(Context& context, Frame& frame)
+        {
+            vkCmdEndRenderPass(frame.commandBuffer);
+
+            if (VK_NULL_HANDLE != frame.timestamps)
+            {
+                vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamps, 1);
+            }
+
+            if (VK_SUCCESS != vkEndCommandBuffer(frame.commandBuffer))
+            {
+                throw std::runtime_error("Failed to record command buffer !");
+            }
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers    = &frame.commandBuffer;
+
+            if (VK_SUCCESS != vkQueueSubmit(context.queue, 1, &submitInfo, frame.fence))
+            {
+                throw std::runtime_error("Failed to submit draw command buffer !");
+            }
+
+            vkWaitForFences(context.device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(context.device, 1, &frame.fence);
+
+            Timing timing;
+            timing.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.start).count();
+
+            uint64_t ticks[2];
+            if (VK_NULL_HANDLE != frame.timestamps && VK_SUCCESS == vkGetQueryPoolResults(context.device, frame.timestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT))
+            {
+                timing.gpuMs = (ticks[1] - ticks[0]) * context.properties.limits.timestampPeriod * 1e-6;
+            }
+
+            return timing;
+        }
+
+        void DestroyFrame(Context& context, Frame& frame)
+        {
+            if (VK_NULL_HANDLE != frame.timestamps)
+            {
+                vkDestroyQueryPool(context.device, frame.timestamps, HostMemory::Callbacks());
+            }
+
+            if (VK_NULL_HANDLE != frame.fence)
+            {
+                vkDestroyFence(context.device, frame.fence, HostMemory::Callbacks());
+            }
+
+            frame = {};
+        }
+
+        /* Copies the last rendered frame to rgba, 4 bytes a pixel, rows top
+        down. Only for 8 bit RGBA / BGRA targets, BGRA is swizzled. */
+        void ReadBack(Context& context, Target& target, std::vector<uint8_t>& rgba)
+        {
+            bool bgra = VK_FORMAT_B8G8R8A8_UNORM == target.format || VK_FORMAT_B8G8R8A8_SRGB == target.format;
+            if (!bgra && VK_FORMAT_R8G8B8A8_UNORM != target.format && VK_FORMAT_R8G8B8A8_SRGB != target.format)
+            {
+                throw std::runtime_error("Read back needs an 8 bit RGBA target !");
+            }
+
+            VkDeviceSize   size = VkDeviceSize(target.extent.width) * target.extent.height * 4;
+            VkBuffer       buffer;
+            VkDeviceMemory memory;
+            Memory::CreateBuffer(context.device, context.physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+            // The pass left the color attachment in TRANSFER_SRC_OPTIMAL.
+            VkBufferImageCopy region{};
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent      = {target.extent.width, target.extent.height, 1};
+
+            VkCommandBuffer commandBuffer = Memory::BeginSingleTimeCommands(context.device, context.commandPool);
+            vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+            Memory::EndSingleTimeCommands(context.device, context.commandPool, context.queue, commandBuffer);
+
+            void* data;
+            if (VK_SUCCESS != vkMapMemory(context.device, memory, 0, size, 0, &data))
+            {
+                Memory::DestroyBuffer(context.device, buffer, memory);
+                throw std::runtime_error("Failed to map read back buffer !");
+            }
+            rgba.resize(static_cast<size_t>(size));
+            memcpy(rgba.data(), data, rgba.size());
+            vkUnmapMemory(context.device, memory);
+            Memory::DestroyBuffer(context.device, buffer, memory);
+
+            for (size_t i = 0; bgra && i < rgba.size(); i += 4)
+            {
+                std::swap(rgba[i], rgba[i + 2]);
+            }
+        }
+
+        void DestroyTarget(Context& context, Target& target)
+        {
+            vkDestroyFramebuffer(context.device, target.framebuffer, HostMemory::Callbacks());
+            vkDestroyRenderPass(context.device, target.renderPass, HostMemory::Callbacks());
+            Multisample::Destroy(context.device, target.multisample);
+            Depth::Destroy(context.device, target.depthImage, target.depthMemory, target.depthView);
+            vkDestroyImageView(context.device, target.view, HostMemory::Callbacks());
+            Memory::DestroyImage(context.device, target.image, target.memory);
+
+            target = {};
+        }
+    }
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Visuals
+{
+    namespace HostMemory
+    {
+        /* VkAllocationCallbacks for every object the app creates, so driver
+        host allocations are counted per VkSystemAllocationScope instead of
+        disappearing into malloc.
+            command    bump arena reset every frame, the allocation only has
+                       to live for the duration of the call
+            the others a free list per scope and size class up to kLargest,
+                       larger or over aligned blocks straight from malloc
+        Every block carries a Header just in front of it. */
+
+        const bool     kEnabled         = true;
+        const size_t   kArenaBytes      = 1 << 20; // per frame, overflow falls back to the pools
+        const size_t   kHeader          = 16;      // keeps pooled blocks 16 byte aligned
+        const uint32_t kClasses         = 7;       // 16 .. 1024 bytes
+        const size_t   kLargest         = size_t(16) << (kClasses - 1);
+        const uint32_t kScopes          = 5;       // VkSystemAllocationScope values
+
+        enum class Kind : uint8_t
+        {
+            Arena,
+            Pooled,
+            Direct
+        };
+
+        struct Header
+        {
+            void*    raw;       // what malloc returned, Direct only
+            uint32_t size;
+            uint8_t  scope;
+            Kind     kind;
+            uint16_t sizeClass;
+        };
+        static_assert(sizeof(Header) <= kHeader, "Header must fit in front of a 16 byte aligned block");
+
+        struct Counters
+        {
+            std::atomic<uint64_t> allocations{0};
+            std::atomic<uint64_t> frees{0};
+            std::atomic<uint64_t> reallocations{0};
+            std::atomic<uint64_t> liveBytes{0};
+            std::atomic<uint64_t> peakBytes{0};
+            std::atomic<uint64_t> totalBytes{0};
+            std::atomic<uint64_t> internalBytes{0}; // reported by the driver, not ours
+        };
+
+        struct Pool
+        {
+            std::mutex         mutex;
+            std::vector<void*> free[kClasses];
+            uint64_t           blocks = 0; // ever taken from malloc
+        };
+
+        struct Tracker
+        {
+            Counters              scopes[kScopes];
+            Pool                  pools[kScopes];
+            alignas(64) uint8_t   arena[kArenaBytes];
+            std::atomic<size_t>   arenaUsed{0};
+            std::atomic<uint64_t> arenaOverflows{0};
+            size_t                lastFrameArena       = 0; // bytes the previous frame took
+            uint64_t              lastFrameCommand     = 0; // command scope allocations of the previous frame
+            uint64_t              commandAtFrameStart  = 0;
+        };
+
+        Tracker& Get()
+        {
+            static Tracker tracker;
+            return tracker;
+        }
+
+        static Header* HeaderOf(void* memory)
+        {
+            return reinterpret_cast<Header*>(static_cast<uint8_t*>(memory) - kHeader);
+        }
+
+        static uintptr_t AlignUp(uintptr_t value, size_t alignment)
+        {
+            return (value + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        }
+
+        static uint32_t ClassOf(size_t size)
+        {
+            uint32_t sizeClass = 0;
+            while ((size_t(16) << sizeClass) < size)
+            {
+                sizeClass++;
+            }
+            return sizeClass;
+        }
+
+        static void Count(Counters& counters, size_t size)
+        {
+            counters.allocations.fetch_add(1, std::memory_order_relaxed);
+            counters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+            uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+            uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+            while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // Lock free, nullptr once the frame's arena is used up.
+        static void* ArenaAllocate(Tracker& tracker, size_t size, size_t alignment)
+        {
+            size_t reserve = size + kHeader + std::max(alignment, kHeader);
+            size_t offset  = tracker.arenaUsed.fetch_add(reserve, std::memory_order_relaxed);
+            if (offset + reserve > kArenaBytes)
+            {
+                tracker.arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            uintptr_t start = reinterpret_cast<uintptr_t>(tracker.arena + offset);
+            void*     block = reinterpret_cast<void*>(AlignUp(start + kHeader, std::max(alignment, kHeader)));
+            HeaderOf(block)->kind = Kind::Arena;
+            return block;
+        }
+
+        static void* PoolAllocate(Pool& pool, size_t size)
+        {
+            uint32_t sizeClass = ClassOf(size);
+            void*    block     = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                if (!pool.free[sizeClass].empty())
+                {
+                    block = pool.free[sizeClass].back();
+                    pool.free[sizeClass].pop_back();
+                }
+                else
+                {
+                    pool.blocks++;
+                }
+            }
+
+            if (nullptr == block)
+            {
+                uint8_t* raw = static_cast<uint8_t*>(malloc(kHeader + (size_t(16) << sizeClass)));
+                if (nullptr == raw)
+                {
+                    return nullptr;
+                }
+                block = raw + kHeader;
+            }
+
+            HeaderOf(block)->kind      = Kind::Pooled;
+            HeaderOf(block)->sizeClass = static_cast<uint16_t>(sizeClass);
+            return block;
+        }
+
+        static void* DirectAllocate(size_t size, size_t alignment)
+        {
+            size_t   align = std::max(alignment, kHeader);
+            uint8_t* raw   = static_cast<uint8_t*>(malloc(size + kHeader + align));
+            if (nullptr == raw)
+            {
+                return nullptr;
+            }
+
+            void* block = reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(raw) + kHeader, align));
+            HeaderOf(block)->kind = Kind::Direct;
+            HeaderOf(block)->raw  = raw;
+            return block;
+        }
+
+        static void* VKAPI_PTR Allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+        {
+            Tracker& tracker = *static_cast<Tracker*>(userData);
+            uint32_t scope   = std::min(static_cast<uint32_t>(allocationScope), kScopes - 1);
+            if (0 == size)
+            {
+                return nullptr;
+            }
+
+            void* block = VK_SYSTEM_ALLOCATION_SCOPE_COMMAND == allocationScope ? ArenaAllocate(tracker, size, alignment) : nullptr;
+            if (nullptr == block)
+            {
+                block = alignment <= kHeader && size <= kLargest ? PoolAllocate(tracker.pools[scope], size) : DirectAllocate(size, alignment);
+            }
+            if (nullptr == block)
+            {
+                return nullptr;
+            }
+
+            HeaderOf(block)->size  = static_cast<uint32_t>(size);
+            HeaderOf(block)->scope = static_cast<uint8_t>(scope);
+            Count(tracker.scopes[scope], size);
+            return block;
+        }
+
+        static void VKAPI_PTR Free(void* userData, void* memory)
+        {
+            if (nullptr == memory)
+            {
+                return;
+            }
+
+            Tracker& tracker = *static_cast<Tracker*>(userData);
+            Header*  header  = HeaderOf(memory);
+            Counters& counters = tracker.scopes[header->scope];
+            counters.frees.fetch_add(1, std::memory_order_relaxed);
+            counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+            if (Kind::Pooled == header->kind)
+            {
+                Pool& pool = tracker.pools[header->scope];
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                pool.free[header->sizeClass].push_back(memory);
+            }
+            else if (Kind::Direct == header->kind)
+            {
+                free(header->raw);
+            }
+            // Arena blocks go with the next BeginFrame.
+        }
+
+        static void* VKAPI_PTR Reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+        {
+            if (nullptr == original)
+            {
+                return Allocate(userData, size, alignment, allocationScope);
+            }
+            if (0 == size)
+            {
+                Free(userData, original);
+                return nullptr;
+            }
+
+            Tracker& tracker = *static_cast<Tracker*>(userData);
+            Header*  header  = HeaderOf(original);
+            tracker.scopes[header->scope].reallocations.fetch_add(1, std::memory_order_relaxed);
+
+            // Still fits its size class, only the counters move.
+            if (Kind::Pooled == header->kind && alignment <= kHeader && size <= (size_t(16) << header->sizeClass))
+            {
+                Counters& counters = tracker.scopes[header->scope];
+                counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+                counters.liveBytes.fetch_add(size, std::memory_order_relaxed);
+                header->size = static_cast<uint32_t>(size);
+                return original;
+            }
+
+            void* block = Allocate(userData, size, alignment, allocationScope);
+            if (nullptr != block)
+            {
+                memcpy(block, original, std::min<size_t>(size, header->size));
+                Free(userData, original);
+            }
+            return block;
+        }
+
+        static void VKAPI_PTR InternalAllocation(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+        {
+            Tracker& tracker = *static_cast<Tracker*>(userData);
+            tracker.scopes[std::min(static_cast<uint32_t>(allocationScope), kScopes - 1)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        static void VKAPI_PTR InternalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+        {
+            Tracker& tracker = *static_cast<Tracker*>(userData);
+            tracker.scopes[std::min(static_cast<uint32_t>(allocationScope), kScopes - 1)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        /* What every vkCreate* / vkDestroy* / vkAllocateMemory / vkFreeMemory
+        passes. An object has to be destroyed with the callbacks it was
+        created with, so it is this everywhere or nowhere. */
+        const VkAllocationCallbacks* Callbacks()
+        {
+            static const VkAllocationCallbacks callbacks =
+            {
+                &Get(),
+                Allocate,
+                Reallocate,
+                Free,
+                InternalAllocation,
+                InternalFree
+            };
+            return kEnabled ? &callbacks : nullptr;
+        }
+
+        /* Render thread, right after the in flight fence wait, while no other
+        thread is inside a Vulkan call. Command scope allocations of the
+        previous frame are all gone by now. */
+        void BeginFrame()
+        {
+            Tracker& tracker = Get();
+            uint64_t command = tracker.scopes[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND].allocations.load(std::memory_order_relaxed);
+
+            tracker.lastFrameCommand    = command - tracker.commandAtFrameStart;
+            tracker.commandAtFrameStart = command;
+            tracker.lastFrameArena      = std::min(tracker.arenaUsed.load(std::memory_order_relaxed), kArenaBytes);
+            tracker.arenaUsed.store(0, std::memory_order_relaxed);
+        }
+
+        const char* ScopeName(uint32_t scope)
+        {
+            const char* names[] = {"command", "object", "cache", "device", "instance"};
+            return scope < kScopes ? names[scope] : "unknown";
+        }
+
+        // After the instance is destroyed: hands the pooled free blocks back to malloc.
+        void Release()
+        {
+            Tracker& tracker = Get();
+            for (Pool& pool : tracker.pools)
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                for (std::vector<void*>& blocks : pool.free)
+                {
+                    for (void* block : blocks)
+                    {
+                        free(static_cast<uint8_t*>(block) - kHeader);
+                    }
+                    blocks.clear();
+                }
+            }
+        }
+    }
+}
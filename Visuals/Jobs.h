@@ -0,0 +1,543 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Visuals
+{
+    namespace Jobs
+    {
+        /* Work stealing scheduler.
+        Every worker owns a deque: it pushes and pops at the bottom, idle
+        workers steal from the top of someone else's. The thread that calls
+        Create is worker 0 and only runs jobs while it Waits.
+
+        Jobs live in per-worker arenas that are rewound by BeginFrame, so
+        spawning a job is a bump of an index and never allocates. A job's
+        callable is stored inline and must be trivially destructible (plain
+        captures, no std::function / containers by value).
+
+        Counters join jobs: Run increments the counter it is given and the
+        job decrements it when it finishes. RunAfter parks a job on another
+        counter until that one drops to zero.
+
+        Threads that are not workers, like the render thread, may Run and
+        Wait too. Only a deque's owner may push to it, so their jobs go
+        through one locked queue and a shared arena instead.
+
+        RunDetached is for the odd job that may outlive the frame, a terrain
+        chunk build: it comes from a small pool that BeginFrame leaves alone
+        and goes back to it when the job finishes. Poll such a job's counter
+        with Done rather than Wait, which would run every other job too.
+        */
+
+        const uint32_t kJobsPerWorker = 4096;
+        const uint32_t kDequeSize     = 4096; // power of two
+        const size_t   kStorage       = 64;
+        const uint32_t kDetachedJobs  = 64;
+
+        struct Counter;
+
+        struct alignas(64) Job
+        {
+            void   (*invoke)(void*) = nullptr;
+            Counter* signal         = nullptr;
+            Job*     next           = nullptr; // in Counter::waiting
+            bool     detached       = false;   // back to Scheduler::detachedFree once done
+            alignas(16) unsigned char storage[kStorage];
+        };
+
+        struct Counter
+        {
+            std::atomic<uint32_t> value{0};
+            std::atomic_flag      lock = ATOMIC_FLAG_INIT;
+            Job*                  waiting = nullptr;
+        };
+
+        // Chase-Lev deque, memory orders after Le et al. 2013.
+        struct Deque
+        {
+            std::atomic<int64_t> top{0};
+            alignas(64) std::atomic<int64_t> bottom{0};
+            std::atomic<Job*>    slots[kDequeSize];
+
+            bool Push(Job* job)
+            {
+                int64_t b = bottom.load(std::memory_order_relaxed);
+                int64_t t = top.load(std::memory_order_acquire);
+                if (b - t >= static_cast<int64_t>(kDequeSize))
+                {
+                    return false;
+                }
+
+                slots[b & (kDequeSize - 1)].store(job, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_release);
+                return true;
+            }
+
+            Job* Pop()
+            {
+                int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+                bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top.load(std::memory_order_relaxed);
+
+                if (t > b)
+                {
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                Job* job = slots[b & (kDequeSize - 1)].load(std::memory_order_relaxed);
+                if (t == b)
+                {
+                    // Last one: race the thieves for it.
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    {
+                        job = nullptr;
+                    }
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                return job;
+            }
+
+            Job* Steal()
+            {
+                int64_t t = top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t b = bottom.load(std::memory_order_acquire);
+
+                if (t >= b)
+                {
+                    return nullptr;
+                }
+
+                Job* job = slots[t & (kDequeSize - 1)].load(std::memory_order_relaxed);
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    return nullptr;
+                }
+                return job;
+            }
+        };
+
+        struct Worker
+        {
+            Deque                 deque;
+            std::unique_ptr<Job[]> arena;
+            std::atomic<uint32_t> used{0};
+            uint32_t              random = 0;
+        };
+
+        struct Scheduler
+        {
+            std::unique_ptr<Worker[]> workers;
+            uint32_t                  workerCount = 0;
+            std::vector<std::thread>  threads;
+            std::atomic<bool>         running{false};
+
+            // Jobs spawned outside the workers.
+            std::unique_ptr<Job[]>    foreignArena;
+            std::atomic<uint32_t>     foreignUsed{0};
+            std::mutex                foreignMutex;
+            std::vector<Job*>         foreignQueue;
+            std::atomic<uint32_t>     foreignCount{0}; // foreignQueue.size(), read without the lock
+
+            // Jobs that may outlive the frame, see RunDetached.
+            std::unique_ptr<Job[]>    detachedArena;
+            std::mutex                detachedMutex;
+            std::vector<Job*>         detachedFree;
+
+            std::mutex                sleepMutex;
+            std::condition_variable   wake;
+            std::atomic<uint32_t>     sleeping{0};
+        };
+
+        namespace Detail
+        {
+            const uint32_t kForeign = UINT32_MAX;
+
+            inline thread_local uint32_t t_worker        = kForeign;
+            inline thread_local uint32_t t_foreignRandom = 0x2545F491u;
+
+            void Push(Scheduler& scheduler, Job* job);
+
+            void Lock(Counter& counter)
+            {
+                while (counter.lock.test_and_set(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            /* Decrements under the lock: a waiter that sees zero still has to
+            take the lock once, so it cannot drop the counter while the last
+            signaller is touching it. */
+            void Signal(Scheduler& scheduler, Counter& counter)
+            {
+                Lock(counter);
+                Job* waiting = nullptr;
+                if (1 == counter.value.fetch_sub(1, std::memory_order_acq_rel))
+                {
+                    waiting         = counter.waiting;
+                    counter.waiting = nullptr;
+                }
+                counter.lock.clear(std::memory_order_release);
+
+                while (nullptr != waiting)
+                {
+                    Job* next = waiting->next;
+                    Push(scheduler, waiting);
+                    waiting = next;
+                }
+            }
+
+            void Execute(Scheduler& scheduler, Job* job)
+            {
+                // Read first: once signalled, a frame job's slot may be reused.
+                bool detached = job->detached;
+                job->invoke(job->storage);
+
+                if (nullptr != job->signal)
+                {
+                    Signal(scheduler, *job->signal);
+                }
+
+                if (detached)
+                {
+                    std::lock_guard<std::mutex> lock(scheduler.detachedMutex);
+                    scheduler.detachedFree.push_back(job);
+                }
+            }
+
+            void Push(Scheduler& scheduler, Job* job)
+            {
+                if (kForeign == t_worker)
+                {
+                    std::lock_guard<std::mutex> lock(scheduler.foreignMutex);
+                    scheduler.foreignQueue.push_back(job);
+                    scheduler.foreignCount.fetch_add(1, std::memory_order_release);
+                }
+                // A full deque degrades to running the job right here.
+                else if (!scheduler.workers[t_worker].deque.Push(job))
+                {
+                    Execute(scheduler, job);
+                    return;
+                }
+
+                if (scheduler.sleeping.load(std::memory_order_relaxed) > 0)
+                {
+                    scheduler.wake.notify_one();
+                }
+            }
+
+            static Job* PopForeign(Scheduler& scheduler)
+            {
+                if (0 == scheduler.foreignCount.load(std::memory_order_acquire))
+                {
+                    return nullptr;
+                }
+
+                std::lock_guard<std::mutex> lock(scheduler.foreignMutex);
+                if (scheduler.foreignQueue.empty())
+                {
+                    return nullptr;
+                }
+                Job* job = scheduler.foreignQueue.back();
+                scheduler.foreignQueue.pop_back();
+                scheduler.foreignCount.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+
+            Job* Next(Scheduler& scheduler)
+            {
+                bool foreign = kForeign == t_worker;
+                if (!foreign)
+                {
+                    if (Job* job = scheduler.workers[t_worker].deque.Pop())
+                    {
+                        return job;
+                    }
+                }
+
+                if (Job* job = PopForeign(scheduler))
+                {
+                    return job;
+                }
+
+                // xorshift start so thieves spread out over the victims.
+                uint32_t& random = foreign ? t_foreignRandom : scheduler.workers[t_worker].random;
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+
+                for (uint32_t i = 0; i < scheduler.workerCount; ++i)
+                {
+                    uint32_t victim = (random + i) % scheduler.workerCount;
+                    if (victim == t_worker)
+                    {
+                        continue;
+                    }
+                    if (Job* job = scheduler.workers[victim].deque.Steal())
+                    {
+                        return job;
+                    }
+                }
+
+                return nullptr;
+            }
+
+            void Loop(Scheduler& scheduler, uint32_t index)
+            {
+                t_worker = index;
+                uint32_t idle = 0;
+
+                while (scheduler.running.load(std::memory_order_acquire))
+                {
+                    if (Job* job = Next(scheduler))
+                    {
+                        Execute(scheduler, job);
+                        idle = 0;
+                        continue;
+                    }
+
+                    if (++idle < 64)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    // Between frames: sleep until new work is pushed.
+                    std::unique_lock<std::mutex> lock(scheduler.sleepMutex);
+                    scheduler.sleeping.fetch_add(1, std::memory_order_relaxed);
+                    scheduler.wake.wait_for(lock, std::chrono::milliseconds(1));
+                    scheduler.sleeping.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            template <typename F>
+            void Init(Job* job, F&& function, Counter* signal)
+            {
+                using Callable = std::decay_t<F>;
+                static_assert(sizeof(Callable) <= kStorage, "Job callable too large, capture less or by reference");
+                static_assert(alignof(Callable) <= 16, "Job callable over-aligned");
+                static_assert(std::is_trivially_destructible<Callable>::value, "Job callables are never destroyed");
+
+                job->invoke = [](void* storage) { (*static_cast<Callable*>(storage))(); };
+                job->signal = signal;
+                job->next   = nullptr;
+                new (job->storage) Callable(std::forward<F>(function));
+
+                if (nullptr != signal)
+                {
+                    signal->value.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            template <typename F>
+            Job* Allocate(Scheduler& scheduler, F&& function, Counter* signal)
+            {
+                bool                   foreign = kForeign == t_worker;
+                std::atomic<uint32_t>& used    = foreign ? scheduler.foreignUsed : scheduler.workers[t_worker].used;
+                uint32_t               index   = used.fetch_add(1, std::memory_order_relaxed);
+                if (index >= kJobsPerWorker)
+                {
+                    throw std::runtime_error("Job arena exhausted, raise kJobsPerWorker !");
+                }
+
+                Job* job = foreign ? &scheduler.foreignArena[index] : &scheduler.workers[t_worker].arena[index];
+                Init(job, std::forward<F>(function), signal);
+                job->detached = false;
+                return job;
+            }
+
+            template <typename F>
+            Job* AllocateDetached(Scheduler& scheduler, F&& function, Counter* signal)
+            {
+                Job* job = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(scheduler.detachedMutex);
+                    if (scheduler.detachedFree.empty())
+                    {
+                        throw std::runtime_error("Detached jobs exhausted, raise kDetachedJobs !");
+                    }
+                    job = scheduler.detachedFree.back();
+                    scheduler.detachedFree.pop_back();
+                }
+
+                Init(job, std::forward<F>(function), signal);
+                job->detached = true;
+                return job;
+            }
+        }
+
+        // workerCount includes the calling thread, 0 picks one per core.
+        void Create(Scheduler& scheduler, uint32_t workerCount = 0)
+        {
+            if (0 == workerCount)
+            {
+                workerCount = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            scheduler.workerCount = workerCount;
+            scheduler.workers.reset(new Worker[workerCount]);
+            for (uint32_t i = 0; i < workerCount; ++i)
+            {
+                scheduler.workers[i].arena.reset(new Job[kJobsPerWorker]);
+                scheduler.workers[i].random = 0x9E3779B9u * (i + 1);
+            }
+            scheduler.foreignArena.reset(new Job[kJobsPerWorker]);
+            scheduler.detachedArena.reset(new Job[kDetachedJobs]);
+            for (uint32_t i = 0; i < kDetachedJobs; ++i)
+            {
+                scheduler.detachedFree.push_back(&scheduler.detachedArena[i]);
+            }
+
+            Detail::t_worker = 0;
+            scheduler.running.store(true, std::memory_order_release);
+            for (uint32_t i = 1; i < workerCount; ++i)
+            {
+                scheduler.threads.emplace_back(Detail::Loop, std::ref(scheduler), i);
+            }
+        }
+
+        void Destroy(Scheduler& scheduler)
+        {
+            scheduler.running.store(false, std::memory_order_release);
+            scheduler.wake.notify_all();
+            for (std::thread& thread : scheduler.threads)
+            {
+                thread.join();
+            }
+            scheduler.threads.clear();
+            scheduler.workers.reset();
+            scheduler.workerCount = 0;
+            scheduler.foreignArena.reset();
+            scheduler.foreignQueue.clear();
+            scheduler.foreignCount.store(0, std::memory_order_relaxed);
+            scheduler.detachedFree.clear();
+            scheduler.detachedArena.reset();
+        }
+
+        // Rewinds every arena. Only while no job of the previous frame is alive.
+        void BeginFrame(Scheduler& scheduler)
+        {
+            for (uint32_t i = 0; i < scheduler.workerCount; ++i)
+            {
+                scheduler.workers[i].used.store(0, std::memory_order_relaxed);
+            }
+            scheduler.foreignUsed.store(0, std::memory_order_relaxed);
+        }
+
+        template <typename F>
+        void Run(Scheduler& scheduler, F&& function, Counter* signal = nullptr)
+        {
+            Detail::Push(scheduler, Detail::Allocate(scheduler, std::forward<F>(function), signal));
+        }
+
+        // Starts once dependency reaches zero, right away if it already has.
+        template <typename F>
+        void RunAfter(Scheduler& scheduler, Counter& dependency, F&& function, Counter* signal = nullptr)
+        {
+            Job* job = Detail::Allocate(scheduler, std::forward<F>(function), signal);
+
+            Detail::Lock(dependency);
+            bool ready = 0 == dependency.value.load(std::memory_order_acquire);
+            if (!ready)
+            {
+                job->next          = dependency.waiting;
+                dependency.waiting = job;
+            }
+            dependency.lock.clear(std::memory_order_release);
+
+            if (ready)
+            {
+                Detail::Push(scheduler, job);
+            }
+        }
+
+        // Like Run, but the job may still be running after the next BeginFrame.
+        template <typename F>
+        void RunDetached(Scheduler& scheduler, F&& function, Counter* signal = nullptr)
+        {
+            Detail::Push(scheduler, Detail::AllocateDetached(scheduler, std::forward<F>(function), signal));
+        }
+
+        // Runs other jobs until counter reaches zero.
+        void Wait(Scheduler& scheduler, Counter& counter)
+        {
+            while (0 != counter.value.load(std::memory_order_acquire))
+            {
+                if (Job* job = Detail::Next(scheduler))
+                {
+                    Detail::Execute(scheduler, job);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            // The last Signal may still hold the lock.
+            Detail::Lock(counter);
+            counter.lock.clear(std::memory_order_release);
+        }
+
+        // True once counter has reached zero and may be destroyed. Never runs a job.
+        bool Done(Counter& counter)
+        {
+            if (0 != counter.value.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            // As in Wait, the last Signal may still hold the lock.
+            Detail::Lock(counter);
+            counter.lock.clear(std::memory_order_release);
+            return true;
+        }
+
+        /* Splits [0, count) into at most maxRanges ranges of at least
+        minRange items (a multiple of granularity) and runs
+        function(range, begin, end) for each, returning once all are done.
+        Returns the number of ranges used. */
+        template <typename F>
+        uint32_t ParallelFor(Scheduler* scheduler, uint32_t count, uint32_t minRange, uint32_t granularity, uint32_t maxRanges, F&& function)
+        {
+            uint32_t workers = nullptr == scheduler ? 1 : scheduler->workerCount;
+            uint32_t ranges  = std::max(1u, std::min({maxRanges, workers * 4, count / std::max(1u, minRange)}));
+            uint32_t chunk   = (count + ranges - 1) / ranges;
+            chunk            = (chunk + granularity - 1) / granularity * granularity;
+            ranges           = 0 == chunk ? 1 : (count + chunk - 1) / chunk;
+
+            if (1 >= ranges || nullptr == scheduler)
+            {
+                function(0u, 0u, count);
+                return 1;
+            }
+
+            Counter done;
+            for (uint32_t range = 1; range < ranges; ++range)
+            {
+                uint32_t begin = range * chunk;
+                uint32_t end   = std::min(count, begin + chunk);
+                Run(*scheduler, [&function, range, begin, end]() { function(range, begin, end); }, &done);
+            }
+            function(0u, 0u, std::min(count, chunk));
+
+            Wait(*scheduler, done);
+            return ranges;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Visuals
+{
+    namespace Mailbox
+    {
+        /* Lock free triple buffer between one writer and one reader.
+        The writer fills Back and Publishes it, the reader Takes the newest
+        published value and keeps reading Front until the next Take. Neither
+        side ever waits for the other: a slow reader just skips values, a
+        fast reader sees the same value again.
+
+        The three slots rotate between writer, reader and the shared middle
+        one. state holds the middle slot's index plus a bit telling whether
+        it is newer than what the reader has.
+        */
+
+        const uint32_t kFresh = 4;
+
+        template <typename T>
+        struct Box
+        {
+            T slots[3];
+
+            alignas(64) std::atomic<uint32_t> state{1};
+            alignas(64) uint32_t back  = 0; // writer only
+            alignas(64) uint32_t front = 2; // reader only
+        };
+
+        template <typename T>
+        T& Back(Box<T>& box)
+        {
+            return box.slots[box.back];
+        }
+
+        template <typename T>
+        void Publish(Box<T>& box)
+        {
+            box.back = box.state.exchange(box.back | kFresh, std::memory_order_acq_rel) & 3;
+        }
+
+        // Returns false and leaves Front alone when nothing new was published.
+        template <typename T>
+        bool Take(Box<T>& box)
+        {
+            if (0 == (box.state.load(std::memory_order_relaxed) & kFresh))
+            {
+                return false;
+            }
+
+            box.front = box.state.exchange(box.front, std::memory_order_acq_rel) & 3;
+            return true;
+        }
+
+        template <typename T>
+        const T& Front(const Box<T>& box)
+        {
+            return box.slots[box.front];
+        }
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Single entry point for glm so the Vulkan clip space conventions are set
+// before any glm header is seen.
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace Memory
+    {
+        uint32_t FindType(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+        {
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+            {
+                if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                {
+                    return i;
+                }
+            }
+
+            throw std::runtime_error("Failed to find suitable memory type !");
+        }
+
+        bool HasType(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+        {
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+            {
+                if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Device memory allocated through this namespace since startup, for the regression baselines.
+        // Atomic, startup creates resources from several threads.
+        struct Counters
+        {
+            std::atomic<uint64_t>     allocations{0};
+            std::atomic<VkDeviceSize> bytes{0};
+        };
+
+        Counters& Allocated()
+        {
+            static Counters counters;
+            return counters;
+        }
+
+        void CreateBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size        = size;
+            bufferInfo.usage       = usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (VK_SUCCESS != vkCreateBuffer(device, &bufferInfo, HostMemory::Callbacks(), &buffer))
+            {
+                throw std::runtime_error("Failed to create buffer !");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize  = memRequirements.size;
+            allocInfo.memoryTypeIndex = FindType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+            if (VK_SUCCESS != vkAllocateMemory(device, &allocInfo, HostMemory::Callbacks(), &bufferMemory))
+            {
+                throw std::runtime_error("Failed to allocate buffer memory !");
+            }
+
+            Allocated().allocations.fetch_add(1, std::memory_order_relaxed);
+            Allocated().bytes.fetch_add(memRequirements.size, std::memory_order_relaxed);
+
+            vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        }
+
+        void DestroyBuffer(VkDevice& device, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+        {
+            if (VK_NULL_HANDLE != buffer)
+            {
+                vkDestroyBuffer(device, buffer, HostMemory::Callbacks());
+                buffer = VK_NULL_HANDLE;
+            }
+
+            if (VK_NULL_HANDLE != bufferMemory)
+            {
+                vkFreeMemory(device, bufferMemory, HostMemory::Callbacks());
+                bufferMemory = VK_NULL_HANDLE;
+            }
+        }
+
+        // LAZILY_ALLOCATED in properties is a preference: desktop GPUs have no such memory.
+        // With more than one queue family the image is shared between them, no ownership transfers.
+        void CreateImage(VkDevice& device, VkPhysicalDevice& physicalDevice, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, const std::vector<uint32_t>& queueFamilies = {})
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width  = width;
+            imageInfo.extent.height = height;
+            imageInfo.extent.depth  = 1;
+            imageInfo.mipLevels     = mipLevels;
+            imageInfo.arrayLayers   = 1;
+            imageInfo.format        = format;
+            imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage         = usage;
+            imageInfo.samples       = samples;
+            imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (queueFamilies.size() > 1)
+            {
+                imageInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+                imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+                imageInfo.pQueueFamilyIndices   = queueFamilies.data();
+            }
+
+            if (VK_SUCCESS != vkCreateImage(device, &imageInfo, HostMemory::Callbacks(), &image))
+            {
+                throw std::runtime_error("Failed to create image !");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+            if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !HasType(physicalDevice, memRequirements.memoryTypeBits, properties))
+            {
+                properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+            }
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize  = memRequirements.size;
+            allocInfo.memoryTypeIndex = FindType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+            if (VK_SUCCESS != vkAllocateMemory(device, &allocInfo, HostMemory::Callbacks(), &imageMemory))
+            {
+                throw std::runtime_error("Failed to allocate image memory !");
+            }
+
+            Allocated().allocations.fetch_add(1, std::memory_order_relaxed);
+            Allocated().bytes.fetch_add(memRequirements.size, std::memory_order_relaxed);
+
+            vkBindImageMemory(device, image, imageMemory, 0);
+        }
+
+        void CreateImageView(VkDevice& device, VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount, VkImageView& imageView)
+        {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image                           = image;
+            viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format                          = format;
+            viewInfo.subresourceRange.aspectMask     = aspectFlags;
+            viewInfo.subresourceRange.baseMipLevel   = baseMipLevel;
+            viewInfo.subresourceRange.levelCount     = levelCount;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount     = 1;
+
+            if (VK_SUCCESS != vkCreateImageView(device, &viewInfo, HostMemory::Callbacks(), &imageView))
+            {
+                throw std::runtime_error("Failed to create image view !");
+            }
+        }
+
+        void DestroyImage(VkDevice& device, VkImage& image, VkDeviceMemory& imageMemory)
+        {
+            if (VK_NULL_HANDLE != image)
+            {
+                vkDestroyImage(device, image, HostMemory::Callbacks());
+                image = VK_NULL_HANDLE;
+            }
+
+            if (VK_NULL_HANDLE != imageMemory)
+            {
+                vkFreeMemory(device, imageMemory, HostMemory::Callbacks());
+                imageMemory = VK_NULL_HANDLE;
+            }
+        }
+
+        /* Stretches sourceExtent of source over a just acquired swapchain image
+        and leaves it ready to present. acquireStage is where the submit waits
+        for the image, the layout change is chained to it. */
+        void BlitToPresent(VkCommandBuffer& commandBuffer, VkImage source, VkImageLayout sourceLayout, VkExtent2D sourceExtent, VkImage target, VkExtent2D targetExtent, VkPipelineStageFlags acquireStage)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image                           = target;
+            barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel   = 0;
+            barrier.subresourceRange.levelCount     = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount     = 1;
+            barrier.srcAccessMask                   = 0;
+            barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+            vk.CmdPipelineBarrier(commandBuffer, acquireStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit{};
+            blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            blit.srcOffsets[1]  = {static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1};
+            blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            blit.dstOffsets[1]  = {static_cast<int32_t>(targetExtent.width), static_cast<int32_t>(targetExtent.height), 1};
+
+            bool     scaled = sourceExtent.width != targetExtent.width || sourceExtent.height != targetExtent.height;
+            VkFilter filter = scaled ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+            vk.CmdBlitImage(commandBuffer, source, sourceLayout, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        VkCommandBuffer BeginSingleTimeCommands(VkDevice& device, VkCommandPool& commandPool)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool        = commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (VK_SUCCESS != vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer))
+            {
+                throw std::runtime_error("Failed to allocate single time command buffer !");
+            }
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            return commandBuffer;
+        }
+
+        void EndSingleTimeCommands(VkDevice& device, VkCommandPool& commandPool, VkQueue& queue, VkCommandBuffer& commandBuffer)
+        {
+            vkEndCommandBuffer(commandBuffer);
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers    = &commandBuffer;
+
+            if (VK_SUCCESS != vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE))
+            {
+                throw std::runtime_error("Failed to submit single time command buffer !");
+            }
+
+            vkQueueWaitIdle(queue);
+            vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "MeshFormat.h"
+#include "Memory.h"
+
+namespace Visuals
+{
+    namespace Mesh
+    {
+        // A .skym file mapped read-only. Nothing is parsed: the stream pointers
+        // below point straight into the mapping.
+        struct Mapped
+        {
+            void*                      data   = nullptr;
+            size_t                     size   = 0;
+            const MeshFormat::Header*  header = nullptr;
+        };
+
+        struct Gpu
+        {
+            VkBuffer           buffer        = VK_NULL_HANDLE;
+            VkDeviceMemory     memory        = VK_NULL_HANDLE;
+            VkDeviceSize       vertexOffset  = 0;
+            VkDeviceSize       indexOffset   = 0;
+            VkDeviceSize       meshletOffset = 0;
+            VkIndexType        indexType     = VK_INDEX_TYPE_UINT16;
+            uint32_t           vertexCount   = 0;
+            uint32_t           indexCount    = 0;
+            uint32_t           meshletCount  = 0;
+            MeshFormat::Bounds bounds{};
+        };
+
+        void Map(const std::string& filename, Mapped& mapped)
+        {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Failed to open mesh file !");
+            }
+
+            struct stat st;
+            if (0 != fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(MeshFormat::Header))
+            {
+                close(fd);
+                throw std::runtime_error("Mesh file is too small !");
+            }
+
+            void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (MAP_FAILED == data)
+            {
+                throw std::runtime_error("Failed to map mesh file !");
+            }
+
+            // The payload is consumed front to back exactly once by Upload().
+            madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+            mapped.data   = data;
+            mapped.size   = static_cast<size_t>(st.st_size);
+            mapped.header = static_cast<const MeshFormat::Header*>(data);
+
+            try
+            {
+                MeshFormat::Validate(*mapped.header, mapped.size);
+            }
+            catch (...)
+            {
+                munmap(mapped.data, mapped.size);
+                mapped = {};
+                throw;
+            }
+        }
+
+        void Unmap(Mapped& mapped)
+        {
+            if (nullptr != mapped.data)
+            {
+                munmap(mapped.data, mapped.size);
+                mapped = {};
+            }
+        }
+
+        const MeshFormat::Vertex* Vertices(const Mapped& mapped)
+        {
+            return reinterpret_cast<const MeshFormat::Vertex*>(static_cast<const char*>(mapped.data) + mapped.header->vertices.offset);
+        }
+
+        const void* Indices(const Mapped& mapped)
+        {
+            return static_cast<const char*>(mapped.data) + mapped.header->indices.offset;
+        }
+
+        const MeshFormat::Meshlet* Meshlets(const Mapped& mapped)
+        {
+            return reinterpret_cast<const MeshFormat::Meshlet*>(static_cast<const char*>(mapped.data) + mapped.header->meshlets.offset);
+        }
+
+        // Streams every section of the file into one device local buffer with a
+        // single memcpy and a single copy region. Offsets inside the buffer keep
+        // the file's page alignment, which satisfies every vertex, index and
+        // storage buffer offset alignment requirement.
+        void Upload(VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool& commandPool, VkQueue& queue, const Mapped& mapped, Gpu& mesh)
+        {
+            const MeshFormat::Header& header = *mapped.header;
+
+            VkDeviceSize payloadOffset = header.vertices.offset;
+            VkDeviceSize payloadSize   = mapped.size - payloadOffset;
+
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingMemory;
+            Memory::CreateBuffer(device, physicalDevice, payloadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+
+            void* data;
+            if (VK_SUCCESS != vkMapMemory(device, stagingMemory, 0, payloadSize, 0, &data))
+            {
+                Memory::DestroyBuffer(device, stagingBuffer, stagingMemory);
+                throw std::runtime_error("Failed to map mesh staging buffer !");
+            }
+            memcpy(data, static_cast<const char*>(mapped.data) + payloadOffset, static_cast<size_t>(payloadSize));
+            vkUnmapMemory(device, stagingMemory);
+
+            VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            Memory::CreateBuffer(device, physicalDevice, payloadSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mesh.buffer, mesh.memory);
+
+            VkCommandBuffer commandBuffer = Memory::BeginSingleTimeCommands(device, commandPool);
+
+            VkBufferCopy copyRegion{};
+            copyRegion.srcOffset = 0;
+            copyRegion.dstOffset = 0;
+            copyRegion.size      = payloadSize;
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, mesh.buffer, 1, &copyRegion);
+
+            Memory::EndSingleTimeCommands(device, commandPool, queue, commandBuffer);
+            Memory::DestroyBuffer(device, stagingBuffer, stagingMemory);
+
+            mesh.vertexOffset  = 0;
+            mesh.indexOffset   = header.indices.offset - payloadOffset;
+            mesh.meshletOffset = header.meshletCount > 0 ? header.meshlets.offset - payloadOffset : 0;
+            mesh.indexType     = (header.flags & MeshFormat::kFlagIndex32) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+            mesh.vertexCount   = static_cast<uint32_t>(header.vertexCount);
+            mesh.indexCount    = static_cast<uint32_t>(header.indexCount);
+            mesh.meshletCount  = static_cast<uint32_t>(header.meshletCount);
+            mesh.bounds        = header.bounds;
+        }
+
+        void Destroy(VkDevice& device, Gpu& mesh)
+        {
+            Memory::DestroyBuffer(device, mesh.buffer, mesh.memory);
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Visuals
+{
+    namespace MeshFormat
+    {
+        /* LAYOUT (.skym):
+        [ Header          ] 256 bytes
+        [ pad             ] up to kAlignment
+        [ Vertex[]        ] vertices.offset, vertices.size
+        [ pad             ]
+        [ uint16/uint32[] ] indices.offset, indices.size
+        [ pad             ]
+        [ Meshlet[]       ] meshlets.offset, meshlets.size (optional)
+
+        Every stream starts on a page boundary and streams follow each other in
+        that order, so everything from vertices.offset to the end of the file can
+        be copied into a staging buffer with a single memcpy.
+        */
+
+        static constexpr uint32_t kMagic     = 0x4D594B53; // "SKYM"
+        static constexpr uint32_t kVersion   = 1;
+        static constexpr uint64_t kAlignment = 4096;
+
+        enum Flags : uint32_t
+        {
+            kFlagIndex32  = 1u << 0,
+            kFlagMeshlets = 1u << 1,
+        };
+
+        struct Vertex
+        {
+            float position[3];
+            float normal[3];
+            float uv[2];
+        };
+
+        struct Bounds
+        {
+            float min[3];
+            float max[3];
+            float center[3];
+            float radius;
+        };
+
+        // std430 compatible, read directly by compute shaders.
+        struct Meshlet
+        {
+            float    center[3];
+            float    radius;
+            float    coneAxis[3];
+            float    coneCutoff;
+            uint32_t firstIndex;
+            uint32_t triangleCount;
+            uint32_t pad[2];
+        };
+
+        struct Stream
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t flags;
+            uint32_t vertexStride;
+            uint64_t vertexCount;
+            uint64_t indexCount;
+            uint64_t meshletCount;
+            Stream   vertices;
+            Stream   indices;
+            Stream   meshlets;
+            Bounds   bounds;
+            uint8_t  reserved[128];
+        };
+
+        static_assert(sizeof(Vertex) == 32, "Vertex layout is part of the file format");
+        static_assert(sizeof(Meshlet) == 48, "Meshlet layout is part of the file format");
+        static_assert(sizeof(Header) == 256, "Header layout is part of the file format");
+        static_assert(std::is_trivially_copyable<Header>::value, "Header must be memcpy-able");
+
+        constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment = kAlignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        uint32_t IndexSize(const Header& header)
+        {
+            return (header.flags & kFlagIndex32) ? 4 : 2;
+        }
+
+        // Exactly count elements, without multiplying a count read from the file.
+        static bool Holds(const Stream& stream, uint64_t count, uint64_t elementSize)
+        {
+            return 0 == stream.size % elementSize && stream.size / elementSize == count;
+        }
+
+        void Validate(const Header& header, uint64_t fileSize)
+        {
+            if (kMagic != header.magic)
+            {
+                throw std::runtime_error("Not a SKYM mesh file !");
+            }
+
+            if (kVersion != header.version)
+            {
+                throw std::runtime_error("Unsupported SKYM mesh version !");
+            }
+
+            if (sizeof(Vertex) != header.vertexStride)
+            {
+                throw std::runtime_error("Unsupported SKYM vertex stride !");
+            }
+
+            const Stream streams[] = {header.vertices, header.indices, header.meshlets};
+            for (const Stream& stream : streams)
+            {
+                if (0 != stream.offset % kAlignment || stream.offset > fileSize || stream.size > fileSize - stream.offset)
+                {
+                    throw std::runtime_error("Corrupt SKYM mesh stream !");
+                }
+            }
+
+            if (!Holds(header.vertices, header.vertexCount, sizeof(Vertex)) ||
+                !Holds(header.indices, header.indexCount, IndexSize(header)) ||
+                !Holds(header.meshlets, header.meshletCount, sizeof(Meshlet)))
+            {
+                throw std::runtime_error("SKYM mesh stream sizes do not match header counts !");
+            }
+
+            if (0 == header.vertexCount || 0 == header.indexCount)
+            {
+                throw std::runtime_error("SKYM mesh has no vertices or indices !");
+            }
+
+            // Every stream is inside the file now, so these sums cannot wrap.
+            // Mesh::Upload copies from vertices.offset on and offsets the others from it.
+            if (header.vertices.offset < sizeof(Header) ||
+                header.indices.offset < header.vertices.offset + header.vertices.size ||
+                (header.meshletCount > 0 && header.meshlets.offset < header.indices.offset + header.indices.size))
+            {
+                throw std::runtime_error("SKYM mesh streams are out of order !");
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "Memory.h"
+
+namespace Visuals
+{
+    namespace Multisample
+    {
+        /* Multisampled color target of the main render pass. Samples live in
+        a transient, lazily allocated image that is resolved into the
+        swapchain image at the end of the subpass and never stored, so on
+        tiled GPUs they never leave tile memory at all. Depth gets the same
+        treatment in Depth::Create. */
+
+        struct Target
+        {
+            VkImage        image  = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkImageView    view   = VK_NULL_HANDLE;
+        };
+
+        // Highest count both color and depth framebuffers support, at most requested.
+        VkSampleCountFlagBits Pick(VkPhysicalDevice& physicalDevice, uint32_t requested)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+            uint32_t samples = VK_SAMPLE_COUNT_64_BIT;
+            while (samples > VK_SAMPLE_COUNT_1_BIT && (samples > requested || 0 == (supported & samples)))
+            {
+                samples >>= 1;
+            }
+
+            return static_cast<VkSampleCountFlagBits>(samples);
+        }
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkExtent2D& extent, VkFormat format, VkSampleCountFlagBits samples, Target& target)
+        {
+            Memory::CreateImage(device, physicalDevice, extent.width, extent.height, 1, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, target.image, target.memory, samples);
+            Memory::CreateImageView(device, target.image, format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, target.view);
+        }
+
+        void Destroy(VkDevice& device, Target& target)
+        {
+            if (VK_NULL_HANDLE != target.view)
+            {
+                vkDestroyImageView(device, target.view, HostMemory::Callbacks());
+            }
+            Memory::DestroyImage(device, target.image, target.memory);
+
+            target = {};
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "Descriptors.h"
+#include "Memory.h"
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Objects
+    {
+        /* Per object data read by Mesh.vert (binding 0) and the culling
+        shaders (binding 1), indexed by firstInstance / gl_InstanceIndex:
+            binding 0  mat4 models[count]
+            binding 1  vec4 spheres[count]   world center, radius (< 0: nothing to draw)
+        One host visible copy per frame. Only one frame is ever in flight, so
+        the copy written for frame N was last read by frame N - 2, whose fence
+        has been waited on before frame N - 1 was recorded.
+        */
+
+        const uint32_t kFrames = 2;
+
+        // Sphere of objects that only exist to carry a transform.
+        const glm::vec4 kNoBounds(0.0f, 0.0f, 0.0f, -std::numeric_limits<float>::max());
+
+        struct Buffer
+        {
+            VkBuffer              buffers[kFrames]        = {};
+            VkDeviceMemory        memories[kFrames]       = {};
+            void*                 mapped[kFrames]         = {};
+            VkDescriptorSetLayout setLayout               = VK_NULL_HANDLE;
+            VkDescriptorPool      descriptorPool          = VK_NULL_HANDLE;
+            VkDescriptorSet       descriptorSets[kFrames] = {};
+            VkDeviceSize          spheresOffset           = 0;
+            uint32_t              count                   = 0;
+            uint32_t              frame                   = 0;
+
+            // Per copy, the index range changed since it was last written.
+            uint32_t              pendingBegin[kFrames]   = {};
+            uint32_t              pendingEnd[kFrames]     = {};
+        };
+
+        glm::mat4* Models(Buffer& objects, uint32_t frame)
+        {
+            return static_cast<glm::mat4*>(objects.mapped[frame]);
+        }
+
+        glm::vec4* Spheres(Buffer& objects, uint32_t frame)
+        {
+            return reinterpret_cast<glm::vec4*>(static_cast<char*>(objects.mapped[frame]) + objects.spheresOffset);
+        }
+
+        VkDescriptorSet& CurrentSet(Buffer& objects)
+        {
+            return objects.descriptorSets[objects.frame];
+        }
+
+        // Creates the layout only, so pipelines can be built before any objects exist.
+        void CreateSetLayout(VkDevice& device, Buffer& objects)
+        {
+            Descriptors::CreateSetLayout(device, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, objects.setLayout);
+        }
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, uint32_t count, Buffer& objects)
+        {
+            objects.count = count;
+
+            // 256 is the largest minStorageBufferOffsetAlignment the spec allows.
+            VkDeviceSize modelsSize  = sizeof(glm::mat4) * count;
+            VkDeviceSize spheresSize = sizeof(glm::vec4) * count;
+            objects.spheresOffset    = (modelsSize + 255) & ~VkDeviceSize(255);
+
+            Descriptors::CreatePool(device, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}, kFrames, objects.descriptorPool);
+
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                Memory::CreateBuffer(device, physicalDevice, objects.spheresOffset + spheresSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objects.buffers[frame], objects.memories[frame]);
+                if (VK_SUCCESS != vkMapMemory(device, objects.memories[frame], 0, VK_WHOLE_SIZE, 0, &objects.mapped[frame]))
+                {
+                    throw std::runtime_error("Failed to map object buffer !");
+                }
+
+                Descriptors::Allocate(device, objects.descriptorPool, objects.setLayout, objects.descriptorSets[frame]);
+                Descriptors::WriteBuffer(device, objects.descriptorSets[frame], 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects.buffers[frame], 0, modelsSize);
+                Descriptors::WriteBuffer(device, objects.descriptorSets[frame], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects.buffers[frame], objects.spheresOffset, spheresSize);
+
+                objects.pendingBegin[frame] = 0;
+                objects.pendingEnd[frame]   = count;
+            }
+        }
+
+        /* Advances to the next copy and brings it up to date. models and
+        spheres are full arrays of count entries; [changedBegin, changedEnd)
+        is what changed since the previous call. */
+        void Write(Buffer& objects, const glm::mat4* models, const glm::vec4* spheres, uint32_t changedBegin, uint32_t changedEnd)
+        {
+            objects.frame = (objects.frame + 1) % kFrames;
+
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                if (changedBegin < changedEnd)
+                {
+                    bool empty = objects.pendingBegin[frame] >= objects.pendingEnd[frame];
+                    objects.pendingBegin[frame] = empty ? changedBegin : std::min(objects.pendingBegin[frame], changedBegin);
+                    objects.pendingEnd[frame]   = empty ? changedEnd   : std::max(objects.pendingEnd[frame], changedEnd);
+                }
+            }
+
+            uint32_t begin = objects.pendingBegin[objects.frame];
+            uint32_t end   = objects.pendingEnd[objects.frame];
+
+            if (begin < end)
+            {
+                memcpy(Models(objects, objects.frame) + begin, models + begin, sizeof(glm::mat4) * (end - begin));
+                memcpy(Spheres(objects, objects.frame) + begin, spheres + begin, sizeof(glm::vec4) * (end - begin));
+            }
+
+            objects.pendingBegin[objects.frame] = 0;
+            objects.pendingEnd[objects.frame]   = 0;
+        }
+
+        void Destroy(VkDevice& device, Buffer& objects)
+        {
+            if (VK_NULL_HANDLE != objects.descriptorPool)
+            {
+                vkDestroyDescriptorPool(device, objects.descriptorPool, HostMemory::Callbacks());
+            }
+
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                if (nullptr != objects.mapped[frame])
+                {
+                    vkUnmapMemory(device, objects.memories[frame]);
+                }
+                Memory::DestroyBuffer(device, objects.buffers[frame], objects.memories[frame]);
+            }
+
+            if (VK_NULL_HANDLE != objects.setLayout)
+            {
+                vkDestroyDescriptorSetLayout(device, objects.setLayout, HostMemory::Callbacks());
+            }
+
+            objects = {};
+        }
+    }
+}
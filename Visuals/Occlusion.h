@@ -0,0 +1,433 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "ComputePipeline.h"
+#include "Descriptors.h"
+#include "Memory.h"
+#include "Mesh.h"
+#include "Objects.h"
+#include "HostMemory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace Occlusion
+    {
+        /* TWO PHASE CULLING, per frame:
+        Cull(First)   objects visible last frame and inside the frustum -> early draws
+        [pass First]  draw early set, keep depth
+        BuildPyramid  depth -> Hi-Z pyramid (max reduction, power of two)
+        Cull(Second)  every object against frustum + pyramid -> late draws for the
+                      newly visible ones, visibility written for the next frame
+        [pass Second] draw late set on top, present
+        */
+
+        enum Phase : uint32_t
+        {
+            First  = 0,
+            Second = 1
+        };
+
+        // Mirrors the Counters block in OcclusionCull.comp.
+        struct Stats
+        {
+            uint32_t objects         = 0;
+            uint32_t frustumCulled   = 0;
+            uint32_t occlusionCulled = 0;
+            uint32_t earlyDrawn      = 0;
+            uint32_t lateDrawn       = 0;
+        };
+
+        struct CullPushConstants
+        {
+            glm::mat4  view;
+            glm::vec4  frustum;    // symmetric side planes in view space
+            glm::vec4  projection; // P00, P11, zNear, zFar
+            glm::uvec4 info;       // objectCount, phase, pyramid width, pyramid height
+        };
+
+        struct ReducePushConstants
+        {
+            glm::uvec2 sourceSize;
+            glm::uvec2 destinationSize;
+        };
+
+        struct Resources
+        {
+            VkImage                      pyramid          = VK_NULL_HANDLE;
+            VkDeviceMemory               pyramidMemory    = VK_NULL_HANDLE;
+            VkImageView                  pyramidView      = VK_NULL_HANDLE;
+            std::vector<VkImageView>     pyramidMipViews;
+            uint32_t                     pyramidWidth     = 0;
+            uint32_t                     pyramidHeight    = 0;
+            uint32_t                     pyramidLevels    = 0;
+            VkSampler                    sampler          = VK_NULL_HANDLE;
+
+            VkDescriptorSetLayout        reduceSetLayout  = VK_NULL_HANDLE;
+            VkPipelineLayout             reduceLayout     = VK_NULL_HANDLE;
+            VkPipeline                   reducePipeline   = VK_NULL_HANDLE;
+            VkDescriptorPool             reducePool       = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> reduceSets;
+
+            VkDescriptorSetLayout        cullSetLayout    = VK_NULL_HANDLE;
+            VkPipelineLayout             cullLayout       = VK_NULL_HANDLE;
+            VkPipeline                   cullPipeline     = VK_NULL_HANDLE;
+            VkDescriptorPool             cullPool         = VK_NULL_HANDLE;
+            VkDescriptorSet              cullSet          = VK_NULL_HANDLE;
+
+            VkBuffer                     visibilityBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory               visibilityMemory = VK_NULL_HANDLE;
+            VkBuffer                     earlyDraws       = VK_NULL_HANDLE;
+            VkDeviceMemory               earlyDrawsMemory = VK_NULL_HANDLE;
+            VkBuffer                     lateDraws        = VK_NULL_HANDLE;
+            VkDeviceMemory               lateDrawsMemory  = VK_NULL_HANDLE;
+            VkBuffer                     countersBuffer   = VK_NULL_HANDLE;
+            VkDeviceMemory               countersMemory   = VK_NULL_HANDLE;
+            VkBuffer                     readbackBuffer   = VK_NULL_HANDLE;
+            VkDeviceMemory               readbackMemory   = VK_NULL_HANDLE;
+            Stats*                       readback         = nullptr;
+
+            uint32_t                     objectCount      = 0;
+            bool                         multiDraw        = false;
+        };
+
+        static uint32_t PreviousPow2(uint32_t value)
+        {
+            uint32_t result = 1;
+            while (result * 2 <= value)
+            {
+                result *= 2;
+            }
+            return result;
+        }
+
+        static void CreatePyramid(VkDevice& device, VkPhysicalDevice& physicalDevice, VkExtent2D& extent, Resources& res)
+        {
+            // Power of two so every level halves exactly; level 0 reduces up to 2x2 depth texels.
+            res.pyramidWidth  = PreviousPow2(extent.width);
+            res.pyramidHeight = PreviousPow2(extent.height);
+            res.pyramidLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(res.pyramidWidth, res.pyramidHeight)))) + 1;
+
+            Memory::CreateImage(device, physicalDevice, res.pyramidWidth, res.pyramidHeight, res.pyramidLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.pyramid, res.pyramidMemory);
+            Memory::CreateImageView(device, res.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, res.pyramidLevels, res.pyramidView);
+
+            res.pyramidMipViews.resize(res.pyramidLevels);
+            for (uint32_t level = 0; level < res.pyramidLevels; ++level)
+            {
+                Memory::CreateImageView(device, res.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1, res.pyramidMipViews[level]);
+            }
+
+            VkSamplerCreateInfo samplerInfo{};
+            samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter    = VK_FILTER_NEAREST;
+            samplerInfo.minFilter    = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.minLod       = 0.0f;
+            samplerInfo.maxLod       = static_cast<float>(res.pyramidLevels);
+
+            if (VK_SUCCESS != vkCreateSampler(device, &samplerInfo, HostMemory::Callbacks(), &res.sampler))
+            {
+                throw std::runtime_error("Failed to create Hi-Z sampler !");
+            }
+        }
+
+        static void CreateDrawBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool& commandPool, VkQueue& queue, Mesh::Gpu& mesh, uint32_t objectCount, VkBuffer& buffer, VkDeviceMemory& memory)
+        {
+            // Everything but instanceCount is static, the cull shader only toggles visibility.
+            std::vector<VkDrawIndexedIndirectCommand> draws(objectCount);
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                draws[i].indexCount    = mesh.indexCount;
+                draws[i].instanceCount = 0;
+                draws[i].firstIndex    = 0;
+                draws[i].vertexOffset  = 0;
+                draws[i].firstInstance = i;
+            }
+
+            VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * objectCount;
+
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingMemory;
+            Memory::CreateBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+
+            void* data;
+            if (VK_SUCCESS != vkMapMemory(device, stagingMemory, 0, size, 0, &data))
+            {
+                throw std::runtime_error("Failed to map occlusion draw staging buffer !");
+            }
+            memcpy(data, draws.data(), static_cast<size_t>(size));
+            vkUnmapMemory(device, stagingMemory);
+
+            Memory::CreateBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+            VkCommandBuffer commandBuffer = Memory::BeginSingleTimeCommands(device, commandPool);
+            VkBufferCopy copyRegion{};
+            copyRegion.size = size;
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+            Memory::EndSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+            Memory::DestroyBuffer(device, stagingBuffer, stagingMemory);
+        }
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool& commandPool, VkQueue& queue, VkExtent2D& extent, VkImageView& depthImageView, Objects::Buffer& objects, Mesh::Gpu& mesh, Resources& res)
+        {
+            VkPhysicalDeviceFeatures features;
+            vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+            if (VK_TRUE != features.drawIndirectFirstInstance)
+            {
+                throw std::runtime_error("Occlusion culling needs drawIndirectFirstInstance !");
+            }
+
+            res.multiDraw   = VK_TRUE == features.multiDrawIndirect;
+            res.objectCount = objects.count;
+
+            CreatePyramid(device, physicalDevice, extent, res);
+
+            // Reduction: one set per pyramid level, level 0 reads the depth attachment.
+            const std::vector<VkDescriptorType> reduceTypes = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+            Descriptors::CreateSetLayout(device, reduceTypes, VK_SHADER_STAGE_COMPUTE_BIT, res.reduceSetLayout);
+            ComputePipeline::Create(res.reducePipeline, device, res.reduceLayout, "HiZReduce.comp.spv", {res.reduceSetLayout}, sizeof(ReducePushConstants));
+            Descriptors::CreatePool(device, reduceTypes, res.pyramidLevels, res.reducePool);
+
+            res.reduceSets.resize(res.pyramidLevels);
+            for (uint32_t level = 0; level < res.pyramidLevels; ++level)
+            {
+                VkImageView source       = 0 == level ? depthImageView : res.pyramidMipViews[level - 1];
+                VkImageLayout sourceLayout = 0 == level ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+                Descriptors::Allocate(device, res.reducePool, res.reduceSetLayout, res.reduceSets[level]);
+                Descriptors::WriteImage(device, res.reduceSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, source, sourceLayout);
+                Descriptors::WriteImage(device, res.reduceSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, res.pyramidMipViews[level], VK_IMAGE_LAYOUT_GENERAL);
+            }
+
+            // Culling: set 0 is the shared object buffer.
+            VkDeviceSize visibilitySize = sizeof(uint32_t) * res.objectCount;
+            Memory::CreateBuffer(device, physicalDevice, visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.visibilityBuffer, res.visibilityMemory);
+            CreateDrawBuffer(device, physicalDevice, commandPool, queue, mesh, res.objectCount, res.earlyDraws, res.earlyDrawsMemory);
+            CreateDrawBuffer(device, physicalDevice, commandPool, queue, mesh, res.objectCount, res.lateDraws, res.lateDrawsMemory);
+            Memory::CreateBuffer(device, physicalDevice, sizeof(Stats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.countersBuffer, res.countersMemory);
+            Memory::CreateBuffer(device, physicalDevice, sizeof(Stats), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, res.readbackBuffer, res.readbackMemory);
+
+            if (VK_SUCCESS != vkMapMemory(device, res.readbackMemory, 0, sizeof(Stats), 0, reinterpret_cast<void**>(&res.readback)))
+            {
+                throw std::runtime_error("Failed to map occlusion stats buffer !");
+            }
+            memset(res.readback, 0, sizeof(Stats));
+
+            // Nothing was visible "last frame": the first frame draws everything late.
+            VkCommandBuffer commandBuffer = Memory::BeginSingleTimeCommands(device, commandPool);
+            Dispatch::Device().CmdFillBuffer(commandBuffer, res.visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+            Memory::EndSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+            const std::vector<VkDescriptorType> cullTypes =
+            {
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            };
+            Descriptors::CreateSetLayout(device, cullTypes, VK_SHADER_STAGE_COMPUTE_BIT, res.cullSetLayout);
+            ComputePipeline::Create(res.cullPipeline, device, res.cullLayout, "OcclusionCull.comp.spv", {objects.setLayout, res.cullSetLayout}, sizeof(CullPushConstants));
+            Descriptors::CreatePool(device, cullTypes, 1, res.cullPool);
+            Descriptors::Allocate(device, res.cullPool, res.cullSetLayout, res.cullSet);
+            Descriptors::WriteBuffer(device, res.cullSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.visibilityBuffer, 0, VK_WHOLE_SIZE);
+            Descriptors::WriteBuffer(device, res.cullSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.earlyDraws, 0, VK_WHOLE_SIZE);
+            Descriptors::WriteBuffer(device, res.cullSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.lateDraws, 0, VK_WHOLE_SIZE);
+            Descriptors::WriteBuffer(device, res.cullSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, res.countersBuffer, 0, VK_WHOLE_SIZE);
+            Descriptors::WriteImage(device, res.cullSet, 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, res.pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+        }
+
+        void Destroy(VkDevice& device, Resources& res)
+        {
+            if (VK_NULL_HANDLE == res.cullPipeline)
+            {
+                return;
+            }
+
+            vkDestroyDescriptorPool(device, res.cullPool, HostMemory::Callbacks());
+            ComputePipeline::Destroy(device, res.cullPipeline, res.cullLayout);
+            vkDestroyDescriptorSetLayout(device, res.cullSetLayout, HostMemory::Callbacks());
+
+            vkUnmapMemory(device, res.readbackMemory);
+            Memory::DestroyBuffer(device, res.readbackBuffer, res.readbackMemory);
+            Memory::DestroyBuffer(device, res.countersBuffer, res.countersMemory);
+            Memory::DestroyBuffer(device, res.lateDraws, res.lateDrawsMemory);
+            Memory::DestroyBuffer(device, res.earlyDraws, res.earlyDrawsMemory);
+            Memory::DestroyBuffer(device, res.visibilityBuffer, res.visibilityMemory);
+
+            vkDestroyDescriptorPool(device, res.reducePool, HostMemory::Callbacks());
+            ComputePipeline::Destroy(device, res.reducePipeline, res.reduceLayout);
+            vkDestroyDescriptorSetLayout(device, res.reduceSetLayout, HostMemory::Callbacks());
+
+            vkDestroySampler(device, res.sampler, HostMemory::Callbacks());
+            for (VkImageView view : res.pyramidMipViews)
+            {
+                vkDestroyImageView(device, view, HostMemory::Callbacks());
+            }
+            vkDestroyImageView(device, res.pyramidView, HostMemory::Callbacks());
+            Memory::DestroyImage(device, res.pyramid, res.pyramidMemory);
+
+            res = {};
+        }
+
+        // Outside any render pass.
+        void Cull(VkCommandBuffer& commandBuffer, Resources& res, Objects::Buffer& objects, Phase phase, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (Phase::First == phase)
+            {
+                Stats reset{};
+                vk.CmdUpdateBuffer(commandBuffer, res.countersBuffer, 0, sizeof(reset), &reset);
+
+                VkMemoryBarrier resetBarrier{};
+                resetBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+            }
+
+            float tanX = 1.0f / projection[0][0];
+            float tanY = 1.0f / std::abs(projection[1][1]);
+
+            CullPushConstants params{};
+            params.view       = view;
+            params.frustum    = glm::vec4(1.0f, tanX, 1.0f, tanY) / glm::vec4(std::sqrt(1.0f + tanX * tanX), std::sqrt(1.0f + tanX * tanX), std::sqrt(1.0f + tanY * tanY), std::sqrt(1.0f + tanY * tanY));
+            params.projection = glm::vec4(projection[0][0], std::abs(projection[1][1]), zNear, zFar);
+            params.info       = glm::uvec4(res.objectCount, static_cast<uint32_t>(phase), res.pyramidWidth, res.pyramidHeight);
+
+            VkDescriptorSet sets[] = {Objects::CurrentSet(objects), res.cullSet};
+            vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.cullPipeline);
+            vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.cullLayout, 0, 2, sets, 0, nullptr);
+            vk.CmdPushConstants(commandBuffer, res.cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+            vk.CmdDispatch(commandBuffer, (res.objectCount + 63) / 64, 1, 1);
+
+            VkMemoryBarrier cullBarrier{};
+            cullBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+            if (Phase::Second == phase)
+            {
+                VkBufferCopy copyRegion{};
+                copyRegion.size = sizeof(Stats);
+                vk.CmdCopyBuffer(commandBuffer, res.countersBuffer, res.readbackBuffer, 1, &copyRegion);
+
+                VkMemoryBarrier hostBarrier{};
+                hostBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+                vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+            }
+        }
+
+        // Between RenderPasses::Phase::First and Second. The depth attachment is
+        // left in DEPTH_STENCIL_READ_ONLY_OPTIMAL by the first pass.
+        void BuildPyramid(VkCommandBuffer& commandBuffer, Resources& res, VkExtent2D& extent)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            // Same layout on both sides, so a memory barrier covers the depth
+            // attachment without caring whether its format carries stencil.
+            VkMemoryBarrier depthBarrier{};
+            depthBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            // Last frame's contents are never read again.
+            VkImageMemoryBarrier pyramidBarrier{};
+            pyramidBarrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            pyramidBarrier.srcAccessMask                   = VK_ACCESS_SHADER_READ_BIT;
+            pyramidBarrier.dstAccessMask                   = VK_ACCESS_SHADER_WRITE_BIT;
+            pyramidBarrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+            pyramidBarrier.newLayout                       = VK_IMAGE_LAYOUT_GENERAL;
+            pyramidBarrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            pyramidBarrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            pyramidBarrier.image                           = res.pyramid;
+            pyramidBarrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            pyramidBarrier.subresourceRange.baseMipLevel   = 0;
+            pyramidBarrier.subresourceRange.levelCount     = res.pyramidLevels;
+            pyramidBarrier.subresourceRange.baseArrayLayer = 0;
+            pyramidBarrier.subresourceRange.layerCount     = 1;
+
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &depthBarrier, 0, nullptr, 1, &pyramidBarrier);
+
+            vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.reducePipeline);
+
+            glm::uvec2 sourceSize(extent.width, extent.height);
+            for (uint32_t level = 0; level < res.pyramidLevels; ++level)
+            {
+                glm::uvec2 destinationSize(std::max(res.pyramidWidth >> level, 1u), std::max(res.pyramidHeight >> level, 1u));
+
+                ReducePushConstants params{};
+                params.sourceSize      = sourceSize;
+                params.destinationSize = destinationSize;
+
+                vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.reduceLayout, 0, 1, &res.reduceSets[level], 0, nullptr);
+                vk.CmdPushConstants(commandBuffer, res.reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+                vk.CmdDispatch(commandBuffer, (destinationSize.x + 15) / 16, (destinationSize.y + 15) / 16, 1);
+
+                VkImageMemoryBarrier levelBarrier{};
+                levelBarrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                levelBarrier.srcAccessMask                   = VK_ACCESS_SHADER_WRITE_BIT;
+                levelBarrier.dstAccessMask                   = VK_ACCESS_SHADER_READ_BIT;
+                levelBarrier.oldLayout                       = VK_IMAGE_LAYOUT_GENERAL;
+                levelBarrier.newLayout                       = VK_IMAGE_LAYOUT_GENERAL;
+                levelBarrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+                levelBarrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+                levelBarrier.image                           = res.pyramid;
+                levelBarrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+                levelBarrier.subresourceRange.baseMipLevel   = level;
+                levelBarrier.subresourceRange.levelCount     = 1;
+                levelBarrier.subresourceRange.baseArrayLayer = 0;
+                levelBarrier.subresourceRange.layerCount     = 1;
+
+                vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+                sourceSize = destinationSize;
+            }
+        }
+
+        // Inside the render pass with the mesh pipeline and object set bound.
+        void Draw(VkCommandBuffer& commandBuffer, Resources& res, Mesh::Gpu& mesh, Phase phase)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            VkBuffer draws = Phase::First == phase ? res.earlyDraws : res.lateDraws;
+            VkDeviceSize vertexOffset = mesh.vertexOffset;
+
+            vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.buffer, &vertexOffset);
+            vk.CmdBindIndexBuffer(commandBuffer, mesh.buffer, mesh.indexOffset, mesh.indexType);
+
+            if (res.multiDraw)
+            {
+                vk.CmdDrawIndexedIndirect(commandBuffer, draws, 0, res.objectCount, sizeof(VkDrawIndexedIndirectCommand));
+                return;
+            }
+
+            for (uint32_t i = 0; i < res.objectCount; ++i)
+            {
+                vk.CmdDrawIndexedIndirect(commandBuffer, draws, sizeof(VkDrawIndexedIndirectCommand) * i, 1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+
+        // Only valid once the frame that recorded the culling has signalled its fence.
+        void ReadStats(Resources& res, Stats& stats)
+        {
+            stats = *res.readback;
+        }
+    }
+}
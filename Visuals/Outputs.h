@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include "Device.h"
+#include "Dispatch.h"
+#include "HostMemory.h"
+#include "Retire.h"
+#include "Surface.h"
+#include "SwapChain.h"
+#include "Window.h"
+
+namespace Visuals
+{
+    namespace Outputs
+    {
+        /* Extra windows on the main window's device. Each has its own surface,
+        swapchain and framebuffers; the render pass, pipelines, depth and
+        MSAA targets are the main window's, so every swapchain has to match
+        its format and size. All of them are drawn by the one command buffer
+        and presented by the one vkQueuePresentKHR of the frame. An output
+        that is minimized, not ready or cannot be rebuilt yet sits frames
+        out instead of holding up the main window. */
+
+        const uint64_t kAcquireTimeout = 1000000; // 1 ms
+
+        struct Output
+        {
+            GLFWwindow*                window     = nullptr;
+            VkSurfaceKHR               surface    = VK_NULL_HANDLE;
+            VkSwapchainKHR             swapChain  = VK_NULL_HANDLE;
+            std::vector<VkImage>       images;
+            std::vector<VkImageView>   views;
+            std::vector<VkFramebuffer> framebuffers;
+            VkFormat                   format     = VK_FORMAT_UNDEFINED;
+            VkExtent2D                 extent     = {0, 0};
+            VkSemaphore                imageAvailable = VK_NULL_HANDLE;
+            uint32_t                   imageIndex = 0;
+            bool                       acquired   = false; // render thread, this frame
+            bool                       stale      = false; // render thread, out of date and not rebuilt yet
+        };
+
+        // Main thread, GLFW.
+        void CreateWindow(Output& output, uint32_t width, uint32_t height, const char* name)
+        {
+            Window::Create(output.window, width, height, name);
+        }
+
+        void CreateSurface(VkInstance& instance, Output& output)
+        {
+            Surface::Create(output.window, instance, output.surface);
+        }
+
+        static void CreateTargets(VkDevice& device, Output& output, VkRenderPass& renderPass, VkImageView& depthImageView, VkImageView colorImageView)
+        {
+            ImageViews::Create(device, output.views, output.images, output.format);
+            Buffers::Create(device, output.framebuffers, output.views, depthImageView, renderPass, output.extent, colorImageView);
+        }
+
+        static void CheckMatches(const Output& output, VkFormat format, VkExtent2D extent)
+        {
+            if (format != output.format || extent.width != output.extent.width || extent.height != output.extent.height)
+            {
+                throw std::runtime_error("Extra window swap chain does not match the main window's format and size !");
+            }
+        }
+
+        /* After the main swapchain, render pass and targets. The output has to
+        present from the main window's present queue. */
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkSurfaceKHR& mainSurface, Output& output, VkFormat format, VkExtent2D extent, VkRenderPass& renderPass, VkImageView& depthImageView, VkImageView colorImageView)
+        {
+            PhysicalDevice::QueueFamilyIndices main  = PhysicalDevice::FindQueueFamilies(physicalDevice, mainSurface);
+            PhysicalDevice::QueueFamilyIndices extra = PhysicalDevice::FindQueueFamilies(physicalDevice, output.surface);
+            if (!extra.presentFamily.has_value() || extra.presentFamily.value() != main.presentFamily.value())
+            {
+                throw std::runtime_error("Extra window cannot present from the main window's queue !");
+            }
+
+            SwapChain::Create(output.swapChain, physicalDevice, device, output.surface, Window::FramebufferSize(output.window), output.images, output.format, output.extent);
+            CheckMatches(output, format, extent);
+            CreateTargets(device, output, renderPass, depthImageView, colorImageView);
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, HostMemory::Callbacks(), &output.imageAvailable))
+            {
+                throw std::runtime_error("Failed to create semaphores !");
+            }
+        }
+
+        /* Render thread, after the main window's acquire. False when the
+        swapchain is out of date. Without an image within kAcquireTimeout
+        it returns true with acquired unset; either way the output sits
+        this frame out. */
+        bool Acquire(VkDevice& device, Output& output)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            output.acquired = false;
+            VkResult result = vk.AcquireNextImageKHR(device, output.swapChain, kAcquireTimeout, output.imageAvailable, VK_NULL_HANDLE, &output.imageIndex);
+            if (VK_ERROR_OUT_OF_DATE_KHR == result)
+            {
+                return false;
+            }
+            if (VK_TIMEOUT == result || VK_NOT_READY == result)
+            {
+                return true;
+            }
+            if (VK_SUCCESS != result && VK_SUBOPTIMAL_KHR != result)
+            {
+                throw std::runtime_error("Failed to acquire swap chain image !");
+            }
+
+            output.acquired = true;
+            return true;
+        }
+
+        /* Like Visuals::RecreateSwapChain, framebufferSize read on the main
+        thread. False while the window is minimized, stale stays set and
+        the caller tries again on a later frame. */
+        bool Recreate(VkDevice& device, VkPhysicalDevice& physicalDevice, Output& output, VkExtent2D framebufferSize, Retire::Queue& retire, VkRenderPass& renderPass, VkImageView& depthImageView, VkImageView colorImageView)
+        {
+            output.stale = true;
+            SwapChain::SupportDetails support = SwapChain::QuerySupport(physicalDevice, output.surface);
+            if (0 == support.capabilities.currentExtent.width || 0 == support.capabilities.currentExtent.height)
+            {
+                return false;
+            }
+
+            VkSwapchainKHR oldSwapChain = output.swapChain;
+            VkFormat       format       = output.format;
+            VkExtent2D     extent       = output.extent;
+            SwapChain::Create(output.swapChain, physicalDevice, device, output.surface, framebufferSize, output.images, output.format, output.extent, oldSwapChain);
+            CheckMatches(output, format, extent);
+
+            Retire::SwapChain(retire, oldSwapChain);
+            Retire::ImageViews(retire, output.views);
+            Retire::Framebuffers(retire, output.framebuffers);
+            CreateTargets(device, output, renderPass, depthImageView, colorImageView);
+            output.stale = false;
+            return true;
+        }
+
+        // Device idle; the window last, on the main thread.
+        void Destroy(VkDevice& device, VkInstance& instance, Output& output)
+        {
+            if (VK_NULL_HANDLE != output.imageAvailable)
+            {
+                vkDestroySemaphore(device, output.imageAvailable, HostMemory::Callbacks());
+            }
+            Buffers::Destroy(device, output.framebuffers);
+            ImageViews::Destroy(device, output.views);
+            if (VK_NULL_HANDLE != output.swapChain)
+            {
+                SwapChain::Destroy(output.swapChain, device);
+            }
+            Surface::Destroy(instance, output.surface);
+            Window::Destroy(output.window);
+            output = Output{};
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace PipelineCache
+    {
+        /* One VkPipelineCache for every pipeline the app builds, saved at
+        exit and fed back in at the next start so the driver can skip
+        compiling what it has seen before. Reading the file does not need
+        the device and runs beside instance creation. */
+
+        const char* const kPath = "sky.pipelinecache";
+
+        // VK_NULL_HANDLE until Create, pipelines are then built without a cache.
+        VkPipelineCache& Handle()
+        {
+            static VkPipelineCache cache = VK_NULL_HANDLE;
+            return cache;
+        }
+
+        // A missing file leaves data empty.
+        void Read(const char* path, std::vector<char>& data)
+        {
+            std::ifstream file(path, std::ios::ate | std::ios::binary);
+            if (!file.is_open())
+            {
+                data.clear();
+                return;
+            }
+
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+        }
+
+        // Data saved by another driver or GPU is dropped rather than handed to this one.
+        static bool Matches(VkPhysicalDevice& physicalDevice, const std::vector<char>& data)
+        {
+            if (data.size() < 16 + VK_UUID_SIZE)
+            {
+                return false;
+            }
+
+            uint32_t header[4];
+            memcpy(header, data.data(), sizeof(header));
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            return VK_PIPELINE_CACHE_HEADER_VERSION_ONE == header[1] && properties.vendorID == header[2] && properties.deviceID == header[3]
+                && 0 == memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        }
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, const std::vector<char>& data)
+        {
+            bool usable = Matches(physicalDevice, data);
+
+            VkPipelineCacheCreateInfo createInfo{};
+            createInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            createInfo.initialDataSize = usable ? data.size() : 0;
+            createInfo.pInitialData    = usable ? data.data() : nullptr;
+
+            if (VK_SUCCESS != vkCreatePipelineCache(device, &createInfo, HostMemory::Callbacks(), &Handle()))
+            {
+                throw std::runtime_error("Failed to create pipeline cache !");
+            }
+        }
+
+        void Save(VkDevice& device, const char* path)
+        {
+            if (VK_NULL_HANDLE == Handle())
+            {
+                return;
+            }
+
+            size_t size = 0;
+            vkGetPipelineCacheData(device, Handle(), &size, nullptr);
+            std::vector<char> data(size);
+            if (VK_SUCCESS != vkGetPipelineCacheData(device, Handle(), &size, data.data()))
+            {
+                return;
+            }
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), size);
+        }
+
+        void Destroy(VkDevice& device)
+        {
+            if (VK_NULL_HANDLE != Handle())
+            {
+                vkDestroyPipelineCache(device, Handle(), HostMemory::Callbacks());
+                Handle() = VK_NULL_HANDLE;
+            }
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace PipelineStats
+    {
+        /* One pipeline statistics query per pass of a frame, read back once
+        the frame's fence has been waited on. Queries of one type cannot
+        nest, so the frame total is the sum of its passes, and anything
+        recorded outside a pass (compute culling, post) is not counted.
+        Without the pipelineStatisticsQuery feature the pool stays null and
+        every call is a no-op.
+
+        Overdraw is fragment invocations over the pass's pixels; the
+        Overdraw mesh view shows the same thing per pixel. */
+
+        const uint32_t kMaxPasses = 16; // passes past this are not counted
+
+        // In the order Vulkan writes them, lowest flag bit first.
+        struct Counters
+        {
+            uint64_t inputVertices       = 0;
+            uint64_t vertexInvocations   = 0;
+            uint64_t clippingPrimitives  = 0;
+            uint64_t fragmentInvocations = 0;
+        };
+
+        const VkQueryPipelineStatisticFlags kFlags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+        struct Pass
+        {
+            const char* name   = "";
+            VkExtent2D  extent = {0, 0};
+            Counters    counters;
+        };
+
+        // What Read hands back for the last frame.
+        struct Frame
+        {
+            uint32_t passCount = 0;
+            Pass     passes[kMaxPasses];
+            Counters total;
+        };
+
+        struct Resources
+        {
+            VkQueryPool pool     = VK_NULL_HANDLE;
+            uint32_t    passes   = 0;     // begun this frame
+            bool        open     = false; // BeginPass without EndPass yet
+            bool        recorded = false; // a frame was ended since the last Read
+            Pass        layout[kMaxPasses]; // names and extents, counters filled by Read
+        };
+
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, Resources& stats)
+        {
+            VkPhysicalDeviceFeatures features;
+            vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+            if (VK_TRUE != features.pipelineStatisticsQuery)
+            {
+                return;
+            }
+
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount         = kMaxPasses;
+            poolInfo.pipelineStatistics = kFlags;
+
+            if (VK_SUCCESS != vkCreateQueryPool(device, &poolInfo, HostMemory::Callbacks(), &stats.pool))
+            {
+                throw std::runtime_error("Failed to create pipeline statistics query pool !");
+            }
+        }
+
+        // Start of the frame, outside a render pass: the reset is not allowed inside one.
+        void Begin(VkCommandBuffer& commandBuffer, Resources& stats)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (VK_NULL_HANDLE == stats.pool)
+            {
+                return;
+            }
+
+            vk.CmdResetQueryPool(commandBuffer, stats.pool, 0, kMaxPasses);
+            stats.passes = 0;
+        }
+
+        // Right before vkCmdBeginRenderPass. name must outlive the frame, a literal.
+        void BeginPass(VkCommandBuffer& commandBuffer, Resources& stats, const char* name, VkExtent2D extent)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (VK_NULL_HANDLE == stats.pool || stats.passes >= kMaxPasses)
+            {
+                return;
+            }
+
+            stats.layout[stats.passes].name   = name;
+            stats.layout[stats.passes].extent = extent;
+            vk.CmdBeginQuery(commandBuffer, stats.pool, stats.passes, 0);
+            stats.open = true;
+        }
+
+        // Right after vkCmdEndRenderPass.
+        void EndPass(VkCommandBuffer& commandBuffer, Resources& stats)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (!stats.open)
+            {
+                return;
+            }
+
+            vk.CmdEndQuery(commandBuffer, stats.pool, stats.passes);
+            stats.passes++;
+            stats.open = false;
+        }
+
+        void End(VkCommandBuffer& commandBuffer, Resources& stats)
+        {
+            if (VK_NULL_HANDLE == stats.pool)
+            {
+                return;
+            }
+
+            stats.recorded = true;
+        }
+
+        // Only once the fence of the recording frame has signaled.
+        bool Read(VkDevice& device, Resources& stats, Frame& frame)
+        {
+            if (VK_NULL_HANDLE == stats.pool || !stats.recorded)
+            {
+                return false;
+            }
+
+            stats.recorded = false;
+            if (0 == stats.passes)
+            {
+                frame = Frame{};
+                return true;
+            }
+
+            Counters counters[kMaxPasses];
+            if (VK_SUCCESS != vkGetQueryPoolResults(device, stats.pool, 0, stats.passes, sizeof(counters), counters, sizeof(Counters), VK_QUERY_RESULT_64_BIT))
+            {
+                return false;
+            }
+
+            frame.passCount = stats.passes;
+            frame.total     = Counters{};
+            for (uint32_t i = 0; i < stats.passes; ++i)
+            {
+                frame.passes[i]          = stats.layout[i];
+                frame.passes[i].counters = counters[i];
+
+                frame.total.inputVertices       += counters[i].inputVertices;
+                frame.total.vertexInvocations   += counters[i].vertexInvocations;
+                frame.total.clippingPrimitives  += counters[i].clippingPrimitives;
+                frame.total.fragmentInvocations += counters[i].fragmentInvocations;
+            }
+            return true;
+        }
+
+        // Fragments shaded per pixel of the pass, 1 is no overdraw.
+        double Overdraw(const Pass& pass)
+        {
+            uint64_t pixels = uint64_t(pass.extent.width) * pass.extent.height;
+            return pixels > 0 ? static_cast<double>(pass.counters.fragmentInvocations) / pixels : 0.0;
+        }
+
+        void Destroy(VkDevice& device, Resources& stats)
+        {
+            if (VK_NULL_HANDLE != stats.pool)
+            {
+                vkDestroyQueryPool(device, stats.pool, HostMemory::Callbacks());
+            }
+
+            stats = {};
+        }
+    }
+}
@@ -0,0 +1,617 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "ComputePipeline.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "Dispatch.h"
+#include "GraphicsPipeline.h"
+#include "Memory.h"
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Post
+    {
+        /* COMPUTE POST CHAIN, pipelined one frame behind the scene:
+
+        graphics  | scene k   -> target[k % 2] | blit output(k - 1) -> swapchain, present
+        compute   |   chain k - 1 on target[(k - 1) % 2] -> output |  chain k ...
+
+        The scene renders into a half float target. The chain then builds
+        a bloom pyramid (bright pass, downsample, tent upsample), tonemaps
+        scene plus bloom, grades it and writes output. That runs on a
+        dedicated compute queue when the device has one, while the graphics
+        queue draws the next frame into the other target. Graphics waits for
+        the chain at TRANSFER only, just before the blit, so the geometry of
+        frame k overlaps the chain of frame k - 1.
+
+        sceneDone (graphics -> compute) and postDone (compute -> graphics)
+        are binary semaphores, each signaled and waited once per frame.
+        Everything the chain reads or writes is shared CONCURRENT between
+        the two families. Present lags the scene by one frame, the usual
+        price of async compute.
+
+        Timestamps on both queues measure how much of the chain hid behind
+        the scene. Setting serial puts the same chain on the graphics queue
+        for comparison.
+        */
+
+        const VkFormat kFormat      = VK_FORMAT_R16G16B16A16_SFLOAT;
+        const uint32_t kFrames      = 2;
+        const uint32_t kBloomLevels = 5;
+
+        // Mirrors the push constant block of the three post shaders.
+        struct PushConstants
+        {
+            glm::uvec4 size;   // destination width, height, bright pass
+            glm::vec4  params; // downsample / upsample: source texel size, threshold, knee
+                               // tonemap: exposure, contrast, saturation, bloom strength
+            glm::vec4  tint;
+        };
+
+        struct Grading
+        {
+            float     threshold  = 0.8f;
+            float     knee       = 0.4f;
+            float     exposure   = 1.0f;
+            float     contrast   = 1.05f;
+            float     saturation = 1.1f;
+            float     bloom      = 0.06f;
+            glm::vec4 tint{1.0f, 0.98f, 0.95f, 1.0f};
+        };
+
+        // Averages over the frames since the last Reset, all in milliseconds.
+        struct Timings
+        {
+            double   sceneMs   = 0.0;
+            double   chainMs   = 0.0;
+            double   overlapMs = 0.0;
+            uint32_t frames    = 0;
+        };
+
+        struct Resources
+        {
+            VkImage                      targets[kFrames]       = {};
+            VkDeviceMemory               targetMemory[kFrames]  = {};
+            VkImageView                  targetViews[kFrames]   = {};
+            VkFramebuffer                framebuffers[kFrames]  = {};
+            VkRenderPass                 renderPass             = VK_NULL_HANDLE;
+
+            VkImage                      bloom                  = VK_NULL_HANDLE;
+            VkDeviceMemory               bloomMemory            = VK_NULL_HANDLE;
+            std::vector<VkImageView>     bloomViews;
+            std::vector<VkExtent2D>      bloomExtents;
+            VkImage                      output                 = VK_NULL_HANDLE;
+            VkDeviceMemory               outputMemory           = VK_NULL_HANDLE;
+            VkImageView                  outputView             = VK_NULL_HANDLE;
+            VkSampler                    sampler                = VK_NULL_HANDLE;
+
+            VkDescriptorSetLayout        sampleSetLayout        = VK_NULL_HANDLE;
+            VkDescriptorSetLayout        tonemapSetLayout       = VK_NULL_HANDLE;
+            VkPipelineLayout             downsampleLayout       = VK_NULL_HANDLE;
+            VkPipelineLayout             upsampleLayout         = VK_NULL_HANDLE;
+            VkPipelineLayout             tonemapLayout          = VK_NULL_HANDLE;
+            VkPipeline                   downsamplePipeline     = VK_NULL_HANDLE;
+            VkPipeline                   upsamplePipeline       = VK_NULL_HANDLE;
+            VkPipeline                   tonemapPipeline        = VK_NULL_HANDLE;
+            VkDescriptorPool             samplePool             = VK_NULL_HANDLE;
+            VkDescriptorPool             tonemapPool            = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> downsampleSets;        // [frame * levels + level]
+            std::vector<VkDescriptorSet> upsampleSets;          // [level], reads level + 1
+            VkDescriptorSet              tonemapSets[kFrames]   = {};
+
+            // [0] records for the compute queue, [1] for the graphics queue.
+            VkCommandPool                pools[2]               = {};
+            VkCommandBuffer              chains[2][kFrames]     = {};
+            VkSemaphore                  sceneDone              = VK_NULL_HANDLE;
+            VkSemaphore                  postDone               = VK_NULL_HANDLE;
+            bool                         async                  = false; // a dedicated compute queue exists
+            bool                         serial                 = false; // run the chain on the graphics queue
+
+            // Queries 0, 1 time the scene, 2 + 2 * frame and 3 + 2 * frame the chain.
+            VkQueryPool                  timestamps             = VK_NULL_HANDLE;
+            double                       period                 = 1.0; // ns per tick
+            Timings                      timings;
+
+            std::vector<VkImage>         swapChainImages;
+            VkExtent2D                   extent{};
+            Grading                      grading;
+            uint32_t                     frame                  = 0; // target the next scene renders into
+            uint64_t                     submitted              = 0;
+        };
+
+        // Blit support is only needed on the swapchain side, the rest are required formats.
+        bool Supported(VkPhysicalDevice& physicalDevice, VkFormat swapChainImageFormat)
+        {
+            VkFormatProperties format;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &format);
+
+            return 0 != (format.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+        }
+
+        static void Barrier(VkCommandBuffer& commandBuffer)
+        {
+            VkMemoryBarrier barrier{};
+            barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        static void DispatchPass(VkCommandBuffer& commandBuffer, VkPipelineLayout layout, VkDescriptorSet set, const PushConstants& push)
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkCmdDispatch(commandBuffer, (push.size.x + 7) / 8, (push.size.y + 7) / 8, 1);
+        }
+
+        // The whole chain for one target; it never changes, so it is recorded once.
+        static void RecordChain(VkCommandBuffer& commandBuffer, Resources& res, uint32_t frame)
+        {
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+            if (VK_SUCCESS != vkBeginCommandBuffer(commandBuffer, &beginInfo))
+            {
+                throw std::runtime_error("Failed to begin recording post command buffer !");
+            }
+
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vkCmdResetQueryPool(commandBuffer, res.timestamps, 2 + 2 * frame, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, res.timestamps, 2 + 2 * frame);
+            }
+
+            uint32_t levels = static_cast<uint32_t>(res.bloomViews.size());
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.downsamplePipeline);
+            VkExtent2D source = res.extent;
+            for (uint32_t level = 0; level < levels; ++level)
+            {
+                PushConstants push{};
+                push.size   = glm::uvec4(res.bloomExtents[level].width, res.bloomExtents[level].height, 0 == level ? 1 : 0, 0);
+                push.params = glm::vec4(1.0f / source.width, 1.0f / source.height, res.grading.threshold, res.grading.knee);
+
+                DispatchPass(commandBuffer, res.downsampleLayout, res.downsampleSets[frame * levels + level], push);
+                Barrier(commandBuffer);
+                source = res.bloomExtents[level];
+            }
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.upsamplePipeline);
+            for (uint32_t level = levels - 1; level-- > 0;)
+            {
+                PushConstants push{};
+                push.size   = glm::uvec4(res.bloomExtents[level].width, res.bloomExtents[level].height, 0, 0);
+                push.params = glm::vec4(1.0f / res.bloomExtents[level + 1].width, 1.0f / res.bloomExtents[level + 1].height, 0.0f, 0.0f);
+
+                DispatchPass(commandBuffer, res.upsampleLayout, res.upsampleSets[level], push);
+                Barrier(commandBuffer);
+            }
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, res.tonemapPipeline);
+            PushConstants push{};
+            push.size   = glm::uvec4(res.extent.width, res.extent.height, 0, 0);
+            push.params = glm::vec4(res.grading.exposure, res.grading.contrast, res.grading.saturation, res.grading.bloom);
+            push.tint   = res.grading.tint;
+            DispatchPass(commandBuffer, res.tonemapLayout, res.tonemapSets[frame], push);
+
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, res.timestamps, 3 + 2 * frame);
+            }
+
+            if (VK_SUCCESS != vkEndCommandBuffer(commandBuffer))
+            {
+                throw std::runtime_error("Failed to record post command buffer !");
+            }
+        }
+
+        static void CreateImages(VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool& commandPool, VkQueue& graphicsQueue, const std::vector<uint32_t>& families, Resources& res)
+        {
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                Memory::CreateImage(device, physicalDevice, res.extent.width, res.extent.height, 1, kFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.targets[frame], res.targetMemory[frame], VK_SAMPLE_COUNT_1_BIT, families);
+                Memory::CreateImageView(device, res.targets[frame], kFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, res.targetViews[frame]);
+            }
+
+            // Half resolution down to where a level would drop below 4 texels.
+            VkExtent2D level{std::max(1u, res.extent.width / 2), std::max(1u, res.extent.height / 2)};
+            while (res.bloomExtents.size() < kBloomLevels && (res.bloomExtents.empty() || std::min(level.width, level.height) >= 4))
+            {
+                res.bloomExtents.push_back(level);
+                level = {std::max(1u, level.width / 2), std::max(1u, level.height / 2)};
+            }
+
+            uint32_t levels = static_cast<uint32_t>(res.bloomExtents.size());
+            Memory::CreateImage(device, physicalDevice, res.bloomExtents[0].width, res.bloomExtents[0].height, levels, kFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.bloom, res.bloomMemory, VK_SAMPLE_COUNT_1_BIT, families);
+
+            res.bloomViews.resize(levels);
+            for (uint32_t i = 0; i < levels; ++i)
+            {
+                Memory::CreateImageView(device, res.bloom, kFormat, VK_IMAGE_ASPECT_COLOR_BIT, i, 1, res.bloomViews[i]);
+            }
+
+            Memory::CreateImage(device, physicalDevice, res.extent.width, res.extent.height, 1, kFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.output, res.outputMemory, VK_SAMPLE_COUNT_1_BIT, families);
+            Memory::CreateImageView(device, res.output, kFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, res.outputView);
+
+            VkSamplerCreateInfo samplerInfo{};
+            samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter    = VK_FILTER_LINEAR;
+            samplerInfo.minFilter    = VK_FILTER_LINEAR;
+            samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.minLod       = 0.0f;
+            samplerInfo.maxLod       = 0.0f;
+
+            if (VK_SUCCESS != vkCreateSampler(device, &samplerInfo, HostMemory::Callbacks(), &res.sampler))
+            {
+                throw std::runtime_error("Failed to create post sampler !");
+            }
+
+            // Bloom and output stay in GENERAL for good. The output starts black,
+            // it is blitted once before the first chain has run.
+            VkImageMemoryBarrier barriers[2]{};
+            VkImage images[] = {res.bloom, res.output};
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                barriers[i].sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barriers[i].srcAccessMask                   = 0;
+                barriers[i].dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[i].oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+                barriers[i].newLayout                       = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[i].srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].image                           = images[i];
+                barriers[i].subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+                barriers[i].subresourceRange.baseMipLevel   = 0;
+                barriers[i].subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+                barriers[i].subresourceRange.baseArrayLayer = 0;
+                barriers[i].subresourceRange.layerCount     = 1;
+            }
+
+            VkCommandBuffer commandBuffer = Memory::BeginSingleTimeCommands(device, commandPool);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+            VkClearColorValue black{{0.0f, 0.0f, 0.0f, 1.0f}};
+            VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            vkCmdClearColorImage(commandBuffer, res.output, VK_IMAGE_LAYOUT_GENERAL, &black, 1, &range);
+            Memory::EndSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
+        }
+
+        static void CreatePipelines(VkDevice& device, Resources& res)
+        {
+            uint32_t levels = static_cast<uint32_t>(res.bloomViews.size());
+
+            const std::vector<VkDescriptorType> sampleTypes  = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+            const std::vector<VkDescriptorType> tonemapTypes = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+            Descriptors::CreateSetLayout(device, sampleTypes, VK_SHADER_STAGE_COMPUTE_BIT, res.sampleSetLayout);
+            Descriptors::CreateSetLayout(device, tonemapTypes, VK_SHADER_STAGE_COMPUTE_BIT, res.tonemapSetLayout);
+
+            ComputePipeline::Create(res.downsamplePipeline, device, res.downsampleLayout, "BloomDownsample.comp.spv", {res.sampleSetLayout}, sizeof(PushConstants));
+            ComputePipeline::Create(res.upsamplePipeline, device, res.upsampleLayout, "BloomUpsample.comp.spv", {res.sampleSetLayout}, sizeof(PushConstants));
+            ComputePipeline::Create(res.tonemapPipeline, device, res.tonemapLayout, "Tonemap.comp.spv", {res.tonemapSetLayout}, sizeof(PushConstants));
+
+            Descriptors::CreatePool(device, sampleTypes, kFrames * levels + levels - 1, res.samplePool);
+            Descriptors::CreatePool(device, tonemapTypes, kFrames, res.tonemapPool);
+
+            // Downsample level 0 reads the scene target, every other level the one above it.
+            res.downsampleSets.resize(kFrames * levels);
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                for (uint32_t level = 0; level < levels; ++level)
+                {
+                    VkDescriptorSet& set    = res.downsampleSets[frame * levels + level];
+                    VkImageView      source = 0 == level ? res.targetViews[frame] : res.bloomViews[level - 1];
+                    VkImageLayout    layout = 0 == level ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+                    Descriptors::Allocate(device, res.samplePool, res.sampleSetLayout, set);
+                    Descriptors::WriteImage(device, set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, source, layout);
+                    Descriptors::WriteImage(device, set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, res.bloomViews[level], VK_IMAGE_LAYOUT_GENERAL);
+                }
+
+                Descriptors::Allocate(device, res.tonemapPool, res.tonemapSetLayout, res.tonemapSets[frame]);
+                Descriptors::WriteImage(device, res.tonemapSets[frame], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, res.targetViews[frame], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                Descriptors::WriteImage(device, res.tonemapSets[frame], 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, res.bloomViews[0], VK_IMAGE_LAYOUT_GENERAL);
+                Descriptors::WriteImage(device, res.tonemapSets[frame], 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, res.outputView, VK_IMAGE_LAYOUT_GENERAL);
+            }
+
+            res.upsampleSets.resize(levels - 1);
+            for (uint32_t level = 0; level + 1 < levels; ++level)
+            {
+                Descriptors::Allocate(device, res.samplePool, res.sampleSetLayout, res.upsampleSets[level]);
+                Descriptors::WriteImage(device, res.upsampleSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, res.sampler, res.bloomViews[level + 1], VK_IMAGE_LAYOUT_GENERAL);
+                Descriptors::WriteImage(device, res.upsampleSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, res.bloomViews[level], VK_IMAGE_LAYOUT_GENERAL);
+            }
+        }
+
+        /* samples, depthImageView and colorImageView are those the swapchain
+        framebuffers were built with, colorImageView null without MSAA. The
+        scene pass and the main render pass must have been created with kFormat. */
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkCommandPool& commandPool, VkQueue& graphicsQueue, std::vector<VkImage>& swapChainImages, VkExtent2D& swapChainExtent, VkFormat& depthFormat, VkSampleCountFlagBits samples, VkImageView& depthImageView, VkImageView colorImageView, Resources& res)
+        {
+            PhysicalDevice::QueueFamilyIndices indices = PhysicalDevice::FindQueueFamilies(physicalDevice, surface);
+            uint32_t graphicsFamily = indices.graphicsFamily.value();
+            uint32_t computeFamily  = indices.computeFamily.value_or(graphicsFamily);
+
+            res.async           = computeFamily != graphicsFamily;
+            res.swapChainImages = swapChainImages;
+            res.extent          = swapChainExtent;
+
+            std::vector<uint32_t> families = {graphicsFamily};
+            if (res.async)
+            {
+                families.push_back(computeFamily);
+            }
+
+            CreateImages(device, physicalDevice, commandPool, graphicsQueue, families, res);
+
+            VkFormat format = kFormat;
+            RenderPasses::Create(device, res.renderPass, format, depthFormat, RenderPasses::Phase::Post, samples);
+
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                // Same attachment order as Buffers::Create, the target standing in for the swapchain image.
+                bool        multisampled  = VK_NULL_HANDLE != colorImageView;
+                VkImageView attachments[] = {multisampled ? colorImageView : res.targetViews[frame], depthImageView, res.targetViews[frame]};
+
+                VkFramebufferCreateInfo framebufferInfo{};
+                framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebufferInfo.renderPass      = res.renderPass;
+                framebufferInfo.attachmentCount = multisampled ? 3 : 2;
+                framebufferInfo.pAttachments    = attachments;
+                framebufferInfo.width           = res.extent.width;
+                framebufferInfo.height          = res.extent.height;
+                framebufferInfo.layers          = 1;
+
+                if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferInfo, HostMemory::Callbacks(), &res.framebuffers[frame]))
+                {
+                    throw std::runtime_error("Failed to create framebuffer !");
+                }
+            }
+
+            CreatePipelines(device, res);
+
+            // Timing needs timestamps on both queues.
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            res.period = properties.limits.timestampPeriod;
+
+            if (VK_TRUE == properties.limits.timestampComputeAndGraphics)
+            {
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+                poolInfo.queryCount = 2 + 2 * kFrames;
+
+                if (VK_SUCCESS != vkCreateQueryPool(device, &poolInfo, HostMemory::Callbacks(), &res.timestamps))
+                {
+                    throw std::runtime_error("Failed to create timestamp query pool !");
+                }
+            }
+
+            uint32_t poolFamilies[] = {computeFamily, graphicsFamily};
+            for (uint32_t queue = 0; queue < 2; ++queue)
+            {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.queueFamilyIndex = poolFamilies[queue];
+
+                if (VK_SUCCESS != vkCreateCommandPool(device, &poolInfo, HostMemory::Callbacks(), &res.pools[queue]))
+                {
+                    throw std::runtime_error("Failed to create post command pool !");
+                }
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool        = res.pools[queue];
+                allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = kFrames;
+
+                if (VK_SUCCESS != vkAllocateCommandBuffers(device, &allocInfo, res.chains[queue]))
+                {
+                    throw std::runtime_error("Failed to allocate post command buffers !");
+                }
+
+                for (uint32_t frame = 0; frame < kFrames; ++frame)
+                {
+                    RecordChain(res.chains[queue][frame], res, frame);
+                }
+            }
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            if (VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, HostMemory::Callbacks(), &res.sceneDone) ||
+                VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, HostMemory::Callbacks(), &res.postDone))
+            {
+                throw std::runtime_error("Failed to create post semaphores !");
+            }
+        }
+
+        // First thing in the frame's graphics command buffer.
+        void Begin(VkCommandBuffer& commandBuffer, Resources& res)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vk.CmdResetQueryPool(commandBuffer, res.timestamps, 0, 2);
+                vk.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, res.timestamps, 0);
+            }
+        }
+
+        /* After the scene pass: puts the previous frame's output on the
+        swapchain image. Submit holds this back until that chain is done. */
+        void Composite(VkCommandBuffer& commandBuffer, Resources& res, uint32_t imageIndex)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vk.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, res.timestamps, 1);
+            }
+
+            Memory::BlitToPresent(commandBuffer, res.output, VK_IMAGE_LAYOUT_GENERAL, res.extent, res.swapChainImages[imageIndex], res.extent, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+
+        /* Replaces Draw::Submit. The graphics batch waits for the image and the
+        previous chain at TRANSFER only, so its scene pass starts right away,
+        then the chain of this frame goes to the compute queue. Returns false
+        like Draw::Submit. */
+        bool Submit(Resources& res, VkFence& inFlightFence, VkSwapchainKHR& swapChain, VkSemaphore& imageAvailableSemaphore, VkCommandBuffer& commandBuffer, VkSemaphore& renderFinishedSemaphore, VkQueue& graphicsQueue, VkQueue& computeQueue, VkQueue& presentQueue, uint32_t imageIndex)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            VkSemaphore          waitSemaphores[]   = {imageAvailableSemaphore, res.postDone};
+            VkPipelineStageFlags waitStages[]       = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT};
+            VkSemaphore          signalSemaphores[] = {renderFinishedSemaphore, res.sceneDone};
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount   = res.submitted > 0 ? 2 : 1;
+            submitInfo.pWaitSemaphores      = waitSemaphores;
+            submitInfo.pWaitDstStageMask    = waitStages;
+            submitInfo.commandBufferCount   = 1;
+            submitInfo.pCommandBuffers      = &commandBuffer;
+            submitInfo.signalSemaphoreCount = 2;
+            submitInfo.pSignalSemaphores    = signalSemaphores;
+
+            if (VK_SUCCESS != vk.QueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence))
+            {
+                throw std::runtime_error("Failed to submit draw command buffer !");
+            }
+
+            bool                 serial     = res.serial || !res.async;
+            VkQueue&             queue      = serial ? graphicsQueue : computeQueue;
+            VkPipelineStageFlags chainStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+            VkSubmitInfo chainInfo{};
+            chainInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            chainInfo.waitSemaphoreCount   = 1;
+            chainInfo.pWaitSemaphores      = &res.sceneDone;
+            chainInfo.pWaitDstStageMask    = &chainStage;
+            chainInfo.commandBufferCount   = 1;
+            chainInfo.pCommandBuffers      = &res.chains[serial ? 1 : 0][res.frame];
+            chainInfo.signalSemaphoreCount = 1;
+            chainInfo.pSignalSemaphores    = &res.postDone;
+
+            if (VK_SUCCESS != vk.QueueSubmit(queue, 1, &chainInfo, VK_NULL_HANDLE))
+            {
+                throw std::runtime_error("Failed to submit post command buffer !");
+            }
+
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores    = &renderFinishedSemaphore;
+            presentInfo.swapchainCount     = 1;
+            presentInfo.pSwapchains        = &swapChain;
+            presentInfo.pImageIndices      = &imageIndex;
+
+            VkResult result = vk.QueuePresentKHR(presentQueue, &presentInfo);
+
+            res.frame = (res.frame + 1) % kFrames;
+            res.submitted++;
+            return VK_SUCCESS == result;
+        }
+
+        /* Only once the fence of the last graphics batch has signaled. That
+        batch waited for the chain before it, whose slot is the next frame's. */
+        void Read(VkDevice& device, Resources& res)
+        {
+            if (VK_NULL_HANDLE == res.timestamps || res.submitted < 2)
+            {
+                return;
+            }
+
+            uint64_t scene[2];
+            uint64_t chain[2];
+            if (VK_SUCCESS != vkGetQueryPoolResults(device, res.timestamps, 0, 2, sizeof(scene), scene, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) ||
+                VK_SUCCESS != vkGetQueryPoolResults(device, res.timestamps, 2 + 2 * res.frame, 2, sizeof(chain), chain, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT))
+            {
+                return;
+            }
+
+            // Both queues tick on the same device clock.
+            double   toMs    = res.period * 1e-6;
+            uint64_t overlap = std::min(scene[1], chain[1]) > std::max(scene[0], chain[0]) ? std::min(scene[1], chain[1]) - std::max(scene[0], chain[0]) : 0;
+
+            res.timings.sceneMs   += (scene[1] - scene[0]) * toMs;
+            res.timings.chainMs   += (chain[1] - chain[0]) * toMs;
+            res.timings.overlapMs += overlap * toMs;
+            res.timings.frames++;
+        }
+
+        // Averages since the last call, then starts over.
+        Timings Reset(Resources& res)
+        {
+            Timings average = res.timings;
+            if (average.frames > 0)
+            {
+                average.sceneMs   /= average.frames;
+                average.chainMs   /= average.frames;
+                average.overlapMs /= average.frames;
+            }
+
+            res.timings = {};
+            return average;
+        }
+
+        void Destroy(VkDevice& device, Resources& res)
+        {
+            if (VK_NULL_HANDLE == res.renderPass)
+            {
+                return;
+            }
+
+            vkDestroySemaphore(device, res.postDone, HostMemory::Callbacks());
+            vkDestroySemaphore(device, res.sceneDone, HostMemory::Callbacks());
+            for (VkCommandPool pool : res.pools)
+            {
+                vkDestroyCommandPool(device, pool, HostMemory::Callbacks());
+            }
+
+            if (VK_NULL_HANDLE != res.timestamps)
+            {
+                vkDestroyQueryPool(device, res.timestamps, HostMemory::Callbacks());
+            }
+
+            vkDestroyDescriptorPool(device, res.tonemapPool, HostMemory::Callbacks());
+            vkDestroyDescriptorPool(device, res.samplePool, HostMemory::Callbacks());
+            ComputePipeline::Destroy(device, res.tonemapPipeline, res.tonemapLayout);
+            ComputePipeline::Destroy(device, res.upsamplePipeline, res.upsampleLayout);
+            ComputePipeline::Destroy(device, res.downsamplePipeline, res.downsampleLayout);
+            vkDestroyDescriptorSetLayout(device, res.tonemapSetLayout, HostMemory::Callbacks());
+            vkDestroyDescriptorSetLayout(device, res.sampleSetLayout, HostMemory::Callbacks());
+
+            vkDestroySampler(device, res.sampler, HostMemory::Callbacks());
+            vkDestroyImageView(device, res.outputView, HostMemory::Callbacks());
+            Memory::DestroyImage(device, res.output, res.outputMemory);
+            for (VkImageView view : res.bloomViews)
+            {
+                vkDestroyImageView(device, view, HostMemory::Callbacks());
+            }
+            Memory::DestroyImage(device, res.bloom, res.bloomMemory);
+
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                vkDestroyFramebuffer(device, res.framebuffers[frame], HostMemory::Callbacks());
+                vkDestroyImageView(device, res.targetViews[frame], HostMemory::Callbacks());
+                Memory::DestroyImage(device, res.targets[frame], res.targetMemory[frame]);
+            }
+
+            vkDestroyRenderPass(device, res.renderPass, HostMemory::Callbacks());
+
+            res = {};
+        }
+    }
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+#include "Memory.h"
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace Readback
+    {
+        /* Offline output: every frame's swapchain image is copied into one of
+        kSlots persistently mapped host buffers at the end of its command
+        buffer. Once that frame's fence has signaled the slot goes to a pool
+        of encoder threads that write it out as PNG or raw RGBA, and comes
+        back free when the file is written. The render thread only waits when
+        the slot it is about to copy into is still being encoded, so the GPU
+        renders frame n + 1 while the copy of n finishes and older frames
+        are encoded beside both.
+            Free -> Copying (recorded) -> Encoding (fence signaled) -> Free */
+
+        const uint32_t kSlots = 4;
+
+        enum class Format
+        {
+            Png,
+            Raw // width * height RGBA8, no header
+        };
+
+        enum class State : uint32_t
+        {
+            Free,
+            Copying,
+            Encoding
+        };
+
+        struct Slot
+        {
+            VkBuffer           buffer = VK_NULL_HANDLE;
+            VkDeviceMemory     memory = VK_NULL_HANDLE;
+            const uint8_t*     mapped = nullptr;
+            std::atomic<State> state{State::Free};
+            uint64_t           frame  = 0; // file number
+        };
+
+        struct Encoder
+        {
+            std::vector<std::thread> threads;
+            std::mutex               mutex;
+            std::condition_variable  work; // a slot was queued, or stopping
+            std::condition_variable  done; // a slot is free again
+            std::deque<uint32_t>     queue;
+            bool                     stopping = false;
+            std::exception_ptr       error; // first failed write, rethrown by Collect
+        };
+
+        struct Resources
+        {
+            Slot                  slots[kSlots];
+            std::vector<VkImage>  images; // swapchain images, by index
+            VkExtent2D            extent{};
+            bool                  bgra   = false;
+            Format                format = Format::Png;
+            std::string           prefix; // files are prefix_000000.png
+            uint32_t              next   = 0; // slot of the next copy
+            uint64_t              frames = 0; // copies recorded
+            uint64_t              stalls = 0; // Reserve had to wait for an encoder
+            Encoder               encoder;
+            std::atomic<uint64_t> written{0};
+            std::chrono::steady_clock::time_point start;
+        };
+
+        // The swapchain has to allow copies out of it, and be 8 bit RGBA in some order.
+        bool Supported(VkSurfaceCapabilitiesKHR& capabilities, VkFormat format)
+        {
+            bool rgba8 = VK_FORMAT_B8G8R8A8_UNORM == format || VK_FORMAT_B8G8R8A8_SRGB == format || VK_FORMAT_R8G8B8A8_UNORM == format || VK_FORMAT_R8G8B8A8_SRGB == format;
+            return rgba8 && 0 != (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        }
+
+        static uint32_t Crc(uint32_t crc, const uint8_t* data, size_t size)
+        {
+            static const std::vector<uint32_t> table = []()
+            {
+                std::vector<uint32_t> entries(256);
+                for (uint32_t n = 0; n < 256; ++n)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[n] = c;
+                }
+                return entries;
+            }();
+
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        static void PutBig(std::vector<uint8_t>& out, uint32_t value)
+        {
+            out.push_back(static_cast<uint8_t>(value >> 24));
+            out.push_back(static_cast<uint8_t>(value >> 16));
+            out.push_back(static_cast<uint8_t>(value >> 8));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        static void Chunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+        {
+            PutBig(out, static_cast<uint32_t>(size));
+            size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data, data + size);
+            PutBig(out, Crc(0, out.data() + start, size + 4));
+        }
+
+        /* RGBA8 PNG with stored (uncompressed) deflate blocks: no zlib to link,
+        and encoding stays a copy plus two checksums. */
+        void EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+        {
+            size_t               rowBytes = size_t(width) * 4;
+            std::vector<uint8_t> rows;
+            rows.reserve((rowBytes + 1) * height);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                rows.push_back(0); // filter: none
+                rows.insert(rows.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+            }
+
+            std::vector<uint8_t> zlib = {0x78, 0x01};
+            uint32_t a = 1, b = 0;
+            for (size_t offset = 0; offset < rows.size() || 0 == offset;)
+            {
+                size_t  size = std::min<size_t>(rows.size() - offset, 65535);
+                uint8_t last = offset + size == rows.size() ? 1 : 0;
+                uint8_t header[5] = {last, static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(~size), static_cast<uint8_t>(~size >> 8)};
+                zlib.insert(zlib.end(), header, header + 5);
+                zlib.insert(zlib.end(), rows.begin() + offset, rows.begin() + offset + size);
+
+                for (size_t i = offset; i < offset + size; ++i)
+                {
+                    a = (a + rows[i]) % 65521;
+                    b = (b + a) % 65521;
+                }
+                offset += size;
+                if (last)
+                {
+                    break;
+                }
+            }
+            PutBig(zlib, (b << 16) | a);
+
+            uint8_t ihdr[13];
+            ihdr[0]  = static_cast<uint8_t>(width >> 24);
+            ihdr[1]  = static_cast<uint8_t>(width >> 16);
+            ihdr[2]  = static_cast<uint8_t>(width >> 8);
+            ihdr[3]  = static_cast<uint8_t>(width);
+            ihdr[4]  = static_cast<uint8_t>(height >> 24);
+            ihdr[5]  = static_cast<uint8_t>(height >> 16);
+            ihdr[6]  = static_cast<uint8_t>(height >> 8);
+            ihdr[7]  = static_cast<uint8_t>(height);
+            ihdr[8]  = 8; // bit depth
+            ihdr[9]  = 6; // RGBA
+            ihdr[10] = 0;
+            ihdr[11] = 0;
+            ihdr[12] = 0;
+
+            const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            out.assign(signature, signature + 8);
+            Chunk(out, "IHDR", ihdr, sizeof(ihdr));
+            Chunk(out, "IDAT", zlib.data(), zlib.size());
+            Chunk(out, "IEND", nullptr, 0);
+        }
+
+        static void Encode(Resources& res, Slot& slot)
+        {
+            size_t               size = size_t(res.extent.width) * res.extent.height * 4;
+            std::vector<uint8_t> rgba(slot.mapped, slot.mapped + size);
+            for (size_t i = 0; res.bgra && i < size; i += 4)
+            {
+                std::swap(rgba[i], rgba[i + 2]);
+            }
+
+            char number[16];
+            snprintf(number, sizeof(number), "_%06llu", static_cast<unsigned long long>(slot.frame));
+            std::string path = res.prefix + number + (Format::Png == res.format ? ".png" : ".raw");
+
+            std::vector<uint8_t> png;
+            if (Format::Png == res.format)
+            {
+                EncodePng(rgba.data(), res.extent.width, res.extent.height, png);
+            }
+            const std::vector<uint8_t>& bytes = Format::Png == res.format ? png : rgba;
+
+            FILE* file = fopen(path.c_str(), "wb");
+            if (nullptr == file)
+            {
+                throw std::runtime_error("Failed to open output file !");
+            }
+
+            size_t count = fwrite(bytes.data(), 1, bytes.size(), file);
+            if (0 != fclose(file) || count != bytes.size())
+            {
+                throw std::runtime_error("Failed to write output file !");
+            }
+            res.written.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void Work(Resources& res)
+        {
+            Encoder& encoder = res.encoder;
+            while (true)
+            {
+                uint32_t index;
+                {
+                    std::unique_lock<std::mutex> lock(encoder.mutex);
+                    encoder.work.wait(lock, [&encoder]() { return encoder.stopping || !encoder.queue.empty(); });
+                    if (encoder.queue.empty())
+                    {
+                        return; // stopping, and everything queued is written
+                    }
+                    index = encoder.queue.front();
+                    encoder.queue.pop_front();
+                }
+
+                std::exception_ptr error;
+                try
+                {
+                    Encode(res, res.slots[index]);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(encoder.mutex);
+                    res.slots[index].state.store(State::Free, std::memory_order_release);
+                    if (error && !encoder.error)
+                    {
+                        encoder.error = error;
+                    }
+                }
+                encoder.done.notify_all();
+            }
+        }
+
+        /* path ending in .raw writes raw frames, anything else PNG; the
+        extension is replaced by the frame number. Host cached memory is
+        preferred, the encoders read every byte. */
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, const std::vector<VkImage>& images, VkExtent2D extent, VkFormat format, const std::string& path, Resources& res)
+        {
+            res.images = images;
+            res.extent = extent;
+            res.bgra   = VK_FORMAT_B8G8R8A8_UNORM == format || VK_FORMAT_B8G8R8A8_SRGB == format;
+            res.format = path.size() > 4 && 0 == path.compare(path.size() - 4, 4, ".raw") ? Format::Raw : Format::Png;
+            res.prefix = path.size() > 4 && (Format::Raw == res.format || 0 == path.compare(path.size() - 4, 4, ".png")) ? path.substr(0, path.size() - 4) : path;
+
+            VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            if (Memory::HasType(physicalDevice, ~0u, properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+            {
+                properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            }
+
+            VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+            for (Slot& slot : res.slots)
+            {
+                Memory::CreateBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+                void* mapped = nullptr;
+                if (VK_SUCCESS != vkMapMemory(device, slot.memory, 0, size, 0, &mapped))
+                {
+                    throw std::runtime_error("Failed to map readback buffer !");
+                }
+                slot.mapped = static_cast<const uint8_t*>(mapped);
+            }
+
+            // Leaves a core each for the simulation and the render thread.
+            uint32_t threads = std::max(1u, std::min(kSlots, std::thread::hardware_concurrency() > 2 ? std::thread::hardware_concurrency() - 2 : 1u));
+            for (uint32_t i = 0; i < threads; ++i)
+            {
+                res.encoder.threads.emplace_back(Work, std::ref(res));
+            }
+            res.start = std::chrono::steady_clock::now();
+        }
+
+        /* Render thread, right after the in flight fence wait: the copies
+        recorded so far are done, their slots go to the encoders. Throws
+        what an encoder failed with. */
+        void Collect(Resources& res)
+        {
+            bool queued = false;
+            {
+                std::lock_guard<std::mutex> lock(res.encoder.mutex);
+                if (res.encoder.error)
+                {
+                    std::rethrow_exception(std::exchange(res.encoder.error, nullptr));
+                }
+
+                for (uint32_t i = 0; i < kSlots; ++i)
+                {
+                    if (State::Copying == res.slots[i].state.load(std::memory_order_relaxed))
+                    {
+                        res.slots[i].state.store(State::Encoding, std::memory_order_relaxed);
+                        res.encoder.queue.push_back(i);
+                        queued = true;
+                    }
+                }
+            }
+
+            if (queued)
+            {
+                res.encoder.work.notify_all();
+            }
+        }
+
+        // Render thread, before recording: waits until the next slot is free.
+        void Reserve(Resources& res)
+        {
+            Slot& slot = res.slots[res.next];
+            if (State::Free == slot.state.load(std::memory_order_acquire))
+            {
+                return;
+            }
+
+            res.stalls++;
+            std::unique_lock<std::mutex> lock(res.encoder.mutex);
+            res.encoder.done.wait(lock, [&slot]() { return State::Free == slot.state.load(std::memory_order_acquire); });
+        }
+
+        /* Last thing in the frame's command buffer: the swapchain image is in
+        PRESENT_SRC after the scene pass, post or upscale blit, and goes back
+        there after the copy. */
+        void Record(VkCommandBuffer& commandBuffer, Resources& res, uint32_t imageIndex)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            Slot& slot = res.slots[res.next];
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image               = res.images[imageIndex];
+            barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barrier.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.oldLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkBufferImageCopy region{};
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent      = {res.extent.width, res.extent.height, 1};
+            vk.CmdCopyImageToBuffer(commandBuffer, res.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+            // The host reads the buffer after the fence.
+            VkBufferMemoryBarrier host{};
+            host.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            host.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+            host.dstAccessMask       = VK_ACCESS_HOST_READ_BIT;
+            host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            host.buffer              = slot.buffer;
+            host.size                = VK_WHOLE_SIZE;
+
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &host, 0, nullptr);
+
+            slot.frame = res.frames++;
+            slot.state.store(State::Copying, std::memory_order_relaxed);
+            res.next = (res.next + 1) % kSlots;
+        }
+
+        // Sustained rate since Create.
+        double FramesPerSecond(const Resources& res)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - res.start).count();
+            return seconds > 0.0 ? res.written.load(std::memory_order_relaxed) / seconds : 0.0;
+        }
+
+        /* Device idle: the last copies are done, every queued frame is written
+        before this returns. A write failing this late only shows in written. */
+        void Destroy(VkDevice& device, Resources& res)
+        {
+            if (!res.encoder.threads.empty())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(res.encoder.mutex);
+                    res.encoder.error = nullptr;
+                }
+                Collect(res);
+                {
+                    std::lock_guard<std::mutex> lock(res.encoder.mutex);
+                    res.encoder.stopping = true;
+                }
+                res.encoder.work.notify_all();
+                for (std::thread& thread : res.encoder.threads)
+                {
+                    thread.join();
+                }
+                res.encoder.threads.clear();
+            }
+
+            for (Slot& slot : res.slots)
+            {
+                if (nullptr != slot.mapped)
+                {
+                    vkUnmapMemory(device, slot.memory);
+                    slot.mapped = nullptr;
+                }
+                if (VK_NULL_HANDLE != slot.buffer)
+                {
+                    Memory::DestroyBuffer(device, slot.buffer, slot.memory);
+                }
+                slot.state.store(State::Free, std::memory_order_relaxed);
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "GraphicsPipeline.h"
+#include "Mesh.h"
+#include "Capture.h"
+#include "ClusterCull.h"
+#include "DynamicResolution.h"
+#include "Objects.h"
+#include "Occlusion.h"
+#include "PipelineStats.h"
+#include "Readback.h"
+#include "RenderQueue.h"
+#include "Terrain.h"
+#include "Post.h"
+#include "UniformRing.h"
+
+namespace Visuals
+{
+    // An extra window drawn after the main pass, see Outputs.h.
+    struct OutputPass
+    {
+        VkFramebuffer   framebuffer    = VK_NULL_HANDLE;
+        VkExtent2D      extent         = {0, 0};
+        uint32_t        frameOffset    = 0;
+        glm::vec3       cameraPosition{0.0f};
+        const uint32_t* visibleObjects = nullptr;
+        uint32_t        visibleCount   = 0;
+    };
+
+    // Everything a frame records beyond the swap chain essentials. Optional
+    // features leave their handles null and are skipped by CommandBuffer::Record.
+    struct RenderContext
+    {
+        glm::mat4 view{1.0f};
+        glm::mat4 projection{1.0f};
+        glm::mat4 viewProj{1.0f};
+        glm::vec3 cameraPosition{0.0f};
+        glm::vec4 frustumPlanes[6];
+        float     zNear = 0.1f;
+        float     zFar  = 100.0f;
+
+        Mesh::Gpu*             mesh               = nullptr;
+        VkPipeline             meshPipeline       = VK_NULL_HANDLE;
+        VkPipelineLayout       meshPipelineLayout = VK_NULL_HANDLE;
+        Objects::Buffer*       objects            = nullptr;
+
+        // This frame's UniformRing::FrameUniforms, bound at set 1.
+        UniformRing::Ring*     uniforms           = nullptr;
+        uint32_t               frameOffset        = 0;
+
+        // CPU frustum culled objects, drawn one by one through firstInstance.
+        const uint32_t*        visibleObjects     = nullptr;
+        uint32_t               visibleCount       = 0;
+
+        // CPU culled draws sorted front to back with binds elided, see RenderQueue.h.
+        // spheres are the snapshot's world bounds, indexed like visibleObjects.
+        RenderQueue::Queue*    queue              = nullptr;
+        const glm::vec4*       spheres            = nullptr;
+
+        // Streamed sky island chunks, drawn through the queue instead of mesh, see Terrain.h.
+        Terrain::Gpu*          terrain            = nullptr;
+
+        ClusterCull::Resources* clusters          = nullptr;
+        ClusterCull::Stats      clusterStats;
+
+        // Two phase Hi-Z culling, see Occlusion.h.
+        Occlusion::Resources*   occlusion         = nullptr;
+        VkRenderPass            renderPassFirst   = VK_NULL_HANDLE;
+        VkRenderPass            renderPassSecond  = VK_NULL_HANDLE;
+        Occlusion::Stats        occlusionStats;
+
+        // Depth only pass, then color with EQUAL testing. Not used with occlusion.
+        bool                    depthPrepass         = false;
+        VkPipeline              depthPrepassPipeline = VK_NULL_HANDLE;
+        VkPipeline              meshEqualPipeline    = VK_NULL_HANDLE;
+
+        // Per pass pipeline statistics, null without the feature.
+        PipelineStats::Resources* pipelineStats      = nullptr;
+        PipelineStats::Frame      pipelineFrame;
+
+        // Renders below swapchain size and blits up, see DynamicResolution.h. Not used with occlusion.
+        DynamicResolution::Resources* resolution     = nullptr;
+
+        // Scene into a half float target, compute post chain after, see Post.h. Not used with occlusion.
+        Post::Resources*              post           = nullptr;
+
+        // Records the CPU culled mesh draws into a .skyc file, see Capture.h.
+        Capture::Log*                 capture        = nullptr;
+
+        // Copies every frame out of the swapchain for offline output, see Readback.h.
+        Readback::Resources*          readback       = nullptr;
+
+        // Extra windows acquired this frame. Only on the plain forward path.
+        std::vector<OutputPass>       outputPasses;
+    };
+
+    // An extra window's camera and culling for one simulation tick.
+    struct OutputView
+    {
+        glm::mat4              view{1.0f};
+        glm::mat4              projection{1.0f};
+        glm::mat4              viewProj{1.0f};
+        glm::vec3              cameraPosition{0.0f};
+        std::vector<uint32_t>  visibleObjects;
+        uint32_t               visibleCount = 0;
+        VkExtent2D             framebufferSize{0, 0}; // read on the main thread, 0 while minimized
+    };
+
+    /* What the simulation hands the render thread through a Mailbox, one per
+    simulation tick. Never changed once published. */
+    struct Snapshot
+    {
+        uint64_t  sequence = 0; // 0 until the first tick
+        double    time     = 0.0;
+
+        glm::mat4 view{1.0f};
+        glm::mat4 projection{1.0f};
+        glm::mat4 viewProj{1.0f};
+        glm::vec3 cameraPosition{0.0f};
+        glm::vec4 frustumPlanes[6];
+        float     zNear = 0.1f;
+        float     zFar  = 100.0f;
+
+        // Full Objects arrays; [changedBegin, changedEnd) changed since sequence - 1.
+        std::vector<glm::mat4> models;
+        std::vector<glm::vec4> spheres;
+        uint32_t               changedBegin = 0;
+        uint32_t               changedEnd   = 0;
+
+        std::vector<uint32_t>  visibleObjects;
+        uint32_t               visibleCount = 0;
+
+        std::vector<OutputView> outputs; // one per extra window
+
+        VkExtent2D framebufferSize{0, 0}; // main window's, GLFW only answers on the main thread
+
+        GraphicsPipeline::MeshVariant meshVariant;
+        bool                          depthPrepass = false;
+        bool                          asyncPost    = true;
+    };
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Dispatch.h"
+
+namespace Visuals
+{
+    namespace RenderQueue
+    {
+        /* Draws of one render pass, each behind a 64 bit key, radix sorted
+        once a frame and recorded in key order so that a pipeline or
+        material is bound once for every run of draws that share it. From
+        the top bit down:
+
+            phase    4 bits   depth prepass before color, and so on
+            pipeline 12 bits  index into Queue::pipelines
+            material 16 bits  index into Queue::materials
+            depth    32 bits  front to back, see DepthBucket
+
+        The vertex and index buffers are bound by the caller, or by a
+        material that has its own, like a terrain arena page. Materials
+        share one pipeline layout, so their sets stay bound across pipeline
+        changes. */
+
+        const uint32_t kMaxSets = 2;
+
+        // Descriptor sets bound from firstSet on, with their dynamic offsets.
+        struct Material
+        {
+            VkPipelineLayout layout       = VK_NULL_HANDLE;
+            uint32_t         firstSet     = 0;
+            uint32_t         setCount     = 0;
+            VkDescriptorSet  sets[kMaxSets]{};
+            uint32_t         offsetCount  = 0;
+            uint32_t         offsets[kMaxSets]{};
+            VkBuffer         vertexBuffer = VK_NULL_HANDLE; // bound at offset 0 when not null
+            VkBuffer         indexBuffer  = VK_NULL_HANDLE;
+            VkIndexType      indexType    = VK_INDEX_TYPE_UINT32;
+        };
+
+        struct Draw
+        {
+            uint32_t indexCount    = 0;
+            uint32_t firstIndex    = 0;
+            int32_t  vertexOffset  = 0;
+            uint32_t firstInstance = 0;
+        };
+
+        // Key and index of the draw it sorts.
+        struct Item
+        {
+            uint64_t key  = 0;
+            uint32_t draw = 0;
+        };
+
+        struct Stats
+        {
+            uint64_t draws                 = 0;
+            uint64_t pipelineBinds         = 0;
+            uint64_t pipelineBindsAvoided  = 0;
+            uint64_t materialBinds         = 0;
+            uint64_t materialBindsAvoided  = 0;
+            double   sortMs                = 0.0;
+            double   recordMs              = 0.0;
+        };
+
+        struct Queue
+        {
+            std::vector<VkPipeline> pipelines;
+            std::vector<Material>   materials;
+            std::vector<Draw>       draws;
+            std::vector<Item>       items;
+            std::vector<Item>       scratch; // radix sort ping-pong, kept for its capacity
+            Stats                   stats;   // since BeginFrame
+        };
+
+        uint64_t Key(uint32_t phase, uint32_t pipeline, uint32_t material, uint32_t depth)
+        {
+            return (uint64_t(phase & 0xF) << 60) | (uint64_t(pipeline & 0xFFF) << 48) | (uint64_t(material & 0xFFFF) << 32) | depth;
+        }
+
+        uint32_t PhaseOf(uint64_t key)    { return static_cast<uint32_t>(key >> 60); }
+        uint32_t PipelineOf(uint64_t key) { return static_cast<uint32_t>(key >> 48) & 0xFFF; }
+        uint32_t MaterialOf(uint64_t key) { return static_cast<uint32_t>(key >> 32) & 0xFFFF; }
+
+        // Distance between zNear and zFar to 32 bits, nearer first; outside the range clamps.
+        uint32_t DepthBucket(float distance, float zNear, float zFar)
+        {
+            float t = (distance - zNear) / (zFar - zNear);
+            t       = std::min(std::max(t, 0.0f), 1.0f);
+            return static_cast<uint32_t>(t * 4294967040.0f);
+        }
+
+        // Tables and draws are rebuilt every frame, the vectors keep their capacity.
+        void Clear(Queue& queue)
+        {
+            queue.pipelines.clear();
+            queue.materials.clear();
+            queue.draws.clear();
+            queue.items.clear();
+        }
+
+        void BeginFrame(Queue& queue)
+        {
+            Clear(queue);
+            queue.stats = Stats{};
+        }
+
+        // Index for Key, the same pipeline twice gets the same index.
+        uint32_t AddPipeline(Queue& queue, VkPipeline pipeline)
+        {
+            for (uint32_t i = 0; i < queue.pipelines.size(); ++i)
+            {
+                if (pipeline == queue.pipelines[i])
+                {
+                    return i;
+                }
+            }
+            if (queue.pipelines.size() > 0xFFF)
+            {
+                throw std::runtime_error("Too many pipelines in one render queue !");
+            }
+            queue.pipelines.push_back(pipeline);
+            return static_cast<uint32_t>(queue.pipelines.size() - 1);
+        }
+
+        uint32_t AddMaterial(Queue& queue, const Material& material)
+        {
+            if (queue.materials.size() > 0xFFFF)
+            {
+                throw std::runtime_error("Too many materials in one render queue !");
+            }
+            queue.materials.push_back(material);
+            return static_cast<uint32_t>(queue.materials.size() - 1);
+        }
+
+        void Push(Queue& queue, uint64_t key, const Draw& draw)
+        {
+            queue.items.push_back({key, static_cast<uint32_t>(queue.draws.size())});
+            queue.draws.push_back(draw);
+        }
+
+        /* LSD radix sort, eight 8 bit digits. Stable, so equal keys keep the
+        order they were pushed in. A digit every key shares, like the phase
+        and pipeline of a scene with one of each, costs one histogram and
+        no scatter. */
+        void Sort(Queue& queue)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<Item>& items   = queue.items;
+            std::vector<Item>& scratch = queue.scratch;
+            scratch.resize(items.size());
+
+            uint32_t counts[8][256] = {};
+            for (const Item& item : items)
+            {
+                for (uint32_t digit = 0; digit < 8; ++digit)
+                {
+                    counts[digit][(item.key >> (digit * 8)) & 0xFF]++;
+                }
+            }
+
+            for (uint32_t digit = 0; digit < 8; ++digit)
+            {
+                uint32_t* count = counts[digit];
+                if (!items.empty() && items.size() == count[(items[0].key >> (digit * 8)) & 0xFF])
+                {
+                    continue;
+                }
+
+                uint32_t offset = 0;
+                for (uint32_t bucket = 0; bucket < 256; ++bucket)
+                {
+                    uint32_t size = count[bucket];
+                    count[bucket] = offset;
+                    offset       += size;
+                }
+                for (const Item& item : items)
+                {
+                    scratch[count[(item.key >> (digit * 8)) & 0xFF]++] = item;
+                }
+                items.swap(scratch);
+            }
+
+            queue.stats.sortMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        static void BindMaterial(VkCommandBuffer& commandBuffer, const Material& material)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.layout, material.firstSet, material.setCount, material.sets, material.offsetCount, material.offsets);
+
+            VkDeviceSize offset = 0;
+            if (VK_NULL_HANDLE != material.vertexBuffer)
+            {
+                vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &material.vertexBuffer, &offset);
+            }
+            if (VK_NULL_HANDLE != material.indexBuffer)
+            {
+                vk.CmdBindIndexBuffer(commandBuffer, material.indexBuffer, 0, material.indexType);
+            }
+        }
+
+        /* Sorted draws of one phase, inside the render pass. A pipeline or
+        material equal to the one recorded before is not bound again; the
+        first of each phase is always bound, the caller may have bound
+        something else in between. */
+        void Record(VkCommandBuffer& commandBuffer, Queue& queue, uint32_t phase)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            auto first = std::lower_bound(queue.items.begin(), queue.items.end(), uint64_t(phase) << 60, [](const Item& item, uint64_t key) { return item.key < key; });
+
+            uint32_t pipeline = UINT32_MAX;
+            uint32_t material = UINT32_MAX;
+            for (auto it = first; it != queue.items.end() && phase == PhaseOf(it->key); ++it)
+            {
+                if (PipelineOf(it->key) != pipeline)
+                {
+                    pipeline = PipelineOf(it->key);
+                    vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, queue.pipelines[pipeline]);
+                    queue.stats.pipelineBinds++;
+                }
+                else
+                {
+                    queue.stats.pipelineBindsAvoided++;
+                }
+
+                if (MaterialOf(it->key) != material)
+                {
+                    material = MaterialOf(it->key);
+                    BindMaterial(commandBuffer, queue.materials[material]);
+                    queue.stats.materialBinds++;
+                }
+                else
+                {
+                    queue.stats.materialBindsAvoided++;
+                }
+
+                const Draw& draw = queue.draws[it->draw];
+                vk.CmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+                queue.stats.draws++;
+            }
+
+            queue.stats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+}
@@ -1,29 +1,116 @@
 #pragma once
 
+#include "Dispatch.h"
+#include "HostMemory.h"
 #include "SwapChain.h"
+#include <algorithm>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace Visuals
 {
     namespace Draw
     {
-        void Frame(VkDevice& device, VkFence& inFlightFence, VkSwapchainKHR& swapChain, VkSemaphore& imageAvailableSemaphore, VkCommandBuffer& commandBuffer, VkCommandPool& commandPool, VkRenderPass& renderPass, std::vector<VkFramebuffer>& swapChainFramebuffers, VkExtent2D& swapChainExtent, VkPipeline& graphicsPipeline, VkSemaphore& renderFinishedSemaphore, VkQueue& graphicsQueue, VkQueue& presentQueue)
+        /* Waits for the previous frame, acquires the next image and picks up
+        the previous frame's readbacks. commandBuffer is free to record once
+        this returns true. False when the swapchain is out of date: the fence
+        is left signaled and nothing is read, rebuild it and try again. */
+        bool Acquire(VkDevice& device, VkFence& inFlightFence, VkSwapchainKHR& swapChain, VkSemaphore& imageAvailableSemaphore, VkCommandBuffer& commandBuffer, RenderContext& context, uint32_t& imageIndex)
         {
-            vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-            vkResetFences(device, 1, &inFlightFence);
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.WaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
 
-            uint32_t imageIndex;
-            vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            // Suboptimal still acquires and signals, the present reports it again.
+            VkResult result = vk.AcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            if (VK_ERROR_OUT_OF_DATE_KHR == result)
+            {
+                return false;
+            }
+            if (VK_SUCCESS != result && VK_SUBOPTIMAL_KHR != result)
+            {
+                throw std::runtime_error("Failed to acquire swap chain image !");
+            }
+
+            vk.ResetFences(device, 1, &inFlightFence);
+
+            // The previous frame is done, its readbacks are safe to look at.
+            if (nullptr != context.clusters)
+            {
+                ClusterCull::ReadStats(*context.clusters, *context.mesh, context.clusterStats);
+            }
+
+            if (nullptr != context.occlusion)
+            {
+                Occlusion::ReadStats(*context.occlusion, context.occlusionStats);
+            }
+
+            if (nullptr != context.pipelineStats)
+            {
+                PipelineStats::Read(device, *context.pipelineStats, context.pipelineFrame);
+            }
+
+            if (nullptr != context.resolution)
+            {
+                DynamicResolution::Read(device, *context.resolution);
+            }
+
+            if (nullptr != context.post)
+            {
+                Post::Read(device, *context.post);
+            }
 
-            vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-            CommandBuffer::Record(commandPool, commandBuffer, imageIndex, renderPass, swapChainFramebuffers, swapChainExtent, graphicsPipeline);
+            vk.ResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+            return true;
+        }
+
+        // The main swapchain and up to seven extra windows per present.
+        const uint32_t kMaxSwapChains = 8;
+
+        /* Swapchains of extra windows acquired this frame, waited for by the
+        same submit and presented by the same vkQueuePresentKHR as the main
+        one. results is filled per swapchain. */
+        struct Batch
+        {
+            std::vector<VkSemaphore>    imageAvailable;
+            std::vector<VkSwapchainKHR> swapChains;
+            std::vector<uint32_t>       imageIndices;
+            std::vector<VkResult>       results;
+        };
+
+        // Keeps the vectors' capacity from frame to frame.
+        void Clear(Batch& batch)
+        {
+            batch.imageAvailable.clear();
+            batch.swapChains.clear();
+            batch.imageIndices.clear();
+            batch.results.clear();
+        }
+
+        // False when the present found the main swapchain out of date or suboptimal.
+        bool Submit(VkFence& inFlightFence, VkSwapchainKHR& swapChain, VkSemaphore& imageAvailableSemaphore, VkCommandBuffer& commandBuffer, VkSemaphore& renderFinishedSemaphore, VkQueue& graphicsQueue, VkQueue& presentQueue, uint32_t imageIndex, Batch* batch = nullptr)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
 
             VkSubmitInfo submitInfo{};
             submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-            VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-            VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-            submitInfo.waitSemaphoreCount   = 1;
+            // The main swapchain first, then the batch.
+            uint32_t             count = 1;
+            VkSemaphore          waitSemaphores[kMaxSwapChains] = {imageAvailableSemaphore};
+            VkPipelineStageFlags waitStages[kMaxSwapChains];
+            VkSwapchainKHR       swapChains[kMaxSwapChains] = {swapChain};
+            uint32_t             imageIndices[kMaxSwapChains] = {imageIndex};
+            VkResult             results[kMaxSwapChains];
+            for (size_t i = 0; nullptr != batch && i < batch->swapChains.size() && count < kMaxSwapChains; ++i, ++count)
+            {
+                waitSemaphores[count] = batch->imageAvailable[i];
+                swapChains[count]     = batch->swapChains[i];
+                imageIndices[count]   = batch->imageIndices[i];
+            }
+            std::fill(waitStages, waitStages + count, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            std::fill(results, results + count, VK_SUCCESS);
+
+            submitInfo.waitSemaphoreCount   = count;
             submitInfo.pWaitSemaphores      = waitSemaphores;
             submitInfo.pWaitDstStageMask    = waitStages;
 
@@ -34,23 +121,43 @@ namespace Visuals
             submitInfo.signalSemaphoreCount = 1;
             submitInfo.pSignalSemaphores    = signalSemaphores;
 
-            if (VK_SUCCESS != vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence))
+            if (VK_SUCCESS != vk.QueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence))
             {
                 throw std::runtime_error("Failed to submit draw command buffer !");
             }
 
+            // One wait covers every swapchain of the present.
             VkPresentInfoKHR presentInfo{};
             presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
             presentInfo.waitSemaphoreCount = 1;
             presentInfo.pWaitSemaphores    = signalSemaphores;
 
-            VkSwapchainKHR swapChains[] = {swapChain};
-            presentInfo.swapchainCount     = 1;
+            presentInfo.swapchainCount     = count;
             presentInfo.pSwapchains        = swapChains;
 
-            presentInfo.pImageIndices      = &imageIndex;
+            presentInfo.pImageIndices      = imageIndices;
+            presentInfo.pResults           = results;
+
+            vk.QueuePresentKHR(presentQueue, &presentInfo);
+
+            if (nullptr != batch)
+            {
+                batch->results.assign(results + 1, results + count);
+            }
+            return VK_SUCCESS == results[0];
+        }
+
+        // Returns false like Submit, or when no image could be acquired.
+        bool Frame(VkDevice& device, VkFence& inFlightFence, VkSwapchainKHR& swapChain, VkSemaphore& imageAvailableSemaphore, VkCommandBuffer& commandBuffer, VkCommandPool& commandPool, VkRenderPass& renderPass, std::vector<VkFramebuffer>& swapChainFramebuffers, VkExtent2D& swapChainExtent, VkPipeline& graphicsPipeline, VkSemaphore& renderFinishedSemaphore, VkQueue& graphicsQueue, VkQueue& presentQueue, RenderContext& context)
+        {
+            uint32_t imageIndex;
+            if (!Acquire(device, inFlightFence, swapChain, imageAvailableSemaphore, commandBuffer, context, imageIndex))
+            {
+                return false;
+            }
 
-            vkQueuePresentKHR(presentQueue, &presentInfo);
+            CommandBuffer::Record(commandPool, commandBuffer, imageIndex, renderPass, swapChainFramebuffers, swapChainExtent, graphicsPipeline, context);
+            return Submit(inFlightFence, swapChain, imageAvailableSemaphore, commandBuffer, renderFinishedSemaphore, graphicsQueue, presentQueue, imageIndex);
         }
     }
 
@@ -66,9 +173,9 @@ namespace Visuals
             fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
 
-            if (VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) ||
-                VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) ||
-                VK_SUCCESS != vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence))
+            if (VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, HostMemory::Callbacks(), &imageAvailableSemaphore) ||
+                VK_SUCCESS != vkCreateSemaphore(device, &semaphoreInfo, HostMemory::Callbacks(), &renderFinishedSemaphore) ||
+                VK_SUCCESS != vkCreateFence(device, &fenceInfo, HostMemory::Callbacks(), &inFlightFence))
             {
                 throw std::runtime_error("Failed to create semaphores !");
             }
@@ -76,9 +183,9 @@ namespace Visuals
 
         void Destroy(VkDevice& device, VkSemaphore& imageAvailableSemaphore, VkSemaphore& renderFinishedSemaphore, VkFence& inFlightFence)
         {
-            vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-            vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-            vkDestroyFence(device, inFlightFence, nullptr);
+            vkDestroySemaphore(device, imageAvailableSemaphore, HostMemory::Callbacks());
+            vkDestroySemaphore(device, renderFinishedSemaphore, HostMemory::Callbacks());
+            vkDestroyFence(device, inFlightFence, HostMemory::Callbacks());
         }
     }
 }
\ No newline at end of file
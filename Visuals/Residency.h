@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Device.h"
+#include "Memory.h"
+#include "Retire.h"
+
+// Cap on every heap's budget in MB, 0 for none, see Residency below.
+#ifndef SKY_RESIDENCY_BUDGET_MB
+#define SKY_RESIDENCY_BUDGET_MB 0
+#endif
+
+namespace Visuals
+{
+    namespace Residency
+    {
+        /* Device memory against the driver's budget, sampled once a frame with
+        VK_EXT_memory_budget, and the streamable resources that give memory
+        back when a device local heap gets close to it. Evicting ahead of
+        the budget keeps the driver from paging behind our back.
+
+        Resources are evicted least recently used first, and only once the
+        GPU can no longer be reading them. The owner brings a resource back
+        when Touch says it is gone, then calls Restored.
+
+        Without the extension the budget is the heap size and the usage is
+        only what is registered here. Owners check Pressure before growing,
+        so what was just evicted is not allocated again. Render thread only.
+
+        SKY_RESIDENCY_BUDGET_MB caps every heap's budget, so a small cap
+        shows idle resources evicted and restored without running out of
+        real memory. */
+
+        const double   kHighWater  = 0.90; // of a heap's budget, eviction starts above
+        const double   kLowWater   = 0.80; // and stops below
+        const uint64_t kIdleFrames = Retire::kLag + 2; // unused this long, the GPU is done with it
+        const uint32_t kNone       = UINT32_MAX;
+
+        struct Heap
+        {
+            VkDeviceSize size        = 0;
+            VkDeviceSize budget      = 0;
+            VkDeviceSize usage       = 0; // whole process, not only what is registered
+            bool         deviceLocal = false;
+        };
+
+        struct Budget
+        {
+            bool     supported = false; // VK_EXT_memory_budget enabled
+            uint32_t heapCount = 0;
+            Heap     heaps[VK_MAX_MEMORY_HEAPS];
+        };
+
+        // Releases the resource's memory, through the retire queue when the GPU may still read it.
+        using Evict = std::function<void()>;
+
+        struct Resource
+        {
+            const char*  name     = "";
+            VkDeviceSize bytes    = 0;
+            uint32_t     heap     = 0;
+            uint64_t     lastUsed = 0; // frame
+            bool         resident = true;
+            Evict        evict;
+        };
+
+        struct Stats
+        {
+            uint32_t     resident      = 0;
+            uint32_t     evicted       = 0; // right now
+            VkDeviceSize residentBytes = 0;
+            uint64_t     evictions     = 0; // since startup
+            VkDeviceSize evictedBytes  = 0; // since startup
+            uint64_t     restores      = 0; // since startup
+        };
+
+        // Freed by an eviction but maybe still counted by the driver.
+        struct Pending
+        {
+            uint64_t     frame = 0;
+            uint32_t     heap  = 0;
+            VkDeviceSize bytes = 0;
+        };
+
+        struct Manager
+        {
+            Budget                budget;
+            std::vector<Resource> resources; // index is the id
+            std::vector<Pending>  pending;
+            uint64_t              frame = 0;
+            Stats                 stats;
+        };
+
+        void Create(VkPhysicalDevice& physicalDevice, Manager& manager)
+        {
+            manager = Manager{};
+            manager.budget.supported = PhysicalDevice::HasExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
+        // Heap of the memory type an allocation with these requirements gets.
+        uint32_t HeapOf(VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+        {
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+            return memProperties.memoryTypes[Memory::FindType(physicalDevice, typeFilter, properties)].heapIndex;
+        }
+
+        /* Returns the id for Touch and Restored. Starts resident and used this
+        frame. Register and Restored count toward the heap's usage until the
+        next Sample, so Pressure sees pages created in the same frame. */
+        uint32_t Register(Manager& manager, const char* name, VkDeviceSize bytes, uint32_t heap, Evict evict)
+        {
+            manager.budget.heaps[heap].usage += bytes;
+
+            Resource resource;
+            resource.name     = name;
+            resource.bytes    = bytes;
+            resource.heap     = heap;
+            resource.lastUsed = manager.frame;
+            resource.evict    = std::move(evict);
+            manager.resources.push_back(std::move(resource));
+            return static_cast<uint32_t>(manager.resources.size() - 1);
+        }
+
+        // Every frame the resource is drawn with. False: evicted, restore it before drawing.
+        bool Touch(Manager& manager, uint32_t id)
+        {
+            Resource& resource = manager.resources[id];
+            resource.lastUsed  = manager.frame;
+            return resource.resident;
+        }
+
+        void Restored(Manager& manager, uint32_t id, VkDeviceSize bytes)
+        {
+            Resource& resource = manager.resources[id];
+            manager.budget.heaps[resource.heap].usage += bytes;
+            resource.bytes     = bytes;
+            resource.resident  = true;
+            resource.lastUsed  = manager.frame;
+            manager.stats.restores++;
+        }
+
+        static VkDeviceSize Registered(const Manager& manager, uint32_t heap)
+        {
+            VkDeviceSize bytes = 0;
+            for (const Resource& resource : manager.resources)
+            {
+                bytes += resource.resident && heap == resource.heap ? resource.bytes : 0;
+            }
+            return bytes;
+        }
+
+        void Sample(VkPhysicalDevice& physicalDevice, Manager& manager)
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+            budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+            VkPhysicalDeviceMemoryProperties2 memProperties{};
+            memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            memProperties.pNext = manager.budget.supported ? &budgetProperties : nullptr;
+            vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+            Budget& budget   = manager.budget;
+            budget.heapCount = memProperties.memoryProperties.memoryHeapCount;
+            for (uint32_t i = 0; i < budget.heapCount; ++i)
+            {
+                const VkMemoryHeap& heap = memProperties.memoryProperties.memoryHeaps[i];
+                budget.heaps[i].size        = heap.size;
+                budget.heaps[i].deviceLocal = 0 != (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+                budget.heaps[i].budget      = budget.supported ? budgetProperties.heapBudget[i] : heap.size;
+                budget.heaps[i].usage       = budget.supported ? budgetProperties.heapUsage[i] : Registered(manager, i);
+                if (SKY_RESIDENCY_BUDGET_MB > 0)
+                {
+                    budget.heaps[i].budget = std::min<VkDeviceSize>(budget.heaps[i].budget, VkDeviceSize(SKY_RESIDENCY_BUDGET_MB) * 1024 * 1024);
+                }
+            }
+        }
+
+        /* The heap's usage less what evictions freed but the driver may still
+        count. Without the extension usage is Registered, which already
+        leaves evicted resources out. */
+        static VkDeviceSize Usage(const Manager& manager, uint32_t heap)
+        {
+            VkDeviceSize usage = manager.budget.heaps[heap].usage;
+            for (const Pending& pending : manager.pending)
+            {
+                usage -= manager.budget.supported && heap == pending.heap ? std::min(usage, pending.bytes) : 0;
+            }
+            return usage;
+        }
+
+        // Above the high water mark: reuse what is there rather than allocate more.
+        bool Pressure(const Manager& manager, uint32_t heap)
+        {
+            return Usage(manager, heap) > manager.budget.heaps[heap].budget * kHighWater;
+        }
+
+        /* Least recently used first, until the heap is back under the low
+        water mark or nothing idle is left in it. */
+        static void EvictHeap(Manager& manager, uint32_t heap, VkDeviceSize usage)
+        {
+            VkDeviceSize target = static_cast<VkDeviceSize>(manager.budget.heaps[heap].budget * kLowWater);
+
+            std::vector<uint32_t> idle;
+            for (uint32_t id = 0; id < manager.resources.size(); ++id)
+            {
+                const Resource& resource = manager.resources[id];
+                if (resource.resident && heap == resource.heap && resource.lastUsed + kIdleFrames <= manager.frame)
+                {
+                    idle.push_back(id);
+                }
+            }
+            std::sort(idle.begin(), idle.end(), [&manager](uint32_t a, uint32_t b) { return manager.resources[a].lastUsed < manager.resources[b].lastUsed; });
+
+            for (uint32_t id : idle)
+            {
+                if (usage <= target)
+                {
+                    break;
+                }
+
+                Resource& resource = manager.resources[id];
+                resource.evict();
+                resource.resident = false;
+                usage -= std::min(usage, resource.bytes);
+                manager.pending.push_back({manager.frame, heap, resource.bytes});
+                manager.stats.evictions++;
+                manager.stats.evictedBytes += resource.bytes;
+            }
+        }
+
+        // Once a frame, after the fence wait and the resources' Touch calls.
+        void Update(VkPhysicalDevice& physicalDevice, Manager& manager)
+        {
+            manager.frame++;
+            Sample(physicalDevice, manager);
+
+            // The retire queue frees evicted memory a few frames late.
+            manager.pending.erase(std::remove_if(manager.pending.begin(), manager.pending.end(),
+                [&manager](const Pending& pending) { return pending.frame + kIdleFrames <= manager.frame; }), manager.pending.end());
+
+            for (uint32_t i = 0; i < manager.budget.heapCount; ++i)
+            {
+                if (manager.budget.heaps[i].deviceLocal && Pressure(manager, i))
+                {
+                    EvictHeap(manager, i, Usage(manager, i));
+                }
+            }
+
+            manager.stats.resident      = 0;
+            manager.stats.evicted       = 0;
+            manager.stats.residentBytes = 0;
+            for (const Resource& resource : manager.resources)
+            {
+                manager.stats.resident      += resource.resident ? 1 : 0;
+                manager.stats.evicted       += resource.resident ? 0 : 1;
+                manager.stats.residentBytes += resource.resident ? resource.bytes : 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Retire
+    {
+        /* Objects the GPU may still be using, destroyed once it is past them
+        instead of waiting for the device to go idle. Each one is tagged with
+        the frame that was being recorded when it was released; Collect
+        destroys a tag after that frame's fence and kLag more have signaled.
+
+        The render thread owns the queue: Retire* from anywhere on it,
+        Submitted after every frame's submit, Collect after the fence wait. */
+
+        // A frame's post chain and present finish behind the next frame's fence.
+        const uint64_t kLag = 1;
+
+        enum class Kind : uint32_t
+        {
+            Buffer,
+            Image,
+            ImageView,
+            Memory,
+            Framebuffer,
+            Pipeline,
+            RenderPass,
+            SwapChain
+        };
+
+        struct Entry
+        {
+            uint64_t frame = 0;
+            Kind     kind  = Kind::Buffer;
+            union
+            {
+                VkBuffer       buffer;
+                VkImage        image;
+                VkImageView    view;
+                VkDeviceMemory memory;
+                VkFramebuffer  framebuffer;
+                VkPipeline     pipeline;
+                VkRenderPass   renderPass;
+                VkSwapchainKHR swapChain;
+            };
+        };
+
+        struct Queue
+        {
+            std::vector<Entry> entries;        // in release order, so also in frame order
+            uint64_t           frame     = 0;  // frames submitted so far
+            uint64_t           destroyed = 0;  // since startup
+        };
+
+        static void Push(Queue& queue, Kind kind, Entry entry)
+        {
+            entry.frame = queue.frame;
+            entry.kind  = kind;
+            queue.entries.push_back(entry);
+        }
+
+        void Buffer(Queue& queue, VkBuffer& buffer, VkDeviceMemory& memory)
+        {
+            Entry entry{};
+            entry.buffer = buffer;
+            Push(queue, Kind::Buffer, entry);
+            entry.memory = memory;
+            Push(queue, Kind::Memory, entry);
+
+            buffer = VK_NULL_HANDLE;
+            memory = VK_NULL_HANDLE;
+        }
+
+        // view may be null.
+        void Image(Queue& queue, VkImage& image, VkDeviceMemory& memory, VkImageView& view)
+        {
+            Entry entry{};
+            if (VK_NULL_HANDLE != view)
+            {
+                entry.view = view;
+                Push(queue, Kind::ImageView, entry);
+            }
+            entry.image = image;
+            Push(queue, Kind::Image, entry);
+            entry.memory = memory;
+            Push(queue, Kind::Memory, entry);
+
+            image  = VK_NULL_HANDLE;
+            memory = VK_NULL_HANDLE;
+            view   = VK_NULL_HANDLE;
+        }
+
+        void ImageViews(Queue& queue, std::vector<VkImageView>& views)
+        {
+            for (VkImageView view : views)
+            {
+                Entry entry{};
+                entry.view = view;
+                Push(queue, Kind::ImageView, entry);
+            }
+            views.clear();
+        }
+
+        void Framebuffers(Queue& queue, std::vector<VkFramebuffer>& framebuffers)
+        {
+            for (VkFramebuffer framebuffer : framebuffers)
+            {
+                Entry entry{};
+                entry.framebuffer = framebuffer;
+                Push(queue, Kind::Framebuffer, entry);
+            }
+            framebuffers.clear();
+        }
+
+        void Pipeline(Queue& queue, VkPipeline& pipeline)
+        {
+            Entry entry{};
+            entry.pipeline = pipeline;
+            Push(queue, Kind::Pipeline, entry);
+            pipeline = VK_NULL_HANDLE;
+        }
+
+        void RenderPass(Queue& queue, VkRenderPass& renderPass)
+        {
+            Entry entry{};
+            entry.renderPass = renderPass;
+            Push(queue, Kind::RenderPass, entry);
+            renderPass = VK_NULL_HANDLE;
+        }
+
+        // Only after a new swapchain was created from it, its images go with it.
+        void SwapChain(Queue& queue, VkSwapchainKHR& swapChain)
+        {
+            Entry entry{};
+            entry.swapChain = swapChain;
+            Push(queue, Kind::SwapChain, entry);
+            swapChain = VK_NULL_HANDLE;
+        }
+
+        static void DestroyEntry(VkDevice& device, const Entry& entry)
+        {
+            switch (entry.kind)
+            {
+                case Kind::Buffer:      vkDestroyBuffer(device, entry.buffer, HostMemory::Callbacks()); break;
+                case Kind::Image:       vkDestroyImage(device, entry.image, HostMemory::Callbacks()); break;
+                case Kind::ImageView:   vkDestroyImageView(device, entry.view, HostMemory::Callbacks()); break;
+                case Kind::Memory:      vkFreeMemory(device, entry.memory, HostMemory::Callbacks()); break;
+                case Kind::Framebuffer: vkDestroyFramebuffer(device, entry.framebuffer, HostMemory::Callbacks()); break;
+                case Kind::Pipeline:    vkDestroyPipeline(device, entry.pipeline, HostMemory::Callbacks()); break;
+                case Kind::RenderPass:  vkDestroyRenderPass(device, entry.renderPass, HostMemory::Callbacks()); break;
+                case Kind::SwapChain:   vkDestroySwapchainKHR(device, entry.swapChain, HostMemory::Callbacks()); break;
+            }
+        }
+
+        void Submitted(Queue& queue)
+        {
+            queue.frame++;
+        }
+
+        /* Right after the in flight fence wait: every submitted frame but the
+        last kLag is done, so their entries go in one batch. */
+        void Collect(VkDevice& device, Queue& queue)
+        {
+            size_t done = 0;
+            while (done < queue.entries.size() && queue.entries[done].frame + kLag < queue.frame)
+            {
+                DestroyEntry(device, queue.entries[done]);
+                done++;
+            }
+
+            queue.entries.erase(queue.entries.begin(), queue.entries.begin() + done);
+            queue.destroyed += done;
+        }
+
+        // At teardown, once the device is idle.
+        void Flush(VkDevice& device, Queue& queue)
+        {
+            for (const Entry& entry : queue.entries)
+            {
+                DestroyEntry(device, entry);
+            }
+
+            queue.destroyed += queue.entries.size();
+            queue.entries.clear();
+        }
+    }
+}
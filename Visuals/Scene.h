@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "Math.h"
+#include "Jobs.h"
+#include "Objects.h"
+
+namespace Visuals
+{
+    namespace Scene
+    {
+        /* Transform hierarchy as parallel arrays indexed by slot. Slots are
+        sorted by depth, so every parent sits before its children and each
+        depth level is one contiguous range whose nodes only read the
+        previous levels: levels run in order, a level's range runs in
+        parallel. world[] is the flat array uploaded as Objects models, slot
+        i is object i / firstInstance i.
+
+        Nodes are addressed by stable handles; slots move when the hierarchy
+        is re-sorted after an Add.
+        */
+
+        const uint32_t kNone = ~0u;
+
+        struct Transform
+        {
+            glm::vec3 position{0.0f};
+            glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+            glm::vec3 scale{1.0f};
+        };
+
+        struct Graph
+        {
+            // By slot.
+            std::vector<uint32_t>  parent;      // slot, kNone for roots
+            std::vector<uint32_t>  depth;
+            std::vector<glm::vec3> position;
+            std::vector<glm::quat> rotation;
+            std::vector<glm::vec3> scale;
+            std::vector<glm::vec4> localSphere; // Objects::kNoBounds when there is nothing to draw
+            std::vector<uint8_t>   dirty;       // local transform changed, propagated down during Update
+            std::vector<glm::mat4> world;
+            std::vector<glm::vec4> worldSphere;
+            std::vector<uint32_t>  handleOf;
+
+            // By handle.
+            std::vector<uint32_t>  slotOf;
+
+            // First slot of every depth, plus the end.
+            std::vector<uint32_t>  levels{0};
+            bool                   sorted = true;
+
+            // Slots whose world matrix changed during the last Update.
+            uint32_t               changedBegin = 0;
+            uint32_t               changedEnd   = 0;
+        };
+
+        uint32_t Count(const Graph& graph)
+        {
+            return static_cast<uint32_t>(graph.parent.size());
+        }
+
+        uint32_t Add(Graph& graph, uint32_t parentHandle, const Transform& transform, const glm::vec4& localSphere = Objects::kNoBounds)
+        {
+            uint32_t handle     = static_cast<uint32_t>(graph.slotOf.size());
+            uint32_t slot       = Count(graph);
+            uint32_t parentSlot = kNone == parentHandle ? kNone : graph.slotOf[parentHandle];
+            uint32_t depth      = kNone == parentSlot ? 0 : graph.depth[parentSlot] + 1;
+
+            // Appending keeps the order only while depths never decrease.
+            if (slot > 0 && depth < graph.depth.back())
+            {
+                graph.sorted = false;
+            }
+
+            graph.parent.push_back(parentSlot);
+            graph.depth.push_back(depth);
+            graph.position.push_back(transform.position);
+            graph.rotation.push_back(transform.rotation);
+            graph.scale.push_back(transform.scale);
+            graph.localSphere.push_back(localSphere);
+            graph.dirty.push_back(1);
+            graph.world.emplace_back(1.0f);
+            graph.worldSphere.push_back(localSphere);
+            graph.handleOf.push_back(handle);
+            graph.slotOf.push_back(slot);
+
+            if (graph.sorted)
+            {
+                graph.levels.resize(depth + 2, slot);
+                graph.levels[depth + 1] = slot + 1;
+            }
+
+            return handle;
+        }
+
+        void SetTransform(Graph& graph, uint32_t handle, const Transform& transform)
+        {
+            uint32_t slot = graph.slotOf[handle];
+            graph.position[slot] = transform.position;
+            graph.rotation[slot] = transform.rotation;
+            graph.scale[slot]    = transform.scale;
+            graph.dirty[slot]    = 1;
+        }
+
+        void SetPosition(Graph& graph, uint32_t handle, const glm::vec3& position)
+        {
+            uint32_t slot = graph.slotOf[handle];
+            graph.position[slot] = position;
+            graph.dirty[slot]    = 1;
+        }
+
+        namespace Detail
+        {
+            template <typename T>
+            void Permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+            {
+                std::vector<T> sorted(values.size());
+                for (size_t i = 0; i < order.size(); ++i)
+                {
+                    sorted[i] = values[order[i]];
+                }
+                values.swap(sorted);
+            }
+
+            // Stable counting sort by depth, parents keep preceding their children.
+            void Sort(Graph& graph)
+            {
+                uint32_t count    = Count(graph);
+                uint32_t maxDepth = *std::max_element(graph.depth.begin(), graph.depth.end());
+
+                graph.levels.assign(maxDepth + 2, 0);
+                for (uint32_t depth : graph.depth)
+                {
+                    graph.levels[depth + 1]++;
+                }
+                for (uint32_t level = 1; level < graph.levels.size(); ++level)
+                {
+                    graph.levels[level] += graph.levels[level - 1];
+                }
+
+                std::vector<uint32_t> order(count);
+                std::vector<uint32_t> newSlot(count);
+                std::vector<uint32_t> next(graph.levels.begin(), graph.levels.end() - 1);
+                for (uint32_t slot = 0; slot < count; ++slot)
+                {
+                    uint32_t target = next[graph.depth[slot]]++;
+                    order[target]   = slot;
+                    newSlot[slot]   = target;
+                }
+
+                for (uint32_t& parent : graph.parent)
+                {
+                    parent = kNone == parent ? kNone : newSlot[parent];
+                }
+
+                Permute(graph.parent, order);
+                Permute(graph.depth, order);
+                Permute(graph.position, order);
+                Permute(graph.rotation, order);
+                Permute(graph.scale, order);
+                Permute(graph.localSphere, order);
+                Permute(graph.worldSphere, order);
+                Permute(graph.handleOf, order);
+
+                for (uint32_t slot = 0; slot < count; ++slot)
+                {
+                    graph.slotOf[graph.handleOf[slot]] = slot;
+                }
+
+                // Every slot moved, so everything is recomputed and re-uploaded.
+                graph.dirty.assign(count, 1);
+                graph.sorted = true;
+            }
+
+            glm::mat4 Compose(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+            {
+                glm::mat4 local = glm::mat4_cast(rotation);
+                local[0] *= scale.x;
+                local[1] *= scale.y;
+                local[2] *= scale.z;
+                local[3]  = glm::vec4(position, 1.0f);
+                return local;
+            }
+
+            // Updates [begin, end) of one level and widens the changed slot range.
+            void UpdateRange(Graph& graph, uint32_t begin, uint32_t end, uint32_t& changedBegin, uint32_t& changedEnd)
+            {
+                for (uint32_t slot = begin; slot < end; ++slot)
+                {
+                    uint32_t parent = graph.parent[slot];
+
+                    if (0 == graph.dirty[slot] && (kNone == parent || 0 == graph.dirty[parent]))
+                    {
+                        continue;
+                    }
+
+                    glm::mat4 local   = Compose(graph.position[slot], graph.rotation[slot], graph.scale[slot]);
+                    glm::mat4& world  = graph.world[slot];
+                    world             = kNone == parent ? local : graph.world[parent] * local;
+                    graph.dirty[slot] = 1; // children of a moved parent move too
+
+                    const glm::vec4& sphere = graph.localSphere[slot];
+                    if (sphere.w >= 0.0f)
+                    {
+                        float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+                        graph.worldSphere[slot] = glm::vec4(glm::vec3(world * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w * scale);
+                    }
+
+                    changedBegin = std::min(changedBegin, slot);
+                    changedEnd   = std::max(changedEnd, slot + 1);
+                }
+            }
+        }
+
+        /* Recomputes the world matrices of dirty nodes and their subtrees.
+        With a scheduler, levels wider than a few thousand nodes are split
+        into jobs; each level still finishes before the next one starts. */
+        void Update(Graph& graph, Jobs::Scheduler* jobs = nullptr)
+        {
+            const uint32_t kMaxRanges = 64;
+
+            graph.changedBegin = Count(graph);
+            graph.changedEnd   = 0;
+
+            if (0 == Count(graph))
+            {
+                return;
+            }
+
+            if (!graph.sorted)
+            {
+                Detail::Sort(graph);
+            }
+
+            for (size_t level = 0; level + 1 < graph.levels.size(); ++level)
+            {
+                uint32_t levelBegin = graph.levels[level];
+                uint32_t changedBegins[kMaxRanges];
+                uint32_t changedEnds[kMaxRanges];
+
+                uint32_t ranges = Jobs::ParallelFor(jobs, graph.levels[level + 1] - levelBegin, 4096, 1, kMaxRanges, [&](uint32_t range, uint32_t begin, uint32_t end)
+                {
+                    changedBegins[range] = Count(graph);
+                    changedEnds[range]   = 0;
+                    Detail::UpdateRange(graph, levelBegin + begin, levelBegin + end, changedBegins[range], changedEnds[range]);
+                });
+
+                for (uint32_t range = 0; range < ranges; ++range)
+                {
+                    graph.changedBegin = std::min(graph.changedBegin, changedBegins[range]);
+                    graph.changedEnd   = std::max(graph.changedEnd, changedEnds[range]);
+                }
+            }
+
+            std::fill(graph.dirty.begin(), graph.dirty.end(), 0);
+        }
+
+        // Straight copy of the changed part of world[] into the next per-frame copy.
+        void Upload(Graph& graph, Objects::Buffer& objects)
+        {
+            if (Count(graph) != objects.count)
+            {
+                throw std::runtime_error("Scene and object buffer sizes differ !");
+            }
+
+            Objects::Write(objects, graph.world.data(), graph.worldSphere.data(), graph.changedBegin, graph.changedEnd);
+        }
+    }
+}
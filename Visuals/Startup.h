@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Jobs.h"
+
+namespace Visuals
+{
+    namespace Startup
+    {
+        /* Initialization as a dependency graph. A step starts once every step
+        it comes after has finished; worker steps go to the job scheduler,
+        main steps (GLFW) run on the thread that calls Run, in between.
+        Every step is timed against the start of Run for the report. */
+
+        enum class Thread
+        {
+            Main,
+            Worker
+        };
+
+        enum class State
+        {
+            Waiting,
+            Running,
+            Finished
+        };
+
+        struct Step
+        {
+            const char*            name   = "";
+            Thread                 thread = Thread::Worker;
+            std::function<void()>  run;
+            std::vector<uint32_t>  after;
+            Jobs::Counter          done;
+            State                  state   = State::Waiting;
+            bool                   skipped = false; // an earlier step failed
+            std::exception_ptr     error;
+            double                 startMs = 0.0;
+            double                 endMs   = 0.0;
+        };
+
+        struct Graph
+        {
+            std::deque<Step>                      steps; // stable addresses for the jobs
+            std::chrono::steady_clock::time_point origin;
+            double                                wallMs = 0.0;
+        };
+
+        // Returns the step's index, for the after lists of later steps.
+        uint32_t Add(Graph& graph, const char* name, Thread thread, std::vector<uint32_t> after, std::function<void()> run)
+        {
+            graph.steps.emplace_back();
+            Step& step  = graph.steps.back();
+            step.name   = name;
+            step.thread = thread;
+            step.after  = std::move(after);
+            step.run    = std::move(run);
+            return static_cast<uint32_t>(graph.steps.size() - 1);
+        }
+
+        static double Since(const Graph& graph)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - graph.origin).count();
+        }
+
+        static void Time(Graph& graph, Step& step)
+        {
+            step.startMs = Since(graph);
+            try
+            {
+                step.run();
+            }
+            catch (...)
+            {
+                step.error = std::current_exception();
+            }
+            step.endMs = Since(graph);
+        }
+
+        static bool Ready(const Graph& graph, const Step& step)
+        {
+            for (uint32_t index : step.after)
+            {
+                if (State::Finished != graph.steps[index].state)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /* Returns once every step has finished. The first error is rethrown
+        after the steps already running are done; steps not started by then
+        are skipped. */
+        void Run(Graph& graph, Jobs::Scheduler& jobs)
+        {
+            graph.origin    = std::chrono::steady_clock::now();
+            size_t finished = 0;
+            bool   failed   = false;
+
+            while (finished < graph.steps.size())
+            {
+                bool progressed = false;
+
+                for (Step& step : graph.steps)
+                {
+                    if (State::Running == step.state && 0 == step.done.value.load(std::memory_order_acquire))
+                    {
+                        Jobs::Wait(jobs, step.done);
+                        step.state = State::Finished;
+                        failed     = failed || nullptr != step.error;
+                        finished++;
+                        progressed = true;
+                    }
+                }
+
+                // Workers first, so they are busy while this thread runs a main step.
+                for (Thread thread : {Thread::Worker, Thread::Main})
+                {
+                    for (Step& step : graph.steps)
+                    {
+                        if (thread != step.thread || State::Waiting != step.state || !Ready(graph, step))
+                        {
+                            continue;
+                        }
+
+                        progressed = true;
+                        if (failed)
+                        {
+                            step.state   = State::Finished;
+                            step.skipped = true;
+                            finished++;
+                        }
+                        else if (Thread::Main == step.thread)
+                        {
+                            Time(graph, step);
+                            step.state = State::Finished;
+                            failed     = failed || nullptr != step.error;
+                            finished++;
+                        }
+                        else
+                        {
+                            step.state = State::Running;
+                            Jobs::Run(jobs, [&graph, &step]() { Time(graph, step); }, &step.done);
+                        }
+                    }
+                }
+
+                if (progressed)
+                {
+                    continue;
+                }
+
+                /* Nothing to start: run one job here, which may be a step, then
+                look again so a main step never waits on an unrelated one. */
+                bool running = std::any_of(graph.steps.begin(), graph.steps.end(), [](const Step& step) { return State::Running == step.state; });
+                if (!running)
+                {
+                    throw std::runtime_error("Startup steps depend on each other in a cycle !");
+                }
+                if (Jobs::Job* job = Jobs::Detail::Next(jobs))
+                {
+                    Jobs::Detail::Execute(jobs, job);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            graph.wallMs = Since(graph);
+
+            for (const Step& step : graph.steps)
+            {
+                if (nullptr != step.error)
+                {
+                    std::rethrow_exception(step.error);
+                }
+            }
+        }
+
+        // Steps in start order, then the wall time against running them one after another.
+        void Report(const Graph& graph)
+        {
+            std::vector<const Step*> order;
+            double serialMs = 0.0;
+            for (const Step& step : graph.steps)
+            {
+                order.push_back(&step);
+                serialMs += step.endMs - step.startMs;
+            }
+            std::sort(order.begin(), order.end(), [](const Step* a, const Step* b) { return a->startMs < b->startMs; });
+
+            std::cout << std::fixed << std::setprecision(2);
+            for (const Step* step : order)
+            {
+                std::cout << "[startup] " << std::left << std::setw(20) << step->name << std::right
+                          << " at " << std::setw(8) << step->startMs << " ms, took " << std::setw(8) << step->endMs - step->startMs << " ms"
+                          << (Thread::Main == step->thread ? " (main)" : "") << (step->skipped ? " skipped" : "") << std::endl;
+            }
+            std::cout << "[startup] " << graph.steps.size() << " steps in " << graph.wallMs << " ms, " << serialMs << " ms one after another" << std::endl;
+            std::cout << std::defaultfloat << std::setprecision(6);
+        }
+    }
+}
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
 
 namespace Visuals
 {
@@ -17,7 +18,7 @@ namespace Visuals
                 throw std::runtime_error("Invalid Vulkan instance!");
             }
 
-            if (VK_SUCCESS != glfwCreateWindowSurface(instance, window, nullptr, &surface))
+            if (VK_SUCCESS != glfwCreateWindowSurface(instance, window, HostMemory::Callbacks(), &surface))
             {
                 throw std::runtime_error("Failed to create window surface !");
             }
@@ -27,7 +28,7 @@ namespace Visuals
         {
             if (surface != VK_NULL_HANDLE)
             {
-                vkDestroySurfaceKHR(instance, surface, nullptr);
+                vkDestroySurfaceKHR(instance, surface, HostMemory::Callbacks());
                 surface = VK_NULL_HANDLE;
             }
         }
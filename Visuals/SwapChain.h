@@ -9,6 +9,10 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "Device.h"
+#include "Dispatch.h"
+#include "HostMemory.h"
+#include "RenderContext.h"
+#include "Window.h"
 
 namespace Visuals
 {
@@ -71,7 +75,8 @@ namespace Visuals
             return VK_PRESENT_MODE_FIFO_KHR;
         }
 
-        VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow*& window)
+        // framebufferSize is only used when the surface leaves the extent to the swapchain.
+        VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D framebufferSize)
         {
             if (std::numeric_limits<uint32_t>::max() != capabilities.currentExtent.width)
             {
@@ -79,14 +84,7 @@ namespace Visuals
             }
             else
             {
-                int width, height;
-                glfwGetFramebufferSize(window, &width, &height);
-
-                VkExtent2D actualExtent =
-                {
-                    static_cast<uint32_t>(width),
-                    static_cast<uint32_t>(height)
-                };
+                VkExtent2D actualExtent = framebufferSize;
 
                 actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
                 actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
@@ -95,13 +93,16 @@ namespace Visuals
             }
         }
 
-        void Create(VkSwapchainKHR& swapChain, VkPhysicalDevice& physicalDevice, VkDevice& device, VkSurfaceKHR& surface, GLFWwindow*& window, std::vector<VkImage>& swapChainImages, VkFormat& swapChainImageFormat, VkExtent2D& swapChainExtent)
+        /* oldSwapChain is retired by the new one but stays valid until destroyed.
+        framebufferSize is the window's, from Window::FramebufferSize on the
+        main thread, so this can run on the render thread. */
+        void Create(VkSwapchainKHR& swapChain, VkPhysicalDevice& physicalDevice, VkDevice& device, VkSurfaceKHR& surface, VkExtent2D framebufferSize, std::vector<VkImage>& swapChainImages, VkFormat& swapChainImageFormat, VkExtent2D& swapChainExtent, VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE)
         {
             SupportDetails swapChainSupport = QuerySupport(physicalDevice, surface);
 
             VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
             VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
-            VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities, window);
+            VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities, framebufferSize);
 
             uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 
@@ -120,6 +121,11 @@ namespace Visuals
             createInfo.imageArrayLayers = 1;
             createInfo.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+            // Dynamic resolution and post blit into the images instead of rendering to them.
+            createInfo.imageUsage      |= swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            // Offline output copies the finished frames out, see Readback.h.
+            createInfo.imageUsage      |= swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
             PhysicalDevice::QueueFamilyIndices indices = PhysicalDevice::FindQueueFamilies(physicalDevice, surface);
             uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -140,9 +146,9 @@ namespace Visuals
             createInfo.compositeAlpha   = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
             createInfo.presentMode      = presentMode;
             createInfo.clipped          = VK_TRUE;
-            createInfo.oldSwapchain     = VK_NULL_HANDLE;
+            createInfo.oldSwapchain     = oldSwapChain;
 
-            if (VK_SUCCESS != vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain))
+            if (VK_SUCCESS != vkCreateSwapchainKHR(device, &createInfo, HostMemory::Callbacks(), &swapChain))
             {
                 throw std::runtime_error("Failed to create swap chain !");
             }
@@ -157,7 +163,7 @@ namespace Visuals
 
         void Destroy(VkSwapchainKHR& swapChain, VkDevice& device)
         {
-            vkDestroySwapchainKHR(device, swapChain, nullptr);
+            vkDestroySwapchainKHR(device, swapChain, HostMemory::Callbacks());
         }
     }
 
@@ -186,7 +192,7 @@ namespace Visuals
                 viewInfo.subresourceRange.baseArrayLayer = 0;
                 viewInfo.subresourceRange.layerCount     = 1;
 
-                if (VK_SUCCESS != vkCreateImageView(device, &viewInfo, nullptr, &swapChainImageViews[i]))
+                if (VK_SUCCESS != vkCreateImageView(device, &viewInfo, HostMemory::Callbacks(), &swapChainImageViews[i]))
                 {
                     throw std::runtime_error("Failed to create image view for swap chain image");
                 }
@@ -197,14 +203,15 @@ namespace Visuals
         {
            for (auto imageView : swapChainImageViews)
            {
-                vkDestroyImageView(device, imageView, nullptr);
+                vkDestroyImageView(device, imageView, HostMemory::Callbacks());
             } 
         }
     }
 
     namespace Buffers
     {
-        void Create(VkDevice& device, std::vector<VkFramebuffer>& swapChainFramebuffers , std::vector<VkImageView>& swapChainImageViews, VkRenderPass& renderPass, VkExtent2D& swapChainExtent)
+        // With a multisampled colorImageView the swapchain image becomes the resolve target.
+        void Create(VkDevice& device, std::vector<VkFramebuffer>& swapChainFramebuffers , std::vector<VkImageView>& swapChainImageViews, VkImageView& depthImageView, VkRenderPass& renderPass, VkExtent2D& swapChainExtent, VkImageView colorImageView = VK_NULL_HANDLE)
         {
             swapChainFramebuffers.resize(swapChainImageViews.size());
 
@@ -212,19 +219,27 @@ namespace Visuals
             {
                 VkImageView attachments[] =
                 {
+                    swapChainImageViews[i],
+                    depthImageView,
                     swapChainImageViews[i]
                 };
 
+                bool multisampled = VK_NULL_HANDLE != colorImageView;
+                if (multisampled)
+                {
+                    attachments[0] = colorImageView;
+                }
+
                 VkFramebufferCreateInfo framebufferInfo{};
                 framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
                 framebufferInfo.renderPass      = renderPass;
-                framebufferInfo.attachmentCount = 1;
+                framebufferInfo.attachmentCount = multisampled ? 3 : 2;
                 framebufferInfo.pAttachments    = attachments;
                 framebufferInfo.width           = swapChainExtent.width;
                 framebufferInfo.height          = swapChainExtent.height;
                 framebufferInfo.layers          = 1;
 
-                if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]))
+                if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferInfo, HostMemory::Callbacks(), &swapChainFramebuffers[i]))
                 {
                     throw std::runtime_error("Failed to create framebuffer !");
                 }
@@ -235,7 +250,7 @@ namespace Visuals
         {
             for (auto framebuffer : swapChainFramebuffers)
             {
-                vkDestroyFramebuffer(device, framebuffer, nullptr);
+                vkDestroyFramebuffer(device, framebuffer, HostMemory::Callbacks());
             }
         }
     }
@@ -252,7 +267,7 @@ namespace Visuals
             poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
 
-            if (VK_SUCCESS != vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool))
+            if (VK_SUCCESS != vkCreateCommandPool(device, &poolInfo, HostMemory::Callbacks(), &commandPool))
             {
                 throw std::runtime_error("Failed to create command pool !");
             }
@@ -260,7 +275,7 @@ namespace Visuals
 
         void Destoy(VkDevice& device, VkCommandPool& commandPool)
         {
-            vkDestroyCommandPool(device, commandPool, nullptr);
+            vkDestroyCommandPool(device, commandPool, HostMemory::Callbacks());
         }
     }
 
@@ -280,33 +295,25 @@ namespace Visuals
             }
         }
 
-        void Record(VkCommandPool& commandPool, VkCommandBuffer& commandBuffer, uint32_t imageIndex, VkRenderPass& renderPass, std::vector<VkFramebuffer>& swapChainFramebuffers, VkExtent2D& swapChainExtent, VkPipeline& graphicsPipeline)
+        static void BeginPass(VkCommandBuffer& commandBuffer, VkRenderPass& renderPass, VkFramebuffer& framebuffer, VkExtent2D& swapChainExtent)
         {
-            VkCommandBufferBeginInfo beginInfo{};
-            beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags            = 0; // Optional
-            beginInfo.pInheritanceInfo = nullptr; // Optional
-
-            if (VK_SUCCESS != vkBeginCommandBuffer(commandBuffer, &beginInfo))
-            {
-                throw std::runtime_error("Failed to begin recording command buffer !");
-            }
-
             VkRenderPassBeginInfo renderPassInfo{};
             renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
             renderPassInfo.renderPass        = renderPass;
-            renderPassInfo.framebuffer       = swapChainFramebuffers[imageIndex];
+            renderPassInfo.framebuffer       = framebuffer;
 
             renderPassInfo.renderArea.offset = {0, 0};
             renderPassInfo.renderArea.extent = swapChainExtent;
 
-            VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-            renderPassInfo.clearValueCount   = 1;
-            renderPassInfo.pClearValues      = &clearColor;
-
-            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            // Ignored by passes that load their attachments.
+            VkClearValue clearValues[2]{};
+            clearValues[0].color             = {{0.0f, 0.0f, 0.0f, 1.0f}};
+            clearValues[1].depthStencil      = {1.0f, 0};
+            renderPassInfo.clearValueCount   = 2;
+            renderPassInfo.pClearValues      = clearValues;
 
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.CmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
             VkViewport viewport{};
             viewport.x        = 0.0f;
@@ -315,18 +322,399 @@ namespace Visuals
             viewport.height   = static_cast<float>(swapChainExtent.height);
             viewport.minDepth = 0.0f;
             viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vk.CmdSetViewport(commandBuffer, 0, 1, &viewport);
 
             VkRect2D scissor{};
             scissor.offset = {0, 0};
             scissor.extent = swapChainExtent;
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            vk.CmdSetScissor(commandBuffer, 0, 1, &scissor);
+        }
 
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        static void BindMesh(VkCommandBuffer& commandBuffer, RenderContext& context, VkPipeline pipeline)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            VkDescriptorSet sets[] = {Objects::CurrentSet(*context.objects), context.uniforms->descriptorSet};
+            vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context.meshPipelineLayout, 0, 2, sets, 1, &context.frameOffset);
+        }
 
-            vkCmdEndRenderPass(commandBuffer);
+        static void CaptureBind(RenderContext& context, Capture::Pipeline pipeline)
+        {
+            if (nullptr != context.capture)
+            {
+                Capture::BindPipeline(*context.capture, pipeline);
+            }
+        }
+
+        // Cluster, CPU culled or single draws of the bound mesh pipeline.
+        static void DrawMesh(VkCommandBuffer& commandBuffer, RenderContext& context)
+        {
+            if (nullptr != context.clusters)
+            {
+                ClusterCull::Draw(commandBuffer, *context.clusters, *context.mesh);
+                return;
+            }
+
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+            VkDeviceSize vertexOffset = context.mesh->vertexOffset;
+            vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &context.mesh->buffer, &vertexOffset);
+            vk.CmdBindIndexBuffer(commandBuffer, context.mesh->buffer, context.mesh->indexOffset, context.mesh->indexType);
+
+            if (nullptr != context.visibleObjects)
+            {
+                for (uint32_t i = 0; i < context.visibleCount; ++i)
+                {
+                    vk.CmdDrawIndexed(commandBuffer, context.mesh->indexCount, 1, 0, 0, context.visibleObjects[i]);
+                }
+            }
+            else
+            {
+                vk.CmdDrawIndexed(commandBuffer, context.mesh->indexCount, 1, 0, 0, 0);
+            }
+
+            if (nullptr != context.capture && nullptr != context.visibleObjects)
+            {
+                for (uint32_t i = 0; i < context.visibleCount; ++i)
+                {
+                    Capture::DrawIndexed(*context.capture, context.mesh->indexCount, context.visibleObjects[i]);
+                }
+            }
+            else if (nullptr != context.capture)
+            {
+                Capture::DrawIndexed(*context.capture, context.mesh->indexCount, 0);
+            }
+        }
+
+        /* CPU culled objects through the render queue: nearest first, so
+        early depth testing rejects more of what is behind, and a pipeline
+        or set is only bound when it changes. With the depth prepass the
+        depth only draws are phase 0 and the EQUAL ones phase 1. */
+        static void DrawQueued(VkCommandBuffer& commandBuffer, RenderContext& context)
+        {
+            Dispatch::DeviceTable& vk    = Dispatch::Device();
+            RenderQueue::Queue&    queue = *context.queue;
+            RenderQueue::Clear(queue);
+
+            RenderQueue::Material material;
+            material.layout      = context.meshPipelineLayout;
+            material.setCount    = 2;
+            material.sets[0]     = Objects::CurrentSet(*context.objects);
+            material.sets[1]     = context.uniforms->descriptorSet;
+            material.offsetCount = 1;
+            material.offsets[0]  = context.frameOffset;
+            uint32_t materialIndex = RenderQueue::AddMaterial(queue, material);
+
+            uint32_t phases       = context.depthPrepass ? 2 : 1;
+            uint32_t pipelines[2] = {RenderQueue::AddPipeline(queue, context.depthPrepass ? context.depthPrepassPipeline : context.meshPipeline),
+                                     RenderQueue::AddPipeline(queue, context.meshEqualPipeline)};
+
+            for (uint32_t i = 0; i < context.visibleCount; ++i)
+            {
+                uint32_t         object  = context.visibleObjects[i];
+                const glm::vec4& sphere  = context.spheres[object];
+                float            nearest = glm::length(glm::vec3(sphere) - context.cameraPosition) - sphere.w;
+                uint32_t         depth   = RenderQueue::DepthBucket(nearest, context.zNear, context.zFar);
+
+                RenderQueue::Draw draw;
+                draw.indexCount    = context.mesh->indexCount;
+                draw.firstInstance = object;
+                for (uint32_t phase = 0; phase < phases; ++phase)
+                {
+                    RenderQueue::Push(queue, RenderQueue::Key(phase, pipelines[phase], materialIndex, depth), draw);
+                }
+            }
+            RenderQueue::Sort(queue);
+
+            VkDeviceSize vertexOffset = context.mesh->vertexOffset;
+            vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &context.mesh->buffer, &vertexOffset);
+            vk.CmdBindIndexBuffer(commandBuffer, context.mesh->buffer, context.mesh->indexOffset, context.mesh->indexType);
+            for (uint32_t phase = 0; phase < phases; ++phase)
+            {
+                RenderQueue::Record(commandBuffer, queue, phase);
+            }
+        }
+
+        /* Resident terrain chunks inside the frustum through the render
+        queue with the identity object 0, one material per arena page that
+        binds the page's buffer, nearest first within a page. Drawing a
+        chunk keeps its page resident. Phases as in DrawQueued. */
+        static void DrawTerrain(VkCommandBuffer& commandBuffer, RenderContext& context)
+        {
+            RenderQueue::Queue& queue   = *context.queue;
+            Terrain::Gpu&       terrain = *context.terrain;
+            RenderQueue::Clear(queue);
+
+            RenderQueue::Material material;
+            material.layout      = context.meshPipelineLayout;
+            material.setCount    = 2;
+            material.sets[0]     = Objects::CurrentSet(*context.objects);
+            material.sets[1]     = context.uniforms->descriptorSet;
+            material.offsetCount = 1;
+            material.offsets[0]  = context.frameOffset;
+
+            uint32_t materials[Terrain::kPages] = {};
+            for (uint32_t page = 0; page < Terrain::kPages; ++page)
+            {
+                if (VK_NULL_HANDLE != terrain.pages[page].buffer)
+                {
+                    material.vertexBuffer = terrain.pages[page].buffer;
+                    material.indexBuffer  = terrain.pages[page].buffer;
+                    materials[page]       = RenderQueue::AddMaterial(queue, material);
+                }
+            }
+
+            uint32_t phases       = context.depthPrepass ? 2 : 1;
+            uint32_t pipelines[2] = {RenderQueue::AddPipeline(queue, context.depthPrepass ? context.depthPrepassPipeline : context.meshPipeline),
+                                     RenderQueue::AddPipeline(queue, context.meshEqualPipeline)};
+
+            terrain.stats.drawn     = 0;
+            terrain.stats.triangles = 0;
+            std::fill(std::begin(terrain.stats.lodDrawn), std::end(terrain.stats.lodDrawn), 0u);
+            for (const auto& entry : terrain.resident)
+            {
+                const Terrain::Resident& chunk = entry.second;
+                if (0 == chunk.indexCount || !Terrain::Visible(chunk, context.frustumPlanes))
+                {
+                    continue;
+                }
+
+                glm::vec3 closest = glm::clamp(context.cameraPosition, chunk.min, chunk.max);
+                uint32_t  depth   = RenderQueue::DepthBucket(glm::length(closest - context.cameraPosition), context.zNear, context.zFar);
+
+                RenderQueue::Draw draw;
+                draw.indexCount   = chunk.indexCount;
+                draw.firstIndex   = chunk.firstIndex;
+                draw.vertexOffset = chunk.vertexOffset;
+                for (uint32_t phase = 0; phase < phases; ++phase)
+                {
+                    RenderQueue::Push(queue, RenderQueue::Key(phase, pipelines[phase], materials[chunk.page], depth), draw);
+                }
+                Terrain::Drawn(terrain, chunk);
+
+                terrain.stats.drawn++;
+                terrain.stats.triangles += chunk.indexCount / 3;
+                terrain.stats.lodDrawn[chunk.lod]++;
+            }
+            RenderQueue::Sort(queue);
+
+            for (uint32_t phase = 0; phase < phases; ++phase)
+            {
+                RenderQueue::Record(commandBuffer, queue, phase);
+            }
+        }
+
+        // Pipeline statistics around one render pass, when they are on.
+        static void BeginStats(VkCommandBuffer& commandBuffer, RenderContext& context, const char* name, VkExtent2D extent)
+        {
+            if (nullptr != context.pipelineStats)
+            {
+                PipelineStats::BeginPass(commandBuffer, *context.pipelineStats, name, extent);
+            }
+        }
+
+        static void EndStats(VkCommandBuffer& commandBuffer, RenderContext& context)
+        {
+            if (nullptr != context.pipelineStats)
+            {
+                PipelineStats::EndPass(commandBuffer, *context.pipelineStats);
+            }
+        }
+
+        // Early pass, pyramid, late pass. Everything visible last frame goes
+        // first so the pyramid is built from an almost complete depth buffer.
+        static void RecordOcclusion(VkCommandBuffer& commandBuffer, VkFramebuffer& framebuffer, VkExtent2D& swapChainExtent, RenderContext& context)
+        {
+            Occlusion::Resources&  occlusion = *context.occlusion;
+            Dispatch::DeviceTable& vk        = Dispatch::Device();
+
+            Occlusion::Cull(commandBuffer, occlusion, *context.objects, Occlusion::Phase::First, context.view, context.projection, context.zNear, context.zFar);
+
+            BeginStats(commandBuffer, context, "early", swapChainExtent);
+            BeginPass(commandBuffer, context.renderPassFirst, framebuffer, swapChainExtent);
+            BindMesh(commandBuffer, context, context.meshPipeline);
+            Occlusion::Draw(commandBuffer, occlusion, *context.mesh, Occlusion::Phase::First);
+            vk.CmdEndRenderPass(commandBuffer);
+            EndStats(commandBuffer, context);
+
+            Occlusion::BuildPyramid(commandBuffer, occlusion, swapChainExtent);
+            Occlusion::Cull(commandBuffer, occlusion, *context.objects, Occlusion::Phase::Second, context.view, context.projection, context.zNear, context.zFar);
+
+            BeginStats(commandBuffer, context, "late", swapChainExtent);
+            BeginPass(commandBuffer, context.renderPassSecond, framebuffer, swapChainExtent);
+            BindMesh(commandBuffer, context, context.meshPipeline);
+            Occlusion::Draw(commandBuffer, occlusion, *context.mesh, Occlusion::Phase::Second);
+            vk.CmdEndRenderPass(commandBuffer);
+            EndStats(commandBuffer, context);
+        }
+
+        // Terrain, or the mesh with or without depth prepass, the triangle without either.
+        static void DrawScene(VkCommandBuffer& commandBuffer, VkPipeline& graphicsPipeline, RenderContext& context)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            if (nullptr != context.terrain)
+            {
+                DrawTerrain(commandBuffer, context);
+            }
+            else if (nullptr != context.queue && nullptr != context.visibleObjects && nullptr != context.spheres)
+            {
+                DrawQueued(commandBuffer, context);
+            }
+            else if (nullptr != context.mesh && context.depthPrepass)
+            {
+                // Depth only first, then shade just the surviving fragment per pixel.
+                BindMesh(commandBuffer, context, context.depthPrepassPipeline);
+                CaptureBind(context, Capture::Pipeline::DepthOnly);
+                DrawMesh(commandBuffer, context);
+                vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context.meshEqualPipeline);
+                CaptureBind(context, Capture::Pipeline::Equal);
+                DrawMesh(commandBuffer, context);
+            }
+            else if (nullptr != context.mesh)
+            {
+                BindMesh(commandBuffer, context, context.meshPipeline);
+                CaptureBind(context, Capture::Pipeline::Mesh);
+                DrawMesh(commandBuffer, context);
+            }
+            else
+            {
+                vk.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+                vk.CmdDraw(commandBuffer, 3, 1, 0, 0);
+            }
+        }
+
+        /* Each extra window is the main pass again into its own framebuffer,
+        with its own frame uniforms and culled objects swapped in. */
+        static void RecordOutputs(VkCommandBuffer& commandBuffer, VkRenderPass& renderPass, VkPipeline& graphicsPipeline, RenderContext& context)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            uint32_t        frameOffset    = context.frameOffset;
+            glm::vec3       cameraPosition = context.cameraPosition;
+            const uint32_t* visibleObjects = context.visibleObjects;
+            uint32_t        visibleCount   = context.visibleCount;
+
+            for (OutputPass& pass : context.outputPasses)
+            {
+                context.frameOffset    = pass.frameOffset;
+                context.cameraPosition = pass.cameraPosition;
+                context.visibleObjects = pass.visibleObjects;
+                context.visibleCount   = pass.visibleCount;
+
+                BeginStats(commandBuffer, context, "window", pass.extent);
+                BeginPass(commandBuffer, renderPass, pass.framebuffer, pass.extent);
+                DrawScene(commandBuffer, graphicsPipeline, context);
+                vk.CmdEndRenderPass(commandBuffer);
+                EndStats(commandBuffer, context);
+            }
+
+            context.frameOffset    = frameOffset;
+            context.cameraPosition = cameraPosition;
+            context.visibleObjects = visibleObjects;
+            context.visibleCount   = visibleCount;
+        }
+
+        void Record(VkCommandPool& commandPool, VkCommandBuffer& commandBuffer, uint32_t imageIndex, VkRenderPass& renderPass, std::vector<VkFramebuffer>& swapChainFramebuffers, VkExtent2D& swapChainExtent, VkPipeline& graphicsPipeline, RenderContext& context)
+        {
+            Dispatch::DeviceTable& vk = Dispatch::Device();
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags            = 0; // Optional
+            beginInfo.pInheritanceInfo = nullptr; // Optional
+
+            if (VK_SUCCESS != vk.BeginCommandBuffer(commandBuffer, &beginInfo))
+            {
+                throw std::runtime_error("Failed to begin recording command buffer !");
+            }
+
+            if (nullptr != context.post)
+            {
+                Post::Begin(commandBuffer, *context.post);
+            }
+
+            if (nullptr != context.resolution)
+            {
+                DynamicResolution::Begin(commandBuffer, *context.resolution);
+            }
+
+            if (nullptr != context.pipelineStats)
+            {
+                PipelineStats::Begin(commandBuffer, *context.pipelineStats);
+            }
+
+            if (nullptr != context.queue)
+            {
+                RenderQueue::BeginFrame(*context.queue);
+            }
+
+            // Finished chunks into the arena before any pass reads it.
+            if (nullptr != context.terrain)
+            {
+                Terrain::Stream(commandBuffer, *context.terrain, context.cameraPosition);
+            }
+
+            if (nullptr != context.occlusion)
+            {
+                RecordOcclusion(commandBuffer, swapChainFramebuffers[imageIndex], swapChainExtent, context);
+            }
+            else
+            {
+                if (nullptr != context.clusters)
+                {
+                    ClusterCull::Record(commandBuffer, *context.clusters, *context.mesh, context.frustumPlanes, context.cameraPosition);
+                }
+
+                if (nullptr != context.post)
+                {
+                    Post::Resources& post = *context.post;
+                    BeginStats(commandBuffer, context, "scene", swapChainExtent);
+                    BeginPass(commandBuffer, post.renderPass, post.framebuffers[post.frame], swapChainExtent);
+                }
+                else if (nullptr != context.resolution)
+                {
+                    DynamicResolution::Resources& resolution = *context.resolution;
+                    BeginStats(commandBuffer, context, "scene", resolution.renderExtent);
+                    BeginPass(commandBuffer, resolution.renderPass, resolution.framebuffer, resolution.renderExtent);
+                }
+                else
+                {
+                    BeginStats(commandBuffer, context, "scene", swapChainExtent);
+                    BeginPass(commandBuffer, renderPass, swapChainFramebuffers[imageIndex], swapChainExtent);
+                }
+
+                DrawScene(commandBuffer, graphicsPipeline, context);
+                vk.CmdEndRenderPass(commandBuffer);
+                EndStats(commandBuffer, context);
+
+                if (nullptr != context.post)
+                {
+                    Post::Composite(commandBuffer, *context.post, imageIndex);
+                }
+                else if (nullptr != context.resolution)
+                {
+                    DynamicResolution::Upscale(commandBuffer, *context.resolution, imageIndex);
+                }
+
+                RecordOutputs(commandBuffer, renderPass, graphicsPipeline, context);
+            }
+
+            if (nullptr != context.readback)
+            {
+                Readback::Record(commandBuffer, *context.readback, imageIndex);
+            }
+
+            if (nullptr != context.pipelineStats)
+            {
+                PipelineStats::End(commandBuffer, *context.pipelineStats);
+            }
+
+            if (nullptr != context.resolution)
+            {
+                DynamicResolution::End(commandBuffer, *context.resolution);
+            }
 
-            if (VK_SUCCESS != vkEndCommandBuffer(commandBuffer))
+            if (VK_SUCCESS != vk.EndCommandBuffer(commandBuffer))
             {
                 throw std::runtime_error("Failed to record command buffer !");
             }
@@ -0,0 +1,1021 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "Dispatch.h"
+#include "Jobs.h"
+#include "Memory.h"
+#include "MeshFormat.h"
+#include "Residency.h"
+#include "Retire.h"
+
+namespace Visuals
+{
+    namespace Terrain
+    {
+        /* Floating sky islands, streamed in chunks around the camera. Each
+        chunk is kChunkSize x kChunkHeight x kChunkSize voxels filled from
+        two heightfields per column, an island top and its tapered
+        underside, then greedy meshed into MeshFormat::Vertex quads.
+
+        Three kinds of work, none waiting on another:
+            update job     Update, once a tick on a Jobs worker, after the
+                           camera in the simulation graph: which chunks at
+                           which LOD, builds started as jobs, finished ones
+                           and drops passed on to the render thread
+            builds         detached jobs on the Jobs workers, one chunk
+                           each, polled through their counter
+            render thread  Stream, once a frame: at most kUploadBytes and
+                           kUploadMs of finished meshes copied into the
+                           arena pages through the staging buffer, then Draw
+
+        A chunk keeps its old LOD on screen until the new one is uploaded.
+        Faces on chunk borders are always emitted, so neighbours at another
+        LOD never leave a crack.
+
+        Ticks never overlap, so only one Update runs at a time and World
+        needs no lock; Create and Destroy run on the main thread while no
+        tick does. Handoff is the only state shared with the render thread
+        and is guarded by its mutex.
+
+        When the arena is full the render thread evicts the chunks farthest
+        from the camera, or gives back the upload itself when nothing is
+        farther, and tells Update, which rebuilds a chunk given
+        back that way once it wants it at another LOD.
+
+        The arena is kPages buffers of kPageSize, each created when a chunk
+        first needs the room and registered with Residency. A page none of
+        whose chunks was drawn lately, all behind the camera, can be evicted
+        under memory pressure; its chunks are given back the same way and
+        rebuilt once they are in the frustum again, which restores the page. */
+
+        const int32_t      kChunkSize   = 32;   // voxels along x and z, one unit each
+        const int32_t      kChunkHeight = 64;   // along y, the islands float in between
+        const uint32_t     kLods        = 3;    // voxel step 1, 2 and 4
+        const float        kLodDistance = 96.0f; // LOD l + 1 from kLodDistance * (l + 1)
+        const int32_t      kViewRadius  = 10;   // chunks around the camera
+        const uint32_t     kMaxBuilding = 8;    // builds queued or running at once
+        const VkDeviceSize kArenaSize   = 64ull * 1024 * 1024;
+        const VkDeviceSize kStagingSize = 8ull * 1024 * 1024; // a frame's uploads
+        const VkDeviceSize kPageSize    = 1024ull * 1024; // a chunk fits one, LOD 0 ones take up to a quarter
+        const uint32_t     kPages       = static_cast<uint32_t>(kArenaSize / kPageSize);
+        const VkDeviceSize kUploadBytes = 2ull * 1024 * 1024; // per frame, one chunk more than that never
+        const double       kUploadMs    = 1.0;  // per frame, checked after each chunk
+        const VkDeviceSize kAlignment   = sizeof(MeshFormat::Vertex); // indices follow vertices
+
+        struct Coord
+        {
+            int32_t x = 0;
+            int32_t z = 0;
+        };
+
+        static uint64_t KeyOf(Coord coord)
+        {
+            return (uint64_t(uint32_t(coord.x)) << 32) | uint32_t(coord.z);
+        }
+
+        struct Mesh
+        {
+            std::vector<MeshFormat::Vertex> vertices;
+            std::vector<uint32_t>           indices;
+            glm::vec3                       min{0.0f};
+            glm::vec3                       max{0.0f};
+        };
+
+        // One chunk at one LOD, owned by the update job, filled by a build job.
+        struct Build
+        {
+            Coord         coord;
+            uint32_t      lod = 0;
+            Mesh          mesh;
+            Jobs::Counter counter; // zero once built
+        };
+
+        // Update job to render thread, applied in order.
+        struct Command
+        {
+            enum class Kind
+            {
+                Upload, // replaces whatever the chunk had
+                Drop
+            };
+
+            Kind     kind       = Kind::Upload;
+            uint64_t key        = 0;
+            uint32_t lod        = 0;
+            uint32_t generation = 0; // Upload: the chunk's count of uploads so far
+            Mesh     mesh;
+        };
+
+        // Render thread to update job, a chunk no longer in the arena.
+        struct Eviction
+        {
+            uint64_t key        = 0;
+            uint32_t generation = 0;     // of the upload evicted, older ones are stale
+            bool     idle       = false; // its page went to Residency, not for room
+        };
+
+        struct Handoff
+        {
+            std::mutex            mutex;
+            std::deque<Command>   commands;
+            std::vector<Eviction> evicted;
+        };
+
+        struct Chunk
+        {
+            Coord                  coord;
+            uint32_t               lod        = UINT32_MAX; // last handed to the render thread
+            uint32_t               wanted     = 0;
+            uint32_t               generation = 0;          // uploads handed over
+            uint32_t               refused    = UINT32_MAX; // LOD evicted for room, not rebuilt while wanted
+            bool                   offscreen  = false;      // evicted idle, rebuilt once in the frustum
+            std::unique_ptr<Build> build;                   // in flight
+        };
+
+        // Update job side.
+        struct World
+        {
+            uint32_t                                seed = 1;
+            Jobs::Scheduler*                        jobs = nullptr;
+            Handoff                                 handoff;
+            std::unordered_map<uint64_t, Chunk>     chunks;
+            std::vector<std::unique_ptr<Build>>     orphans;  // dropped while building
+            uint32_t                                building = 0;
+        };
+
+        // What the render thread has in the arena for one chunk.
+        struct Resident
+        {
+            uint32_t     lod          = 0;
+            uint32_t     generation   = 0;
+            uint32_t     page         = 0;
+            VkDeviceSize offset       = 0;
+            VkDeviceSize size         = 0; // 0: empty chunk, nothing allocated
+            uint32_t     indexCount   = 0;
+            uint32_t     firstIndex   = 0;
+            int32_t      vertexOffset = 0;
+            glm::vec3    min{0.0f};
+            glm::vec3    max{0.0f};
+        };
+
+        struct Freed
+        {
+            uint64_t     frame  = 0;
+            uint32_t     page   = 0;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size   = 0;
+        };
+
+        struct Stats
+        {
+            uint32_t     resident     = 0;
+            uint32_t     drawn        = 0; // last frame, after frustum culling
+            uint64_t     triangles    = 0; // drawn
+            uint32_t     lodDrawn[kLods] = {};
+            uint32_t     uploads      = 0; // last frame
+            VkDeviceSize uploadBytes  = 0; // last frame
+            double       uploadMs     = 0.0;
+            uint32_t     waiting      = 0; // commands left for later frames
+            VkDeviceSize arenaUsed    = 0;
+            uint32_t     pages        = 0; // created and not evicted
+            uint64_t     arenaFull    = 0; // frames an upload had to wait for arena space
+            uint64_t     evicted      = 0; // chunks given back for arena space, since startup
+        };
+
+        // One buffer of the arena, vertices and indices. Null until needed and once evicted.
+        struct Page
+        {
+            VkBuffer                             buffer    = VK_NULL_HANDLE;
+            VkDeviceMemory                       memory    = VK_NULL_HANDLE;
+            std::map<VkDeviceSize, VkDeviceSize> free;      // offset to size, coalesced
+            VkDeviceSize                         used      = 0;
+            uint32_t                             residency = Residency::kNone;
+        };
+
+        // Render thread side.
+        struct Gpu
+        {
+            Handoff*                               handoff        = nullptr;
+            VkDevice                               device         = VK_NULL_HANDLE; // pages are created while streaming
+            VkPhysicalDevice                       physicalDevice = VK_NULL_HANDLE;
+            Residency::Manager*                    residency      = nullptr;
+            uint32_t                               heap           = Residency::kNone; // the pages', known once one exists
+            Retire::Queue*                         retire         = nullptr;
+            Page                                   pages[kPages];
+            VkBuffer                               staging        = VK_NULL_HANDLE;
+            VkDeviceMemory                         stagingMemory  = VK_NULL_HANDLE;
+            char*                                  mapped         = nullptr;
+            std::unordered_map<uint64_t, Resident> resident;
+            std::deque<Command>                    waiting;       // taken from the handoff, not uploaded yet
+            std::vector<Freed>                     freed;         // the GPU may still read them
+            uint64_t                               frame          = 0;
+            Stats                                  stats;
+        };
+
+        // Value noise in [0, 1].
+        static float Hash(int32_t x, int32_t z, uint32_t seed)
+        {
+            uint32_t h = seed ^ (uint32_t(x) * 0x8da6b343u) ^ (uint32_t(z) * 0xd8163841u);
+            h = (h ^ (h >> 13)) * 0x5bd1e995u;
+            h ^= h >> 15;
+            return static_cast<float>(h & 0xFFFFFF) / static_cast<float>(0xFFFFFF);
+        }
+
+        static float Noise(float x, float z, uint32_t seed)
+        {
+            float   fx = std::floor(x);
+            float   fz = std::floor(z);
+            int32_t ix = static_cast<int32_t>(fx);
+            int32_t iz = static_cast<int32_t>(fz);
+            float   tx = x - fx;
+            float   tz = z - fz;
+            tx = tx * tx * (3.0f - 2.0f * tx);
+            tz = tz * tz * (3.0f - 2.0f * tz);
+
+            float a = Hash(ix, iz, seed) + (Hash(ix + 1, iz, seed) - Hash(ix, iz, seed)) * tx;
+            float b = Hash(ix, iz + 1, seed) + (Hash(ix + 1, iz + 1, seed) - Hash(ix, iz + 1, seed)) * tx;
+            return a + (b - a) * tz;
+        }
+
+        static float Fbm(float x, float z, uint32_t octaves, uint32_t seed)
+        {
+            float sum       = 0.0f;
+            float amplitude = 0.5f;
+            float total     = 0.0f;
+            for (uint32_t i = 0; i < octaves; ++i)
+            {
+                sum       += Noise(x, z, seed + i) * amplitude;
+                total     += amplitude;
+                x         *= 2.0f;
+                z         *= 2.0f;
+                amplitude *= 0.5f;
+            }
+            return sum / total;
+        }
+
+        // Solid between bottom and top; bottom >= top over open sky.
+        struct Column
+        {
+            float bottom = 0.0f;
+            float top    = 0.0f;
+        };
+
+        Column Sample(uint32_t seed, float x, float z)
+        {
+            float island = (Fbm(x * 0.006f, z * 0.006f, 3, seed) - 0.5f) * 5.0f; // > 0 over an island
+            if (island <= 0.0f)
+            {
+                return Column{};
+            }
+            island = std::min(island, 1.0f);
+
+            float hills = Fbm(x * 0.04f, z * 0.04f, 4, seed + 16);
+            float roots = Fbm(x * 0.05f, z * 0.05f, 2, seed + 32);
+
+            Column column;
+            column.top    = 40.0f + island * 6.0f + hills * 10.0f * island;
+            column.bottom = column.top - 1.0f - island * (10.0f + 20.0f * roots);
+            return column;
+        }
+
+        /* Voxels at the chunk's LOD, each column sampled at its center, then
+        merged into as few quads per face direction as the mask allows. */
+        void Generate(uint32_t seed, Build& build)
+        {
+            const int32_t step   = 1 << build.lod;
+            const int32_t dims[3] = {kChunkSize / step, kChunkHeight / step, kChunkSize / step};
+            const float   originX = static_cast<float>(build.coord.x * kChunkSize);
+            const float   originZ = static_cast<float>(build.coord.z * kChunkSize);
+
+            std::vector<uint8_t> solid(size_t(dims[0]) * dims[1] * dims[2], 0);
+            auto At = [&dims, &solid](const int32_t p[3]) -> bool
+            {
+                if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= dims[0] || p[1] >= dims[1] || p[2] >= dims[2])
+                {
+                    return false; // chunk borders always get faces
+                }
+                return 0 != solid[p[0] + dims[0] * (p[1] + dims[1] * p[2])];
+            };
+
+            for (int32_t z = 0; z < dims[2]; ++z)
+            {
+                for (int32_t x = 0; x < dims[0]; ++x)
+                {
+                    Column column = Sample(seed, originX + (x + 0.5f) * step, originZ + (z + 0.5f) * step);
+                    for (int32_t y = 0; y < dims[1]; ++y)
+                    {
+                        float center = (y + 0.5f) * step;
+                        solid[x + dims[0] * (y + dims[1] * z)] = center > column.bottom && center < column.top ? 1 : 0;
+                    }
+                }
+            }
+
+            Mesh& mesh = build.mesh;
+            mesh.vertices.clear();
+            mesh.indices.clear();
+            mesh.min = glm::vec3(std::numeric_limits<float>::max());
+            mesh.max = glm::vec3(-std::numeric_limits<float>::max());
+
+            std::vector<int8_t> mask;
+            for (int32_t d = 0; d < 3; ++d)
+            {
+                const int32_t u = (d + 1) % 3;
+                const int32_t v = (d + 2) % 3;
+                int32_t x[3] = {0, 0, 0};
+                int32_t q[3] = {0, 0, 0};
+                q[d] = 1;
+                mask.assign(size_t(dims[u]) * dims[v], 0);
+
+                // Between slice x[d] - 1 and x[d]: +1 faces +d, -1 faces -d.
+                for (x[d] = 0; x[d] <= dims[d]; ++x[d])
+                {
+                    for (x[v] = 0; x[v] < dims[v]; ++x[v])
+                    {
+                        for (x[u] = 0; x[u] < dims[u]; ++x[u])
+                        {
+                            int32_t behind[3] = {x[0] - q[0], x[1] - q[1], x[2] - q[2]};
+                            bool    a         = At(behind);
+                            bool    b         = At(x);
+                            mask[x[u] + dims[u] * x[v]] = a == b ? 0 : (a ? 1 : -1);
+                        }
+                    }
+
+                    for (int32_t j = 0; j < dims[v]; ++j)
+                    {
+                        for (int32_t i = 0; i < dims[u];)
+                        {
+                            int8_t face = mask[i + dims[u] * j];
+                            if (0 == face)
+                            {
+                                ++i;
+                                continue;
+                            }
+
+                            int32_t width = 1;
+                            while (i + width < dims[u] && face == mask[i + width + dims[u] * j])
+                            {
+                                ++width;
+                            }
+
+                            int32_t height = 1;
+                            for (bool grow = true; grow && j + height < dims[v]; height += grow ? 1 : 0)
+                            {
+                                for (int32_t k = 0; k < width; ++k)
+                                {
+                                    if (face != mask[i + k + dims[u] * (j + height)])
+                                    {
+                                        grow = false;
+                                        break;
+                                    }
+                                }
+                            }
+
+                            float corner[3];
+                            corner[d] = static_cast<float>(x[d]);
+                            corner[u] = static_cast<float>(i);
+                            corner[v] = static_cast<float>(j);
+                            float du[3] = {0.0f, 0.0f, 0.0f};
+                            float dv[3] = {0.0f, 0.0f, 0.0f};
+                            du[u] = static_cast<float>(width);
+                            dv[v] = static_cast<float>(height);
+
+                            uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+                            for (int32_t c = 0; c < 4; ++c)
+                            {
+                                float s = (1 == c || 2 == c) ? 1.0f : 0.0f;
+                                float t = (2 == c || 3 == c) ? 1.0f : 0.0f;
+
+                                MeshFormat::Vertex vertex{};
+                                glm::vec3 position(corner[0] + du[0] * s + dv[0] * t, corner[1] + du[1] * s + dv[1] * t, corner[2] + du[2] * s + dv[2] * t);
+                                position    = position * static_cast<float>(step) + glm::vec3(originX, 0.0f, originZ);
+                                vertex.position[0] = position.x;
+                                vertex.position[1] = position.y;
+                                vertex.position[2] = position.z;
+                                vertex.normal[d]   = static_cast<float>(face);
+                                vertex.uv[0]       = (corner[u] + du[u] * s) * step;
+                                vertex.uv[1]       = (corner[v] + dv[v] * t) * step;
+                                mesh.vertices.push_back(vertex);
+
+                                mesh.min = glm::min(mesh.min, position);
+                                mesh.max = glm::max(mesh.max, position);
+                            }
+
+                            // Counter clockwise seen from the side the face points to.
+                            static const uint32_t kFront[6] = {0, 1, 2, 0, 2, 3};
+                            static const uint32_t kBack[6]  = {0, 2, 1, 0, 3, 2};
+                            for (uint32_t index : face > 0 ? kFront : kBack)
+                            {
+                                mesh.indices.push_back(base + index);
+                            }
+
+                            for (int32_t l = 0; l < height; ++l)
+                            {
+                                std::fill_n(mask.begin() + i + dims[u] * (j + l), width, 0);
+                            }
+                            i += width;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Main thread. Chunks are built by detached jobs on jobs.
+        void Create(World& world, Jobs::Scheduler& jobs, uint32_t seed)
+        {
+            world.seed = seed;
+            world.jobs = &jobs;
+        }
+
+        static void Queue(World& world, Chunk& chunk)
+        {
+            chunk.build        = std::make_unique<Build>();
+            chunk.build->coord = chunk.coord;
+            chunk.build->lod   = chunk.wanted;
+            world.building++;
+
+            Build*   build = chunk.build.get();
+            uint32_t seed  = world.seed;
+            Jobs::RunDetached(*world.jobs, [build, seed]() { Generate(seed, *build); }, &build->counter);
+        }
+
+        // Box against the inward pointing planes of Camera::FrustumPlanes.
+        bool Visible(const glm::vec3& min, const glm::vec3& max, const glm::vec4 planes[6])
+        {
+            for (int i = 0; i < 6; ++i)
+            {
+                glm::vec3 normal(planes[i]);
+                glm::vec3 corner(normal.x >= 0.0f ? max.x : min.x,
+                                 normal.y >= 0.0f ? max.y : min.y,
+                                 normal.z >= 0.0f ? max.z : min.z);
+                if (glm::dot(normal, corner) + planes[i].w < 0.0f)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // The whole column a chunk may fill, before it is built.
+        static bool Visible(const Chunk& chunk, const glm::vec4 planes[6])
+        {
+            glm::vec3 min(static_cast<float>(chunk.coord.x * kChunkSize), 0.0f, static_cast<float>(chunk.coord.z * kChunkSize));
+            return Visible(min, min + glm::vec3(kChunkSize, kChunkHeight, kChunkSize), planes);
+        }
+
+        uint32_t LodOf(float distance)
+        {
+            return std::min(kLods - 1, static_cast<uint32_t>(distance / kLodDistance));
+        }
+
+        /* Update job, once a tick. Bookkeeping only: the chunks within
+        kViewRadius, nearest first, get a build when their LOD changes, as
+        long as fewer than kMaxBuilding are out. planes is the frustum the
+        chunks evicted idle wait for. */
+        void Update(World& world, const glm::vec3& camera, const glm::vec4 planes[6])
+        {
+            std::vector<Command>  commands;
+            std::vector<Eviction> evicted;
+            {
+                std::lock_guard<std::mutex> lock(world.handoff.mutex);
+                evicted.swap(world.handoff.evicted);
+            }
+
+            // Nothing of these is in the arena any more, and no Drop is owed for them.
+            for (const Eviction& eviction : evicted)
+            {
+                auto found = world.chunks.find(eviction.key);
+                if (found == world.chunks.end() || eviction.generation != found->second.generation || UINT32_MAX == found->second.lod)
+                {
+                    continue;
+                }
+
+                Chunk& chunk = found->second;
+                if (eviction.idle)
+                {
+                    chunk.offscreen = true;
+                }
+                else
+                {
+                    chunk.refused = chunk.lod;
+                }
+                chunk.lod = UINT32_MAX;
+            }
+
+            // Finished builds go on to the render thread if they are still wanted.
+            for (auto& entry : world.chunks)
+            {
+                Chunk& chunk = entry.second;
+                if (nullptr == chunk.build || !Jobs::Done(chunk.build->counter))
+                {
+                    continue;
+                }
+
+                world.building--;
+                Command command;
+                command.kind = Command::Kind::Upload;
+                command.key  = entry.first;
+                command.lod        = chunk.build->lod;
+                command.generation = ++chunk.generation;
+                command.mesh       = std::move(chunk.build->mesh);
+                commands.push_back(std::move(command));
+                chunk.lod       = chunk.build->lod;
+                chunk.refused   = UINT32_MAX;
+                chunk.offscreen = false;
+                chunk.build.reset();
+            }
+            for (size_t i = 0; i < world.orphans.size();)
+            {
+                if (Jobs::Done(world.orphans[i]->counter))
+                {
+                    world.building--;
+                    world.orphans[i] = std::move(world.orphans.back());
+                    world.orphans.pop_back();
+                    continue;
+                }
+                ++i;
+            }
+
+            const int32_t cx = static_cast<int32_t>(std::floor(camera.x / kChunkSize));
+            const int32_t cz = static_cast<int32_t>(std::floor(camera.z / kChunkSize));
+
+            std::vector<std::pair<float, uint64_t>> wanted;
+            for (int32_t dz = -kViewRadius; dz <= kViewRadius; ++dz)
+            {
+                for (int32_t dx = -kViewRadius; dx <= kViewRadius; ++dx)
+                {
+                    if (dx * dx + dz * dz > kViewRadius * kViewRadius)
+                    {
+                        continue;
+                    }
+
+                    Coord coord{cx + dx, cz + dz};
+                    float centerX  = (coord.x + 0.5f) * kChunkSize;
+                    float centerZ  = (coord.z + 0.5f) * kChunkSize;
+                    float distance = std::sqrt((centerX - camera.x) * (centerX - camera.x) + (centerZ - camera.z) * (centerZ - camera.z));
+
+                    uint64_t key   = KeyOf(coord);
+                    Chunk&   chunk = world.chunks[key];
+                    chunk.coord    = coord;
+                    chunk.wanted   = LodOf(distance);
+                    wanted.push_back({distance, key});
+                }
+            }
+
+            // Out of range: dropped on the render thread, a running build is left to finish.
+            for (auto it = world.chunks.begin(); it != world.chunks.end();)
+            {
+                Chunk& chunk = it->second;
+                int32_t dx = chunk.coord.x - cx;
+                int32_t dz = chunk.coord.z - cz;
+                if (dx * dx + dz * dz <= kViewRadius * kViewRadius)
+                {
+                    ++it;
+                    continue;
+                }
+
+                if (nullptr != chunk.build)
+                {
+                    world.orphans.push_back(std::move(chunk.build));
+                }
+                if (UINT32_MAX != chunk.lod)
+                {
+                    Command command;
+                    command.kind = Command::Kind::Drop;
+                    command.key  = it->first;
+                    commands.push_back(std::move(command));
+                }
+                it = world.chunks.erase(it);
+            }
+
+            std::sort(wanted.begin(), wanted.end());
+            for (const auto& entry : wanted)
+            {
+                if (world.building >= kMaxBuilding)
+                {
+                    break;
+                }
+
+                Chunk& chunk = world.chunks[entry.second];
+                if (nullptr == chunk.build && chunk.lod != chunk.wanted && chunk.refused != chunk.wanted && (!chunk.offscreen || Visible(chunk, planes)))
+                {
+                    Queue(world, chunk);
+                }
+            }
+
+            if (!commands.empty())
+            {
+                std::lock_guard<std::mutex> lock(world.handoff.mutex);
+                for (Command& command : commands)
+                {
+                    world.handoff.commands.push_back(std::move(command));
+                }
+            }
+        }
+
+        // Main thread, after the render thread and the last tick have stopped. Waits for the builds still running.
+        void Destroy(World& world)
+        {
+            for (auto& entry : world.chunks)
+            {
+                if (nullptr != entry.second.build)
+                {
+                    Jobs::Wait(*world.jobs, entry.second.build->counter);
+                }
+            }
+            for (std::unique_ptr<Build>& build : world.orphans)
+            {
+                Jobs::Wait(*world.jobs, build->counter);
+            }
+            world.chunks.clear();
+            world.orphans.clear();
+            world.building = 0;
+        }
+
+        // Pages are created while streaming, registered with residency; evicted ones go through retire.
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, World& world, Gpu& gpu, Residency::Manager& residency, Retire::Queue& retire)
+        {
+            gpu.handoff        = &world.handoff;
+            gpu.device         = device;
+            gpu.physicalDevice = physicalDevice;
+            gpu.residency      = &residency;
+            gpu.retire         = &retire;
+
+            Memory::CreateBuffer(device, physicalDevice, kStagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, gpu.staging, gpu.stagingMemory);
+
+            void* data;
+            if (VK_SUCCESS != vkMapMemory(device, gpu.stagingMemory, 0, kStagingSize, 0, &data))
+            {
+                throw std::runtime_error("Failed to map terrain staging buffer !");
+            }
+            gpu.mapped = static_cast<char*>(data);
+        }
+
+        // Frees the arena range once the frames that drew from it are done.
+        static void Defer(Gpu& gpu, const Resident& resident)
+        {
+            if (resident.size > 0)
+            {
+                gpu.freed.push_back({gpu.frame, resident.page, resident.offset, resident.size});
+            }
+        }
+
+        // Out of the arena, and the update job told so. Returns the next resident chunk.
+        static std::unordered_map<uint64_t, Resident>::iterator Evict(Gpu& gpu, std::unordered_map<uint64_t, Resident>::iterator found, bool idle)
+        {
+            {
+                std::lock_guard<std::mutex> lock(gpu.handoff->mutex);
+                gpu.handoff->evicted.push_back({found->first, found->second.generation, idle});
+            }
+            Defer(gpu, found->second);
+            gpu.stats.evicted += idle ? 0 : 1;
+            return gpu.resident.erase(found);
+        }
+
+        /* Residency's evict for a page: its chunks are given back whole and
+        the buffer goes through the retire queue. Idle means nothing drew
+        from it for Residency::kIdleFrames, so no copy or draw is pending. */
+        static void EvictPage(Gpu& gpu, uint32_t index)
+        {
+            for (auto it = gpu.resident.begin(); it != gpu.resident.end();)
+            {
+                if (it->second.size > 0 && index == it->second.page)
+                {
+                    it->second.size = 0; // the page goes whole, no range to give back
+                    it = Evict(gpu, it, true);
+                    continue;
+                }
+                ++it;
+            }
+            gpu.freed.erase(std::remove_if(gpu.freed.begin(), gpu.freed.end(), [index](const Freed& freed) { return index == freed.page; }), gpu.freed.end());
+
+            Page& page = gpu.pages[index];
+            Retire::Buffer(*gpu.retire, page.buffer, page.memory);
+            page.free.clear();
+            page.used = 0;
+        }
+
+        // The first time registered with residency, after an eviction restored.
+        static void CreatePage(Gpu& gpu, uint32_t index)
+        {
+            Page& page = gpu.pages[index];
+            VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+            Memory::CreateBuffer(gpu.device, gpu.physicalDevice, kPageSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, page.buffer, page.memory);
+            page.free[0] = kPageSize;
+
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(gpu.device, page.buffer, &requirements);
+            if (Residency::kNone == page.residency)
+            {
+                gpu.heap       = Residency::HeapOf(gpu.physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                page.residency = Residency::Register(*gpu.residency, "terrain page", requirements.size, gpu.heap, [&gpu, index]() { EvictPage(gpu, index); });
+            }
+            else
+            {
+                Residency::Restored(*gpu.residency, page.residency, requirements.size);
+            }
+        }
+
+        // First fit. False when no free range is large enough.
+        static bool Allocate(Page& page, VkDeviceSize size, VkDeviceSize& offset)
+        {
+            for (auto it = page.free.begin(); it != page.free.end(); ++it)
+            {
+                if (it->second < size)
+                {
+                    continue;
+                }
+
+                offset = it->first;
+                VkDeviceSize left = it->second - size;
+                page.free.erase(it);
+                if (left > 0)
+                {
+                    page.free[offset + size] = left;
+                }
+                page.used += size;
+                return true;
+            }
+            return false;
+        }
+
+        /* In the pages there are, then in a new one. False when none has a
+        free range large enough and every page is there, or the heap is
+        above residency's high water mark: a page created right after one
+        was evicted would only be evicted again. One page is always allowed. */
+        static bool Allocate(Gpu& gpu, VkDeviceSize size, uint32_t& page, VkDeviceSize& offset)
+        {
+            size = (size + kAlignment - 1) / kAlignment * kAlignment;
+            bool any = false;
+            for (page = 0; page < kPages; ++page)
+            {
+                any = any || VK_NULL_HANDLE != gpu.pages[page].buffer;
+                if (VK_NULL_HANDLE != gpu.pages[page].buffer && Allocate(gpu.pages[page], size, offset))
+                {
+                    Residency::Touch(*gpu.residency, gpu.pages[page].residency);
+                    return true;
+                }
+            }
+            if (any && Residency::Pressure(*gpu.residency, gpu.heap))
+            {
+                return false;
+            }
+            for (page = 0; page < kPages; ++page)
+            {
+                if (VK_NULL_HANDLE == gpu.pages[page].buffer)
+                {
+                    CreatePage(gpu, page);
+                    Allocate(gpu.pages[page], size, offset);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void Release(Gpu& gpu, uint32_t index, VkDeviceSize offset, VkDeviceSize size)
+        {
+            Page& page = gpu.pages[index];
+            size       = (size + kAlignment - 1) / kAlignment * kAlignment;
+            page.used -= size;
+
+            auto next = page.free.lower_bound(offset);
+            if (next != page.free.end() && offset + size == next->first)
+            {
+                size += next->second;
+                next  = page.free.erase(next);
+            }
+            if (next != page.free.begin())
+            {
+                auto previous = std::prev(next);
+                if (previous->first + previous->second == offset)
+                {
+                    previous->second += size;
+                    return;
+                }
+            }
+            page.free[offset] = size;
+        }
+
+        static float Distance(const glm::vec3& min, const glm::vec3& max, const glm::vec3& camera)
+        {
+            return glm::length(0.5f * (min + max) - camera);
+        }
+
+        // Every frame a chunk is drawn from its page.
+        void Drawn(Gpu& gpu, const Resident& resident)
+        {
+            Residency::Touch(*gpu.residency, gpu.pages[resident.page].residency);
+        }
+
+        /* Evicts chunks farther from the camera than distance, farthest
+        first, until the ranges on their way back to the free list add up
+        to size. They come back Retire::kLag frames later. False when all
+        that is farther would not be enough, nothing is evicted then. */
+        static bool MakeRoom(Gpu& gpu, VkDeviceSize size, float distance, uint64_t key, const glm::vec3& camera)
+        {
+            VkDeviceSize coming = 0;
+            for (const Freed& freed : gpu.freed)
+            {
+                coming += freed.size;
+            }
+
+            std::vector<std::pair<float, uint64_t>> farther;
+            VkDeviceSize                            fartherBytes = 0;
+            for (const auto& entry : gpu.resident)
+            {
+                float d = Distance(entry.second.min, entry.second.max, camera);
+                if (entry.second.size > 0 && key != entry.first && d > distance)
+                {
+                    farther.push_back({d, entry.first});
+                    fartherBytes += entry.second.size;
+                }
+            }
+            if (coming + fartherBytes < size)
+            {
+                return false;
+            }
+
+            std::sort(farther.rbegin(), farther.rend());
+            for (size_t i = 0; i < farther.size() && coming < size; ++i)
+            {
+                auto found = gpu.resident.find(farther[i].second);
+                coming += found->second.size;
+                Evict(gpu, found, false);
+            }
+            return true;
+        }
+
+        /* Render thread, once a frame, after the fence wait and before any
+        render pass. Applies the update job's commands in order and stops
+        at the upload or time budget; the rest waits for the next frame.
+        camera picks what to evict when the arena is full. */
+        void Stream(VkCommandBuffer& commandBuffer, Gpu& gpu, const glm::vec3& camera)
+        {
+            auto start = std::chrono::steady_clock::now();
+            gpu.frame++;
+
+            size_t done = 0;
+            while (done < gpu.freed.size() && gpu.freed[done].frame + Retire::kLag < gpu.frame)
+            {
+                Release(gpu, gpu.freed[done].page, gpu.freed[done].offset, gpu.freed[done].size);
+                done++;
+            }
+            gpu.freed.erase(gpu.freed.begin(), gpu.freed.begin() + done);
+
+            {
+                std::lock_guard<std::mutex> lock(gpu.handoff->mutex);
+                for (Command& command : gpu.handoff->commands)
+                {
+                    gpu.waiting.push_back(std::move(command));
+                }
+                gpu.handoff->commands.clear();
+            }
+
+            VkDeviceSize staged = 0;
+            uint32_t     uploads = 0;
+            std::vector<VkBufferCopy> copies[kPages];
+            while (!gpu.waiting.empty())
+            {
+                Command& command = gpu.waiting.front();
+                auto     found   = gpu.resident.find(command.key);
+
+                if (Command::Kind::Drop == command.kind)
+                {
+                    if (found != gpu.resident.end())
+                    {
+                        Defer(gpu, found->second);
+                        gpu.resident.erase(found);
+                    }
+                    gpu.waiting.pop_front();
+                    continue;
+                }
+
+                VkDeviceSize vertexBytes = command.mesh.vertices.size() * sizeof(MeshFormat::Vertex);
+                VkDeviceSize indexBytes  = command.mesh.indices.size() * sizeof(uint32_t);
+                VkDeviceSize size        = vertexBytes + indexBytes;
+                if (size > kPageSize)
+                {
+                    throw std::runtime_error("Terrain chunk does not fit an arena page !");
+                }
+                if (staged > 0 && (staged + size > kUploadBytes || std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() > kUploadMs))
+                {
+                    break;
+                }
+
+                Resident resident;
+                resident.lod        = command.lod;
+                resident.generation = command.generation;
+                resident.indexCount = static_cast<uint32_t>(command.mesh.indices.size());
+                resident.min        = command.mesh.min;
+                resident.max        = command.mesh.max;
+                if (size > 0)
+                {
+                    if (!Allocate(gpu, size, resident.page, resident.offset))
+                    {
+                        if (MakeRoom(gpu, size, Distance(resident.min, resident.max, camera), command.key, camera))
+                        {
+                            gpu.stats.arenaFull++;
+                            break;
+                        }
+
+                        // The farthest chunk itself, given back whole rather than left waiting.
+                        if (found != gpu.resident.end())
+                        {
+                            Defer(gpu, found->second);
+                        }
+                        gpu.resident[command.key] = resident;
+                        Evict(gpu, gpu.resident.find(command.key), false);
+                        gpu.waiting.pop_front();
+                        continue;
+                    }
+                    resident.size         = size;
+                    resident.vertexOffset = static_cast<int32_t>(resident.offset / sizeof(MeshFormat::Vertex));
+                    resident.firstIndex   = static_cast<uint32_t>((resident.offset + vertexBytes) / sizeof(uint32_t));
+
+                    memcpy(gpu.mapped + staged, command.mesh.vertices.data(), vertexBytes);
+                    memcpy(gpu.mapped + staged + vertexBytes, command.mesh.indices.data(), indexBytes);
+                    copies[resident.page].push_back({staged, resident.offset, size});
+                    staged += (size + kAlignment - 1) / kAlignment * kAlignment;
+                }
+
+                if (found != gpu.resident.end())
+                {
+                    Defer(gpu, found->second);
+                    found->second = resident;
+                }
+                else
+                {
+                    gpu.resident[command.key] = resident;
+                }
+                uploads++;
+                gpu.waiting.pop_front();
+            }
+
+            if (staged > 0)
+            {
+                Dispatch::DeviceTable& vk = Dispatch::Device();
+                for (uint32_t page = 0; page < kPages; ++page)
+                {
+                    if (!copies[page].empty())
+                    {
+                        vk.CmdCopyBuffer(commandBuffer, gpu.staging, gpu.pages[page].buffer, static_cast<uint32_t>(copies[page].size()), copies[page].data());
+                    }
+                }
+
+                // One barrier for all pages written.
+                VkMemoryBarrier barrier{};
+                barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+                vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            }
+
+            gpu.stats.arenaUsed = 0;
+            gpu.stats.pages     = 0;
+            for (const Page& page : gpu.pages)
+            {
+                gpu.stats.arenaUsed += page.used;
+                gpu.stats.pages     += VK_NULL_HANDLE != page.buffer ? 1 : 0;
+            }
+            gpu.stats.resident    = static_cast<uint32_t>(gpu.resident.size());
+            gpu.stats.uploads     = uploads;
+            gpu.stats.uploadBytes = staged;
+            gpu.stats.waiting     = static_cast<uint32_t>(gpu.waiting.size());
+            gpu.stats.uploadMs    = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        bool Visible(const Resident& resident, const glm::vec4 planes[6])
+        {
+            return Visible(resident.min, resident.max, planes);
+        }
+
+        // Device idle.
+        void Destroy(VkDevice& device, Gpu& gpu)
+        {
+            if (nullptr != gpu.mapped)
+            {
+                vkUnmapMemory(device, gpu.stagingMemory);
+            }
+            Memory::DestroyBuffer(device, gpu.staging, gpu.stagingMemory);
+            for (Page& page : gpu.pages)
+            {
+                Memory::DestroyBuffer(device, page.buffer, page.memory);
+            }
+            gpu = Gpu{};
+        }
+    }
+}
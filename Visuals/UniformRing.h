@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "Math.h"
+#include "Descriptors.h"
+#include "Memory.h"
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace UniformRing
+    {
+        /* One persistently mapped, host coherent uniform buffer cut into a
+        slice per frame. Allocations bump a head through the current slice,
+        aligned to minUniformBufferOffsetAlignment, and are bound through a
+        single UNIFORM_BUFFER_DYNAMIC descriptor written once at Create: a
+        per-draw constant costs a bump, a memcpy and a dynamic offset, never
+        an allocation or a descriptor write.
+
+        Slices rotate like the Objects copies, so a slice is only rewritten
+        once the frame that read it has been waited on.
+        */
+
+        const uint32_t kFrames = 2;
+
+        struct Ring
+        {
+            VkBuffer              buffer         = VK_NULL_HANDLE;
+            VkDeviceMemory        memory         = VK_NULL_HANDLE;
+            char*                 mapped         = nullptr;
+            VkDescriptorSetLayout setLayout      = VK_NULL_HANDLE;
+            VkDescriptorPool      descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet       descriptorSet  = VK_NULL_HANDLE;
+            VkDeviceSize          alignment      = 0;
+            VkDeviceSize          sliceSize      = 0;
+            VkDeviceSize          maxRange       = 0;
+            VkDeviceSize          head           = 0;
+            uint32_t              frame          = 0;
+        };
+
+        // Layout of the per frame block, std140 on the shader side.
+        struct FrameUniforms
+        {
+            glm::mat4 view;
+            glm::mat4 projection;
+            glm::mat4 viewProj;
+            glm::vec4 cameraPosition;
+        };
+
+        // Creates the layout only, so pipelines can be built before the ring exists.
+        void CreateSetLayout(VkDevice& device, Ring& ring)
+        {
+            Descriptors::CreateSetLayout(device, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC}, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, ring.setLayout);
+        }
+
+        // maxRange is the largest single allocation shaders will see through the descriptor.
+        void Create(VkDevice& device, VkPhysicalDevice& physicalDevice, VkDeviceSize sliceSize, VkDeviceSize maxRange, Ring& ring)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            if (maxRange > properties.limits.maxUniformBufferRange)
+            {
+                throw std::runtime_error("Uniform ring range above maxUniformBufferRange !");
+            }
+
+            ring.alignment = properties.limits.minUniformBufferOffsetAlignment;
+            ring.sliceSize = (sliceSize + ring.alignment - 1) / ring.alignment * ring.alignment;
+            ring.maxRange  = maxRange;
+
+            Memory::CreateBuffer(device, physicalDevice, ring.sliceSize * kFrames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ring.buffer, ring.memory);
+
+            void* mapped = nullptr;
+            if (VK_SUCCESS != vkMapMemory(device, ring.memory, 0, VK_WHOLE_SIZE, 0, &mapped))
+            {
+                throw std::runtime_error("Failed to map uniform ring !");
+            }
+            ring.mapped = static_cast<char*>(mapped);
+
+            Descriptors::CreatePool(device, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC}, 1, ring.descriptorPool);
+            Descriptors::Allocate(device, ring.descriptorPool, ring.setLayout, ring.descriptorSet);
+            Descriptors::WriteBuffer(device, ring.descriptorSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ring.buffer, 0, maxRange);
+
+            ring.frame = kFrames - 1;
+            ring.head  = ring.frame * ring.sliceSize;
+        }
+
+        // Moves to the next slice and rewinds it.
+        void BeginFrame(Ring& ring)
+        {
+            ring.frame = (ring.frame + 1) % kFrames;
+            ring.head  = ring.frame * ring.sliceSize;
+        }
+
+        // Returns where to write size bytes; offset is the dynamic offset to bind them with.
+        void* Allocate(Ring& ring, VkDeviceSize size, uint32_t& offset)
+        {
+            VkDeviceSize begin = (ring.head + ring.alignment - 1) / ring.alignment * ring.alignment;
+            VkDeviceSize end   = (ring.frame + 1) * ring.sliceSize;
+
+            // The descriptor always spans maxRange bytes, so that much has to fit.
+            if (size > ring.maxRange || begin + ring.maxRange > end)
+            {
+                throw std::runtime_error("Uniform ring slice exhausted !");
+            }
+
+            ring.head = begin + size;
+            offset    = static_cast<uint32_t>(begin);
+            return ring.mapped + begin;
+        }
+
+        template <typename T>
+        uint32_t Push(Ring& ring, const T& value)
+        {
+            uint32_t offset;
+            memcpy(Allocate(ring, sizeof(T), offset), &value, sizeof(T));
+            return offset;
+        }
+
+        void Destroy(VkDevice& device, Ring& ring)
+        {
+            if (VK_NULL_HANDLE != ring.descriptorPool)
+            {
+                vkDestroyDescriptorPool(device, ring.descriptorPool, HostMemory::Callbacks());
+            }
+
+            if (nullptr != ring.mapped)
+            {
+                vkUnmapMemory(device, ring.memory);
+            }
+            Memory::DestroyBuffer(device, ring.buffer, ring.memory);
+
+            if (VK_NULL_HANDLE != ring.setLayout)
+            {
+                vkDestroyDescriptorSetLayout(device, ring.setLayout, HostMemory::Callbacks());
+            }
+
+            ring = {};
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+#include "HostMemory.h"
+
+namespace Visuals
+{
+    namespace Variants
+    {
+        /* Pipeline permutations keyed by plain structs of 4 byte fields
+        (VkBool32, uint32_t, int32_t, float). Each field is one SPIR-V
+        specialization constant, declared once next to the key:
+
+            struct Key { VkBool32 fog; uint32_t mode; };
+            template <> struct Variants::Layout<Key>
+            {
+                static constexpr VkSpecializationMapEntry entries[] =
+                {
+                    {0, offsetof(Key, fog),  sizeof(VkBool32)},
+                    {1, offsetof(Key, mode), sizeof(uint32_t)},
+                };
+            };
+
+        and matched in GLSL by layout(constant_id = N). The driver folds the
+        constants and drops dead branches when the pipeline is built, so
+        every permutation that can be asked for is baked up front and Find
+        never compiles anything. A key type without a Layout does not
+        compile, and Find only takes the key type its cache was made for.
+        */
+
+        template <typename Key>
+        struct Layout;
+
+        namespace Detail
+        {
+            template <typename Key>
+            constexpr bool Covers()
+            {
+                size_t size = 0;
+                for (const VkSpecializationMapEntry& entry : Layout<Key>::entries)
+                {
+                    size += entry.size;
+                }
+                return sizeof(Key) == size;
+            }
+        }
+
+        template <typename Key>
+        VkSpecializationInfo Specialization(const Key& key)
+        {
+            static_assert(std::is_trivially_copyable<Key>::value && std::has_unique_object_representations<Key>::value, "Variant keys are compared bytewise, no padding or bool fields");
+            static_assert(Detail::Covers<Key>(), "Layout entries must cover every field of the key");
+
+            VkSpecializationInfo info{};
+            info.mapEntryCount = static_cast<uint32_t>(std::size(Layout<Key>::entries));
+            info.pMapEntries   = Layout<Key>::entries;
+            info.dataSize      = sizeof(Key);
+            info.pData         = &key;
+            return info;
+        }
+
+        template <typename Key>
+        struct Cache
+        {
+            std::vector<Key>        keys;
+            std::vector<VkPipeline> pipelines;
+        };
+
+        /* Builds a pipeline for every key that is not baked yet.
+        create(const VkSpecializationInfo&) returns the new pipeline. */
+        template <typename Key, typename F>
+        void Bake(Cache<Key>& cache, const std::vector<Key>& keys, F&& create)
+        {
+            for (const Key& key : keys)
+            {
+                bool baked = false;
+                for (const Key& existing : cache.keys)
+                {
+                    baked = baked || 0 == memcmp(&existing, &key, sizeof(Key));
+                }
+
+                if (!baked)
+                {
+                    VkSpecializationInfo info = Specialization(key);
+                    cache.pipelines.push_back(create(info));
+                    cache.keys.push_back(key);
+                }
+            }
+        }
+
+        template <typename Key>
+        VkPipeline Find(const Cache<Key>& cache, const Key& key)
+        {
+            for (size_t i = 0; i < cache.keys.size(); ++i)
+            {
+                if (0 == memcmp(&cache.keys[i], &key, sizeof(Key)))
+                {
+                    return cache.pipelines[i];
+                }
+            }
+
+            throw std::runtime_error("Pipeline variant was not baked !");
+        }
+
+        // Pipelines only; their shared layout belongs to whoever made it.
+        template <typename Key>
+        void Destroy(VkDevice& device, Cache<Key>& cache)
+        {
+            for (VkPipeline pipeline : cache.pipelines)
+            {
+                vkDestroyPipeline(device, pipeline, HostMemory::Callbacks());
+            }
+
+            cache = {};
+        }
+    }
+}
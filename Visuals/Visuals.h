@@ -9,13 +9,50 @@
 #include "SwapChain.h"
 #include "GraphicsPipeline.h"
 #include "Renderer.h"
+#include "Mesh.h"
+#include "Camera.h"
+#include "Capture.h"
+#include "ClusterCull.h"
+#include "Depth.h"
+#include "DynamicResolution.h"
+#include "FrustumCull.h"
+#include "Jobs.h"
+#include "Mailbox.h"
+#include "Multisample.h"
+#include "Objects.h"
+#include "Outputs.h"
+#include "Occlusion.h"
+#include "PipelineStats.h"
+#include "PipelineCache.h"
+#include "Readback.h"
+#include "Residency.h"
+#include "Post.h"
+#include "RenderContext.h"
+#include "Retire.h"
+#include "Scene.h"
+#include "Startup.h"
+#include "Terrain.h"
+#include "UniformRing.h"
+#include "HostMemory.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <thread>
 
 namespace Visuals
 {
     struct Visuals
     {
-        Visuals()
+        // samples is clamped to what the device supports, 1 renders without MSAA.
+        // minScale below 1 lets dynamic resolution go down to that fraction of the window.
+        // post runs the compute post chain, on its own queue where there is one.
+        // capturePath records the first CAPTURE_FRAMES frames for SkyReplay.
+        // windows above 1 opens extra windows on the same device, see Outputs.h.
+        // outputPath writes every frame to numbered PNG or raw files, see Readback.h.
+        // meshPath "terrain" streams procedural sky islands instead of a mesh, see Terrain.h.
+        Visuals(const char* meshPath = nullptr, uint32_t samples = 1, float minScale = 1.0f, bool post = false, const char* capturePath = nullptr, uint32_t windows = 1, const char* outputPath = nullptr)
             :m_window(nullptr),
             m_height(600), m_width(800),
             m_name("SkyLands"),
@@ -33,11 +70,30 @@ namespace Visuals
             m_commandBuffer{VK_NULL_HANDLE},
             m_imageAvailableSemaphore{VK_NULL_HANDLE},
             m_renderFinishedSemaphore{VK_NULL_HANDLE},
-            m_inFlightFence{VK_NULL_HANDLE}
+            m_inFlightFence{VK_NULL_HANDLE},
+            m_depthImage{VK_NULL_HANDLE},
+            m_depthImageMemory{VK_NULL_HANDLE},
+            m_depthImageView{VK_NULL_HANDLE},
+            m_requestedSamples(samples),
+            m_resolutionSettings{minScale},
+            m_postRequested(post),
+            m_meshPath(nullptr != meshPath && 0 == strcmp(meshPath, "terrain") ? nullptr : meshPath),
+            m_terrainRequested(nullptr != meshPath && 0 == strcmp(meshPath, "terrain")),
+            m_capturePath(capturePath),
+            m_windowCount(std::min(std::max(windows, 1u), Draw::kMaxSwapChains)),
+            m_outputPath(outputPath),
+            m_meshPipelineLayout{VK_NULL_HANDLE},
+            m_renderPassFirst{VK_NULL_HANDLE},
+            m_renderPassSecond{VK_NULL_HANDLE}
         {
             Create();
             Loop();
             Destroy();
+
+            if (m_renderError)
+            {
+                std::rethrow_exception(m_renderError);
+            }
         }
 
     private:
@@ -52,6 +108,7 @@ namespace Visuals
         VkQueue                  m_graphicsQueue;
         VkSurfaceKHR             m_surface;
         VkQueue                  m_presentQueue;
+        VkQueue                  m_computeQueue = VK_NULL_HANDLE; // the graphics queue without a compute only family
         VkSwapchainKHR           m_swapChain;
         std::vector<VkImage>     m_swapChainImages;
         VkFormat                 m_swapChainImageFormat;
@@ -67,55 +124,1154 @@ namespace Visuals
         VkSemaphore              m_renderFinishedSemaphore;
         VkFence                  m_inFlightFence;
         const int MAX_FRAMES_IN_FLIGHT = 2; // to do
+        const double SIMULATION_RATE = 120.0; // ticks per second
+        const uint32_t CAPTURE_FRAMES = 600;
+        VkFormat                 m_depthFormat;
+        VkImage                  m_depthImage;
+        VkDeviceMemory           m_depthImageMemory;
+        VkImageView              m_depthImageView;
+        uint32_t                 m_requestedSamples;
+        VkSampleCountFlagBits    m_samples = VK_SAMPLE_COUNT_1_BIT;
+        Multisample::Target      m_colorTarget; // only when m_samples > 1
+        DynamicResolution::Settings  m_resolutionSettings;
+        DynamicResolution::Resources m_resolution;
+        bool                     m_postRequested;
+        VkFormat                 m_sceneFormat; // swapchain format, or Post::kFormat with post
+        Post::Resources          m_post;
+        bool                     m_asyncPost = true; // main thread, toggled with A
+        bool                     m_asyncPostKey = false;
+
+        const char*              m_meshPath;
+        bool                     m_terrainRequested;
+        const char*              m_capturePath;
+        Mesh::Mapped             m_meshFile; // mapped at startup, unmapped once uploaded
+        std::vector<char>        m_pipelineCacheData; // startup only
+        std::chrono::steady_clock::time_point m_startTime;
+        Capture::Log             m_capture;
+        uint32_t                 m_windowCount; // including the main one
+        std::vector<Outputs::Output> m_outputs; // extra windows, same order as Snapshot::outputs
+        Draw::Batch              m_batch;       // render thread
+        const char*              m_outputPath;
+        Readback::Resources      m_readback;
+        Mesh::Gpu                m_mesh;
+        Variants::Cache<GraphicsPipeline::MeshVariant> m_meshPipelines;
+        Variants::Cache<GraphicsPipeline::MeshVariant> m_meshPipelinesEqual;
+        VkPipeline               m_depthPrepassPipeline = VK_NULL_HANDLE;
+        PipelineStats::Resources m_pipelineStats;
+        RenderQueue::Queue       m_renderQueue;   // render thread
+        Residency::Manager       m_residency; // render thread after Create
+        Terrain::World           m_terrain;    // terrain update job and build jobs
+        Terrain::Gpu             m_terrainGpu; // render thread
+        PipelineStats::Counters  m_prepassCounters[2]; // render thread, last frame without / with
+        bool                     m_depthPrepass = false; // main thread, per scene default, toggled with P
+        bool                     m_prepassKey   = false;
+        GraphicsPipeline::MeshVariant m_meshVariant; // main thread, toggled with L / V
+        bool                     m_lightingKey = false;
+        bool                     m_viewKey     = false;
+        VkPipelineLayout         m_meshPipelineLayout;
+        ClusterCull::Resources   m_clusterCull;
+        Objects::Buffer          m_objects;
+        UniformRing::Ring        m_uniforms;
+        MeshFormat::Bounds       m_sceneBounds;
+        Occlusion::Resources     m_occlusion;
+        Scene::Graph             m_scene;
+        std::vector<uint32_t>    m_fieldRows;
+        float                    m_fieldSpacing = 0.0f;
+        FrustumCull::Spheres     m_objectSpheres; // empty unless culling on the CPU
+        VkRenderPass             m_renderPassFirst;
+        VkRenderPass             m_renderPassSecond;
+        Camera::State            m_camera;
+        RenderContext            m_renderContext;
+        Retire::Queue            m_retire; // render thread
+        Jobs::Scheduler          m_jobs;
+
+        // Main thread simulates and publishes, the render thread records.
+        Mailbox::Box<Snapshot>   m_snapshots;
+        uint64_t                 m_sequence = 0;
+        std::atomic<uint64_t>    m_rendered{0}; // sequence of the last snapshot recorded
+        std::thread              m_renderThread;
+        std::atomic<bool>        m_rendering{false};
+        std::exception_ptr       m_renderError; // what stopped the render thread, rethrown after Destroy
 
 
+        /* Startup as a dependency graph on the job scheduler. File reads
+        (shaders, pipeline cache, mesh) and the validation layer query run
+        beside GLFW and instance creation; GLFW steps stay on this thread.
+        Post and the mesh both submit on the graphics queue through the one
+        command pool, so they run one after the other. */
         void Create()
         {
-            Glfw::Create();
-            Window::Create(m_window, m_width, m_height, m_name);
-            DebugUtils::CheckSupport(DebugUtils::validationLayers);
-            Instance::Create(m_instance, m_name, DebugUtils::validationLayers);
-            DebugUtils::Create(m_instance, m_debugMessenger);
-            Surface::Create(m_window, m_instance, m_surface);
-            PhysicalDevice::Pick(m_instance, m_physicalDevice, m_surface);
-            LogicalDevice::Create(m_physicalDevice, m_device, DebugUtils::validationLayers, m_graphicsQueue, m_presentQueue, m_surface);
-            SwapChain::Create(m_swapChain, m_physicalDevice, m_device, m_surface, m_window, m_swapChainImages, m_swapChainImageFormat, m_swapChainExtent);
+            m_startTime = std::chrono::steady_clock::now();
+            Jobs::Create(m_jobs);
+
+            using Startup::Thread;
+            Startup::Graph graph;
+
+            uint32_t glfw      = Startup::Add(graph, "glfw", Thread::Main, {}, []() { Glfw::Create(); });
+            uint32_t window    = Startup::Add(graph, "window", Thread::Main, {glfw}, [this]()
+            {
+                Window::Create(m_window, m_width, m_height, m_name);
+                m_outputs.resize(m_windowCount - 1);
+                for (Outputs::Output& output : m_outputs)
+                {
+                    Outputs::CreateWindow(output, m_width, m_height, m_name);
+                }
+            });
+            uint32_t layers    = Startup::Add(graph, "validation layers", Thread::Worker, {}, []() { DebugUtils::CheckSupport(DebugUtils::validationLayers); });
+            uint32_t shaders   = Startup::Add(graph, "shader files", Thread::Worker, {}, []() { GraphicsPipeline::Preload(SKY_SHADER_DIR); });
+            uint32_t cacheFile = Startup::Add(graph, "pipeline cache file", Thread::Worker, {}, [this]() { PipelineCache::Read(PipelineCache::kPath, m_pipelineCacheData); });
+            uint32_t meshFile  = Startup::Add(graph, "mesh file", Thread::Worker, {}, [this]()
+            {
+                if (nullptr != m_meshPath)
+                {
+                    Mesh::Map(m_meshPath, m_meshFile);
+                }
+            });
+
+            uint32_t instance = Startup::Add(graph, "instance", Thread::Worker, {glfw, layers}, [this]()
+            {
+                Instance::Create(m_instance, m_name, DebugUtils::validationLayers);
+                Dispatch::LoadInstance(m_instance, Dispatch::Instance());
+                DebugUtils::Create(m_instance, m_debugMessenger);
+            });
+            uint32_t surface = Startup::Add(graph, "surface", Thread::Main, {window, instance}, [this]()
+            {
+                Surface::Create(m_window, m_instance, m_surface);
+                for (Outputs::Output& output : m_outputs)
+                {
+                    Outputs::CreateSurface(m_instance, output);
+                }
+            });
+            uint32_t device  = Startup::Add(graph, "device", Thread::Worker, {surface, cacheFile}, [this]()
+            {
+                PhysicalDevice::Pick(m_instance, m_physicalDevice, m_surface);
+                LogicalDevice::Create(m_physicalDevice, m_device, DebugUtils::validationLayers, m_graphicsQueue, m_presentQueue, m_computeQueue, m_surface);
+                Dispatch::LoadDevice(Dispatch::Instance(), m_device, Dispatch::Device());
+                Residency::Create(m_physicalDevice, m_residency);
+                PipelineCache::Create(m_device, m_physicalDevice, m_pipelineCacheData);
+                m_pipelineCacheData.clear();
+            });
+
+            // Swapchain creation reads the framebuffer size from GLFW.
+            uint32_t swapChain = Startup::Add(graph, "swapchain", Thread::Main, {device}, [this]()
+            {
+                SwapChain::Create(m_swapChain, m_physicalDevice, m_device, m_surface, Window::FramebufferSize(m_window), m_swapChainImages, m_swapChainImageFormat, m_swapChainExtent);
+                ImageViews::Create(m_device, m_swapChainImageViews, m_swapChainImages, m_swapChainImageFormat);
+                m_depthFormat = Depth::FindFormat(m_physicalDevice);
+                m_sceneFormat = m_postRequested && PostSupported() ? Post::kFormat : m_swapChainImageFormat;
+                m_samples = Multisample::Pick(m_physicalDevice, m_requestedSamples);
+            });
+            uint32_t targets = Startup::Add(graph, "targets", Thread::Worker, {swapChain}, [this]()
+            {
+                if (VK_SAMPLE_COUNT_1_BIT != m_samples)
+                {
+                    Multisample::Create(m_device, m_physicalDevice, m_swapChainExtent, m_sceneFormat, m_samples, m_colorTarget);
+                    std::cout << "[msaa] " << m_samples << "x, resolved in pass" << std::endl;
+                }
+                Depth::Create(m_device, m_physicalDevice, m_swapChainExtent, m_depthFormat, m_depthImage, m_depthImageMemory, m_depthImageView, m_samples);
+            });
+            uint32_t renderPass = Startup::Add(graph, "render pass", Thread::Worker, {targets, shaders}, [this]()
+            {
+                RenderPasses::Create(m_device, m_renderPass, m_sceneFormat, m_depthFormat, RenderPasses::Phase::Full, m_samples);
+                GraphicsPipeline::Create(m_graphicsPipeline, m_device, m_swapChainExtent, m_pipelineLayout, m_renderPass, m_samples);
+                if (Post::kFormat != m_sceneFormat)
+                {
+                    // With post the scene renders into Post's targets, the swapchain only receives blits.
+                    Buffers::Create(m_device, m_swapChainFramebuffers, m_swapChainImageViews, m_depthImageView, m_renderPass, m_swapChainExtent, m_colorTarget.view);
+                }
+                if (m_resolutionSettings.minScale < m_resolutionSettings.maxScale && Post::kFormat == m_sceneFormat)
+                {
+                    std::cout << "[resolution] not combined with post, rendering at window size" << std::endl;
+                }
+                else if (m_resolutionSettings.minScale < m_resolutionSettings.maxScale)
+                {
+                    CreateResolution();
+                }
+            });
+            uint32_t commands = Startup::Add(graph, "commands", Thread::Worker, {device}, [this]()
+            {
+                CommandPool::Create(m_device, m_physicalDevice, m_surface, m_commandPool);
+                CommandBuffer::Create(m_device, m_commandPool, m_commandBuffer);
+                SyncObjects::Create(m_device, m_imageAvailableSemaphore, m_renderFinishedSemaphore, m_inFlightFence);
+                PipelineStats::Create(m_device, m_physicalDevice, m_pipelineStats);
+                m_renderContext.pipelineStats = VK_NULL_HANDLE != m_pipelineStats.pool ? &m_pipelineStats : nullptr;
+            });
+            uint32_t post = Startup::Add(graph, "post", Thread::Worker, {renderPass, commands}, [this]()
+            {
+                if (Post::kFormat == m_sceneFormat)
+                {
+                    Post::Create(m_device, m_physicalDevice, m_surface, m_commandPool, m_graphicsQueue, m_swapChainImages, m_swapChainExtent, m_depthFormat, m_samples, m_depthImageView, m_colorTarget.view, m_post);
+                    m_renderContext.post = &m_post;
+                    std::cout << "[post] " << (m_post.async ? "async compute queue" : "no compute only queue, serial on graphics") << std::endl;
+                }
+            });
+            Startup::Add(graph, "readback", Thread::Worker, {swapChain}, [this]()
+            {
+                if (nullptr != m_outputPath)
+                {
+                    CreateReadback();
+                }
+            });
+            uint32_t windows = Startup::Add(graph, "windows", Thread::Main, {renderPass, meshFile}, [this]() { CreateOutputs(); });
+            Startup::Add(graph, "mesh", Thread::Worker, {post, meshFile, windows}, [this]()
+            {
+                if (nullptr != m_meshPath)
+                {
+                    CreateMesh();
+                }
+                else if (m_terrainRequested)
+                {
+                    CreateTerrain();
+                }
+            });
+
+            Startup::Run(graph, m_jobs);
+            Startup::Report(graph);
+        }
+
+        /* Extra windows draw the main pass again from their own camera, so
+        they need the plain forward path: no post chain or dynamic resolution
+        (their targets are sized and blitted for one swapchain), no capture,
+        no clustered mesh (culled for one camera on the GPU) and no terrain
+        (streamed around one camera). Otherwise they are closed again and
+        only the main window renders. */
+        void CreateOutputs()
+        {
+            if (m_outputs.empty())
+            {
+                return;
+            }
+
+            bool clustered = nullptr != m_meshFile.header && m_meshFile.header->meshletCount > 0;
+            if (Post::kFormat == m_sceneFormat || nullptr != m_renderContext.resolution || nullptr != m_capturePath || clustered || m_terrainRequested)
+            {
+                for (Outputs::Output& output : m_outputs)
+                {
+                    Outputs::Destroy(m_device, m_instance, output);
+                }
+                m_outputs.clear();
+                std::cout << "[windows] extra windows need the forward path without post, resolution, capture, clusters or terrain, main window only" << std::endl;
+                return;
+            }
+
+            for (Outputs::Output& output : m_outputs)
+            {
+                Outputs::Create(m_device, m_physicalDevice, m_surface, output, m_swapChainImageFormat, m_swapChainExtent, m_renderPass, m_depthImageView, m_colorTarget.view);
+            }
+            std::cout << "[windows] " << m_outputs.size() + 1 << " swapchains, one submit and one present per frame" << std::endl;
+        }
+
+        void CreateReadback()
+        {
+            SwapChain::SupportDetails support = SwapChain::QuerySupport(m_physicalDevice, m_surface);
+            if (!Readback::Supported(support.capabilities, m_swapChainImageFormat))
+            {
+                std::cout << "[readback] swapchain cannot be copied from or is not 8 bit RGBA, no output" << std::endl;
+                return;
+            }
+
+            Readback::Create(m_device, m_physicalDevice, m_swapChainImages, m_swapChainExtent, m_swapChainImageFormat, m_outputPath, m_readback);
+            m_renderContext.readback = &m_readback;
+            std::cout << "[readback] " << m_readback.encoder.threads.size() << " encoders, " << Readback::kSlots << " buffers, writing " << m_readback.prefix << "_*" << std::endl;
+        }
+
+        void CreateMesh()
+        {
+            Mesh::Mapped& mapped = m_meshFile;
+            Mesh::Upload(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, mapped, m_mesh);
+            if (nullptr != m_capturePath && 0 == mapped.header->meshletCount)
+            {
+                Capture::Create(m_capturePath, m_swapChainExtent, m_sceneFormat, m_samples, CAPTURE_FRAMES, m_capture);
+                Capture::WriteMesh(m_capture, mapped);
+                m_renderContext.capture = &m_capture;
+            }
+            else if (nullptr != m_capturePath)
+            {
+                std::cout << "[capture] clustered meshes draw from the GPU, nothing to capture" << std::endl;
+            }
+            Mesh::Unmap(mapped);
+
+            CreateMeshPipelines();
+            m_renderContext.mesh = &m_mesh;
+            m_sceneBounds        = m_mesh.bounds;
+
+            VkPhysicalDeviceFeatures features;
+            vkGetPhysicalDeviceFeatures(m_physicalDevice, &features);
+
+            if (m_mesh.meshletCount > 0)
+            {
+                // Cluster culling draws the one mesh as instance 0.
+                glm::vec4 sphere(m_mesh.bounds.center[0], m_mesh.bounds.center[1], m_mesh.bounds.center[2], m_mesh.bounds.radius);
+                Scene::Add(m_scene, Scene::kNone, Scene::Transform{}, sphere);
+                Objects::Create(m_device, m_physicalDevice, Scene::Count(m_scene), m_objects);
+
+                ClusterCull::Create(m_device, m_physicalDevice, m_mesh, m_clusterCull);
+                m_renderContext.clusters = &m_clusterCull;
+            }
+            else if (VK_TRUE == features.drawIndirectFirstInstance && VK_SAMPLE_COUNT_1_BIT == m_samples && nullptr == m_renderContext.resolution && nullptr == m_renderContext.post && nullptr == m_renderContext.capture && m_outputs.empty())
+            {
+                // The Hi-Z pyramid is built from a single sampled, full size depth attachment.
+                // A capture needs the CPU culled draws, the Hi-Z ones are generated on the GPU.
+                // Extra windows are culled on the CPU per camera, the pyramid is one camera's.
+                CreateOcclusionScene();
+            }
+            else
+            {
+                CreateCpuCullScene();
+            }
+        }
+
+        // Objects, frame uniforms and every pipeline variant drawing MeshFormat vertices.
+        void CreateMeshPipelines()
+        {
+            Objects::CreateSetLayout(m_device, m_objects);
+            UniformRing::CreateSetLayout(m_device, m_uniforms);
+            UniformRing::Create(m_device, m_physicalDevice, 64 * 1024, sizeof(UniformRing::FrameUniforms), m_uniforms);
+            GraphicsPipeline::CreateMeshVariants(m_meshPipelines, m_device, m_swapChainExtent, m_meshPipelineLayout, m_renderPass, m_objects.setLayout, m_uniforms.setLayout, VK_COMPARE_OP_LESS, m_samples);
+            GraphicsPipeline::CreateMeshVariants(m_meshPipelinesEqual, m_device, m_swapChainExtent, m_meshPipelineLayout, m_renderPass, m_objects.setLayout, m_uniforms.setLayout, VK_COMPARE_OP_EQUAL, m_samples);
+            GraphicsPipeline::CreateMeshDepthOnly(m_depthPrepassPipeline, m_device, m_swapChainExtent, m_meshPipelineLayout, m_renderPass, m_objects.setLayout, m_uniforms.setLayout, m_samples);
+            m_renderContext.depthPrepassPipeline = m_depthPrepassPipeline;
+
+            m_renderContext.meshPipeline       = Variants::Find(m_meshPipelines, m_meshVariant);
+            m_renderContext.meshPipelineLayout = m_meshPipelineLayout;
+            m_renderContext.objects            = &m_objects;
+            m_renderContext.uniforms           = &m_uniforms;
+        }
+
+        /* Sky islands streamed around the flying camera. Chunks are world
+        space, so the whole terrain is the one identity object 0; they are
+        culled and sorted per chunk in DrawTerrain, never per object. */
+        void CreateTerrain()
+        {
+            if (nullptr != m_capturePath)
+            {
+                std::cout << "[capture] only meshes are captured, not terrain" << std::endl;
+            }
+
+            CreateMeshPipelines();
+            Scene::Add(m_scene, Scene::kNone, Scene::Transform{});
+            Objects::Create(m_device, m_physicalDevice, Scene::Count(m_scene), m_objects);
+
+            Terrain::Create(m_terrain, m_jobs, 1);
+            Terrain::Create(m_device, m_physicalDevice, m_terrain, m_terrainGpu, m_residency, m_retire);
+            m_renderContext.terrain = &m_terrainGpu;
+            m_renderContext.queue   = &m_renderQueue;
+            m_depthPrepass          = true;
+
+            std::cout << "[terrain] " << Terrain::kMaxBuilding << " builds at once on " << m_jobs.workerCount << " workers, " << Terrain::kViewRadius << " chunk view radius, "
+                      << Terrain::kArenaSize / (1024 * 1024) << " MB arena in " << Terrain::kPages << " pages, " << Terrain::kUploadBytes / 1024 << " KB / " << Terrain::kUploadMs << " ms upload budget" << std::endl;
+        }
+
+        // Either scene is drawn with the mesh pipelines, objects and frame uniforms.
+        bool HasScene() const
+        {
+            return nullptr != m_renderContext.mesh || nullptr != m_renderContext.terrain;
+        }
+
+        void CreateResolution()
+        {
+            SwapChain::SupportDetails support = SwapChain::QuerySupport(m_physicalDevice, m_surface);
+            if (0 == (support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || !DynamicResolution::Supported(m_physicalDevice, m_swapChainImageFormat))
+            {
+                std::cout << "[resolution] blit or timestamps unsupported, rendering at window size" << std::endl;
+                return;
+            }
+
+            DynamicResolution::Create(m_device, m_physicalDevice, m_swapChainImages, m_swapChainExtent, m_swapChainImageFormat, m_depthFormat, m_samples, m_depthImageView, m_colorTarget.view, m_resolutionSettings, m_resolution);
+            m_renderContext.resolution = &m_resolution;
+        }
+
+        /* Called on the render thread when the surface reports the swapchain
+        out of date or suboptimal. The new chain is created from the old one,
+        which is retired with its views and framebuffers instead of waiting
+        for the device to go idle. The window is not resizable, so only the
+        images change; everything sized by the extent stays as it is.
+        framebufferSize comes from the snapshot, read on the main thread.
+        Returns false while the window is minimized, try again later. */
+        bool RecreateSwapChain(VkExtent2D framebufferSize)
+        {
+            SwapChain::SupportDetails support = SwapChain::QuerySupport(m_physicalDevice, m_surface);
+            if (0 == support.capabilities.currentExtent.width || 0 == support.capabilities.currentExtent.height)
+            {
+                return false;
+            }
+
+            VkSwapchainKHR oldSwapChain = m_swapChain;
+            VkFormat       format       = m_swapChainImageFormat;
+            VkExtent2D     extent       = m_swapChainExtent;
+            SwapChain::Create(m_swapChain, m_physicalDevice, m_device, m_surface, framebufferSize, m_swapChainImages, m_swapChainImageFormat, m_swapChainExtent, oldSwapChain);
+
+            if (format != m_swapChainImageFormat || extent.width != m_swapChainExtent.width || extent.height != m_swapChainExtent.height)
+            {
+                throw std::runtime_error("Swap chain format or size changed, resizing is not supported !");
+            }
+
+            Retire::SwapChain(m_retire, oldSwapChain);
+            Retire::ImageViews(m_retire, m_swapChainImageViews);
             ImageViews::Create(m_device, m_swapChainImageViews, m_swapChainImages, m_swapChainImageFormat);
-            RenderPasses::Create(m_device, m_renderPass, m_swapChainImageFormat);
-            GraphicsPipeline::Create(m_graphicsPipeline, m_device, m_swapChainExtent, m_pipelineLayout, m_renderPass);
-            Buffers::Create(m_device, m_swapChainFramebuffers, m_swapChainImageViews, m_renderPass, m_swapChainExtent);
-            CommandPool::Create(m_device, m_physicalDevice, m_surface, m_commandPool);
-            CommandBuffer::Create(m_device, m_commandPool, m_commandBuffer);
-            SyncObjects::Create(m_device, m_imageAvailableSemaphore, m_renderFinishedSemaphore, m_inFlightFence);
+            if (Post::kFormat != m_sceneFormat)
+            {
+                Retire::Framebuffers(m_retire, m_swapChainFramebuffers);
+                Buffers::Create(m_device, m_swapChainFramebuffers, m_swapChainImageViews, m_depthImageView, m_renderPass, m_swapChainExtent, m_colorTarget.view);
+            }
+
+            // Post and dynamic resolution blit into the images by index, readback copies out of them.
+            m_post.swapChainImages = m_swapChainImages;
+            m_resolution.targets   = m_swapChainImages;
+            m_readback.images      = m_swapChainImages;
+
+            std::cout << "[swapchain] rebuilt, " << m_retire.entries.size() << " objects retired" << std::endl;
+            return true;
+        }
+
+        bool PostSupported()
+        {
+            SwapChain::SupportDetails support = SwapChain::QuerySupport(m_physicalDevice, m_surface);
+            if (0 == (support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || !Post::Supported(m_physicalDevice, m_swapChainImageFormat))
+            {
+                std::cout << "[post] swapchain blit unsupported, post disabled" << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /* A field of copies of the mesh, dense enough that most of it hides
+        behind the front rows while the camera orbits:
+            root -> 32 rows -> 32 copies each
+        Every fourth row bobs up and down, so only those subtrees are
+        recomputed and uploaded each frame. */
+        void CreateField()
+        {
+            const int side = 32;
+            m_fieldSpacing = std::max(m_mesh.bounds.radius, 0.01f) * 2.5f;
+            glm::vec4 sphere(m_mesh.bounds.center[0], m_mesh.bounds.center[1], m_mesh.bounds.center[2], m_mesh.bounds.radius);
+            glm::vec3 center(sphere);
+
+            uint32_t root = Scene::Add(m_scene, Scene::kNone, Scene::Transform{});
+            for (int z = 0; z < side; ++z)
+            {
+                Scene::Transform row;
+                row.position = glm::vec3(0.0f, 0.0f, (z - (side - 1) * 0.5f) * m_fieldSpacing);
+                m_fieldRows.push_back(Scene::Add(m_scene, root, row));
+
+                for (int x = 0; x < side; ++x)
+                {
+                    Scene::Transform copy;
+                    copy.position = glm::vec3((x - (side - 1) * 0.5f) * m_fieldSpacing, 0.0f, 0.0f) - center;
+                    Scene::Add(m_scene, m_fieldRows.back(), copy, sphere);
+                }
+            }
+
+            Objects::Create(m_device, m_physicalDevice, Scene::Count(m_scene), m_objects);
+
+            float halfExtent = side * m_fieldSpacing * 0.5f;
+            m_sceneBounds.center[0] = 0.0f;
+            m_sceneBounds.center[1] = 0.0f;
+            m_sceneBounds.center[2] = 0.0f;
+            m_sceneBounds.radius    = std::sqrt(2.0f) * halfExtent + m_mesh.bounds.radius;
+        }
+
+        void CreateOcclusionScene()
+        {
+            CreateField();
+
+            RenderPasses::Create(m_device, m_renderPassFirst, m_swapChainImageFormat, m_depthFormat, RenderPasses::Phase::First);
+            RenderPasses::Create(m_device, m_renderPassSecond, m_swapChainImageFormat, m_depthFormat, RenderPasses::Phase::Second);
+            Occlusion::Create(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, m_swapChainExtent, m_depthImageView, m_objects, m_mesh, m_occlusion);
+
+            m_renderContext.occlusion        = &m_occlusion;
+            m_renderContext.renderPassFirst  = m_renderPassFirst;
+            m_renderContext.renderPassSecond = m_renderPassSecond;
+        }
+
+        // Without indirect firstInstance the field is culled on the CPU and
+        // every visible object gets its own draw.
+        void CreateCpuCullScene()
+        {
+            CreateField();
+
+            m_objectSpheres.Resize(Scene::Count(m_scene));
+
+            // A capture logs draws in culling order, SkyReplay has to see the same order.
+            if (nullptr == m_renderContext.capture)
+            {
+                m_renderContext.queue = &m_renderQueue;
+            }
+
+            // Rows of copies behind each other, lots of overdraw.
+            m_depthPrepass = true;
+        }
+
+        void UpdateScene(double time)
+        {
+            if (!HasScene())
+            {
+                return;
+            }
+
+            for (size_t row = 0; row < m_fieldRows.size(); row += 4)
+            {
+                float height = std::sin(static_cast<float>(time) * 1.5f + row * 0.4f) * m_fieldSpacing * 0.5f;
+                glm::vec3 position(0.0f, height, (row - (m_fieldRows.size() - 1) * 0.5f) * m_fieldSpacing);
+                Scene::SetPosition(m_scene, m_fieldRows[row], position);
+            }
+
+            Scene::Update(m_scene, &m_jobs);
+
+            if (m_objectSpheres.Count() > 0)
+            {
+                for (uint32_t slot = m_scene.changedBegin; slot < m_scene.changedEnd; ++slot)
+                {
+                    m_objectSpheres.Set(slot, m_scene.worldSphere[slot]);
+                }
+            }
+        }
+
+        void UpdateCamera(double time, Snapshot& snapshot)
+        {
+            if (!HasScene())
+            {
+                return;
+            }
+
+            if (nullptr != m_renderContext.terrain)
+            {
+                Camera::Fly(m_camera, time, 24.0f, 72.0f, Terrain::kViewRadius * Terrain::kChunkSize * 1.25f);
+            }
+            else
+            {
+                Camera::Orbit(m_camera, m_sceneBounds, time);
+            }
+
+            snapshot.view           = Camera::View(m_camera);
+            snapshot.projection     = Camera::Projection(m_camera, m_swapChainExtent);
+            snapshot.viewProj       = snapshot.projection * snapshot.view;
+            snapshot.zNear          = m_camera.zNear;
+            snapshot.zFar           = m_camera.zFar;
+            snapshot.cameraPosition = m_camera.position;
+            Camera::FrustumPlanes(snapshot.viewProj, snapshot.frustumPlanes);
+        }
+
+        // Needs the new camera and frustum; only bookkeeping, the build jobs do the work.
+        void UpdateTerrain(const Snapshot& snapshot)
+        {
+            if (nullptr != m_renderContext.terrain)
+            {
+                Terrain::Update(m_terrain, snapshot.cameraPosition, snapshot.frustumPlanes);
+            }
+        }
+
+        // Needs both the updated spheres and the new frustum.
+        void Cull(Snapshot& snapshot)
+        {
+            if (m_objectSpheres.Count() > 0)
+            {
+                snapshot.visibleObjects.resize(m_objectSpheres.Count());
+                snapshot.visibleCount = FrustumCull::Cull(m_objectSpheres, snapshot.frustumPlanes, snapshot.visibleObjects.data(), FrustumCull::DetectIsa(), &m_jobs);
+            }
+        }
+
+        // An extra window orbits the same bounds, spread evenly round with the main one.
+        void UpdateOutput(double time, uint32_t index, Snapshot& snapshot)
+        {
+            if (nullptr == m_renderContext.mesh)
+            {
+                return;
+            }
+
+            float         offset = 6.2831853f * (index + 1) / (m_outputs.size() + 1);
+            Camera::State camera = m_camera;
+            Camera::Orbit(camera, m_sceneBounds, time, offset);
+
+            OutputView& view    = snapshot.outputs[index];
+            view.view           = Camera::View(camera);
+            view.projection     = Camera::Projection(camera, m_swapChainExtent);
+            view.viewProj       = view.projection * view.view;
+            view.cameraPosition = camera.position;
+
+            if (m_objectSpheres.Count() > 0)
+            {
+                glm::vec4 planes[6];
+                Camera::FrustumPlanes(view.viewProj, planes);
+                view.visibleObjects.resize(m_objectSpheres.Count());
+                view.visibleCount = FrustumCull::Cull(m_objectSpheres, planes, view.visibleObjects.data(), FrustumCull::DetectIsa(), &m_jobs);
+            }
+        }
+
+        // L toggles lighting, V cycles the debug views, P the depth prepass,
+        // A async against serial post. Main thread only.
+        void HandleInput()
+        {
+            bool lighting = GLFW_PRESS == glfwGetKey(m_window, GLFW_KEY_L);
+            bool view     = GLFW_PRESS == glfwGetKey(m_window, GLFW_KEY_V);
+            bool prepass  = GLFW_PRESS == glfwGetKey(m_window, GLFW_KEY_P);
+            bool async    = GLFW_PRESS == glfwGetKey(m_window, GLFW_KEY_A);
+
+            if (prepass && !m_prepassKey)
+            {
+                m_depthPrepass = !m_depthPrepass;
+                std::cout << "[depth] prepass " << (m_depthPrepass ? "on" : "off") << std::endl;
+            }
+            m_prepassKey = prepass;
+
+            if (async && !m_asyncPostKey)
+            {
+                m_asyncPost = !m_asyncPost;
+                std::cout << "[post] " << (m_asyncPost ? "async" : "serial") << std::endl;
+            }
+            m_asyncPostKey = async;
+
+            if (lighting && !m_lightingKey)
+            {
+                m_meshVariant.lighting = VK_TRUE == m_meshVariant.lighting ? VK_FALSE : VK_TRUE;
+            }
+            if (view && !m_viewKey)
+            {
+                m_meshVariant.view = (m_meshVariant.view + 1) % static_cast<uint32_t>(GraphicsPipeline::MeshView::Count);
+            }
+            if ((lighting && !m_lightingKey) || (view && !m_viewKey))
+            {
+                const char* views[] = {"shaded", "normals", "instances", "overdraw"};
+                std::cout << "[variant] lighting " << (VK_TRUE == m_meshVariant.lighting ? "on" : "off") << ", view " << views[m_meshVariant.view] << std::endl;
+            }
+
+            m_lightingKey = lighting;
+            m_viewKey     = view;
         }
 
+        /* One simulation tick as a job graph:
+            scene update, camera  ->  cull, terrain, one camera and cull per extra window
+        then the result is copied into the mailbox's back snapshot and
+        published. The slot was last published a few ticks ago, so the scene
+        arrays are copied whole rather than by changed range. */
+        void Simulate(double time)
+        {
+            Snapshot& snapshot = Mailbox::Back(m_snapshots);
+            HandleInput();
+
+            snapshot.outputs.resize(m_outputs.size());
+            for (size_t i = 0; i < m_outputs.size(); ++i)
+            {
+                snapshot.outputs[i].framebufferSize = Window::FramebufferSize(m_outputs[i].window);
+            }
+
+            Jobs::BeginFrame(m_jobs);
+            Jobs::Counter prepared;
+            Jobs::Counter culled;
+
+            Jobs::Run(m_jobs, [this, time]() { UpdateScene(time); }, &prepared);
+            Jobs::Run(m_jobs, [this, time, &snapshot]() { UpdateCamera(time, snapshot); }, &prepared);
+            Jobs::RunAfter(m_jobs, prepared, [this, &snapshot]() { Cull(snapshot); }, &culled);
+            Jobs::RunAfter(m_jobs, prepared, [this, &snapshot]() { UpdateTerrain(snapshot); }, &culled);
+            for (uint32_t i = 0; i < m_outputs.size(); ++i)
+            {
+                Jobs::RunAfter(m_jobs, prepared, [this, time, i, &snapshot]() { UpdateOutput(time, i, snapshot); }, &culled);
+            }
+            Jobs::Wait(m_jobs, culled);
+
+            snapshot.sequence        = ++m_sequence;
+            snapshot.time            = time;
+            snapshot.models          = m_scene.world;
+            snapshot.spheres         = m_scene.worldSphere;
+            snapshot.changedBegin    = m_scene.changedBegin;
+            snapshot.changedEnd      = m_scene.changedEnd;
+            snapshot.meshVariant     = m_meshVariant;
+            snapshot.depthPrepass    = m_depthPrepass;
+            snapshot.asyncPost       = m_asyncPost;
+            snapshot.framebufferSize = Window::FramebufferSize(m_window);
+
+            Mailbox::Publish(m_snapshots);
+        }
+
+        // Points the render context at a snapshot and uploads its objects
+        // and frame uniforms. Only after the fence wait in Draw::Acquire.
+        void Apply(const Snapshot& snapshot, uint64_t& lastSequence)
+        {
+            m_renderContext.view           = snapshot.view;
+            m_renderContext.projection     = snapshot.projection;
+            m_renderContext.viewProj       = snapshot.viewProj;
+            m_renderContext.cameraPosition = snapshot.cameraPosition;
+            m_renderContext.zNear          = snapshot.zNear;
+            m_renderContext.zFar           = snapshot.zFar;
+            std::copy(snapshot.frustumPlanes, snapshot.frustumPlanes + 6, m_renderContext.frustumPlanes);
+
+            m_renderContext.visibleObjects = snapshot.visibleObjects.empty() ? nullptr : snapshot.visibleObjects.data();
+            m_renderContext.visibleCount   = snapshot.visibleCount;
+            m_renderContext.spheres        = snapshot.spheres.empty() ? nullptr : snapshot.spheres.data();
+
+            // Every variant is baked at startup, this never compiles.
+            if (HasScene())
+            {
+                m_renderContext.meshPipeline      = Variants::Find(m_meshPipelines, snapshot.meshVariant);
+                m_renderContext.meshEqualPipeline = Variants::Find(m_meshPipelinesEqual, snapshot.meshVariant);
+            }
+
+            // The occlusion passes already draw front to back in two phases.
+            m_renderContext.depthPrepass = snapshot.depthPrepass && nullptr == m_renderContext.occlusion;
+            m_post.serial                = !snapshot.asyncPost;
+
+            if (HasScene())
+            {
+                UniformRing::FrameUniforms frame;
+                frame.view           = snapshot.view;
+                frame.projection     = snapshot.projection;
+                frame.viewProj       = snapshot.viewProj;
+                frame.cameraPosition = glm::vec4(snapshot.cameraPosition, 1.0f);
+
+                UniformRing::BeginFrame(m_uniforms);
+                m_renderContext.frameOffset = UniformRing::Push(m_uniforms, frame);
+
+                // Skipped snapshots had their own changed ranges, so upload everything.
+                uint32_t begin = snapshot.changedBegin;
+                uint32_t end   = snapshot.changedEnd;
+                if (snapshot.sequence == lastSequence)
+                {
+                    begin = end = 0;
+                }
+                else if (snapshot.sequence != lastSequence + 1)
+                {
+                    begin = 0;
+                    end   = m_objects.count;
+                }
+
+                Objects::Write(m_objects, snapshot.models.data(), snapshot.spheres.data(), begin, end);
+
+                if (nullptr != m_renderContext.capture)
+                {
+                    Capture::BeginFrame(m_capture, frame, snapshot.meshVariant);
+                    Capture::WriteObjects(m_capture, m_objects.count, snapshot.models.data(), snapshot.spheres.data(), begin, end);
+                }
+            }
+
+            m_renderContext.outputPasses.clear();
+            for (size_t i = 0; i < m_outputs.size() && i < snapshot.outputs.size(); ++i)
+            {
+                Outputs::Output& output = m_outputs[i];
+                if (!output.acquired)
+                {
+                    continue;
+                }
+
+                const OutputView& view = snapshot.outputs[i];
+                OutputPass pass;
+                pass.framebuffer    = output.framebuffers[output.imageIndex];
+                pass.extent         = output.extent;
+                pass.cameraPosition = view.cameraPosition;
+                pass.visibleObjects = view.visibleObjects.empty() ? nullptr : view.visibleObjects.data();
+                pass.visibleCount   = view.visibleCount;
+                if (HasScene())
+                {
+                    UniformRing::FrameUniforms frame;
+                    frame.view           = view.view;
+                    frame.projection     = view.projection;
+                    frame.viewProj       = view.viewProj;
+                    frame.cameraPosition = glm::vec4(view.cameraPosition, 1.0f);
+                    pass.frameOffset     = UniformRing::Push(m_uniforms, frame);
+                }
+                m_renderContext.outputPasses.push_back(pass);
+            }
+
+            lastSequence = snapshot.sequence;
+        }
+
+        // Render thread, after the main acquire. Out of date windows are
+        // rebuilt and sit the frame out, minimized ones are not waited on.
+        void AcquireOutputs(const Snapshot& snapshot)
+        {
+            Draw::Clear(m_batch);
+            for (size_t i = 0; i < m_outputs.size(); ++i)
+            {
+                Outputs::Output& output = m_outputs[i];
+                VkExtent2D       size   = i < snapshot.outputs.size() ? snapshot.outputs[i].framebufferSize : VkExtent2D{0, 0};
+                output.acquired = false;
+                if (0 == size.width || 0 == size.height)
+                {
+                    continue;
+                }
+                if (output.stale && !Outputs::Recreate(m_device, m_physicalDevice, output, size, m_retire, m_renderPass, m_depthImageView, m_colorTarget.view))
+                {
+                    continue;
+                }
+                if (!Outputs::Acquire(m_device, output))
+                {
+                    Outputs::Recreate(m_device, m_physicalDevice, output, size, m_retire, m_renderPass, m_depthImageView, m_colorTarget.view);
+                    continue;
+                }
+                if (!output.acquired)
+                {
+                    continue;
+                }
+
+                m_batch.imageAvailable.push_back(output.imageAvailable);
+                m_batch.swapChains.push_back(output.swapChain);
+                m_batch.imageIndices.push_back(output.imageIndex);
+            }
+        }
+
+        // Suboptimal or out of date after the shared present; stale ones are retried by AcquireOutputs.
+        void PresentedOutputs(const Snapshot& snapshot)
+        {
+            size_t presented = 0;
+            for (size_t i = 0; i < m_outputs.size(); ++i)
+            {
+                Outputs::Output& output = m_outputs[i];
+                if (!output.acquired)
+                {
+                    continue;
+                }
+
+                output.acquired = false;
+                if (VK_SUCCESS != m_batch.results[presented++])
+                {
+                    Outputs::Recreate(m_device, m_physicalDevice, output, snapshot.outputs[i].framebufferSize, m_retire, m_renderPass, m_depthImageView, m_colorTarget.view);
+                }
+            }
+        }
+
+        void PrintStats(double& lastPrint)
+        {
+            double now = glfwGetTime();
+            if (now - lastPrint < 1.0)
+            {
+                return;
+            }
+
+            if (nullptr != m_renderContext.clusters)
+            {
+                const ClusterCull::Stats& stats = m_renderContext.clusterStats;
+                std::cout << "[clusters] " << stats.visibleClusters << "/" << stats.clusters << " visible"
+                          << " (frustum " << stats.frustumCulled << ", backface " << stats.backfaceCulled << ")"
+                          << " triangles " << stats.renderedTriangles << "/" << stats.submittedTriangles << std::endl;
+            }
+
+            if (nullptr != m_renderContext.visibleObjects)
+            {
+                std::cout << "[frustum] " << m_renderContext.visibleCount << "/" << m_objects.count << " visible"
+                          << " (" << FrustumCull::IsaName(FrustumCull::DetectIsa()) << ")" << std::endl;
+            }
+
+            if (nullptr != m_renderContext.queue)
+            {
+                const RenderQueue::Stats& stats = m_renderQueue.stats;
+                std::cout << "[queue] " << stats.draws << " draws, pipeline binds " << stats.pipelineBinds << " (" << stats.pipelineBindsAvoided << " avoided)"
+                          << ", material binds " << stats.materialBinds << " (" << stats.materialBindsAvoided << " avoided)"
+                          << ", sort " << stats.sortMs << " ms, record " << stats.recordMs << " ms" << std::endl;
+            }
+
+            if (nullptr != m_renderContext.terrain)
+            {
+                const Terrain::Stats& stats = m_terrainGpu.stats;
+                std::cout << "[terrain] " << stats.drawn << "/" << stats.resident << " chunks drawn (lod " << stats.lodDrawn[0] << "/" << stats.lodDrawn[1] << "/" << stats.lodDrawn[2] << ")"
+                          << ", " << stats.triangles << " triangles, uploads " << stats.uploads << " (" << stats.uploadBytes / 1024 << " KB, " << stats.uploadMs << " ms)"
+                          << ", " << stats.waiting << " waiting, arena " << stats.arenaUsed / (1024 * 1024) << "/" << Terrain::kArenaSize / (1024 * 1024) << " MB in " << stats.pages << " pages"
+                          << " (" << stats.arenaFull << " full, " << stats.evicted << " chunks evicted)" << std::endl;
+            }
+
+            if (nullptr != m_renderContext.occlusion)
+            {
+                const Occlusion::Stats& stats = m_renderContext.occlusionStats;
+                std::cout << "[occlusion] " << stats.earlyDrawn + stats.lateDrawn << "/" << stats.objects << " drawn"
+                          << " (early " << stats.earlyDrawn << ", late " << stats.lateDrawn << ")"
+                          << " culled frustum " << stats.frustumCulled << ", occlusion " << stats.occlusionCulled << std::endl;
+            }
+
+            if (nullptr != m_renderContext.pipelineStats)
+            {
+                const PipelineStats::Counters& off = m_prepassCounters[0];
+                const PipelineStats::Counters& on  = m_prepassCounters[1];
+                std::cout << "[depth] prepass " << (m_renderContext.depthPrepass ? "on" : "off")
+                          << ", fragment invocations off " << off.fragmentInvocations << " / on " << on.fragmentInvocations
+                          << ", vertex invocations off " << off.vertexInvocations << " / on " << on.vertexInvocations << std::endl;
+
+                const PipelineStats::Frame& frame = m_renderContext.pipelineFrame;
+                for (uint32_t i = 0; i < frame.passCount; ++i)
+                {
+                    const PipelineStats::Pass& pass = frame.passes[i];
+                    std::cout << "[passes] " << pass.name << ": vertices " << pass.counters.vertexInvocations
+                              << ", clipping primitives " << pass.counters.clippingPrimitives
+                              << ", fragments " << pass.counters.fragmentInvocations
+                              << ", overdraw " << PipelineStats::Overdraw(pass) << "x" << std::endl;
+                }
+            }
+
+            if (nullptr != m_renderContext.resolution)
+            {
+                const DynamicResolution::Resources& resolution = m_resolution;
+                std::cout << "[resolution] " << resolution.renderExtent.width << "x" << resolution.renderExtent.height
+                          << " (" << static_cast<int>(resolution.scale * 100.0f + 0.5f) << "%)"
+                          << ", gpu " << resolution.gpuMs << " ms / budget " << resolution.settings.budgetMs << " ms" << std::endl;
+            }
+
+            if (HostMemory::kEnabled)
+            {
+                // Command scope is what the driver allocates per call, the
+                // rest lives as long as the objects, caches or device do.
+                const HostMemory::Tracker& host = HostMemory::Get();
+                std::cout << "[host] command " << host.lastFrameCommand << " allocations/frame, arena " << host.lastFrameArena / 1024 << " KB"
+                          << " (" << host.arenaOverflows.load(std::memory_order_relaxed) << " overflows)";
+                for (uint32_t scope = VK_SYSTEM_ALLOCATION_SCOPE_OBJECT; scope < HostMemory::kScopes; ++scope)
+                {
+                    const HostMemory::Counters& counters = host.scopes[scope];
+                    std::cout << ", " << HostMemory::ScopeName(scope) << " " << counters.liveBytes.load(std::memory_order_relaxed) / 1024 << " KB"
+                              << " (peak " << counters.peakBytes.load(std::memory_order_relaxed) / 1024 << " KB)";
+                }
+                std::cout << std::endl;
+            }
+
+            {
+                const Residency::Budget& budget = m_residency.budget;
+                const Residency::Stats&  stats  = m_residency.stats;
+                std::cout << "[memory] " << (budget.supported ? "budget" : "no budget extension, heap size");
+                for (uint32_t i = 0; i < budget.heapCount; ++i)
+                {
+                    const Residency::Heap& heap = budget.heaps[i];
+                    std::cout << ", heap " << i << (heap.deviceLocal ? " device " : " host ") << heap.usage / (1024 * 1024) << "/" << heap.budget / (1024 * 1024) << " MB";
+                }
+                std::cout << ", resident " << stats.resident << " (" << stats.residentBytes / (1024 * 1024) << " MB), evicted " << stats.evicted
+                          << ", " << stats.evictions << " evictions (" << stats.evictedBytes / (1024 * 1024) << " MB), " << stats.restores << " restores" << std::endl;
+            }
+
+            if (nullptr != m_renderContext.readback)
+            {
+                std::cout << "[readback] " << m_readback.written.load(std::memory_order_relaxed) << "/" << m_readback.frames << " frames written"
+                          << ", " << Readback::FramesPerSecond(m_readback) << " fps sustained, " << m_readback.stalls << " waits for an encoder" << std::endl;
+            }
+
+            if (nullptr != m_renderContext.post)
+            {
+                // Overlap is the part of the chain that ran while the next scene drew.
+                Post::Timings timings = Post::Reset(m_post);
+                double        frameMs = timings.frames > 0 ? (now - lastPrint) * 1000.0 / timings.frames : 0.0;
+                double        hidden  = timings.chainMs > 0.0 ? 100.0 * timings.overlapMs / timings.chainMs : 0.0;
+                std::cout << "[post] " << (m_post.serial || !m_post.async ? "serial" : "async")
+                          << ", scene " << timings.sceneMs << " ms, chain " << timings.chainMs << " ms"
+                          << ", overlap " << timings.overlapMs << " ms (" << static_cast<int>(hidden + 0.5) << "%)"
+                          << ", frame " << frameMs << " ms" << std::endl;
+            }
+
+            lastPrint = now;
+        }
+
+        // Renders the newest snapshot as fast as the swap chain allows,
+        // the same one again if the simulation has not ticked since.
+        void RenderLoop()
+        {
+            double   lastPrint    = 0.0;
+            uint64_t lastSequence = 0;
+            bool     firstFrame   = true;
+
+            while (m_rendering.load(std::memory_order_acquire))
+            {
+                Mailbox::Take(m_snapshots);
+                const Snapshot& snapshot = Mailbox::Front(m_snapshots);
+                // Offline output writes every tick once, not the same one again.
+                if (0 == snapshot.sequence || (nullptr != m_renderContext.readback && snapshot.sequence == lastSequence))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                uint32_t imageIndex;
+                bool     acquired = Draw::Acquire(m_device, m_inFlightFence, m_swapChain, m_imageAvailableSemaphore, m_commandBuffer, m_renderContext, imageIndex);
+                Retire::Collect(m_device, m_retire);
+                HostMemory::BeginFrame();
+                if (nullptr != m_renderContext.readback)
+                {
+                    Readback::Collect(m_readback);
+                }
+                if (!acquired)
+                {
+                    if (!RecreateSwapChain(snapshot.framebufferSize))
+                    {
+                        std::this_thread::yield();
+                    }
+                    continue;
+                }
+
+                AcquireOutputs(snapshot);
+                Residency::Update(m_physicalDevice, m_residency);
+                m_prepassCounters[m_renderContext.depthPrepass ? 1 : 0] = m_renderContext.pipelineFrame.total;
+                Apply(snapshot, lastSequence);
+                if (nullptr != m_renderContext.readback)
+                {
+                    Readback::Reserve(m_readback);
+                }
+                CommandBuffer::Record(m_commandPool, m_commandBuffer, imageIndex, m_renderPass, m_swapChainFramebuffers, m_swapChainExtent, m_graphicsPipeline, m_renderContext);
+                if (nullptr != m_renderContext.capture && !Capture::EndFrame(m_capture))
+                {
+                    m_renderContext.capture = nullptr;
+                    std::cout << "[capture] " << CAPTURE_FRAMES << " frames written to " << m_capturePath << std::endl;
+                }
+                bool presented = nullptr != m_renderContext.post
+                    ? Post::Submit(m_post, m_inFlightFence, m_swapChain, m_imageAvailableSemaphore, m_commandBuffer, m_renderFinishedSemaphore, m_graphicsQueue, m_computeQueue, m_presentQueue, imageIndex)
+                    : Draw::Submit(m_inFlightFence, m_swapChain, m_imageAvailableSemaphore, m_commandBuffer, m_renderFinishedSemaphore, m_graphicsQueue, m_presentQueue, imageIndex, &m_batch);
+                Retire::Submitted(m_retire);
+                PresentedOutputs(snapshot);
+                m_rendered.store(snapshot.sequence, std::memory_order_release);
+                if (nullptr != m_renderContext.readback)
+                {
+                    glfwPostEmptyEvent(); // wakes Loop for the next fixed step
+                }
+                if (firstFrame)
+                {
+                    firstFrame = false;
+                    std::cout << "[startup] first frame submitted " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count() << " ms after start" << std::endl;
+                }
+                if (!presented)
+                {
+                    RecreateSwapChain(snapshot.framebufferSize);
+                }
+                PrintStats(lastPrint);
+            }
+        }
+
+        /* Render thread entry. An exception would terminate the process from
+        a std::thread, so it stops rendering instead, wakes the main thread
+        and is rethrown there once everything is torn down. */
+        void RenderThread()
+        {
+            try
+            {
+                RenderLoop();
+            }
+            catch (...)
+            {
+                m_renderError = std::current_exception();
+                m_rendering.store(false, std::memory_order_release);
+                glfwPostEmptyEvent();
+            }
+        }
+
+        // Main thread. Every window shows the same run, closing any of them ends it.
+        bool ShouldClose()
+        {
+            bool close = glfwWindowShouldClose(m_window);
+            for (const Outputs::Output& output : m_outputs)
+            {
+                close = close || glfwWindowShouldClose(output.window);
+            }
+            return close;
+        }
+
+        /* The main thread only handles GLFW events and ticks the simulation
+        at SIMULATION_RATE; all Vulkan work after Create happens on the
+        render thread. A stalled acquire or fence wait no longer delays
+        input, and slow event handling no longer delays a frame.
+        Offline output ticks once per rendered frame instead, at a fixed
+        step of simulated time, so no tick is skipped and none is written
+        twice however slow the encoders are. */
         void Loop()
         {
-            while (!glfwWindowShouldClose(m_window))
+            m_rendering.store(true, std::memory_order_release);
+            m_renderThread = std::thread(&Visuals::RenderThread, this);
+
+            double step    = 1.0 / SIMULATION_RATE;
+            double next    = glfwGetTime();
+            bool   offline = nullptr != m_renderContext.readback;
+
+            while (!ShouldClose() && m_rendering.load(std::memory_order_acquire))
             {
-                glfwPollEvents();
-                Draw::Frame(m_device, m_inFlightFence, m_swapChain, m_imageAvailableSemaphore, m_commandBuffer, m_commandPool, m_renderPass, m_swapChainFramebuffers, m_swapChainExtent, m_graphicsPipeline, m_renderFinishedSemaphore, m_graphicsQueue, m_presentQueue);
+                if (offline)
+                {
+                    if (m_rendered.load(std::memory_order_acquire) == m_sequence)
+                    {
+                        glfwPollEvents();
+                        Simulate(m_sequence * step);
+                    }
+                    else
+                    {
+                        glfwWaitEvents();
+                    }
+                    continue;
+                }
+
+                double wait = next - glfwGetTime();
+                if (wait > 0.0)
+                {
+                    glfwWaitEventsTimeout(wait);
+                }
+                else
+                {
+                    glfwPollEvents();
+                }
+
+                double now = glfwGetTime();
+                if (now < next)
+                {
+                    continue;
+                }
+
+                // Ticks that were missed are dropped, not caught up on.
+                next = std::max(next + step, now);
+                Simulate(now);
             }
 
+            m_rendering.store(false, std::memory_order_release);
+            m_renderThread.join();
+            Terrain::Destroy(m_terrain);
+
+            // Presentation is not fenced, teardown is the one place that idles.
             vkDeviceWaitIdle(m_device);
         }
 
         void Destroy()
         {
+            Retire::Flush(m_device, m_retire);
+
+            if (HasScene())
+            {
+                if (nullptr != m_renderContext.occlusion)
+                {
+                    Occlusion::Destroy(m_device, m_occlusion);
+                    RenderPasses::Destroy(m_device, m_renderPassSecond);
+                    RenderPasses::Destroy(m_device, m_renderPassFirst);
+                }
+
+                ClusterCull::Destroy(m_device, m_clusterCull);
+                Variants::Destroy(m_device, m_meshPipelinesEqual);
+                vkDestroyPipeline(m_device, m_depthPrepassPipeline, HostMemory::Callbacks());
+                GraphicsPipeline::DestroyMeshVariants(m_device, m_meshPipelines, m_meshPipelineLayout);
+                Objects::Destroy(m_device, m_objects);
+                UniformRing::Destroy(m_device, m_uniforms);
+                Mesh::Destroy(m_device, m_mesh);
+                Terrain::Destroy(m_device, m_terrainGpu);
+            }
+
+            Capture::Destroy(m_capture);
+            if (nullptr != m_renderContext.readback)
+            {
+                Readback::Destroy(m_device, m_readback);
+                std::cout << "[readback] " << m_readback.written.load(std::memory_order_relaxed) << " frames written to " << m_readback.prefix << "_*" << std::endl;
+            }
+            PipelineStats::Destroy(m_device, m_pipelineStats);
             SyncObjects::Destroy(m_device, m_imageAvailableSemaphore, m_renderFinishedSemaphore, m_inFlightFence);
             CommandPool::Destoy(m_device, m_commandPool);
+            Post::Destroy(m_device, m_post);
+            DynamicResolution::Destroy(m_device, m_resolution);
             Buffers::Destroy(m_device, m_swapChainFramebuffers);
             GraphicsPipeline::Destroy(m_device, m_graphicsPipeline, m_pipelineLayout);
             RenderPasses::Destroy(m_device, m_renderPass);
+            Depth::Destroy(m_device, m_depthImage, m_depthImageMemory, m_depthImageView);
+            Multisample::Destroy(m_device, m_colorTarget);
             ImageViews::Destroy(m_device, m_swapChainImageViews);
+            for (Outputs::Output& output : m_outputs)
+            {
+                Outputs::Destroy(m_device, m_instance, output);
+            }
             SwapChain::Destroy(m_swapChain, m_device);
             Surface::Destroy(m_instance, m_surface);
+            PipelineCache::Save(m_device, PipelineCache::kPath);
+            PipelineCache::Destroy(m_device);
+            Dispatch::Unload(Dispatch::Device());
             LogicalDevice::Destroy(m_device);
             // PhysicalDevice::
             DebugUtils::Destroy(m_instance, m_debugMessenger);
             Instance::Destroy(m_instance);
             Window::Destroy(m_window);
             Glfw::Destroy();
+            Jobs::Destroy(m_jobs);
+            HostMemory::Release();
         }
     };
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vector>
 #include "DebugUtils.h"
 #include "GraphicsPipeline.h"
+#include "HostMemory.h"
 
 
 namespace Visuals
@@ -52,7 +53,7 @@ namespace Visuals
             createInfo.ppEnabledExtensionNames = extensions.data();
 
 
-            if (VK_SUCCESS != vkCreateInstance(&createInfo, nullptr, &instance))
+            if (VK_SUCCESS != vkCreateInstance(&createInfo, HostMemory::Callbacks(), &instance))
             {
                 throw std::runtime_error("Failed to create VULKAN instance !");
             }
@@ -60,7 +61,7 @@ namespace Visuals
 
         void Destroy(VkInstance& instance)
         {
-            vkDestroyInstance(instance, nullptr);
+            vkDestroyInstance(instance, HostMemory::Callbacks());
         }
 
         std::vector<const char*> GetRequiredExtensions()
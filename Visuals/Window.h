@@ -40,6 +40,14 @@ namespace Visuals
             glfwMakeContextCurrent(window);
         }
 
+        // Main thread only, like every GLFW window call.
+        VkExtent2D FramebufferSize(GLFWwindow* window)
+        {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        }
+
         void Destroy(GLFWwindow* window)
         {
             if (nullptr != window)
@@ -1,9 +1,82 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "Visuals/Visuals.h"
 
-int main()
+static const char* kUsage = "[--mesh file.skym | --terrain] [--msaa samples] [--min-scale scale] [--post] [--capture file.skyc] [--windows count] [--output frames.png | frames.raw]";
+
+int main(int argc, char** argv)
 {
-    Visuals::Visuals vis;
+    const char* mesh     = nullptr;
+    uint32_t    samples  = 1;
+    float       minScale = 1.0f;
+    bool        post     = false;
+    const char* capture  = nullptr;
+    uint32_t    windows  = 1;
+    const char* output   = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool        used  = true;
+
+        if (0 == strcmp(argv[i], "--terrain"))
+        {
+            mesh = "terrain";
+            used = false;
+        }
+        else if (0 == strcmp(argv[i], "--post"))
+        {
+            post = true;
+            used = false;
+        }
+        else if (nullptr == value)
+        {
+            std::cerr << "Usage: " << argv[0] << " " << kUsage << std::endl;
+            return EXIT_FAILURE;
+        }
+        else if (0 == strcmp(argv[i], "--mesh"))
+        {
+            mesh = value;
+        }
+        else if (0 == strcmp(argv[i], "--msaa"))
+        {
+            samples = static_cast<uint32_t>(std::atoi(value));
+        }
+        else if (0 == strcmp(argv[i], "--min-scale"))
+        {
+            minScale = static_cast<float>(std::atof(value));
+        }
+        else if (0 == strcmp(argv[i], "--capture"))
+        {
+            capture = value;
+        }
+        else if (0 == strcmp(argv[i], "--windows"))
+        {
+            windows = static_cast<uint32_t>(std::atoi(value));
+        }
+        else if (0 == strcmp(argv[i], "--output"))
+        {
+            output = value;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " " << kUsage << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        i += used ? 1 : 0;
+    }
+
+    try
+    {
+        Visuals::Visuals vis(mesh, samples, minScale, post, capture, windows, output);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return 0;
-}
\ No newline at end of file
+}